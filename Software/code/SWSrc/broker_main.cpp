@@ -0,0 +1,87 @@
+// broker_main.cpp : Defines the entry point for the broker console application.
+//
+// Usage: broker_main [-<driverVersion>] [-n<name>] [FPGA_MAC_addr]
+// Opens the board and serves it to BROKER_SIRC clients in other processes, as the
+// broker called name (default "sirc"), until Ctrl-C.  See sirc_broker.h.
+//
+
+#include "sirc_internal.h"
+
+using namespace std;
+
+static SIRC_BROKER * volatile broker;
+
+void error(string inErr){
+	cerr << "Error:" << endl;
+	cerr << "\t" << inErr << endl;
+
+    PrintZeLog();
+	exit(-1);
+}
+
+//Ctrl-C, Ctrl-Break, closing the console
+BOOL WINAPI stopBroker(DWORD ctrlType)
+{
+    SIRC_BROKER *running = broker;
+
+    if (running)
+        running->stop();
+    return TRUE;
+}
+
+int main(int argc, char* argv[])
+{
+    uint8_t FPGA_ID[6];
+    uint32_t driverVersion = 0;
+    wchar_t name[SIRC_BROKER_MAX_NAME + 1] = L"sirc";
+    size_t converted;
+    SIRC *device;
+    SIRC_BROKER_STATISTICS statistics;
+
+	std::ostringstream tempStream;
+
+    /* args? */
+    memset(FPGA_ID, 0xAA, sizeof(FPGA_ID));
+    for (int a = 1; a < argc; a++) {
+        if (argv[a][0] != '-') {
+            if (hexToFpgaId(argv[a], FPGA_ID, sizeof(FPGA_ID)) != 6)
+                error("Invalid MAC address " + (string) argv[a]);
+        } else if (argv[a][1] == 'n')
+            mbstowcs_s(&converted, name, SIRC_BROKER_MAX_NAME + 1, argv[a] + 2, _TRUNCATE);
+        else
+            driverVersion = atoi(argv[a]+1);
+    }
+
+    device = openSirc(FPGA_ID, driverVersion);
+    if (device == NULL)
+        error("Unable to find a suitable SIRC driver");
+    if (device->getLastError() != 0) {
+        tempStream << "Constructor failed with code " << (int) device->getLastError();
+        error(tempStream.str());
+    }
+
+    broker = new SIRC_BROKER(device, name, true);
+    if (broker->getLastError() != 0) {
+        tempStream << "Broker failed with code " << (int) broker->getLastError();
+        error(tempStream.str());
+    }
+    SetConsoleCtrlHandler(stopBroker, TRUE);
+
+    printf("Serving the board as broker %S, Ctrl-C to stop\n", name);
+    if (!broker->run()) {
+        tempStream << "Cannot serve, code " << (int) broker->getLastError() << " (is another broker running?)";
+        error(tempStream.str());
+    }
+
+    broker->getStatistics(&statistics);
+    printf("%u clients, %I64u calls, %I64u of them waited %I64u usec for their turn\n",
+           statistics.connects, statistics.calls, statistics.waits, statistics.waitedUsec);
+
+    SIRC_BROKER *stopped = broker;
+    broker = NULL;
+    delete stopped;
+
+    PrintZeLog();
+
+	return 0;
+}
@@ -80,6 +80,65 @@
 //This number should be smaller than NUMOUTSTANDINGREADS
 #define NUMOUTSTANDINGWRITES 250
 
+//******These control the online tuner (see tuneAfterBurst).
+//With autoTune on, the two limits above are only caps.  We start with a small receive
+// pool and write window and grow them only as far as the traffic actually needs.
+//Smallest receive pool we keep posted, and the initial write window.
+#define MINOUTSTANDINGREADS 16
+#define MINOUTSTANDINGWRITES 8
+
+//Receives we keep posted beyond the largest burst of responses we expect
+#define RECEIVEMARGIN 8
+
+//After this many bursts without a drop we try to give some receives back
+#define TUNEEPOCH 32
+
+//******Discovery probe (see probe)
+//Receives the constructor posts.  The rest of the pool is posted when the first
+// transfer needs it, so a board that is not there costs us next to nothing.
+#define PROBERECEIVES 4
+
+//The controller acknowledges a reset itself, a board that is there answers within a
+// round trip.  These keep a missing board from holding up openSirc for seconds.
+#define PROBETIMEOUT 100
+#define PROBERETRIES 2
+
+//******Priority lanes
+//While control commands from another thread are in flight the bulk lane checks on
+// them at least this often (in milliseconds), to retransmit them if needed.
+#define CONTROLPOLLSLICE 10
+
+//******Dedicated I/O thread (PARAMETERS::ioThread)
+//With control commands in flight the idle I/O thread looks for new submissions this
+// often (in milliseconds).  Otherwise it sleeps until something is submitted.
+#define IOTHREADPOLLSLICE 1
+
+//..but wakes up this often (in milliseconds) to recycle stray frames into the receive pool
+#define IOTHREADIDLETIME 100
+
+//******Recovery
+//quiesce looks at the abandoned responses this often (in milliseconds)
+#define QUIESCESLICE 10
+
+//******Payload compression (see sirc_codec.h)
+//How long we wait for the FPGA to answer a negotiate.  Older hardware never does,
+// so this is kept short.
+#define NEGOTIATETIMEOUT 250
+
+//After a write frame that did not compress, send this many plain frames before
+// trying again.  Keeps the cost down on data that does not compress at all.
+#define CODINGBACKOFF 8
+
+//******Receive credits (see SircWire::Credit)
+//With receive credits, how many credit frames we send per burst as receives are reposted.
+//More keep the FPGA going with fewer receives, at the cost of more frames to it.
+#define CREDITSPERBURST 4
+
+//******Payload checksums (see sirc_crc.h)
+//Slowest rate (bytes per millisecond) we expect the FPGA to checksum its buffers at.
+//A checksum request waits readTimeout plus however long that takes for its length.
+#define CHECKSUMBYTESPERMSEC (1024 * 100)
+
 //******
 //******Other (internal) constants.
 //******
@@ -120,10 +179,39 @@
 //Constructor for the class
 //FPGA_ID: 6 byte array containing the MAC adddress of the destination FPGA
 //Return with an error code if anything goes wrong.
-SIRC_DLL_LINKAGE ETH_SIRC::ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wchar_t *nicName){
-	setLastError(0);
+SIRC_DLL_LINKAGE ETH_SIRC::ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wchar_t *nicName,
+                                     BOOL contact){
+    nic = NULL;
 	//Make connection to NIC driver
-    PacketDriver = OpenPacketDriver(nicName,driverVersion,false);
+    initialize(OpenPacketDriver(nicName,driverVersion,false), FPGA_ID, contact);
+}
+
+//Constructor for a session on a shared NIC
+//nic: owns the packet driver and sorts what it receives by board
+SIRC_DLL_LINKAGE ETH_SIRC::ETH_SIRC(ETH_NIC *nic, uint8_t *FPGA_ID, BOOL contact){
+    this->nic = nic;
+    initialize(nic->getDriver(), FPGA_ID, contact);
+}
+
+//The rest of construction, on the given packet driver (NULL if it did not open)
+void ETH_SIRC::initialize(PACKET_DRIVER *driver, uint8_t *FPGA_ID, BOOL contact){
+    wireOwner = 0;
+    wireDepth = 0;
+    wireError = 0;
+	setLastError(0);
+    Steering = NULL;
+    bulkLane = -1;
+    controlLane = -1;
+    codeBuffer = NULL;
+    fec = NULL;
+    io = NULL;
+    ioThread = 0;
+    InitializeCriticalSection(&wireLock);
+    InitializeCriticalSection(&laneLock);
+    bulkDepth = 0;
+    controlPending = 0;
+
+    PacketDriver = driver;
     if (!PacketDriver) {
         setLastError(FAILDRIVERPRESENT);
 		return;
@@ -142,7 +230,7 @@ SIRC_DLL_LINKAGE ETH_SIRC::ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wc
          << setw(2) << (int)ethHeader.My_MACAddress[5] << dec << endl;
 #endif
 
-    //See how many outstanding packets we can have
+    //See how many outstanding packets we can have (our share, on a shared NIC)
     if (!PacketDriver->GetMaxOutstanding(&maxOutstandingReads,
                                          &maxOutstandingWrites)) {
         setLastError(FAILVMNSDRIVERACTIVE);//should not happen really
@@ -162,6 +250,34 @@ SIRC_DLL_LINKAGE ETH_SIRC::ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wc
     maxInputDataBytes  = MAXINPUTDATABYTEADDRESS;
     maxOutputDataBytes = MAXOUTPUTDATABYTEADDRESS;
 
+    //Start the tuner small, it will grow what it needs
+    autoTune           = true;
+    postedReceives     = 0;
+    targetReceives     = MINOUTSTANDINGREADS;
+    writeWindow        = MINOUTSTANDINGWRITES;
+    slowStart          = true;
+    burstHighWater     = 0;
+    cleanBursts        = 0;
+    tunerDecisions     = 0;
+    clampTuner();
+
+    //Plain frames until asked for and agreed to
+    compression        = 0;
+    codingMisses       = 0;
+    fecGroup           = 0;
+    fecRecovered       = 0;
+    fecParityFrames    = 0;
+    creditFlow         = false;
+    readCredits        = SircWire::CreditRead::keep;
+    creditBatch        = 1;
+    creditsOwed        = 0;
+    creditGrants       = 0;
+
+    streamSweep        = 0;
+    streamAcks         = 0;
+    streamResent       = false;
+    streamWaited       = false;
+
 	if(FPGA_ID == NULL){
 		PRINTF(("Invalid destination MAC address given!\n"));
 		setLastError(INVALIDFPGAMACADDRESS);
@@ -170,10 +286,37 @@ SIRC_DLL_LINKAGE ETH_SIRC::ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wc
 
 	memcpy(ethHeader.FPGA_MACAddress, FPGA_ID, 6);
 
+    //Only frames from our FPGA make it to us, already sorted by lane
+    if (nic) {
+        int8_t error = nic->addSession(ethHeader.FPGA_MACAddress, "wrgzqup", "kymnjfch", &bulkLane, &controlLane);
+        if (error) {
+            setLastError(error);
+            return;
+        }
+        //The shares just got smaller
+        (void) nic->getShares(&maxOutstandingReads, &maxOutstandingWrites);
+        if (maxOutstandingReads == 0)
+            maxOutstandingReads = NUMOUTSTANDINGREADS;
+        if (maxOutstandingWrites == 0)
+            maxOutstandingWrites = NUMOUTSTANDINGWRITES;
+        clampTuner();
+    } else {
+        Steering = new PACKET_STEERING(PacketDriver, MAXPACKETSIZE, recycleReceive, this);
+        bulkLane = Steering->AddConsumer(ethHeader.FPGA_MACAddress, "wrgzqup");
+        controlLane = Steering->AddConsumer(ethHeader.FPGA_MACAddress, "kymnjfch");
+    }
+
 	outstandingTransmits = 0;
     currentPacket = NULL;
     currentBuffer = NULL;
 
+    codeBuffer = (uint8_t *) malloc(MAXPACKETDATASIZE);
+    fec = (SIRC_FEC_GROUP *) calloc(1, sizeof(SIRC_FEC_GROUP));
+    if(!codeBuffer || !fec){
+        setLastError(FAILMEMALLOC);
+        return;
+    }
+
 #ifdef DEBUG
 	writeResends = 0;
 	readResends = 0;
@@ -183,25 +326,27 @@ SIRC_DLL_LINKAGE ETH_SIRC::ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wc
 	writeAndRunResends = 0;
 #endif
 
-	//Queue up a bunch of receives
-	//We want to keep this full, so every time we read
-	// one out we should add one back.
-	for(UINT32 i = 0; i < maxOutstandingReads; i++){
-		if(!addReceive()){
-            return;
-		}
+	//Queue up just enough receives to make contact.
+	//ensureReceiveCapacity fills the pool before the first transfer, and from then on
+	// every time we read one out we add one back.
+	while (postedReceives < PROBERECEIVES) {
+		if (!addReceive())
+			return;
 	}
-	
+
 	//Send a soft reset to make sure that the user circuit is not running.
-    LogIt(LOGIT_TIME_MARKER);
-	if(!sendReset()){
+	//Discovery probes instead, with short timeouts.
+	if (contact && !sendReset())
 		setLastError(FAILINITIALCONTACT);
-	}
 
 	return;
 }
 
 ETH_SIRC::~ETH_SIRC(){
+    //Submitted requests still use everything below
+    finishAsync();
+    stopIoThread();
+
 	PRINTF(("Write Resends = %d\n", writeResends));
 	PRINTF(("Read Resends = %d\n", readResends));
 	PRINTF(("Param Reg Write Resends = %d\n", paramWriteResends));
@@ -210,7 +355,40 @@ ETH_SIRC::~ETH_SIRC(){
 	PRINTF(("Param Reg Read Resends = %d\n", paramReadResends));
 	PRINTF(("Write and Run Resends = %d\n", writeAndRunResends));
 
-    delete PacketDriver;
+    //Those the driver still has go with it, or stay with the shared NIC's
+    freeRetiredTransmits();
+
+    if (nic) {
+        //The driver stays, and so do our receives, for the other sessions to retire
+        if (bulkLane >= 0)
+            nic->removeSession(bulkLane, controlLane, postedReceives);
+    } else {
+        delete Steering;
+        delete PacketDriver;
+    }
+    free(codeBuffer);
+    free(fec);
+    DeleteCriticalSection(&laneLock);
+    DeleteCriticalSection(&wireLock);
+}
+
+//Soft reset with the probe timeouts, then back to the configured ones
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::probe(){
+    uint32_t savedTimeout = writeTimeout;
+    uint32_t savedRetries = maxRetries;
+    BOOL ok;
+
+    writeTimeout = PROBETIMEOUT;
+    maxRetries = PROBERETRIES;
+    LogIt(LOGIT_TIME_MARKER);
+    ok = sendReset();
+    writeTimeout = savedTimeout;
+    maxRetries = savedRetries;
+
+    if (!ok)
+        setLastError(FAILINITIALCONTACT);
+    return ok;
 }
 
 //Dynamic parameters
@@ -227,14 +405,22 @@ BOOL ETH_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLen
     params.maxRetries           = maxRetries;
     params.maxOutstandingReads  = maxOutstandingReads;
     params.maxOutstandingWrites = maxOutstandingWrites;
-
-    if (maxOutLength >= sizeof(*outParameters)) {
-        *outParameters = params;
+    params.autoTune             = autoTune;
+    params.postedReceives       = postedReceives;
+    params.writeWindow          = writeWindow;
+    params.tunerDecisions       = tunerDecisions;
+    params.compression          = compression;
+    params.ioThread             = ioThread;
+    params.fecGroup             = fecGroup;
+    params.fecRecovered         = fecRecovered;
+    params.fecParityFrames      = fecParityFrames;
+    params.receiveCredits       = creditFlow ? 1 : 0;
+    params.creditGrants         = creditGrants;
+
+    if (copyParameters(&params, outParameters, maxOutLength)) {
         setLastError(0);
         return true;
     }
-    //Wants to know version or partial (or error)
-    memcpy(outParameters,&params,maxOutLength);
     setLastError(INVALIDLENGTH);
     return false;
 }
@@ -243,8 +429,9 @@ BOOL ETH_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLen
 BOOL ETH_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
 {
     //Sometimes you got to know what you are doing.
-    if ((length < sizeof(*inParameters)) ||
-        (inParameters->myVersion < SIRC_PARAMETERS_CURRENT_VERSION)){
+    //Older callers do not know about the tuner, compression, the I/O thread, FEC or credits,
+    // leave those alone.
+    if (!parametersLengthValid(inParameters, length)){
         setLastError(INVALIDLENGTH);
         return false;
     }
@@ -271,13 +458,41 @@ BOOL ETH_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t leng
         return false;
     }
 
-    
+    //Nothing below can run under the I/O thread.  It is started again (or not) at the end.
+    stopIoThread();
+
     maxInputDataBytes    = inParameters->maxInputDataBytes;
     maxOutputDataBytes   = inParameters->maxOutputDataBytes;
     writeTimeout         = inParameters->writeTimeout;
     readTimeout          = inParameters->readTimeout;
     maxRetries           = inParameters->maxRetries;
 
+    if (inParameters->myVersion >= 2)
+        autoTune         = (inParameters->autoTune != 0);
+    if (inParameters->myVersion >= 4)
+        ioThread         = inParameters->ioThread;
+
+    //Fit the tuner into the (possibly) new limits
+    clampTuner();
+    BOOL ok = resizeReceivePool();
+
+    //Only bother the FPGA if the request changed
+    if (ok && (inParameters->myVersion >= 3) && (inParameters->compression != compression))
+        ok = negotiateFeatures(inParameters->compression);
+    if (ok && (inParameters->myVersion >= 5) && (inParameters->fecGroup != fecGroup))
+        ok = negotiateFec(inParameters->fecGroup);
+    if (ok && (inParameters->myVersion >= 6) && ((inParameters->receiveCredits != 0) != (creditFlow != 0)))
+        ok = negotiateCredits(inParameters->receiveCredits != 0);
+
+    //Whatever else happened, the I/O thread is back if wanted
+    int8_t error = getLastError();
+    if (!startIoThread())
+        return false;
+    if (!ok) {
+        setLastError(error);
+        return false;
+    }
+
     setLastError(0);
     return true;
 }
@@ -303,6 +518,344 @@ BOOL ETH_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t leng
 #define BIGDEBUG_packet_matched(_P_)                                              \
     BIGDEBUG_ONLY({printf("Matched in scoreboard packet @ %p!\n", _P_);});
 
+//Scoped ownership of the wire.
+//Bulk commands always take the wire, waiting for whoever has it.
+//Control commands take it if they can.  If a bulk command has it they queue their
+// request instead, and the bulk command sends it ahead of its own traffic.  If another
+// control command has it they wait to be told it is free (or taken by a bulk command).
+class ETH_SIRC::LaneGuard {
+public:
+    //Bulk lane
+    LaneGuard(ETH_SIRC *sirc) : owner(sirc), bulk(true), wire(true) {
+        EnterCriticalSection(&owner->wireLock);
+        took();
+        EnterCriticalSection(&owner->laneLock);
+        owner->bulkDepth++;
+        //Control commands waiting for the wire can queue now
+        wakeWaiters();
+        LeaveCriticalSection(&owner->laneLock);
+    }
+
+    //Control lane
+    LaneGuard(ETH_SIRC *sirc, CONTROL_REQUEST *request) : owner(sirc), bulk(false), wire(false) {
+        HANDLE wake = NULL;
+
+        for (;;) {
+            EnterCriticalSection(&owner->laneLock);
+            //Free, or we already have it (sendWriteAndRun does a sendReset)
+            if (TryEnterCriticalSection(&owner->wireLock)) {
+                wire = true;
+                took();
+                break;
+            }
+            if (owner->bulkDepth) {
+                request->done = CreateEvent(NULL, TRUE, FALSE, NULL);
+                if (request->done) {
+                    owner->controlQueue.push_back(request);
+                    InterlockedIncrement(&owner->controlPending);
+                } else
+                    request->error = FAILMEMALLOC;
+                break;
+            }
+            //Another control command has it, those are short
+            if (!wake)
+                wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+            if (!wake) {
+                request->error = FAILMEMALLOC;
+                break;
+            }
+            owner->wireWaiters.push_back(wake);
+            LeaveCriticalSection(&owner->laneLock);
+            WaitForSingleObject(wake, INFINITE);
+        }
+        LeaveCriticalSection(&owner->laneLock);
+        if (wake)
+            CloseHandle(wake);
+    }
+
+    ~LaneGuard() {
+        if (bulk) {
+            EnterCriticalSection(&owner->laneLock);
+            uint32_t depth = --owner->bulkDepth;
+            LeaveCriticalSection(&owner->laneLock);
+            //Nobody can queue anymore, finish what was queued.
+            if (depth == 0)
+                owner->drainControlLane();
+        }
+        if (wire) {
+            if (--owner->wireDepth == 0)
+                owner->wireOwner = 0;
+            LeaveCriticalSection(&owner->wireLock);
+            EnterCriticalSection(&owner->laneLock);
+            wakeWaiters();
+            LeaveCriticalSection(&owner->laneLock);
+        }
+    }
+
+    inline BOOL ownsWire() { return wire; }
+
+private:
+    ETH_SIRC *owner;
+    BOOL bulk;
+    BOOL wire;
+
+    //We have wireLock.  The first time around the error starts out clean.
+    void took() {
+        if (owner->wireDepth++ == 0) {
+            owner->wireOwner = GetCurrentThreadId();
+            owner->wireError = 0;
+        }
+    }
+
+    //Let the waiting control commands look again.  Called with laneLock held.
+    void wakeWaiters() {
+        while (!owner->wireWaiters.empty()) {
+            SetEvent(owner->wireWaiters.front());
+            owner->wireWaiters.pop_front();
+        }
+    }
+};
+
+//Request runner for the submit* methods.
+//Runs of consecutive writes go through sendWrites as one batch, so they share the
+// write window.  Everything else goes through the synchronous method.
+//Requests are completed on the pool thread, while it holds the wire.
+class ETH_SIRC::Async : public SIRC_ASYNC {
+public:
+    Async(ETH_SIRC *sirc) : SIRC_ASYNC(sirc), owner(sirc) {}
+
+    BOOL submit(SIRC_ASYNC_REQUEST *request);
+
+protected:
+    void run(std::list <SIRC_ASYNC_REQUEST *> &batch) {
+        std::vector <WRITE_SEGMENT> segments;
+
+        while (!batch.empty()) {
+            SIRC_ASYNC_REQUEST *request = batch.front();
+
+            if (request->operation != SIRC_ASYNC_REQUEST::WRITE) {
+                batch.pop_front();
+                execute(request);
+                continue;
+            }
+
+            segments.clear();
+            while (!batch.empty() && (batch.front()->operation == SIRC_ASYNC_REQUEST::WRITE)) {
+                WRITE_SEGMENT segment;
+                request = batch.front();
+                batch.pop_front();
+
+                segment.startAddress = request->startAddress;
+                segment.length = request->length;
+                segment.buffer = request->buffer;
+                segment.request = request;
+                segments.push_back(segment);
+            }
+            LogIt("sirc::async.writes %u",(uint32_t)segments.size());
+            (void) owner->sendWrites(&segments[0], (uint32_t)segments.size());
+        }
+    }
+
+private:
+    ETH_SIRC *owner;
+};
+
+SIRC_ASYNC *ETH_SIRC::createAsync(){
+    return new Async(this);
+}
+
+//The dedicated I/O thread.
+//It holds the wire from start to finish, so every control command from another thread
+// is queued for it (see LaneGuard), and bulk commands and submitted requests come
+// in through a lock-free list.  It runs them in order, batching writes like Async.
+//Between commands it keeps the control lane going and the receive pool recycled.
+class ETH_SIRC::IoThread : public ETH_SIRC::Async {
+public:
+    IoThread(ETH_SIRC *sirc, uint32_t cpu) : Async(sirc), owner(sirc), cpu(cpu) {
+        submissions = (PSLIST_HEADER) _aligned_malloc(sizeof(SLIST_HEADER), MEMORY_ALLOCATION_ALIGNMENT);
+        if (submissions)
+            InitializeSListHead(submissions);
+        wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+        thread = NULL;
+        threadId = 0;
+        stopping = 0;
+    }
+
+    //Runs everything posted so far, then stops
+    ~IoThread() {
+        if (thread) {
+            InterlockedExchange(&stopping, 1);
+            SetEvent(wake);
+            WaitForSingleObject(thread, INFINITE);
+            CloseHandle(thread);
+        }
+        if (wake)
+            CloseHandle(wake);
+        _aligned_free(submissions);
+    }
+
+    //Returns false if the thread could not be started
+    BOOL start() {
+        if (!submissions || !wake)
+            return false;
+        thread = CreateThread(NULL, 0, threadProc, this, CREATE_SUSPENDED, &threadId);
+        if (!thread)
+            return false;
+        //Keep it on one CPU, if there is such a CPU
+        if (cpu < sizeof(DWORD_PTR) * 8)
+            (void) SetThreadAffinityMask(thread, (DWORD_PTR)1 << cpu);
+        (void) SetThreadPriority(thread, THREAD_PRIORITY_ABOVE_NORMAL);
+        ResumeThread(thread);
+        return true;
+    }
+
+    //Queue a request for the thread.  Any thread, never blocks.
+    void post(SIRC_ASYNC_REQUEST *request) {
+        SUBMISSION *entry = (SUBMISSION *) _aligned_malloc(sizeof(SUBMISSION), MEMORY_ALLOCATION_ALIGNMENT);
+
+        if (!entry) {
+            request->complete(FAILMEMALLOC, 0);
+            return;
+        }
+        entry->request = request;
+        InterlockedPushEntrySList(submissions, &entry->link);
+        SetEvent(wake);
+    }
+
+    void wakeUp() {
+        SetEvent(wake);
+    }
+
+    BOOL onThread() {
+        return GetCurrentThreadId() == threadId;
+    }
+
+private:
+    typedef struct {
+        SLIST_ENTRY link;               //first, and aligned like the list head
+        SIRC_ASYNC_REQUEST *request;
+    } SUBMISSION;
+
+    static DWORD WINAPI threadProc(LPVOID lpParam) {
+        ((IoThread *) lpParam)->loop();
+        return 0;
+    }
+
+    void loop() {
+        std::list <SIRC_ASYNC_REQUEST *> batch;
+        LaneGuard lane(owner);
+
+        for (;;) {
+            PSLIST_ENTRY entry = InterlockedFlushSList(submissions);
+
+            if (entry == NULL) {
+                if (stopping)
+                    break;
+                idle();
+                continue;
+            }
+
+            //The list comes newest first
+            while (entry) {
+                SUBMISSION *submission = (SUBMISSION *) entry;
+                entry = entry->Next;
+                batch.push_front(submission->request);
+                _aligned_free(submission);
+            }
+            LogIt("sirc::io.batch %u",(uint32_t)batch.size());
+            run(batch);
+            batch.clear();
+        }
+    }
+
+    //Nothing submitted.  Stay with the control commands in flight if there are any,
+    // otherwise sleep until something comes in.  Either way whatever the driver has
+    // for us goes where it belongs.
+    void idle() {
+        PACKET *Packet;
+
+        if (owner->controlPending != 0) {
+            Packet = owner->nextBulkPacket(IOTHREADPOLLSLICE);
+            if (Packet)
+                (void) owner->addReceive(Packet);
+            return;
+        }
+
+        (void) WaitForSingleObject(wake, IOTHREADIDLETIME);
+        while ((Packet = owner->nextBulkPacket(0)) != NULL)
+            (void) owner->addReceive(Packet);
+    }
+
+    ETH_SIRC *owner;
+    uint32_t cpu;
+    PSLIST_HEADER submissions;
+    HANDLE wake;
+    HANDLE thread;
+    DWORD threadId;
+    volatile LONG stopping;
+};
+
+//With the I/O thread running it takes them instead
+BOOL ETH_SIRC::Async::submit(SIRC_ASYNC_REQUEST *request){
+    if (owner->io) {
+        owner->io->post(request);
+        return true;
+    }
+    return SIRC_ASYNC::submit(request);
+}
+
+//Start the I/O thread, if the parameters ask for one and it is not running yet
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::startIoThread(){
+    if ((ioThread == 0) || io)
+        return true;
+
+    //Requests still queued on a pool thread would wait for the wire forever
+    finishAsync();
+
+    io = new IoThread(this, ioThread - 1);
+    if (!io->start()) {
+        delete io;
+        io = NULL;
+        setLastError(FAILMEMALLOC);
+        return false;
+    }
+    LogIt("sirc::io.start %u",ioThread - 1);
+    return true;
+}
+
+//Stop the I/O thread, after it has run everything handed to it
+void ETH_SIRC::stopIoThread(){
+    if (io) {
+        //Still takes posts while it drains
+        delete io;
+        io = NULL;
+    }
+}
+
+//Hand a bulk command to the I/O thread and wait for it
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::callIoThread(SIRC_ASYNC_REQUEST *request, uint32_t *value){
+    if (!request->valid()) {
+        //Nobody will complete it, drop both references
+        request->release();
+        request->release();
+        setLastError(FAILMEMALLOC);
+        return false;
+    }
+
+    io->post(request);
+    request->wait(INFINITE);
+
+    int8_t error = request->getError();
+    if (value)
+        *value = request->getValue();
+    request->release();
+
+    setLastError(error);
+    return error == 0;
+}
+
 //Interface methods.
 
 //Send a block of data to an input buffer on the FPGA
@@ -312,143 +865,610 @@ BOOL ETH_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t leng
 //Return true if write is successful.
 //If write fails for any reason, return false w/error code
 BOOL ETH_SIRC::sendWrite(uint32_t  startAddress, uint32_t length, uint8_t *buffer){
-	//This function breaks the write request into packet-appropriate write commands.
-	//These write commands are sent in blocks of maxOutstandingWrites.
-	//Each write command is acknowledged when it has been received by the FPGA.
-	//After sending out maxOutstandingWrites write commands, we check to see which,
-	// if any commands have been acknowledged.  If they are not acknowledged in a 
-	// timely manner, we resend the write command.
-	//If any command is not acknowledged after MAXRETRIES attempts, we will
-	// return false.
-	uint32_t currLength;
-	uint32_t numRetries;
-	
-    LogIt("sirc:sw %u %u",startAddress, length);
+    WRITE_SEGMENT segment;
+
+    if (io && !io->onThread()) {
+        SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::WRITE, NULL, NULL);
+        request->startAddress = startAddress;
+        request->length = length;
+        request->buffer = buffer;
+        return callIoThread(request, NULL);
+    }
 
-	setLastError(0);
+    segment.startAddress = startAddress;
+    segment.length = length;
+    segment.buffer = buffer;
+    segment.request = NULL;
 
-	if(!buffer){
-		setLastError(INVALIDBUFFER);
+    if(sendWrites(&segment, 1))
+        return true;
+    setLastError(segment.error);
+    return false;
+}
+
+//Sort order for vectored transfers
+static bool segmentBefore(const SIRC_SEGMENT &a, const SIRC_SEGMENT &b){
+	return a.startAddress < b.startAddress;
+}
+
+//Send several blocks of data to the FPGA input buffer, see SIRC::sendWriteV
+// segments: blocks to write, in any order, they must not overlap
+// count: # of segments
+//Return true if all segments made it.
+//If any fails, return false w/error code of the first one that did.
+BOOL ETH_SIRC::sendWriteV(const SIRC_SEGMENT *segments, uint32_t count){
+	std::vector <SIRC_SEGMENT> sorted;
+	std::vector <PACKED_RUN> runs;
+	std::vector <WRITE_SEGMENT> writes;
+	std::vector <uint8_t> staging;
+	uint32_t s;
+
+    if (io && !io->onThread()) {
+        SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::WRITEV, NULL, NULL);
+        request->segments = segments;
+        request->count = count;
+        return callIoThread(request, NULL);
+    }
+
+    LogIt("sirc:swv %u",count);
+
+	if(!checkSegments(segments, count, maxInputDataBytes))
 		return false;
+
+	//In address order, so neighbours can be found
+	sorted.assign(segments, segments + count);
+	std::sort(sorted.begin(), sorted.end(), segmentBefore);
+	for(s = 1; s < count; s++){
+		if(sorted[s].startAddress < sorted[s - 1].startAddress + sorted[s - 1].length){
+			setLastError(INVALIDADDRESS);
+			return false;
+		}
 	}
 
-	if(startAddress > maxInputDataBytes){
-		setLastError(INVALIDADDRESS);
-		return false;
+	//Gather the small neighbours, everything else goes out from where it is
+	staging.resize(packSegments(sorted, MAXWRITESIZE, runs));
+	uint8_t *stage = staging.empty() ? NULL : &staging[0];
+	for(size_t r = 0; r < runs.size(); r++){
+		WRITE_SEGMENT write;
+
+		if(runs[r].staged){
+			runs[r].buffer = stage;
+			for(s = runs[r].first; s <= runs[r].last; s++)
+				memcpy(stage + (sorted[s].startAddress - runs[r].startAddress), sorted[s].buffer, sorted[s].length);
+			stage += runs[r].length;
+		}
+		write.startAddress = runs[r].startAddress;
+		write.length = runs[r].length;
+		write.buffer = runs[r].buffer;
+		write.request = NULL;
+		writes.push_back(write);
 	}
+    LogIt("sirc:swv.runs %u %u",(uint32_t)writes.size(),(uint32_t)staging.size());
+
+	return sendWrites(&writes[0], (uint32_t)writes.size());
+}
 
-	if(length == 0 || startAddress + length > maxInputDataBytes){
+//Check the segments of a vectored transfer, the same way sendWrite/sendRead check theirs
+// bufferSize: size of the FPGA buffer they are for
+//Return true if they are all good, return false w/error code otherwise
+BOOL ETH_SIRC::checkSegments(const SIRC_SEGMENT *segments, uint32_t count, uint32_t bufferSize){
+	if(!segments){
+		setLastError(INVALIDBUFFER);
+		return false;
+	}
+	if(count == 0){
 		setLastError(INVALIDLENGTH);
 		return false;
 	}
+	for(uint32_t s = 0; s < count; s++){
+		if(!segments[s].buffer){
+			setLastError(INVALIDBUFFER);
+			return false;
+		}
+		if(segments[s].startAddress > bufferSize){
+			setLastError(INVALIDADDRESS);
+			return false;
+		}
+		if(segments[s].length == 0 || segments[s].startAddress + segments[s].length > bufferSize){
+			setLastError(INVALIDLENGTH);
+			return false;
+		}
+	}
+	return true;
+}
 
-	while(length > 0){
-		//Break this write into MAXWRITESIZE sized chunks or smaller
-		if(length > MAXWRITESIZE)
-			currLength = MAXWRITESIZE;
-		else
-			currLength = length;
+//Group segments (sorted by address) into runs, one transfer each.
+//A segment joins the run before it if it overlaps it, or if it starts right where the
+// run ends and either follows it in memory too or it and the segment before it are
+// both shorter than a frame.  Runs that need a copy are marked staged.
+// frameSize: payload bytes in one frame
+//Return the staging space the runs need.
+uint32_t ETH_SIRC::packSegments(const std::vector <SIRC_SEGMENT> &sorted, uint32_t frameSize,
+                                std::vector <PACKED_RUN> &runs){
+	uint32_t staging = 0;
+	uint32_t s;
+
+	runs.clear();
+	for(s = 0; s < (uint32_t)sorted.size(); s++){
+		const SIRC_SEGMENT &segment = sorted[s];
+
+		if(!runs.empty()){
+			PACKED_RUN &run = runs.back();
+			uint32_t end = run.startAddress + run.length;
+
+			//Nothing to copy
+			if(!run.staged && segment.startAddress == end && segment.buffer == run.buffer + run.length){
+				run.length += segment.length;
+				run.last = s;
+				continue;
+			}
+			if(segment.startAddress < end ||
+			   (segment.startAddress == end && sorted[s - 1].length < frameSize && segment.length < frameSize)){
+				run.length = max(end, segment.startAddress + segment.length) - run.startAddress;
+				run.last = s;
+				run.staged = true;
+				continue;
+			}
+		}
 
-		if(!createWriteRequestBackAndTransmit(startAddress, currLength, buffer,
-                                              currLength == length)){
-			//If the send errored out, something is very wrong.
-            return bailOut(0);
+		PACKED_RUN run;
+		run.startAddress = segment.startAddress;
+		run.length = segment.length;
+		run.first = s;
+		run.last = s;
+		run.staged = false;
+		run.buffer = segment.buffer;
+		runs.push_back(run);
+	}
+
+	for(s = 0; s < (uint32_t)runs.size(); s++){
+		if(runs[s].staged)
+			staging += runs[s].length;
+	}
+	return staging;
+}
+
+//Send one or more blocks of data to the FPGA input buffer, through one scoreboard.
+//Frames of consecutive segments share the write window, so the next segment starts
+// going out before the acks for the previous one are all back.
+//Each segment gets its own error code, and is completed (if it has a request) as
+// soon as its last frame is acked.
+//Return true if all segments made it.
+//If any fails, return false w/error code of the first one that did.
+BOOL ETH_SIRC::sendWrites(WRITE_SEGMENT *segments, uint32_t count){
+	//This function breaks each write into packet-appropriate write commands.
+	//These write commands are sent in blocks of writeWindow (at most maxOutstandingWrites).
+	//Each write command is acknowledged when it has been received by the FPGA.
+	//After sending out writeWindow write commands, we check to see which,
+	// if any commands have been acknowledged.  If they are not acknowledged in a 
+	// timely manner, we resend the write command.
+	//If any command is not acknowledged after MAXRETRIES attempts, the segments
+	// with frames in that window fail.  The rest still go.
+	//On the I/O thread the window slides instead: acks are checked off after every frame
+	// and we only wait when the window is full (see streamWriteAcks).
+	uint32_t startAddress;
+	uint32_t length;
+	uint8_t *buffer;
+	uint32_t currLength;
+	uint32_t codedLength;
+	uint32_t acked = 0;     //segments before this one have been completed
+	uint32_t s;
+	int8_t firstError = 0;
+	BOOL sent;
+	BOOL streaming = (io != NULL) && io->onThread();
+
+    LaneGuard lane(this);
+
+	//Every ack of a window has to find a receive posted
+	firstError = ensureReceiveCapacity(0) ? 0 : getLastError();
+	for(s = 0; s < count; s++)
+		segments[s].error = 0;
+	if(firstError){
+		//Nothing went out; complete every request so none of their waiters hang
+		finishWrites(segments, 0, count, firstError);
+		return false;
+	}
+	if(streaming)
+		streamSweep = GetTickCount();
+
+	for(s = 0; s < count; s++){
+		startAddress = segments[s].startAddress;
+		length = segments[s].length;
+		buffer = segments[s].buffer;
+
+        LogIt("sirc:sw %u %u",startAddress, length);
+
+		if(!buffer){
+			segments[s].error = INVALIDBUFFER;
+			continue;
 		}
 
-		//Update all of the markers
-		buffer += currLength;
-		startAddress += currLength;
-		length -= currLength;
-
-		//See if we have too many outstanding messages (or if we are done transmitting).
-		//If so, we should scoreboard and check off any write acks we got back
-		//A better way to do this would have an independent thread take care of the
-		// scoreboarding, but synchronization might be very difficult
-		if(outstandingTransmits >= (int)maxOutstandingWrites || length == 0){
-			//Try to check writes off the scoreboard & resend outstanding packets up to N times
-			numRetries = 0;
-			for(;;){
-				//Try to receive acks for the outstanding writes
-				if(receiveWriteAcks())
-					//We got all of the acks back, so break out of the for(;;) and go to the next block of writes
-					break;
+		if(startAddress > maxInputDataBytes){
+			segments[s].error = INVALIDADDRESS;
+			continue;
+		}
 
-                //Verify that receiveWriteAcks did not return false due to some error
-                // rather then just not getting back all of the acks we expected.
-                MAYBE_BAILOUT();
+		if(length == 0 || startAddress + length > maxInputDataBytes){
+			segments[s].error = INVALIDLENGTH;
+			continue;
+		}
 
-                //Not all of the writes' acks came back, so re-send any outstanding writes that are still left outstanding
-                //However, don't resend anything if that was the last time around.
-                if(numRetries++ >= maxRetries){
-                    //We have resent too many times
-                    PRINTF(("Write resent too many times without acknowledgement!\n"));
-                    return bailOut(FAILWRITEACK);
-                }
-                else{
-                    LogIt("sirc::sw.retries %u",numRetries);
-                    if (!resendOutstandingPackets(INVALIDWRITETRANSMIT DEBUG_ONLY_2ARGS("Write",&writeResends))) {
-                        return false;
-                    }
-                }
+		setLastError(0);
+		while(length > 0){
+			//Break this write into MAXWRITESIZE sized chunks or smaller,
+			// unless a coded frame would carry more
+			if(length > MAXWRITESIZE)
+				currLength = MAXWRITESIZE;
+			else
+				currLength = length;
+			codedLength = codeWriteFrame(buffer, length, &currLength);
+
+			//Control traffic goes first
+			serviceControlLane();
+
+			if(codedLength)
+				sent = createCodedWriteRequestBackAndTransmit(startAddress, currLength, codedLength,
+                                                              currLength == length);
+			else
+				sent = createWriteRequestBackAndTransmit(startAddress, currLength, buffer,
+                                                         currLength == length);
+			if(!sent){
+				//If the send errored out, something is very wrong.
+				//The frames in flight went with it.
+				bailOut(0);
+				finishWrites(segments, acked, s + 1, getLastError() ? getLastError() : INVALIDWRITETRANSMIT);
+				acked = s + 1;
+				break;
+			}
+
+			//Which segment it is part of and when it first went out, for streamWriteAcks
+			outstandingPackets.back()->UserState = (void *)(UINT_PTR)s;
+			outstandingPackets.back()->UserState2 = (void *)(UINT_PTR)GetTickCount();
+
+			//Update all of the markers
+			buffer += currLength;
+			startAddress += currLength;
+			length -= currLength;
+
+			if(streaming){
+				//Check off the acks that are in, waiting only if the window is full
+				if(!streamWriteAcks(false)){
+					finishWrites(segments, acked, s + 1, getLastError());
+					acked = s + 1;
+					break;
+				}
+				//Every segment before the one of the oldest frame still out is through
+				uint32_t through = outstandingPackets.empty() ? ((length == 0) ? s + 1 : s) :
+				                   (uint32_t)(UINT_PTR)outstandingPackets.front()->UserState;
+				finishWrites(segments, acked, through, 0);
+				acked = through;
+			}
+			//See if we have too many outstanding messages.
+			//If so, we should scoreboard and check off any write acks we got back
+			else if(outstandingTransmits >= (int)writeWindow){
+				if(!scoreboardWrites((length > 0) || (s + 1 < count))){
+					finishWrites(segments, acked, s + 1, getLastError());
+					acked = s + 1;
+					break;
+				}
+				//Everything before this segment is through, and this one too if that was its last frame
+				finishWrites(segments, acked, (length == 0) ? s + 1 : s, 0);
+				acked = (length == 0) ? s + 1 : s;
 			}
 		}
 	}
 
+	//Whatever is left in the window
+	if(outstandingTransmits > 0 && !(streaming ? streamWriteAcks(true) : scoreboardWrites(false)))
+		finishWrites(segments, acked, count, getLastError());
+	else
+		finishWrites(segments, acked, count, 0);
+
 	//Make sure that there are no outstanding packets
-	setLastError(0);
 	assert(outstandingPackets.empty());
 	assert(outstandingTransmits == 0);
-	return true;
+
+	for(s = 0; s < count; s++){
+		if(segments[s].error){
+			firstError = segments[s].error;
+			break;
+		}
+	}
+	setLastError(firstError);
+	return firstError == 0;
 }
 
-//Read a block of data from the output buffer of the FPGA
-// startAddress: local address on FPGA output buffer to begin reading from
-// length: # of bytes to read
-// buffer: destination for data received from FPGA
-//Return true if read is successful.
-//If read fails for any reason, return false w/ error code
-BOOL ETH_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer){
-	//This function sends this read request to the FPGA.
-	//The FPGA responds by breaking up the read request into packet-appropriate responses.
-	//If we receive all of the parts back from the read request, we directly return true.
-	//If not, we keep track of the parts we missed and re-send requests for those parts.
-	//If we need to resend any part of the initial read request more than MAXRETRIES times,
-	// we will return false.
-	uint32_t numRetries;
+//Collect the acks for the writes in flight, resending up to maxRetries times.
+// moreToSend: the window (not the end of the data) is why we stopped, for the tuner
+//Return true if all were acked.
+//If not, return false w/error code, with the outstanding writes flushed.
+BOOL ETH_SIRC::scoreboardWrites(BOOL moreToSend){
+    uint32_t burstSize = outstandingTransmits;
+	uint32_t numRetries = 0;
 
-    LogIt("sirc:sr %u %u",startAddress, length);
+	//Try to check writes off the scoreboard & resend outstanding packets up to N times
+	for(;;){
+		//Try to receive acks for the outstanding writes
+		if(receiveWriteAcks())
+			//We got all of the acks back
+			break;
 
-	setLastError(0);
+        //Verify that receiveWriteAcks did not return false due to some error
+        // rather then just not getting back all of the acks we expected.
+        MAYBE_BAILOUT();
 
-	if(!buffer){
-		setLastError(INVALIDBUFFER);
-		return false;
+        //Not all of the writes' acks came back, so re-send any outstanding writes that are still left outstanding
+        //However, don't resend anything if that was the last time around.
+        if(numRetries++ >= maxRetries){
+            //We have resent too many times
+            PRINTF(("Write resent too many times without acknowledgement!\n"));
+            return bailOut(FAILWRITEACK);
+        }
+        else{
+            LogIt("sirc::sw.retries %u",numRetries);
+            if (!resendOutstandingPackets(INVALIDWRITETRANSMIT DEBUG_ONLY_2ARGS("Write",&writeResends))) {
+                return false;
+            }
+        }
 	}
 
-	if(startAddress > maxOutputDataBytes){
-		setLastError(INVALIDADDRESS);
-		return false;
-	}
+    //A full window with more to send means the window was the limit
+    tuneAfterBurst(burstSize, numRetries > 0, moreToSend);
+	return true;
+}
 
-	if(length == 0 || startAddress + length > maxOutputDataBytes){
-		setLastError(INVALIDLENGTH);
-		return false;
-	}
+//I/O thread version of scoreboardWrites.  Takes every ack that is already in, then
+// waits for more only if the window is full, or with drain until all are acked.
+//Each frame has its own retransmit timer (see resendOverdueWrites).
+//Return true if there is room in the window (or nothing left, with drain).
+//If not, return false w/error code, with the outstanding writes flushed.
+BOOL ETH_SIRC::streamWriteAcks(BOOL drain){
+	PACKET *Packet;
+	uint32_t timeOut = 0;
 
-	//Send the read request
-	if(!createReadRequestBackAndTransmit(startAddress, length)){
+	for(;;){
+		Packet = nextBulkPacket(timeOut);
+		if(Packet != NULL){
+			assert(Packet->Mode == PacketModeReceiving);
+			BIGDEBUG_packet_received(Packet,0);
+
+			BOOL matched = checkWriteAck(Packet);
+			if(!addReceive(Packet)){
+				LogIt("sirc::swa.ar");
+				return bailOut(0);
+			}
+			//A window's worth of acks is a burst, as far as the tuner is concerned
+			if(matched && (++streamAcks >= writeWindow)){
+				tuneAfterBurst(streamAcks, streamResent, streamWaited);
+				streamAcks = 0;
+				streamResent = false;
+				streamWaited = false;
+			}
+			//Anything else already in?
+			timeOut = 0;
+			continue;
+		}
+
+		//Verify that nextBulkPacket did not return NULL due to some error
+		MAYBE_BAILOUT();
+
+		if((outstandingTransmits == 0) || (!drain && (outstandingTransmits < (int)writeWindow)))
+			return true;
+		if(!drain)
+			streamWaited = true;
+
+		//Have to wait.  Resend what is overdue first.
+		if(!resendOverdueWrites(&timeOut))
+			return false;
+	}
+}
+
+//Retransmit every outstanding write whose timer ran out since we last looked.
+//A frame goes out again writeTimeout, 2*writeTimeout.. after it first went out
+// (UserState2), and we give up once it has been resent maxRetries times.
+// timeOut: set to the time until the next timer runs out
+//Return true on success, return false w/error code, with the outstanding writes flushed.
+BOOL ETH_SIRC::resendOverdueWrites(uint32_t *timeOut){
+	DWORD now = GetTickCount();
+	uint32_t period = max(writeTimeout, (uint32_t)1);
+	uint32_t sinceSweep = now - streamSweep;
+	uint32_t next = period;
+
+	for(packetIter = outstandingPackets.begin(); packetIter != outstandingPackets.end(); packetIter++){
+		PACKET *packet = *packetIter;
+		uint32_t age = now - (DWORD)(UINT_PTR)packet->UserState2;
+		uint32_t expired = age / period;
+
+		if(expired > maxRetries){
+			//We have resent too many times
+			PRINTF(("Write resent too many times without acknowledgement!\n"));
+			return bailOut(FAILWRITEACK);
+		}
+		next = min(next, (expired + 1) * period - age);
+
+		//Did one run out since the last sweep?
+		if((expired == 0) || ((age > sinceSweep) && (age - sinceSweep >= expired * period)))
+			continue;
+
+		DEBUG_ONLY(writeResends++;);
+		LogIt("sirc::resend %p",(UINT_PTR)packet);
+		if(!addTransmit(packet)){
+			//We are in serious trouble.
+			PRINTF(("Write not sent!\n"));
+			return bailOut(INVALIDWRITETRANSMIT);
+		}
+		streamResent = true;
+	}
+
+	streamSweep = now;
+	*timeOut = next;
+	return true;
+}
+
+//Segments [from, to) are done.  Give the ones without an error of their own this one,
+// and complete their requests.
+void ETH_SIRC::finishWrites(WRITE_SEGMENT *segments, uint32_t from, uint32_t to, int8_t error){
+	for(uint32_t s = from; s < to; s++){
+		if(segments[s].error == 0)
+			segments[s].error = error;
+		if(segments[s].request)
+			segments[s].request->complete(segments[s].error, 0);
+	}
+}
+
+//Read a block of data from the output buffer of the FPGA
+// startAddress: local address on FPGA output buffer to begin reading from
+// length: # of bytes to read
+// buffer: destination for data received from FPGA
+//Return true if read is successful.
+//If read fails for any reason, return false w/ error code
+BOOL ETH_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer){
+    SIRC_SEGMENT target;
+
+    if (io && !io->onThread()) {
+        SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::READ, NULL, NULL);
+        request->startAddress = startAddress;
+        request->length = length;
+        request->buffer = buffer;
+        return callIoThread(request, NULL);
+    }
+
+    LogIt("sirc:sr %u %u",startAddress, length);
+
+    LaneGuard lane(this);
+
+	setLastError(0);
+
+	if(!buffer){
+		setLastError(INVALIDBUFFER);
+		return false;
+	}
+
+	if(startAddress > maxOutputDataBytes){
+		setLastError(INVALIDADDRESS);
+		return false;
+	}
+
+	if(length == 0 || startAddress + length > maxOutputDataBytes){
+		setLastError(INVALIDLENGTH);
+		return false;
+	}
+
+	target.startAddress = startAddress;
+	target.length = length;
+	target.buffer = buffer;
+	return readTargets(&target, 1);
+}
+
+//Read several blocks of data from the output buffer of the FPGA, see SIRC::sendReadV
+// segments: blocks to read, in any order, they may overlap
+// count: # of segments
+//Return true if all segments were read.
+//If any fails, return false w/ error code
+BOOL ETH_SIRC::sendReadV(const SIRC_SEGMENT *segments, uint32_t count){
+	std::vector <SIRC_SEGMENT> sorted;
+	std::vector <PACKED_RUN> runs;
+	std::vector <SIRC_SEGMENT> targets;
+	std::vector <uint8_t> staging;
+	uint32_t s;
+
+    if (io && !io->onThread()) {
+        SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::READV, NULL, NULL);
+        request->segments = segments;
+        request->count = count;
+        return callIoThread(request, NULL);
+    }
+
+    LogIt("sirc:srv %u",count);
+
+    LaneGuard lane(this);
+
+	setLastError(0);
+
+	if(!checkSegments(segments, count, maxOutputDataBytes))
 		return false;
+
+	//In address order, the way the FPGA answers.  Overlapping and small neighbouring
+	// segments are read once, into staging, the rest straight into the caller's buffers.
+	sorted.assign(segments, segments + count);
+	std::sort(sorted.begin(), sorted.end(), segmentBefore);
+	staging.resize(packSegments(sorted, MAXREADSIZE, runs));
+	uint8_t *stage = staging.empty() ? NULL : &staging[0];
+	for(size_t r = 0; r < runs.size(); r++){
+		SIRC_SEGMENT target;
+
+		if(runs[r].staged){
+			runs[r].buffer = stage;
+			stage += runs[r].length;
+		}
+		target.startAddress = runs[r].startAddress;
+		target.length = runs[r].length;
+		target.buffer = runs[r].buffer;
+		targets.push_back(target);
 	}
+    LogIt("sirc:srv.runs %u %u",(uint32_t)targets.size(),(uint32_t)staging.size());
+
+	if(!readTargets(&targets[0], (uint32_t)targets.size()))
+		return false;
 
-	//Now that we've sent out the read request, try to get back some responses.
+	//Hand out what landed in staging
+	for(size_t r = 0; r < runs.size(); r++){
+		if(!runs[r].staged)
+			continue;
+		for(s = runs[r].first; s <= runs[r].last; s++)
+			memcpy(sorted[s].buffer, runs[r].buffer + (sorted[s].startAddress - runs[r].startAddress), sorted[s].length);
+	}
+	return true;
+}
+
+//Read into one or more targets, with the wire already ours.
+// targets: sorted by address, not overlapping
+// count: # of targets
+//Return true if read is successful.
+//If read fails for any reason, return false w/ error code
+BOOL ETH_SIRC::readTargets(const SIRC_SEGMENT *targets, uint32_t count){
+	//This function sends one read request per target to the FPGA, all at once.
+	//The FPGA responds by breaking up each read request into packet-appropriate responses.
+	//If we receive all of the parts back from the read requests, we directly return true.
+	//If not, we keep track of the parts we missed and re-send requests for those parts.
+	//If we need to resend any part of the initial read requests more than MAXRETRIES times,
+	// we will return false.
+	uint32_t numRetries;
+	uint32_t numResponses = 0;
+	uint32_t t;
+
+	//The FPGA will answer with this many frames, all at once.
+	//With FEC they are a little shorter, and every group of them brings a parity frame.
+	uint32_t frameSize = MAXREADSIZE - (fecGroup ? SIRC_FEC_OVERHEAD : 0);
+	for(t = 0; t < count; t++){
+		uint32_t frames = (targets[t].length + frameSize - 1) / frameSize;
+		numResponses += frames;
+		if(fecGroup)
+			numResponses += (frames + fecGroup - 1) / fecGroup;
+	}
+	if(!ensureReceiveCapacity(numResponses)){
+		return false;
+	}
+
+	//Send the read requests, in increasing address order.  The first one tells the FPGA
+	// how many frames we can take.
+	if(creditFlow)
+		readCredits = startCredits();
+	for(t = 0; t < count; t++){
+		if(!createReadRequestBackAndTransmit(targets[t].startAddress, targets[t].length)){
+			return false;
+		}
+	}
+
+	//Now that we've sent out the read requests, try to get back some responses.
 	numRetries = 0;
 	for(;;){
 		//Try to get back all of the read responses associated with the current outstanding
-		// read requests.  The first time through we will only have 1 request on the queue.
-		// However, for subsequent retries, this may be larger than 1.
+		// read requests.  The first time through we will only have the ones we sent.
+		// However, for subsequent retries, there may be more.
 		//If we don't get back all of the reads we want, we will have all of the necessary resends
 		// sitting in the outstanding packet queue.
-		if(receiveReadResponses(startAddress, buffer))
+		if(receiveReadResponses(targets, count))
 			//All of the reads came back, so we are done
             break;
 
@@ -466,12 +1486,15 @@ BOOL ETH_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer)
         else{
             //Transmit/re-transmit the packets in the outstanding list.
             LogIt("sirc::sr.retries %u",numRetries);
-            if (!resendOutstandingPackets(INVALIDREADTRANSMIT DEBUG_ONLY_2ARGS("Read",&readResends))) {
+            if (!sendCredits(true, startCredits()) ||
+                !resendOutstandingPackets(INVALIDREADTRANSMIT DEBUG_ONLY_2ARGS("Read",&readResends))) {
                 return false;
             }
         }
 	}
 
+	tuneAfterBurst(numResponses, numRetries > 0, false);
+
 	setLastError(0);
 	assert(outstandingPackets.empty());
 	assert(outstandingReadStartAddresses.empty());
@@ -489,13 +1512,19 @@ BOOL ETH_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer)
 BOOL ETH_SIRC::sendParamRegisterWrite(uint8_t regNumber, uint32_t value){
 	uint32_t numRetries;
 	
-	setLastError(0);
-
 	if(!(regNumber < 255)){
 		setLastError(INVALIDADDRESS);
 		return false;
 	}
 
+    CONTROL_REQUEST request;
+    initControlRequest(&request, SircWire::RegWrite::command, regNumber, value, writeTimeout, maxRetries, FAILWRITEACK);
+    LaneGuard lane(this, &request);
+    if (!lane.ownsWire())
+        return delegateControl(&request, NULL);
+
+	setLastError(0);
+
 	if(!createParamWriteRequestBackAndTransmit(regNumber, value)){
 		//If the send errored out, something is very wrong.
         return bailOut(getLastError());
@@ -545,13 +1574,19 @@ BOOL ETH_SIRC::sendParamRegisterWrite(uint8_t regNumber, uint32_t value){
 BOOL ETH_SIRC::sendParamRegisterRead(uint8_t regNumber, uint32_t *value){
 	uint32_t numRetries;
 	
-	setLastError(0);
-
 	if(!(regNumber < 255)){
 		setLastError(INVALIDADDRESS);
 		return false;
 	}
 
+    CONTROL_REQUEST request;
+    initControlRequest(&request, SircWire::RegRead::command, regNumber, 0, readTimeout, maxRetries, FAILREADACK);
+    LaneGuard lane(this, &request);
+    if (!lane.ownsWire())
+        return delegateControl(&request, value);
+
+	setLastError(0);
+
 	if(!createParamReadRequestBackAndTransmit(regNumber)){
 		//If the send errored out, something is very wrong.
         return bailOut(getLastError());
@@ -599,6 +1634,12 @@ BOOL ETH_SIRC::sendParamRegisterRead(uint8_t regNumber, uint32_t *value){
 BOOL ETH_SIRC::sendRun(){
 	uint32_t numRetries;
 	
+    CONTROL_REQUEST request;
+    initControlRequest(&request, SircWire::RegWrite::command, 255, 1, writeTimeout, maxRetries, FAILWRITEACK);
+    LaneGuard lane(this, &request);
+    if (!lane.ownsWire())
+        return delegateControl(&request, NULL);
+
 	setLastError(0);
 
 	if(!createParamWriteRequestBackAndTransmit(255, 1)){
@@ -649,9 +1690,21 @@ BOOL ETH_SIRC::sendRun(){
 BOOL ETH_SIRC::waitDone(uint32_t maxWaitTimeInMsec){
 	uint32_t value;
 
-	setLastError(0);
-
 	for(;;){
+        //Each poll is a separate control command, bulk traffic can go in between.
+        CONTROL_REQUEST request;
+        initControlRequest(&request, SircWire::RegRead::command, 255, 0, maxWaitTimeInMsec, 0, FAILWAITACK);
+        LaneGuard lane(this, &request);
+        if (!lane.ownsWire()) {
+            if (!delegateControl(&request, &value))
+                return false;
+            if (value == 0)
+                return true;
+            continue;
+        }
+
+        setLastError(0);
+
 		//Send out the read
 		if(!createParamReadRequestBackAndTransmit(255)){
 			//If the send errored out, something is very wrong.
@@ -696,6 +1749,12 @@ BOOL ETH_SIRC::waitDone(uint32_t maxWaitTimeInMsec){
 BOOL ETH_SIRC::sendReset(){
 	uint32_t numRetries;
 	
+    CONTROL_REQUEST request;
+    initControlRequest(&request, SircWire::Reset::command, 0, 0, writeTimeout, maxRetries, FAILRESETACK);
+    LaneGuard lane(this, &request);
+    if (!lane.ownsWire())
+        return delegateControl(&request, NULL);
+
 	setLastError(0);
 
 	if(!createResetRequestAndTransmit()){
@@ -769,7 +1828,21 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
 	uint32_t numPackets;
 	uint32_t currLength;
 	uint32_t numRetries;
+	SIRC_SEGMENT readBack;      //where missed readback frames land
 	
+    if (io && !io->onThread()) {
+        SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::WRITEANDRUN, NULL, NULL);
+        request->startAddress = startAddress;
+        request->length = inLength;
+        request->buffer = inData;
+        request->maxWaitTime = maxWaitTimeInMsec;
+        request->outData = outData;
+        request->maxOutLength = maxOutLength;
+        return callIoThread(request, outputLength);
+    }
+
+    LaneGuard lane(this);
+
 	setLastError(0);
 
 	//Check the input parameters
@@ -795,6 +1868,9 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
 		setLastError(INVALIDLENGTH);
 		return false;
 	}
+	readBack.startAddress = 0;
+	readBack.length = maxOutLength;
+	readBack.buffer = outData;
 
 	//Try to send the data to the FPGA
 	//First break the write request into packet-appropriate write commands.
@@ -809,6 +1885,16 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
 	}
 	currLength = numPackets * MAXWRITESIZE;
 
+	//Make room for the readback burst (4 bytes of each response go to the remaining count,
+	// and with FEC some more to the parity frames)
+	uint32_t frameSize = MAXREADSIZE - 4 - (fecGroup ? SIRC_FEC_OVERHEAD : 0);
+	uint32_t numResponses = (maxOutLength + frameSize - 1) / frameSize;
+	if(fecGroup)
+		numResponses += (numResponses + fecGroup - 1) / fecGroup;
+	if(!ensureReceiveCapacity(numResponses)){
+		return false;
+	}
+
 	//There are 3 phases to this function: write initial data to FPGA, send last write & run packet,
 	// wait for data to come back.
 	//Aside from the normal, unrecoverable problems that can occur (invalid parameters,
@@ -829,7 +1915,9 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
 		}
 
 		//Now we want to send the last packet out via a write & run command.
-		if(!createWriteAndRunRequestBackAndTransmit(startAddress + currLength, inLength - currLength, inData + currLength)){
+		//With credits, the FPGA first hears how much of the readback we can take at once.
+		if(!sendCredits(true, startCredits()) ||
+		   !createWriteAndRunRequestBackAndTransmit(startAddress + currLength, inLength - currLength, inData + currLength)){
 			//If the send errored out, something is very wrong.
 			return false;
 		}
@@ -840,6 +1928,7 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
 		if(receiveWriteAndRunAcks(maxWaitTimeInMsec, maxOutLength, outData, outputLength)){
 			//We got back all of the write & run responses and they fit within the
 			// output buffer without trouble. We are done ok.
+			tuneAfterBurst(numResponses, numRetries > 0, false);
 			setLastError(0);
 			return true;
 		}
@@ -850,8 +1939,9 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
             //		were lost.  Because of this, we have to retry the entire sequence again, 
             //		beginning at the very first write (execution might have overwritten some of the
             //		input data).
-            emptyOutstandingPackets();
-            sendReset();
+            abandonOutstandingPackets();
+            if(sendReset())
+                forgetAbandoned();
             numRetries++;
             DEBUG_ONLY(writeAndRunResends++;);
             continue;
@@ -876,14 +1966,16 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
 				
             while(numRetries < maxRetries){
                 LogIt("sirc::war.retries %u",numRetries);
-                if (!resendOutstandingPackets(INVALIDREADTRANSMIT DEBUG_ONLY_2ARGS("WriteAndRun",&writeAndRunResends)))
+                if (!sendCredits(true, startCredits()) ||
+                    !resendOutstandingPackets(INVALIDREADTRANSMIT DEBUG_ONLY_2ARGS("WriteAndRun",&writeAndRunResends)))
                     return false;
 
                 numRetries++;
 
                 //Try to get the reads back
-                if(receiveReadResponses(0, outData)){
-                    //We got back all of the outstanding reads
+                if(receiveReadResponses(&readBack, 1)){
+                    //We got back all of the outstanding reads, but we did drop some
+                    tuneAfterBurst(numResponses, true, false);
                     if(okCapacity){
                         setLastError(0);
                         return true;
@@ -914,12 +2006,500 @@ BOOL ETH_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t
 	return bailOut(FAILWRITEACK);
 }
 
+//Ask the FPGA which of the wanted SIRC_COMPRESS_* features it will take.
+//Hardware that predates the negotiate command does not answer, which just means none.
+//Returns false only if something is wrong with the driver.
+BOOL ETH_SIRC::negotiateFeatures(uint32_t wanted){
+	uint32_t numRetries;
+	uint32_t accepted = 0;
+
+    LogIt("sirc:n %u",wanted);
+
+    LaneGuard lane(this);
+
+	setLastError(0);
+
+    //Plain frames until we hear otherwise
+    compression = 0;
+    codingMisses = 0;
+
+	//The packet will be 5 bytes long (1 byte command + 4 bytes feature mask)
+    if (!allocateAndFillPacket(SircWire::Negotiate::headerLength))
+        return false;
+
+	//Set the command byte to 'n', then the mask
+	SircWire::Negotiate::start(currentBuffer);
+	SircWire::Negotiate::Mask::put(currentBuffer, wanted);
+
+	//Keep track of this message
+	outstandingPackets.push_back(currentPacket);
+	outstandingTransmits++;
+
+    if (!sendCurrentPacket(INVALIDPARAMWRITETRANSMIT,false DEBUG_ONLY_1ARG("Negotiate")))
+        return bailOut(getLastError());
+
+	numRetries = 0;
+	for(;;){
+		//A timeout here leaves lastError alone
+		if(receiveGenericAck(NEGOTIATETIMEOUT, &accepted, &ETH_SIRC::checkNegotiateResponse, 0))
+			break;
+
+        MAYBE_BAILOUT();
+
+        if(numRetries++ >= maxRetries){
+            //Nobody there that knows the command, stay with plain frames.
+            LogIt("sirc::n.none");
+            markPacketAcked(outstandingPackets.front());
+            outstandingPackets.pop_front();
+            return true;
+        }
+        if (!resendOutstandingPackets(INVALIDPARAMWRITETRANSMIT))
+            return false;
+	}
+
+	//Never more than we asked for
+	compression = accepted & wanted;
+    LogIt("sirc:n.ok %u",compression);
+
+	assert(outstandingPackets.empty());
+	assert(outstandingTransmits == 0);
+	return true;
+}
+
+//Ask the FPGA for a parity frame every group data frames of a read response or readback
+// (see sirc_fec.h), 0 for none.  It may settle for a smaller group.
+//Hardware that predates FEC does not answer, which just means none.
+//Returns false only if something is wrong with the driver.
+BOOL ETH_SIRC::negotiateFec(uint32_t group){
+	uint32_t numRetries;
+	uint32_t accepted = 0;
+
+    LogIt("sirc:f %u",group);
+
+    LaneGuard lane(this);
+
+	setLastError(0);
+
+    //No parity until we hear otherwise
+    fecGroup = 0;
+    group = min(group, (uint32_t) SIRC_FEC_MAXGROUP);
+
+	//The packet will be 2 bytes long (1 byte command + 1 byte group)
+    if (!allocateAndFillPacket(SircWire::FecSetup::headerLength))
+        return false;
+
+	//Set the command byte to 'f', then the group
+	SircWire::FecSetup::start(currentBuffer);
+	SircWire::FecSetup::Group::put(currentBuffer, (uint8_t) group);
+
+	//Keep track of this message
+	outstandingPackets.push_back(currentPacket);
+	outstandingTransmits++;
+
+    if (!sendCurrentPacket(INVALIDPARAMWRITETRANSMIT,false DEBUG_ONLY_1ARG("FecSetup")))
+        return bailOut(getLastError());
+
+	numRetries = 0;
+	for(;;){
+		//A timeout here leaves lastError alone
+		if(receiveGenericAck(NEGOTIATETIMEOUT, &accepted, &ETH_SIRC::checkFecResponse, 0))
+			break;
+
+        MAYBE_BAILOUT();
+
+        if(numRetries++ >= maxRetries){
+            //Nobody there that knows the command, no parity.
+            LogIt("sirc::f.none");
+            markPacketAcked(outstandingPackets.front());
+            outstandingPackets.pop_front();
+            return true;
+        }
+        if (!resendOutstandingPackets(INVALIDPARAMWRITETRANSMIT))
+            return false;
+	}
+
+	//Never more than we asked for
+	fecGroup = min(accepted, group);
+    LogIt("sirc:f.ok %u",fecGroup);
+
+	assert(outstandingPackets.empty());
+	assert(outstandingTransmits == 0);
+	return true;
+}
+
+//Ask the FPGA to pace read responses and readbacks by receive credits (SircWire::Credit),
+// or to stop.  Hardware that predates credits does not answer, which just means off.
+//Returns false only if something is wrong with the driver.
+BOOL ETH_SIRC::negotiateCredits(BOOL on){
+	uint32_t numRetries;
+	uint32_t accepted = 0;
+
+    LogIt("sirc:c %u",on);
+
+    LaneGuard lane(this);
+
+	setLastError(0);
+
+    //Plain read requests until we hear otherwise
+    creditFlow = false;
+
+	//The packet will be 2 bytes long (1 byte command + 1 byte on/off)
+    if (!allocateAndFillPacket(SircWire::CreditSetup::headerLength))
+        return false;
+
+	//Set the command byte to 'c', then on or off
+	SircWire::CreditSetup::start(currentBuffer);
+	SircWire::CreditSetup::On::put(currentBuffer, on ? 1 : 0);
+
+	//Keep track of this message
+	outstandingPackets.push_back(currentPacket);
+	outstandingTransmits++;
+
+    if (!sendCurrentPacket(INVALIDPARAMWRITETRANSMIT,false DEBUG_ONLY_1ARG("CreditSetup")))
+        return bailOut(getLastError());
+
+	numRetries = 0;
+	for(;;){
+		//A timeout here leaves lastError alone
+		if(receiveGenericAck(NEGOTIATETIMEOUT, &accepted, &ETH_SIRC::checkCreditResponse, 0))
+			break;
+
+        MAYBE_BAILOUT();
+
+        if(numRetries++ >= maxRetries){
+            //Nobody there that knows the command, no credits.
+            LogIt("sirc::c.none");
+            markPacketAcked(outstandingPackets.front());
+            outstandingPackets.pop_front();
+            return true;
+        }
+        if (!resendOutstandingPackets(INVALIDPARAMWRITETRANSMIT))
+            return false;
+	}
+
+	creditFlow = on && (accepted != 0);
+    LogIt("sirc:c.ok %u",creditFlow);
+
+	assert(outstandingPackets.empty());
+	assert(outstandingTransmits == 0);
+	return true;
+}
+
+//A burst of responses is about to start, how many frames can it have right now?
+//Some receives stay for the control lane.
+uint32_t ETH_SIRC::startCredits(){
+    uint32_t credits;
+
+    if (postedReceives > 2 * RECEIVEMARGIN)
+        credits = postedReceives - RECEIVEMARGIN;
+    else
+        credits = max(postedReceives / 2, (uint32_t) 1);
+    creditBatch = max(credits / CREDITSPERBURST, (uint32_t) 1);
+    creditsOwed = 0;
+    return credits;
+}
+
+//Send a credit frame: credits more response frames, or credits from now on with start.
+//Nothing answers it, the packet is ours again once sent.
+//Return true on success (or without credits), return false w/error code on failure
+BOOL ETH_SIRC::sendCredits(BOOL start, uint32_t credits){
+    if (!creditFlow)
+        return true;
+
+	//The packet will be 6 bytes long (1 byte command + 1 byte start + 4 bytes credits)
+    if (!allocateAndFillPacket(SircWire::Credit::headerLength))
+        return false;
+
+	SircWire::Credit::start(currentBuffer);
+	SircWire::Credit::Start::put(currentBuffer, start ? 1 : 0);
+	SircWire::Credit::Credits::put(currentBuffer, credits);
+
+    //Nothing acks it, it is freed once the driver is done sending it
+    PACKET *packet = currentPacket;
+    BOOL sent = sendCurrentPacket(INVALIDREADTRANSMIT,false DEBUG_ONLY_1ARG("Credit"));
+    retireTransmit(packet);
+    if (sent)
+        creditGrants++;
+    return sent;
+}
+
+//A receive for the bulk lane was just posted again.  Every creditBatch of them the FPGA
+// may send that many more frames.
+//Return true on success (or without credits), return false w/error code on failure
+inline BOOL ETH_SIRC::grantCredit(){
+    if (!creditFlow || (++creditsOwed < creditBatch))
+        return true;
+    uint32_t credits = creditsOwed;
+    creditsOwed = 0;
+    return sendCredits(false, credits);
+}
+
+//Payload checksums (sirc_crc.h)
+
+//Have the FPGA compute the CRC32C of part of its input or output buffer, see SIRC::sendChecksum
+// output: false for the input buffer, true for the output buffer
+// startAddress: local address on the FPGA buffer to begin at
+// length: # of bytes to checksum
+// crc: the FPGA's CRC32C of those bytes
+//Return true if the FPGA answered.
+//If it did not, return false w/error code.  FAILNOCHECKSUM if it never did,
+// hardware that predates checksums does not answer.
+BOOL ETH_SIRC::sendChecksum(BOOL output, uint32_t startAddress, uint32_t length, uint32_t *crc){
+	uint32_t numRetries;
+	uint32_t bufferBytes;
+
+    if (io && !io->onThread()) {
+        SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::CHECKSUM, NULL, NULL);
+        request->regNumber = output ? 1 : 0;
+        request->startAddress = startAddress;
+        request->length = length;
+        return callIoThread(request, crc);
+    }
+
+    LogIt("sirc:h %u %u",startAddress,length);
+
+    LaneGuard lane(this);
+
+	setLastError(0);
+
+	if(!crc){
+		setLastError(INVALIDBUFFER);
+		return false;
+	}
+
+	bufferBytes = output ? maxOutputDataBytes : maxInputDataBytes;
+	if(startAddress > bufferBytes){
+		setLastError(INVALIDADDRESS);
+		return false;
+	}
+
+	if(length == 0 || length > bufferBytes - startAddress){
+		setLastError(INVALIDLENGTH);
+		return false;
+	}
+
+	//The packet will be 10 bytes long (1 byte command + 1 byte buffer + 4 bytes address + 4 bytes length)
+    if (!allocateAndFillPacket(SircWire::Checksum::headerLength))
+        return false;
+
+	SircWire::Checksum::start(currentBuffer);
+	SircWire::Checksum::Buffer::put(currentBuffer, output ? SircWire::Checksum::output : SircWire::Checksum::input);
+	SircWire::Checksum::Address::put(currentBuffer, startAddress);
+	SircWire::Checksum::Length::put(currentBuffer, length);
+
+	//Keep track of this message
+	outstandingPackets.push_back(currentPacket);
+	outstandingTransmits++;
+
+    if (!sendCurrentPacket(INVALIDPARAMREADTRANSMIT,false DEBUG_ONLY_1ARG("Checksum")))
+        return bailOut(getLastError());
+
+	numRetries = 0;
+	for(;;){
+		//A timeout here leaves lastError alone
+		if(receiveGenericAck(readTimeout + length / CHECKSUMBYTESPERMSEC, crc, &ETH_SIRC::checkChecksumResponse, 0))
+			break;
+
+        MAYBE_BAILOUT();
+
+        if(numRetries++ >= maxRetries){
+            //Nobody there that knows the command, or the link is down.  Either way no checksum.
+            LogIt("sirc::h.none");
+            return bailOut(FAILNOCHECKSUM);
+        }
+        if (!resendOutstandingPackets(INVALIDPARAMREADTRANSMIT))
+            return false;
+	}
+
+    LogIt("sirc:h.ok %x",*crc);
+
+	assert(outstandingPackets.empty());
+	assert(outstandingTransmits == 0);
+	return true;
+}
+
+//Multicast groups.  ETH_MULTICAST sends each frame once to the group MAC through one
+// member, and every member checks off the acks from its own board.  Frames for the
+// group are not on the scoreboard, a member that missed one gets it again by unicast.
+
+//Ask the board to join (or leave) the multicast group at groupMAC.
+//Hardware without groups does not answer, which just leaves *joined false.
+//Returns false only if something is wrong with the driver.
+BOOL ETH_SIRC::joinGroup(const uint8_t *groupMAC, BOOL join, BOOL *joined){
+	uint32_t numRetries;
+
+    LogIt("sirc:j %u",(uint32_t) join);
+
+    LaneGuard lane(this);
+
+	setLastError(0);
+    *joined = false;
+
+	//The packet will be 8 bytes long (1 byte command + 1 byte join/leave + 6 bytes group)
+    if (!allocateAndFillPacket(SircWire::Join::headerLength))
+        return false;
+
+	//Set the command byte to 'j', then what to do and the group
+	SircWire::Join::start(currentBuffer);
+	SircWire::Join::Op::put(currentBuffer, join ? SircWire::Join::join : SircWire::Join::leave);
+	memcpy(SircWire::Join::group(currentBuffer), groupMAC, 6);
+
+	//Keep track of this message
+	outstandingPackets.push_back(currentPacket);
+	outstandingTransmits++;
+
+    if (!sendCurrentPacket(INVALIDPARAMWRITETRANSMIT,false DEBUG_ONLY_1ARG("Join")))
+        return bailOut(getLastError());
+
+	numRetries = 0;
+	for(;;){
+		//A timeout here leaves lastError alone
+		if(receiveGenericAck(NEGOTIATETIMEOUT, NULL, &ETH_SIRC::checkJoinAck, 0))
+			break;
+
+        MAYBE_BAILOUT();
+
+        if(numRetries++ >= maxRetries){
+            //Nobody there that knows the command, it gets everything by unicast.
+            LogIt("sirc::j.none");
+            markPacketAcked(outstandingPackets.front());
+            outstandingPackets.pop_front();
+            return true;
+        }
+        if (!resendOutstandingPackets(INVALIDPARAMWRITETRANSMIT))
+            return false;
+	}
+
+    *joined = true;
+	assert(outstandingPackets.empty());
+	assert(outstandingTransmits == 0);
+	return true;
+}
+
+//See if this join ack matches the one that is outstanding
+//If the packet matches the one in the outstandingPacket list, return true.
+//If not, return false.
+BOOL ETH_SIRC::checkJoinAck(PACKET* packet, uint32_t *unused){
+    return checkSimpleResponse(packet, SircWire::Join::command, SircWire::Join::headerLength);
+}
+
+//Build (but do not send) a write frame for the group, with as much of the buffer as fits.
+//*sent is how much that is.
+//Returns NULL w/error code on failure.
+PACKET *ETH_SIRC::createGroupWrite(const uint8_t *groupMAC, uint32_t startAddress, uint32_t length,
+                                   uint8_t *buffer, uint32_t *sent){
+    uint32_t currLength = (length > MAXWRITESIZE) ? MAXWRITESIZE : length;
+
+    if (!allocateAndFillPacket(SircWire::Write::frameLength(currLength)))
+        return NULL;
+    memcpy(currentPacket->Buffer, groupMAC, 6);
+
+	SircWire::Write::start(currentBuffer);
+    setLengthAndAddress(currLength,startAddress);
+	memcpy(SircWire::Write::data(currentBuffer), buffer, currLength);
+
+    *sent = currLength;
+    return currentPacket;
+}
+
+//Build (but do not send) a parameter register write for the group
+//Returns NULL w/error code on failure.
+PACKET *ETH_SIRC::createGroupRegWrite(const uint8_t *groupMAC, uint8_t regNumber, uint32_t value){
+    if (!allocateAndFillPacket(SircWire::RegWrite::headerLength))
+        return NULL;
+    memcpy(currentPacket->Buffer, groupMAC, 6);
+
+	SircWire::RegWrite::start(currentBuffer);
+	SircWire::RegWrite::Register::put(currentBuffer, regNumber);
+	setValueField(value);
+    return currentPacket;
+}
+
+//Send a group frame.  It stays the caller's, the acks are matched against it.
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::transmitGroupFrame(PACKET *packet, BOOL flush){
+    uint8_t command = SircWire::Write::Command::get(SircWire::Ethernet::payload(packet->Buffer));
+
+    setLastError(0);
+    packet->Flush = flush;
+    if (addTransmit(packet))
+        return true;
+    setLastError((command == SircWire::RegWrite::command) ? INVALIDPARAMWRITETRANSMIT : INVALIDWRITETRANSMIT);
+    return false;
+}
+
+void ETH_SIRC::freeGroupFrame(PACKET *packet){
+    PacketDriver->FreePacket(packet,false);
+}
+
+//Our board is about to ack numFrames group frames, make sure they have somewhere to land.
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::prepareGroupBurst(uint32_t numFrames){
+    LaneGuard lane(this);
+
+    setLastError(0);
+    return ensureReceiveCapacity(numFrames);
+}
+
+//Check off our board's acks for the group frames: what is already here, waiting up
+// to timeOut for the first one if nothing is.
+//Returns how many were newly acked.  Sets an error code if a receive could not be posted.
+uint32_t ETH_SIRC::takeGroupAcks(PACKET **frames, uint32_t count, BOOL *acked, uint32_t timeOut){
+    uint8_t command = SircWire::Write::Command::get(SircWire::Ethernet::payload(frames[0]->Buffer));
+    //Register writes are acked by echoing the whole frame, writes by echoing the header
+    BOOL control = (command == SircWire::RegWrite::command);
+    uint32_t length = control ? SircWire::RegWrite::headerLength : SircWire::Write::headerLength;
+    uint32_t taken = 0;
+	PACKET *        Packet;
+
+    LaneGuard lane(this);
+
+    setLastError(0);
+    for(;;){
+        Packet = receiveOn(control ? controlLane : bulkLane, timeOut);
+        if (Packet == NULL)
+            break;
+        timeOut = 0;
+        assert(Packet->Mode == PacketModeReceiving);
+
+        if ((SircWire::Ethernet::Length::get(Packet->Buffer) == length) && !lateResponse(Packet)) {
+            uint8_t *frame = SircWire::Ethernet::payload(Packet->Buffer);
+
+            for (uint32_t f = 0; f < count; f++) {
+                if (!acked[f] && (memcmp(frame, SircWire::Ethernet::payload(frames[f]->Buffer), length) == 0)) {
+                    acked[f] = true;
+                    taken++;
+                    break;
+                }
+            }
+        }
+        if (!addReceive(Packet))
+            break;
+    }
+    return taken;
+}
+
 //Internal methods
 
-#pragma intrinsic(_byteswap_ulong,_byteswap_ushort) //jic. And btw why don't we define BYTE_ORDER
+//Next frame for one of our lanes, from our own steering table or the shared NIC's.
+//With returnOnSteer we give up as soon as a frame for the other lane is here.
+inline PACKET *ETH_SIRC::receiveOn(int lane, uint32_t timeOut, BOOL returnOnSteer){
+    if (nic)
+        return nic->receive(lane, timeOut, returnOnSteer ? ((lane == bulkLane) ? controlLane : bulkLane) : -1);
+    return Steering->GetNextReceivedPacket(lane, timeOut, returnOnSteer);
+}
+
+//Any frames already waiting for one of our lanes?
+inline BOOL ETH_SIRC::lanePending(int lane){
+    return nic ? nic->pending(lane) : Steering->HasPackets(lane);
+}
 
 //Allocate a packet for xmit, initialize state & locals
 inline BOOL ETH_SIRC::allocateAndFillPacket(uint16_t length){
+	//Give back what the driver is done with
+	if(!retiredTransmits.empty())
+		freeRetiredTransmits();
+
 	//Get a new xmit packet to put the message in.
 	currentPacket = PacketDriver->AllocatePacket(NULL,MAXPACKETSIZE,false);
 	if(!currentPacket){
@@ -932,64 +2512,75 @@ inline BOOL ETH_SIRC::allocateAndFillPacket(uint16_t length){
 
 	//The length of the frame will be the length of the payload plus 6 + 6 + 2 (dest MAC,
 	//  source MAC, and payload length)
-	currentPacket->nBytesAvail = length + 14;
+	currentPacket->nBytesAvail = length + SircWire::Ethernet::headerLength;
 
 	//Set the destination and source addresses of the packet (0-5 and 6-11)
 	memcpy(currentPacket->Buffer, &ethHeader, 12);
 
-	//The payload length field (bytes 12 and 13) does not include the length of the header
-#if defined(_MSC_VER) //other compilers might not
-    *(uint16_t*)(currentPacket->Buffer+12) = _byteswap_ushort(length);
-#else
-	currentPacket->Buffer[13] = (length) % 256;
-	currentPacket->Buffer[12] = (length) >> 8;
-#endif
+	//The payload length field does not include the length of the header
+	SircWire::Ethernet::Length::put(currentPacket->Buffer, length);
 
-	//Get the beginning of the packet payload (header is 14 bytes)
-	currentBuffer = &(currentPacket->Buffer[14]);
+	//Get the beginning of the packet payload
+	currentBuffer = SircWire::Ethernet::payload(currentPacket->Buffer);
 
     return true;
 }
 
-//Set the start address and write length fields (1-4 and 5-8)
+//Set the start address and length fields.
+//They are in the same place in all of 'w', 'z', 'g', 'r' and 'q'.
+static_assert((SircWire::Write::Address::offset == SircWire::CodedWrite::Address::offset) &&
+              (SircWire::Write::Address::offset == SircWire::WriteAndRun::Address::offset) &&
+              (SircWire::Write::Address::offset == SircWire::Read::Address::offset) &&
+              (SircWire::Write::Address::offset == SircWire::CodedRead::Address::offset) &&
+              (SircWire::Write::Length::offset == SircWire::CodedWrite::Length::offset) &&
+              (SircWire::Write::Length::offset == SircWire::WriteAndRun::Length::offset) &&
+              (SircWire::Write::Length::offset == SircWire::Read::Length::offset) &&
+              (SircWire::Write::Length::offset == SircWire::CodedRead::Length::offset),
+              "address & length commands must share a layout");
 inline void ETH_SIRC::setLengthAndAddress(uint32_t length, uint32_t address){
-#if defined(_MSC_VER) //other compilers might not
-    *(uint32_t*)(currentBuffer+1) = _byteswap_ulong(address);
-    *(uint32_t*)(currentBuffer+5) = _byteswap_ulong(length);
-#else
-	for(int i = 3; i >=0; i--){
-		currentBuffer[i + 1] = address % 256;
-		currentBuffer[i + 5] = length % 256;
-		address = address >> 8;
-		length = length >> 8;
-	}
-#endif
+    SircWire::Write::Address::put(currentBuffer, address);
+    SircWire::Write::Length::put(currentBuffer, length);
 }
 
-//Set the value field (2-5)
+//With credits, the first read request of a burst says how many frames we can take
+// (readCredits), the others and those for what we missed go on with that
+inline void ETH_SIRC::setReadCredits(){
+    if (!creditFlow)
+        return;
+    SircWire::CreditRead::Credits::put(currentBuffer, readCredits);
+    readCredits = SircWire::CreditRead::keep;
+}
+
+//Set the register value field
 inline void ETH_SIRC::setValueField(uint32_t value){
-#if defined(_MSC_VER) //other compilers might not
-    *(uint32_t*)(currentBuffer+2) = _byteswap_ulong(value);
-#else
-	for(int i = 3; i >=0; i--){
-		currentBuffer[i + 2] = value % 256;
-		value = value >> 8;
-	}
-#endif
+    SircWire::RegWrite::Value::put(currentBuffer, value);
 }
 
 //This function queues a receive on the network port
 //Return true on success, return false w/error code on failure
 inline BOOL ETH_SIRC::addReceive(PACKET *Packet){
     
-    if (Packet)
+    if (Packet) {
+        //If the tuner shrunk the pool give this one back rather than recycle it
+        if (postedReceives > targetReceives) {
+            postedReceives--;
+            PacketDriver->FreePacket(Packet,true);
+            return true;
+        }
+        //Same for those a session that left the NIC did not take with it
+        if (nic && nic->retireReceive()) {
+            PacketDriver->FreePacket(Packet,true);
+            return true;
+        }
         Packet->Length = MAXPACKETSIZE;//recycle
-    else
+    } else {
         Packet = PacketDriver->AllocatePacket(NULL,MAXPACKETSIZE,true);
-	if(!Packet){
-		setLastError(FAILMEMALLOC);
-		return false;
-	}
+        if(!Packet){
+            setLastError(FAILMEMALLOC);
+            return false;
+        }
+        postedReceives++;
+    }
 
     BIGDEBUG_adding_receive(Packet);
 
@@ -998,6 +2589,128 @@ inline BOOL ETH_SIRC::addReceive(PACKET *Packet){
     return true;
 }
 
+//Frames the steering table had no lane for go back through addReceive, so that the
+// tuner sees them
+void ETH_SIRC::recycleReceive(PACKET *Packet, void *context){
+    (void) ((ETH_SIRC *) context)->addReceive(Packet);
+}
+
+//Post receives until the pool is as large as the tuner wants it.
+//Shrinking is lazy, addReceive frees the surplus as packets come back.
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::resizeReceivePool(){
+    while (postedReceives < targetReceives) {
+        if (!addReceive())
+            return false;
+    }
+    return true;
+}
+
+//Keep the tuner inside the current limits.  With autoTune off we just use the limits.
+void ETH_SIRC::clampTuner(){
+    if (!autoTune) {
+        writeWindow    = maxOutstandingWrites;
+        targetReceives = maxOutstandingReads;
+        return;
+    }
+    if (writeWindow == 0)
+        writeWindow = 1;
+    if (maxOutstandingWrites && (writeWindow > maxOutstandingWrites))
+        writeWindow = maxOutstandingWrites;
+
+    //Every ack of a full window must find a receive posted
+    if (targetReceives < writeWindow + RECEIVEMARGIN)
+        targetReceives = writeWindow + RECEIVEMARGIN;
+    if (targetReceives < MINOUTSTANDINGREADS)
+        targetReceives = MINOUTSTANDINGREADS;
+    if (targetReceives > maxOutstandingReads)
+        targetReceives = maxOutstandingReads;
+}
+
+//We are about to ask for a burst of numResponses frames, make sure they have somewhere to land.
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::ensureReceiveCapacity(uint32_t numResponses){
+    //Sharing the NIC, what is fair changes as boards come and go
+    uint32_t shareReads, shareWrites;
+    if (nic && nic->getShares(&shareReads, &shareWrites)) {
+        if (shareReads)
+            maxOutstandingReads = shareReads;
+        if (shareWrites)
+            maxOutstandingWrites = shareWrites;
+        clampTuner();
+    }
+
+    //Without the tuner the pool is as large as the limit, once it is posted
+    if (!autoTune)
+        return resizeReceivePool();
+
+    if (numResponses > burstHighWater)
+        burstHighWater = numResponses;
+
+    if (numResponses + RECEIVEMARGIN > targetReceives) {
+        uint32_t oldTarget = targetReceives;
+        targetReceives = numResponses + RECEIVEMARGIN;
+        clampTuner();
+        if (targetReceives != oldTarget) {
+            tunerDecisions++;
+            LogIt("sirc::tune.rx %u %u",oldTarget,targetReceives);
+        }
+    }
+    return resizeReceivePool();
+}
+
+//Adjust the write window and receive pool after a burst completed.
+// burstSize: frames we expected back in this burst
+// sawDrops: we had to retransmit something
+// windowLimited: the burst was cut short by the write window
+//Drops halve the window and grow the pool, clean window-limited bursts grow the window
+// (doubling until the first drop, one frame at a time after that).  A long run of clean
+// bursts lets the pool shrink back to what the largest recent burst needed.
+void ETH_SIRC::tuneAfterBurst(uint32_t burstSize, BOOL sawDrops, BOOL windowLimited){
+    if (!autoTune)
+        return;
+
+    if (burstSize > burstHighWater)
+        burstHighWater = burstSize;
+
+    uint32_t oldWindow = writeWindow;
+    uint32_t oldTarget = targetReceives;
+
+    if (sawDrops) {
+        //Either the receive ring overflowed or the wire/FPGA did.  Back off both ways.
+        slowStart = false;
+        cleanBursts = 0;
+        writeWindow = writeWindow / 2;
+        targetReceives = targetReceives + targetReceives / 2;
+    } else {
+        if (windowLimited &&
+            ((maxOutstandingWrites == 0) || (writeWindow < maxOutstandingWrites)))
+            writeWindow = slowStart ? writeWindow * 2 : writeWindow + 1;
+
+        if (++cleanBursts >= TUNEEPOCH) {
+            //Give back receives we did not need in a while
+            uint32_t needed = max(burstHighWater, writeWindow) + RECEIVEMARGIN;
+            if (needed < targetReceives)
+                targetReceives = needed;
+            cleanBursts = 0;
+            burstHighWater = 0;
+        }
+    }
+
+    clampTuner();
+    if ((writeWindow == oldWindow) && (targetReceives == oldTarget))
+        return;
+
+    tunerDecisions++;
+    LogIt("sirc::tune %u %u",writeWindow,targetReceives);
+
+    //Growing the pool is an optimization, running out of memory here is not fatal
+    if (!resizeReceivePool()) {
+        targetReceives = postedReceives;
+        setLastError(0);
+    }
+}
+
 //This function adds a transmit to the output queue and sends the message
 //Return true if the send goes OK, return false if not.
 //Don't bother with an error code, the function that calls this will take care of that.
@@ -1022,51 +2735,313 @@ inline BOOL ETH_SIRC::sendCurrentPacket(int8_t errorCode, BOOL flushOutstanding,
         return true;
 	PRINTF(("%s not sent!\n", packetName));
     if (flushOutstanding)
-        emptyOutstandingPackets();
+        abandonOutstandingPackets();
 	setLastError(errorCode);
 	return false;
 }
 
-//Flush outstanding packets and return with (optional) error
+//Give up on the outstanding packets and return with (optional) error
 BOOL ETH_SIRC::bailOut(int8_t errorCode){
-    emptyOutstandingPackets();
+    abandonOutstandingPackets();
     if (errorCode)
         setLastError(errorCode);
     return false;
 }
 
-//The ack on the outstanding packets isn't coming, so put them into the free list
-//To avoid all problems, we should clear the completion ports first.
-//This will ensure that no uncompleted requests are outstanding that will complete
-// later, after the packet has been freed.
-void ETH_SIRC::emptyOutstandingPackets(){
-	PACKET *        Packet;
+//The acks on the outstanding packets aren't coming, so put them into the free list.
+//We do not wait for stragglers: what each packet still has coming is written down
+// (abandonResponses) and thrown away when it arrives, see lateResponse.
+//Transmits the driver is still sending are freed once it is done, see retireTransmit.
+void ETH_SIRC::abandonOutstandingPackets(){
+	PACKET *        Packet;
+	DWORD expires = GetTickCount() + max(readTimeout, writeTimeout);
+	std::list <uint32_t>::iterator readStart = outstandingReadStartAddresses.begin();
+	std::list <uint32_t>::iterator readLength = outstandingReadLengths.begin();
+	//The read lists follow the read requests, with what is still missing of each
+	BOOL readsTracked = (outstandingReadStartAddresses.size() == outstandingPackets.size());
+
+	//Now put the outstanding transmits into the free list
+	for(packetIter = outstandingPackets.begin(); packetIter != outstandingPackets.end(); packetIter++){
+		if(readsTracked){
+			abandonResponses(*packetIter, *readStart++, *readLength++, expires);
+		}
+		else{
+			uint8_t *frame = SircWire::Ethernet::payload((*packetIter)->Buffer);
+			abandonResponses(*packetIter, SircWire::Read::Address::get(frame),
+				SircWire::Read::Length::get(frame), expires);
+		}
+        retireTransmit(*packetIter);
+        //Decrement the outstanding packet counter
+        outstandingTransmits --;
+	}
+    outstandingPackets.clear();
+
+    //What is already here for the control lane might still be useful to someone.
+    while (lanePending(controlLane)) {
+        Packet = receiveOn(controlLane, 0);
+        (void) deliverControlResponse(Packet);
+        (void) addReceive(Packet);
+    }
+
+	//Empty the read starting address and length lists
+	outstandingReadStartAddresses.clear();
+	outstandingReadLengths.clear();
+}
+
+//Free a transmit no ack will free: one we gave up on, or one nothing acks (credits).
+//Until the driver hands back its completion (KernelOwned) it may still be sending it,
+// and the completion would land on whatever the packet is by then, so it waits in
+// retiredTransmits.
+void ETH_SIRC::retireTransmit(PACKET *packet){
+    if (packet->KernelOwned)
+        retiredTransmits.push_back(packet);
+    else
+        PacketDriver->FreePacket(packet,false);
+}
+
+//Free the retired transmits whose completions came back.
+//Completions come off the driver as we (or another session on the NIC) receive.
+void ETH_SIRC::freeRetiredTransmits(){
+    std::list <PACKET *>::iterator it = retiredTransmits.begin();
+
+    while (it != retiredTransmits.end()) {
+        if ((*it)->KernelOwned)
+            it++;
+        else {
+            PacketDriver->FreePacket(*it,false);
+            it = retiredTransmits.erase(it);
+        }
+    }
+}
+
+//Write down the responses this packet still has coming, if any.
+// readAddress, readLength: what is still missing, for read requests
+//Bulk frames carry no request id, so a response is known by its command and the part
+// of a buffer (or the register) it is about.
+void ETH_SIRC::abandonResponses(PACKET *packet, uint32_t readAddress, uint32_t readLength, DWORD expires){
+	uint8_t *frame = SircWire::Ethernet::payload(packet->Buffer);
+	ABANDONED late;
+
+	late.startAddress = 0;
+	late.length = 0;
+	late.expires = expires;
+
+	switch(SircWire::Write::Command::get(frame)){
+	case SircWire::Write::command:
+	case SircWire::CodedWrite::command:
+		//Acked by a plain 'w' with the header
+		late.command = SircWire::Write::command;
+		late.startAddress = SircWire::Write::Address::get(frame);
+		late.length = SircWire::Write::Length::get(frame);
+		break;
+	case SircWire::Read::command:
+	case SircWire::CodedRead::command:
+		late.command = SircWire::ReadResponse::command;
+		late.startAddress = readAddress;
+		late.length = readLength;
+		break;
+	case SircWire::WriteAndRun::command:
+		//Could be any part of the output
+		late.command = SircWire::ReadBack::command;
+		late.length = maxOutputDataBytes;
+		break;
+	case SircWire::RegWrite::command:
+		late.command = SircWire::RegWrite::command;
+		late.startAddress = SircWire::RegWrite::Register::get(frame);
+		break;
+	case SircWire::RegRead::command:
+		late.command = SircWire::RegReadResponse::command;
+		late.startAddress = SircWire::RegRead::Register::get(frame);
+		break;
+	case SircWire::Reset::command:
+	case SircWire::Negotiate::command:
+	case SircWire::FecSetup::command:
+	case SircWire::CreditSetup::command:
+		late.command = SircWire::Write::Command::get(frame);
+		break;
+	case SircWire::Checksum::command:
+		late.command = SircWire::ChecksumResponse::command;
+		late.startAddress = SircWire::Checksum::Address::get(frame);
+		late.length = SircWire::Checksum::Length::get(frame);
+		break;
+	default:
+		return;
+	}
+	abandoned.push_back(late);
+}
+
+//Is this packet the response to something we gave up on?
+//If so, it is struck off the list (for data, just the part it carries) and the caller
+// should recycle the packet.
+//A new command that looks the same as an abandoned one may lose its first response
+// here, it then gets resent like any other lost frame.
+BOOL ETH_SIRC::lateResponse(PACKET *packet){
+	std::list <ABANDONED>::iterator iter;
+	uint8_t *frame = SircWire::Ethernet::payload(packet->Buffer);
+	uint32_t length = SircWire::Ethernet::Length::get(packet->Buffer);
+	uint8_t command;
+	uint32_t address = 0;
+	uint32_t count = 0;
+	BOOL data = false;
+
+	if(abandoned.empty())
+		return false;
+	pruneAbandoned();
+
+	command = SircWire::Write::Command::get(frame);
+	switch(command){
+	case SircWire::Write::command:
+		//Acks echo the header, nothing else
+		if(length != SircWire::Write::headerLength)
+			return false;
+		address = SircWire::Write::Address::get(frame);
+		count = SircWire::Write::Length::get(frame);
+		break;
+	case SircWire::ReadResponse::command:
+		if(!SircWire::ReadResponse::valid(frame, length))
+			return false;
+		address = SircWire::ReadResponse::Address::get(frame);
+		count = SircWire::ReadResponse::dataLength(length);
+		data = true;
+		break;
+	case SircWire::CodedReadResponse::command:
+		if(!SircWire::CodedReadResponse::valid(frame, length))
+			return false;
+		command = SircWire::ReadResponse::command;
+		address = SircWire::CodedReadResponse::Address::get(frame);
+		count = SircWire::CodedReadResponse::Length::get(frame);
+		data = true;
+		break;
+	case SircWire::ReadBack::command:
+		if(!SircWire::ReadBack::valid(frame, length))
+			return false;
+		address = SircWire::ReadBack::Address::get(frame);
+		count = SircWire::ReadBack::dataLength(length);
+		data = true;
+		break;
+	case SircWire::CodedReadBack::command:
+		if(!SircWire::CodedReadBack::valid(frame, length))
+			return false;
+		command = SircWire::ReadBack::command;
+		address = SircWire::CodedReadBack::Address::get(frame);
+		count = SircWire::CodedReadBack::Length::get(frame);
+		data = true;
+		break;
+	case SircWire::RegWrite::command:
+		if(!SircWire::RegWrite::valid(frame, length))
+			return false;
+		address = SircWire::RegWrite::Register::get(frame);
+		break;
+	case SircWire::RegReadResponse::command:
+		if(!SircWire::RegReadResponse::valid(frame, length))
+			return false;
+		address = SircWire::RegReadResponse::Register::get(frame);
+		break;
+	case SircWire::Reset::command:
+	case SircWire::Negotiate::command:
+	case SircWire::FecSetup::command:
+	case SircWire::CreditSetup::command:
+		break;
+	case SircWire::ChecksumResponse::command:
+		if(!SircWire::ChecksumResponse::valid(frame, length))
+			return false;
+		address = SircWire::ChecksumResponse::Address::get(frame);
+		count = SircWire::ChecksumResponse::Length::get(frame);
+		break;
+	default:
+		return false;
+	}
+
+	for(iter = abandoned.begin(); iter != abandoned.end(); iter++){
+		if(iter->command != command)
+			continue;
+		if(!data){
+			if((iter->startAddress != address) || (iter->length != count))
+				continue;
+			abandoned.erase(iter);
+			LogIt("sirc::late %c %u",command,address);
+			return true;
+		}
+
+		//Strike the piece it carries out of the range
+		uint32_t end = iter->startAddress + iter->length;
+		if((address < iter->startAddress) || (address + count > end))
+			continue;
+		if(address + count < end){
+			ABANDONED rest = *iter;
+			rest.startAddress = address + count;
+			rest.length = end - rest.startAddress;
+			abandoned.push_back(rest);
+		}
+		iter->length = address - iter->startAddress;
+		if(iter->length == 0)
+			abandoned.erase(iter);
+		LogIt("sirc::late %c %u",command,address);
+		return true;
+	}
+	return false;
+}
+
+//The FPGA answers in order, so once a reset is acked everything it sent before is here.
+//Drop what is still queued on the bulk lane and forget the rest, so that a retry that
+// looks just like what we gave up on keeps its responses.
+void ETH_SIRC::forgetAbandoned(){
+	PACKET *Packet;
 
-	//Keep polling until it comes up empty
-	for(;;){
-        Packet = PacketDriver->GetNextReceivedPacket(readTimeout);
-        if (Packet == NULL)
-            break;
+	while(lanePending(bulkLane)){
+		Packet = receiveOn(bulkLane, 0);
+		if(!Packet)
+			break;
+		(void) addReceive(Packet);
+	}
+	abandoned.clear();
+}
 
-		//Some packet completed, too late.
-        assert(Packet->Mode == PacketModeReceiving);
-        BIGDEBUG_packet_received(Packet,1);
+//Forget the abandoned responses that can no longer come
+void ETH_SIRC::pruneAbandoned(){
+	std::list <ABANDONED>::iterator iter;
+	DWORD now = GetTickCount();
 
-        //Received packets get re-posted immediately
-        (void) addReceive(Packet);
-    }
+	for(iter = abandoned.begin(); iter != abandoned.end();){
+		if((LONG)(now - iter->expires) >= 0)
+			iter = abandoned.erase(iter);
+		else
+			iter++;
+	}
+}
 
-	//Now put the outstanding transmits into the free list
-	for(packetIter = outstandingPackets.begin(); packetIter != outstandingPackets.end(); packetIter++){
-        PacketDriver->FreePacket(*packetIter,false);
-        //Decrement the outstanding packet counter
-        outstandingTransmits --;
+//Wait until nothing we gave up on can still answer, or maxWaitTimeInMsec is up.
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::quiesce(uint32_t maxWaitTimeInMsec){
+	DWORD startTime = GetTickCount();
+	BOOL quiet;
+
+	//The I/O thread holds the wire for good, take it back for a moment
+	stopIoThread();
+	{
+		LaneGuard lane(this);
+
+		for(;;){
+			pruneAbandoned();
+			if(abandoned.empty() || (GetTickCount() - startTime >= maxWaitTimeInMsec))
+				break;
+			//Late responses are struck off in there, anything else is not ours to keep
+			PACKET *Packet = nextBulkPacket(QUIESCESLICE);
+			if(Packet)
+				(void) addReceive(Packet);
+		}
+		quiet = abandoned.empty();
 	}
-    outstandingPackets.clear();
+	if(!startIoThread())
+		return false;
 
-	//Empty the read starting address and length lists
-	outstandingReadStartAddresses.clear();
-	outstandingReadLengths.clear();
+	LogIt("sirc::quiesce %u %u",(uint32_t) abandoned.size(),GetTickCount() - startTime);
+	if(!quiet){
+		setLastError(FAILQUIESCE);
+		return false;
+	}
+	setLastError(0);
+	return true;
 }
 
 //Create a write request, add it to the back of the outstanding queue and transmit it.
@@ -1077,16 +3052,16 @@ BOOL ETH_SIRC::createWriteRequestBackAndTransmit(uint32_t startAddress, uint32_t
     LogIt("sirc::cwr %u %u",startAddress,length);
 
 	/*The packet will be N + 9 bytes long: N payload + 1 byte command + 4 bytes address + 4 bytes length) */
-    if (!allocateAndFillPacket(9+length))
+    if (!allocateAndFillPacket(SircWire::Write::frameLength(length)))
         return false;
 
 	//Set the command byte to 'w'
-	currentBuffer[0] = 'w';
+	SircWire::Write::start(currentBuffer);
 
     setLengthAndAddress(length,startAddress);
 
 	//Copy the write data over
-	memcpy(currentBuffer + 9, buffer, length);
+	memcpy(SircWire::Write::data(currentBuffer), buffer, length);
 
 	//Keep track of this message
 	outstandingPackets.push_back(currentPacket);
@@ -1096,6 +3071,61 @@ BOOL ETH_SIRC::createWriteRequestBackAndTransmit(uint32_t startAddress, uint32_t
     return sendCurrentPacket(INVALIDWRITETRANSMIT,false DEBUG_ONLY_1ARG("Write"));
 }
 
+//See if the next frame of this write is better sent coded.
+//If so the coded payload is left in codeBuffer, *currLength is set to the
+// number of bytes it carries and we return its coded length.
+//Return 0 for a plain frame.
+uint32_t ETH_SIRC::codeWriteFrame(uint8_t *buffer, uint32_t length, uint32_t *currLength){
+    uint32_t rawLength;
+    uint32_t codedLength;
+
+    if (!(compression & SIRC_COMPRESS_WRITES))
+        return 0;
+
+    //This data did not compress a moment ago, do not waste the time
+    if (codingMisses) {
+        codingMisses--;
+        return 0;
+    }
+
+    codedLength = sircRleEncodeFrame(buffer, length, MAXWRITESIZE, codeBuffer, MAXWRITESIZE, &rawLength);
+    if (codedLength == 0) {
+        codingMisses = CODINGBACKOFF;
+        return 0;
+    }
+
+    *currLength = rawLength;
+    return codedLength;
+}
+
+//Create a coded write request from codeBuffer, add it to the back of the outstanding
+// queue and transmit it.  The FPGA acks it like a 'w', echoing the first 9 bytes.
+//Return true if the addition & transmission goes OK.
+//Return false w/error code if not.
+BOOL ETH_SIRC::createCodedWriteRequestBackAndTransmit(uint32_t startAddress, uint32_t rawLength, uint32_t codedLength, BOOL flushQueue){
+
+    LogIt("sirc::cwz %u %u",startAddress,rawLength);
+
+	/*The packet will be N + 9 bytes long: N coded + 1 byte command + 4 bytes address + 4 bytes raw length) */
+    if (!allocateAndFillPacket(SircWire::CodedWrite::frameLength(codedLength)))
+        return false;
+
+	//Set the command byte to 'z'
+	SircWire::CodedWrite::start(currentBuffer);
+
+    setLengthAndAddress(rawLength,startAddress);
+
+	//Copy the coded data over
+	memcpy(SircWire::CodedWrite::data(currentBuffer), codeBuffer, codedLength);
+
+	//Keep track of this message
+	outstandingPackets.push_back(currentPacket);
+	outstandingTransmits++;
+
+    currentPacket->Flush = flushQueue;
+    return sendCurrentPacket(INVALIDWRITETRANSMIT,false DEBUG_ONLY_1ARG("Coded write"));
+}
+
 //Try and grab as many write acks that we can up till:
 // 1) we get all of the outstanding writes acked, return true
 // 2) we haven't gotten a new ack for N seconds (N should never be less than 1), return false
@@ -1104,7 +3134,7 @@ BOOL ETH_SIRC::receiveWriteAcks(){
 	PACKET *        Packet;
 
 	for(;;){
-        Packet = PacketDriver->GetNextReceivedPacket(writeTimeout);
+        Packet = nextBulkPacket(writeTimeout);
         if (Packet == NULL)
             break;
 
@@ -1143,20 +3173,84 @@ BOOL ETH_SIRC::receiveWriteAcks(){
 	return false;
 }
 
-static UINT32 w32(uint8_t *w)
+//Move a response payload into place, expanding it if it came coded
+static inline void placePayload(uint8_t *dst, uint8_t *payload, uint32_t codedLength, uint32_t length)
+{
+    if (codedLength)
+        sircRleDecode(payload, codedLength, dst, length);
+    else
+        memcpy(dst, payload, length);
+}
+
+//Is this a read response ('r' or 'q')?  If so, find its payload.
+static inline BOOL readResponsePayload(uint8_t *frame, uint32_t dataLength, uint8_t **payload,
+                                       uint32_t *payloadLength, uint32_t *codedLength)
+{
+    //Check the command byte and length (at least 1 data byte), and find the payload
+    if (SircWire::ReadResponse::valid(frame, dataLength)) {
+        *payload = SircWire::ReadResponse::data(frame);
+        *payloadLength = SircWire::ReadResponse::dataLength(dataLength);
+        *codedLength = 0;
+        return true;
+    }
+    if (SircWire::CodedReadResponse::valid(frame, dataLength)) {
+        //Coded, 4 more bytes for the length it expands to
+        *payload = SircWire::CodedReadResponse::data(frame);
+        *payloadLength = SircWire::CodedReadResponse::Length::get(frame);
+        *codedLength = SircWire::CodedReadResponse::dataLength(dataLength);
+        return (*payloadLength != 0) && (*payloadLength <= SIRC_RLE_MAXSEGMENT) &&
+               (sircRleDecodedLength(*payload, *codedLength) == *payloadLength);
+    }
+    return false;
+}
+
+//Same for readbacks ('g' or 'u')
+static inline BOOL readBackPayload(uint8_t *frame, uint32_t dataLength, uint8_t **payload,
+                                   uint32_t *payloadLength, uint32_t *codedLength)
 {
-    return ((w[0] << 24) |
-            (w[1] << 16) |
-            (w[2] <<  8) |
-            (w[3] <<  0));
+    if (SircWire::ReadBack::valid(frame, dataLength)) {
+        *payload = SircWire::ReadBack::data(frame);
+        *payloadLength = SircWire::ReadBack::dataLength(dataLength);
+        *codedLength = 0;
+        return true;
+    }
+    if (SircWire::CodedReadBack::valid(frame, dataLength)) {
+        *payload = SircWire::CodedReadBack::data(frame);
+        *payloadLength = SircWire::CodedReadBack::Length::get(frame);
+        *codedLength = SircWire::CodedReadBack::dataLength(dataLength);
+        return (*payloadLength != 0) && (*payloadLength <= SIRC_RLE_MAXSEGMENT) &&
+               (sircRleDecodedLength(*payload, *codedLength) == *payloadLength);
+    }
+    return false;
+}
+
+//Where the data of a read response for [address, address + length) goes, NULL if it
+// does not fit inside a single target.  Targets are sorted by address and do not overlap.
+static inline uint8_t *readDestination(const SIRC_SEGMENT *targets, uint32_t count, uint32_t address, uint32_t length)
+{
+    uint32_t low = 0;
+    uint32_t high = count;
+
+    //Last target starting at or before address
+    while (high - low > 1) {
+        uint32_t middle = (low + high) / 2;
+        if (targets[middle].startAddress <= address)
+            low = middle;
+        else
+            high = middle;
+    }
+    if (count == 0 || address < targets[low].startAddress ||
+        address - targets[low].startAddress + length > targets[low].length)
+        return NULL;
+    return targets[low].buffer + (address - targets[low].startAddress);
 }
 
 //See if this write ack matches one that is outstanding
 //If the packet matches one in the outstandingPacket list, return true.
 //If not, return false.
 inline BOOL ETH_SIRC::checkWriteAck(PACKET* packet){
-    //LogIt("sirc::cwa %u %u", w32(packet->Buffer+15), w32(pcket->Buffer+15+4));
-    return checkSimpleResponse(packet,'w',9);
+    //Coded writes ('z') are acked the same way
+    return checkSimpleResponse(packet, SircWire::Write::command, SircWire::Write::headerLength);
 }
 
 //Create a read request, add it to the back of the outstanding queue and transmit it.
@@ -1164,14 +3258,19 @@ inline BOOL ETH_SIRC::checkWriteAck(PACKET* packet){
 //Return false with error code if anything goes wrong.
 BOOL ETH_SIRC::createReadRequestBackAndTransmit(uint32_t startAddress, uint32_t length){
 
-	/*The packet will be 9 bytes long: 1 byte command + 4 bytes address + 4 bytes length) */
-    if (!allocateAndFillPacket(9))
+	/*The packet will be 9 bytes long: 1 byte command + 4 bytes address + 4 bytes length),
+	  4 more with credits */
+    if (!allocateAndFillPacket(creditFlow ? SircWire::CreditRead::headerLength : SircWire::Read::headerLength))
         return false;
 
-	//Set the command byte to 'r'
-	currentBuffer[0] = 'r';
+	//Set the command byte to 'r', or 'q' if the responses may come coded
+	if(compression & SIRC_COMPRESS_READS)
+		SircWire::CodedRead::start(currentBuffer);
+	else
+		SircWire::Read::start(currentBuffer);
 
     setLengthAndAddress(length,startAddress);
+    setReadCredits();
 
 	//Keep track of this message
 	outstandingPackets.push_back(currentPacket);
@@ -1190,14 +3289,19 @@ BOOL ETH_SIRC::createReadRequestBackAndTransmit(uint32_t startAddress, uint32_t
 //Return false w/error code if not.
 BOOL ETH_SIRC::createReadRequestCurrentIterLocation(uint32_t startAddress, uint32_t length){
 
-	/*The packet will be 9 bytes long: 1 byte command + 4 bytes address + 4 bytes length) */
-    if (!allocateAndFillPacket(9))
+	/*The packet will be 9 bytes long: 1 byte command + 4 bytes address + 4 bytes length),
+	  4 more with credits */
+    if (!allocateAndFillPacket(creditFlow ? SircWire::CreditRead::headerLength : SircWire::Read::headerLength))
         return false;
 
-	//Set the command byte to 'r'
-	currentBuffer[0] = 'r';
+	//Set the command byte to 'r', or 'q' if the responses may come coded
+	if(compression & SIRC_COMPRESS_READS)
+		SircWire::CodedRead::start(currentBuffer);
+	else
+		SircWire::Read::start(currentBuffer);
 
     setLengthAndAddress(length,startAddress);
+    setReadCredits();
 
 	//Keep track of this message
 	packetIter = outstandingPackets.insert(packetIter, currentPacket);
@@ -1212,14 +3316,14 @@ BOOL ETH_SIRC::createReadRequestCurrentIterLocation(uint32_t startAddress, uint3
 // We have sent out one or more read requests (in strictly increasing addresses).
 // The transmitted request packets are in outstandingPackets and the corresponding starting address
 //	and length of the requests are in outstandingReadStartAddresses and outstandingReadLengths.
-// We pass this function the initial start address of the entire read so that we know what the
-//  offset should be within the buffer for subsequent read request replies.
+// We pass this function the targets of the entire read so that we know where in the
+//  caller's buffers subsequent read request replies go.
 // Try any grab as many read responses as we can till:
 //	1) we get all of the reads back that we asked for, return true
 //	2) we haven't gotten a new ack for N seconds (N should never be less than 1), return false
 //		and outstandingPacket/ReadStartAddress/ReadLength will be loaded with the resends
 // 3) we have some problem on the completion port or addReceive, return false w/ error code
-BOOL ETH_SIRC::receiveReadResponses(uint32_t initialStartAddress, uint8_t *buffer){
+BOOL ETH_SIRC::receiveReadResponses(const SIRC_SEGMENT *targets, uint32_t count){
 	PACKET *        Packet;
 
 	//Let's keep track of where we are in the list of outstanding packets.
@@ -1236,9 +3340,10 @@ BOOL ETH_SIRC::receiveReadResponses(uint32_t initialStartAddress, uint8_t *buffe
 	uint32_t currLength = 0;
 
 	noResends = true;
+	sircFecStart(fec);
 
 	for(;;){
-        Packet = PacketDriver->GetNextReceivedPacket(readTimeout);
+        Packet = nextBulkPacket(readTimeout);
         if (Packet == NULL)
             break;
 
@@ -1246,13 +3351,25 @@ BOOL ETH_SIRC::receiveReadResponses(uint32_t initialStartAddress, uint8_t *buffe
         assert(Packet->Mode == PacketModeReceiving);
         BIGDEBUG_packet_received(Packet,0);
 
-        //Check if this is any read response packet we are expecting.
-        //If it is, copy the data to the buffer, update the currAddress/currLength,
-        // and update the outstanding packet list (removing or adding as necessary).
-        if(checkReadData(Packet, &currAddress, &currLength, buffer, initialStartAddress)){
+        //With FEC a parity frame may give back a frame we lost.  If we already put in
+        // another request for it, that request is filled and never sent.
+        BOOL rebuilt;
+        BOOL good = false;
+        if(takeFec(Packet, &rebuilt)){
+            if(rebuilt && fillReadGap(Packet, targets, count))
+                good = true;
+            //Check if this is any read response packet we are expecting.
+            //If it is, copy the data to the buffer, update the currAddress/currLength,
+            // and update the outstanding packet list (removing or adding as necessary).
+            else
+                good = checkReadData(Packet, &currAddress, &currLength, targets, count);
+            if(good && rebuilt)
+                fecRecovered++;
+        }
+        if(good){
 
             //This is a good read response, so repost the packet
-            if (addReceive(Packet)){
+            if (addReceive(Packet) && grantCredit()){
                 //We know we are done if there are no more transmits outstanding and the
                 // currLength == 0
                 if(outstandingTransmits == 0 && currLength == 0){
@@ -1260,8 +3377,8 @@ BOOL ETH_SIRC::receiveReadResponses(uint32_t initialStartAddress, uint8_t *buffe
                 }
                 //We know we are done for now if we are at the end of the outstanding queue and we have
                 // currLength == 0).  No sense in waiting to time out, we know that we had some problems
-                // and we want to resend.
-                if(packetIter == outstandingPackets.end() && currLength == 0){
+                // and we want to resend.  Unless the parity of the last group might still fix them.
+                if(packetIter == outstandingPackets.end() && currLength == 0 && !awaitingParity()){
                     break;
                 }
 
@@ -1277,7 +3394,7 @@ BOOL ETH_SIRC::receiveReadResponses(uint32_t initialStartAddress, uint8_t *buffe
             int8_t err = getLastError();
 
             //repost the packet
-            if (!addReceive(Packet)){
+            if (!addReceive(Packet) || !grantCredit()){
                 return false;
             }
 
@@ -1310,39 +3427,40 @@ BOOL ETH_SIRC::receiveReadResponses(uint32_t initialStartAddress, uint8_t *buffe
 // outstanding list.  If this goes OK, we will return true.  If anything goes wrong
 // we will return false with an error code.
 BOOL ETH_SIRC::checkReadData(PACKET* packet, uint32_t* currAddress, uint32_t* currLength, 
-							 uint8_t* buffer, uint32_t initialStartAddress){
+							 const SIRC_SEGMENT *targets, uint32_t count){
 	uint8_t *message = packet->Buffer;
 
 	uint32_t dataLength;
 	uint32_t startAddress;
-	int i;
+	uint8_t *frame;
+	uint8_t *payload;
+	uint32_t payloadLength;
+	uint32_t codedLength;
+	uint8_t *destination;
 
 	//When we enter this function, packetIter will always be pointing at a request for which 
 	// we have not seen any responses.  This is because as soon as we see any 
 	// response from a given request, we remove it from the list.
 	//First, see if this is a valid read response
-	//See if the packet is from the expected source
-    if (memcmp(message+6,ethHeader.FPGA_MACAddress,6) != 0)
-        return false;
+	//The steering table only lets through packets from our FPGA
 
 	//Get the length of the packet
-	dataLength = message[12];
-	dataLength = (dataLength << 8) + message[13];
-	//This packet must be at least 6 bytes long (1 byte command + 4 bytes address + 1 data byte)
-	if(dataLength < 6){
-		return false;
-	}
+	dataLength = SircWire::Ethernet::Length::get(message);
+	frame = SircWire::Ethernet::payload(message);
 
-	//Check the command byte
-	if(message[14] != 'r')
+	//Check the command byte and length, and find the payload
+	if(!readResponsePayload(frame, dataLength, &payload, &payloadLength, &codedLength))
 		return false;
 
-	//Get the start address
-	startAddress = 0;
-	for(i = 0; i < 4; i++){
-		startAddress = startAddress << 8;
-		startAddress += message[15 + i];
-	}
+	//Get the start address, same place in both
+	static_assert(SircWire::ReadResponse::Address::offset == SircWire::CodedReadResponse::Address::offset,
+	              "read responses must share the address field");
+	startAddress = SircWire::ReadResponse::Address::get(frame);
+
+	//Requests never cross targets, neither do their responses
+	destination = readDestination(targets, count, startAddress, payloadLength);
+	if(!destination)
+		return false;
 
 	//This is probably a valid read response, let's try to match it up
 	for(;;){
@@ -1364,22 +3482,22 @@ BOOL ETH_SIRC::checkReadData(PACKET* packet, uint32_t* currAddress, uint32_t* cu
 			//	Now, there are a few things that can happen:
 			//	1) we get a response for the beginning of the request at packetIter
 			if(startAddress == *currAddress){
-                LogIt("sirc::crd0 %u %u",startAddress,dataLength-5);
+                LogIt("sirc::crd0 %u %u",startAddress,payloadLength);
 				//	a) mark the packet acked
 				markPacketAcked(*packetIter);
 				//	b) remove the packet at from the outstanding list
 				removeReadRequestCurrentIterLocation();
 				//	b) copy over the received data to the buffer
-				memcpy(buffer+(startAddress - initialStartAddress), message + 19, dataLength - 5);
+				placePayload(destination, payload, codedLength, payloadLength);
 				//	c) update currLength & currAddress
-				*currLength -= dataLength - 5;
-				*currAddress += dataLength - 5;
+				*currLength -= payloadLength;
+				*currAddress += payloadLength;
 				return true;
 			}
 			//	2) we get a response for the middle of the request at packetIter (we missed some
 			//		data for the beginning of the request)
 			if(startAddress > *currAddress && startAddress < *currAddress + *currLength){
-                LogIt("sirc::crd1 %u %u",startAddress,dataLength-5);
+                LogIt("sirc::crd1 %u %u",startAddress,payloadLength);
 				noResends = false;
 				//	a) mark the packet acked
 				markPacketAcked(*packetIter);
@@ -1390,16 +3508,16 @@ BOOL ETH_SIRC::checkReadData(PACKET* packet, uint32_t* currAddress, uint32_t* cu
 					return false;
 				}
 				//	d) copy over the data
-				memcpy(buffer+(startAddress - initialStartAddress), message + 19, dataLength - 5);
+				placePayload(destination, payload, codedLength, payloadLength);
 				//	e) update currLength & currAddress
-				*currLength -= (startAddress - *currAddress) + dataLength - 5;
-				*currAddress = startAddress + dataLength - 5;
+				*currLength -= (startAddress - *currAddress) + payloadLength;
+				*currAddress = startAddress + payloadLength;
 				return true;
 			}
 			//	3) we get a response for an interval beyond the end of the request at packetIter
 			//		(we missed responses for the entire request)
 			if(startAddress >= *currAddress + *currLength){
-                LogIt("sirc::crd2 %u %u ???",startAddress,dataLength-5);
+                LogIt("sirc::crd2 %u %u ???",startAddress,payloadLength);
 				noResends = false;
 				//	a) increment packetIter (leave the old request in the list)
 				incrementCurrIterLocation();
@@ -1421,33 +3539,33 @@ BOOL ETH_SIRC::checkReadData(PACKET* packet, uint32_t* currAddress, uint32_t* cu
         //	1) we get a response for right at currAddress (typical)
         if(startAddress == *currAddress){
             //	a) copy over the received data to the buffer
-            LogIt("sirc::crd00 %u %u",startAddress,dataLength-5);
-            memcpy(buffer+(startAddress - initialStartAddress), message + 19, dataLength - 5);
+            LogIt("sirc::crd00 %u %u",startAddress,payloadLength);
+            placePayload(destination, payload, codedLength, payloadLength);
             //	b) update currLength & currAddress
-            *currLength -= dataLength - 5;
-            *currAddress += dataLength - 5;
+            *currLength -= payloadLength;
+            *currAddress += payloadLength;
             return true;
         }
         //	2) we get a response for the middle between currAddress and currLength (we missed some data
         //		for the beginning of the request)
         if(startAddress > *currAddress && startAddress < *currAddress + *currLength){
-            LogIt("sirc::crd01 %u %u",startAddress,dataLength-5);
+            LogIt("sirc::crd01 %u %u",startAddress,payloadLength);
             noResends = false;
             //	a) create and insert a new read request for the missing piece
             if(!createReadRequestCurrentIterLocation(*currAddress, startAddress - *currAddress)){
                 return false;
             }
             //	b) copy over the data
-            memcpy(buffer+(startAddress - initialStartAddress), message + 19, dataLength - 5);
+            placePayload(destination, payload, codedLength, payloadLength);
             //	c) update currLength & currAddress
-            *currLength -= (startAddress - *currAddress) + dataLength - 5;
-            *currAddress = startAddress + dataLength - 5;
+            *currLength -= (startAddress - *currAddress) + payloadLength;
+            *currAddress = startAddress + payloadLength;
             return true;
         }
         // 3) we get a response for an interval beyond the end of the current request
         //		(we missed the response for the remainder of the current request)
         if(startAddress >= *currAddress + *currLength){
-            LogIt("sirc::crd02 %u %u ????",startAddress,dataLength-5);
+            LogIt("sirc::crd02 %u %u ????",startAddress,payloadLength);
             noResends = false;
             //	a) create and insert a new read request for the missing piece of the current request
             if(!createReadRequestCurrentIterLocation(*currAddress, *currLength)){
@@ -1467,19 +3585,44 @@ BOOL ETH_SIRC::checkReadData(PACKET* packet, uint32_t* currAddress, uint32_t* cu
 	}
 }
 
+//A frame FEC rebuilt may be one we already put in another request for, in the
+// outstanding list before packetIter.  If so, take the data and drop the request.
+//Return true if it was, false if the packet should go to checkReadData instead.
+BOOL ETH_SIRC::fillReadGap(PACKET *packet, const SIRC_SEGMENT *targets, uint32_t count){
+	uint8_t *message = packet->Buffer;
+	uint8_t *frame = SircWire::Ethernet::payload(message);
+	uint8_t *payload;
+	uint32_t payloadLength;
+	uint32_t codedLength;
+	uint32_t startAddress;
+	uint8_t *destination;
+
+	if(!readResponsePayload(frame, SircWire::Ethernet::Length::get(message), &payload, &payloadLength, &codedLength))
+		return false;
+	startAddress = SircWire::ReadResponse::Address::get(frame);
+
+	destination = readDestination(targets, count, startAddress, payloadLength);
+	if(!destination || !claimGap(startAddress, payloadLength))
+		return false;
+
+    LogIt("sirc::crdf %u %u",startAddress,payloadLength);
+	placePayload(destination, payload, codedLength, payloadLength);
+	return true;
+}
+
 //Create a register write request, add it to the back of the outstanding queue and transmit it.
 //Return true if the addition & transmission goes OK.
 //Return false w/error code if not.
 BOOL ETH_SIRC::createParamWriteRequestBackAndTransmit(uint8_t regNumber, uint32_t value){
 	//The packet will be 6 bytes long (1 byte command + 1 byte address + 4 bytes length)
-    if (!allocateAndFillPacket(6))
+    if (!allocateAndFillPacket(SircWire::RegWrite::headerLength))
         return false;
 
 	//Set the command byte to 'k'
-	currentBuffer[0] = 'k';
+	SircWire::RegWrite::start(currentBuffer);
 
 	//Copy the register address over
-	currentBuffer[1] = regNumber;
+	SircWire::RegWrite::Register::put(currentBuffer, regNumber);
 	
 	//Copy the value over
     setValueField(value);
@@ -1495,7 +3638,7 @@ BOOL ETH_SIRC::createParamWriteRequestBackAndTransmit(uint8_t regNumber, uint32_
 //If the packet matches the one in the outstandingPacket list, return true.
 //If not, return false.
 BOOL ETH_SIRC::checkParamWriteAck(PACKET* packet, uint32_t *unused){
-    return checkSimpleResponse(packet, 'k', 6);
+    return checkSimpleResponse(packet, SircWire::RegWrite::command, SircWire::RegWrite::headerLength);
 }
 
 //Create a register read request, add it to the back of the outstanding queue and transmit it.
@@ -1504,14 +3647,14 @@ BOOL ETH_SIRC::checkParamWriteAck(PACKET* packet, uint32_t *unused){
 BOOL ETH_SIRC::createParamReadRequestBackAndTransmit(uint8_t regNumber){
 
 	//The packet will be 2 bytes long (1 byte command + 1 byte address)
-    if (!allocateAndFillPacket(2))
+    if (!allocateAndFillPacket(SircWire::RegRead::headerLength))
         return false;
 
 	//Set the command byte to 'y'
-	currentBuffer[0] = 'y';
+	SircWire::RegRead::start(currentBuffer);
 
 	//Copy the register address over
-	currentBuffer[1] = regNumber;
+	SircWire::RegRead::Register::put(currentBuffer, regNumber);
 
 	//Keep track of this message
 	outstandingPackets.push_back(currentPacket);
@@ -1525,7 +3668,7 @@ BOOL ETH_SIRC::createParamReadRequestBackAndTransmit(uint8_t regNumber){
 //If the packet matches the one in the outstandingPacket list, return true.
 //If not, return false.
 BOOL ETH_SIRC::checkParamReadData(PACKET* packet, uint32_t *value){
-    return checkResponseWithValue(packet,value, 'y');
+    return checkResponseWithValue(packet,value, SircWire::RegReadResponse::command);
 }
 
 //Create a write and run request, add it to the back of the outstanding queue and transmit it.
@@ -1534,16 +3677,16 @@ BOOL ETH_SIRC::checkParamReadData(PACKET* packet, uint32_t *value){
 BOOL ETH_SIRC::createWriteAndRunRequestBackAndTransmit(uint32_t startAddress, uint32_t length, uint8_t *buffer){
 
 	/*The packet will be N + 9 bytes long: N payload + 1 byte command + 4 bytes address + 4 bytes length) */
-    if (!allocateAndFillPacket(9+length))
+    if (!allocateAndFillPacket(SircWire::WriteAndRun::frameLength(length)))
         return false;
 
 	//Set the command byte to 'g'
-	currentBuffer[0] = 'g';
+	SircWire::WriteAndRun::start(currentBuffer);
 
     setLengthAndAddress(length,startAddress);
 
 	//Copy the write data over
-	memcpy(currentBuffer + 9, buffer, length);
+	memcpy(SircWire::WriteAndRun::data(currentBuffer), buffer, length);
 
 	//Keep track of this message
     //It will be handled specially though (in receiveWriteAndRunAcks)
@@ -1587,9 +3730,15 @@ BOOL ETH_SIRC::receiveWriteAndRunAcks(uint32_t maxWaitTimeInMsec, uint32_t maxOu
 	uint32_t currLength = 0;
 
 	noResponse = true;
+	sircFecStart(fec);
 
 	for(;;){
-        Packet = PacketDriver->GetNextReceivedPacket(maxWaitTimeInMsec);
+        //Everything is in but the parity of the last group, which might fill a gap
+        uint32_t timeout = maxWaitTimeInMsec;
+        if(!noResponse && currLength == 0)
+            timeout = readTimeout;
+
+        Packet = nextBulkPacket(timeout);
         if (Packet == NULL)
             break;
 
@@ -1597,10 +3746,25 @@ BOOL ETH_SIRC::receiveWriteAndRunAcks(uint32_t maxWaitTimeInMsec, uint32_t maxOu
         assert(Packet->Mode == PacketModeReceiving);
         BIGDEBUG_packet_received(Packet,0);
 
-        //Check if this is any read response packet we are expecting.
-        //If it is, copy the data to the buffer, update the currAddress/currLength/outputLength,
-        // and add missed reads if necessary.
-        if(checkWriteAndRunData(Packet, &currAddress, &currLength, buffer, outputLength, maxOutLength)){
+        //With FEC a parity frame may give back a frame we lost, see receiveReadResponses.
+        BOOL rebuilt;
+        BOOL good = false;
+        if(takeFec(Packet, &rebuilt)){
+            if(rebuilt && !firstPacket && fillReadBackGap(Packet, buffer, maxOutLength)){
+                good = true;
+                //That may have been the last piece missing
+                if(outstandingReadLengths.empty() && getLastError() == FAILWRITEANDRUNREADACK)
+                    setLastError(okCapacity ? 0 : FAILWRITEANDRUNCAPACITY);
+            }
+            //Check if this is any read response packet we are expecting.
+            //If it is, copy the data to the buffer, update the currAddress/currLength/outputLength,
+            // and add missed reads if necessary.
+            else
+                good = checkWriteAndRunData(Packet, &currAddress, &currLength, buffer, outputLength, maxOutLength);
+            if(good && rebuilt)
+                fecRecovered++;
+        }
+        if(good){
 
 			//This is a good read response, therefore the command was heard.
 	        //That is the packet at the head of the queue, free it now.
@@ -1608,10 +3772,11 @@ BOOL ETH_SIRC::receiveWriteAndRunAcks(uint32_t maxWaitTimeInMsec, uint32_t maxOu
 		        firstPacket = false;
 			    markPacketAcked(*packetIter);
 				outstandingPackets.erase(packetIter);
-				packetIter = outstandingPackets.begin();
+				//Requests for what we missed go after those already there, in address order
+				packetIter = outstandingPackets.end();
 			}
 
-            if (addReceive(Packet)){
+            if (addReceive(Packet) && grantCredit()){
 
                 //Are we expecting any more packets?
                 //We are not if the currLength is zero.  If we got here we have seen at least 1 good packet,
@@ -1622,7 +3787,8 @@ BOOL ETH_SIRC::receiveWriteAndRunAcks(uint32_t maxWaitTimeInMsec, uint32_t maxOu
                 //		(lastError == FAILWRITEANDRUNCAPACITY and we return false)
                 //	3) we missed at least one packet somewhere down the line, regardless if the output could fit
                 //		or not (lastError == FAILREADACK and we return false)
-                if(currLength == 0){
+                //	With FEC, case 3) waits a little for the parity of the last group.
+                if(currLength == 0 && !(getLastError() == FAILWRITEANDRUNREADACK && awaitingParity())){
                     return(getLastError() == 0);
                 }
 
@@ -1637,7 +3803,7 @@ BOOL ETH_SIRC::receiveWriteAndRunAcks(uint32_t maxWaitTimeInMsec, uint32_t maxOu
         //This was not a good read response, so just free the packet and go back around
         int8_t err = getLastError();
 
-        if (!addReceive(Packet)){
+        if (!addReceive(Packet) || !grantCredit()){
             return false;
         }
         if(err != 0 && err != FAILWRITEANDRUNREADACK && err != FAILWRITEANDRUNCAPACITY){
@@ -1661,8 +3827,9 @@ BOOL ETH_SIRC::receiveWriteAndRunAcks(uint32_t maxWaitTimeInMsec, uint32_t maxOu
 	}
 	
 	//We have seen a response, but we were anticipating more packets.
-	//Let's add a read request for the remaining part
-	if(!createReadRequestCurrentIterLocation(currAddress, currLength)){
+	//Let's add a read request for the remaining part, if there is one (we may just
+	// have been waiting for a parity frame)
+	if(currLength != 0 && !createReadRequestCurrentIterLocation(currAddress, currLength)){
 		return false;
 	}
 	//This return false is not an error per se, we just missed some packets and we'll have to send new read requests
@@ -1692,38 +3859,28 @@ BOOL ETH_SIRC::checkWriteAndRunData(PACKET* packet, uint32_t* currAddress, uint3
 	uint32_t dataLength;
 	uint32_t startAddress;
 	uint32_t remainingLength;
-	int i;
+	uint8_t *frame;
+	uint8_t *payload;
+	uint32_t payloadLength;
+	uint32_t codedLength;
 
 	//First, see if this is a valid read response
-	//See if the packet is from the expected source
-    if (memcmp(message+6,ethHeader.FPGA_MACAddress,6) != 0)
-        return false;
+	//The steering table only lets through packets from our FPGA
 
 	//Get the length of the packet
-	dataLength = message[12];
-	dataLength = (dataLength << 8) + message[13];
-	//This packet must be at least 10 bytes long (1 byte command + 4 bytes address + 4 bytes remaining # bytes + 1 data byte)
-	if(dataLength < 10){
-		return false;
-	}
+	dataLength = SircWire::Ethernet::Length::get(message);
+	frame = SircWire::Ethernet::payload(message);
 
-	//Check the command byte
-	if(message[14] != 'g')
+	//Check the command byte and length, and find the payload
+	if(!readBackPayload(frame, dataLength, &payload, &payloadLength, &codedLength))
 		return false;
 
-	//Get the start address
-	startAddress = 0;
-	for(i = 0; i < 4; i++){
-		startAddress = startAddress << 8;
-		startAddress += message[15 + i];
-	}
-
-	//Get the remaining length
-	remainingLength = 0;
-	for(i = 0; i < 4; i++){
-		remainingLength = remainingLength << 8;
-		remainingLength += message[19 + i];
-	}
+	//Get the start address and the remaining length, same place in both
+	static_assert((SircWire::ReadBack::Address::offset == SircWire::CodedReadBack::Address::offset) &&
+	              (SircWire::ReadBack::Remaining::offset == SircWire::CodedReadBack::Remaining::offset),
+	              "readbacks must share the address and remaining fields");
+	startAddress = SircWire::ReadBack::Address::get(frame);
+	remainingLength = SircWire::ReadBack::Remaining::get(frame);
 
 	//This is some sort of valid read response, so:
 	//		1) check to see if this is the first response we have seen
@@ -1772,10 +3929,33 @@ BOOL ETH_SIRC::checkWriteAndRunData(PACKET* packet, uint32_t* currAddress, uint3
 
 	//		3) copy the data to the buffer in the correct location and update 
 	//				currAddress & currLength.
-	memcpy(buffer + startAddress, message + 23, min(*currLength, dataLength - 9));
-	*currAddress = startAddress + dataLength - 9;
-	*currLength -= min(*currLength, dataLength - 9);
+	placePayload(buffer + startAddress, payload, codedLength, min(*currLength, payloadLength));
+	*currAddress = startAddress + payloadLength;
+	*currLength -= min(*currLength, payloadLength);
+
+	return true;
+}
+
+//Same as fillReadGap, for a readback.  Requests for what we missed stop at maxOutLength.
+BOOL ETH_SIRC::fillReadBackGap(PACKET *packet, uint8_t *buffer, uint32_t maxOutLength){
+	uint8_t *message = packet->Buffer;
+	uint8_t *frame = SircWire::Ethernet::payload(message);
+	uint8_t *payload;
+	uint32_t payloadLength;
+	uint32_t codedLength;
+	uint32_t startAddress;
+
+	if(!readBackPayload(frame, SircWire::Ethernet::Length::get(message), &payload, &payloadLength, &codedLength))
+		return false;
+	startAddress = SircWire::ReadBack::Address::get(frame);
+
+	if(startAddress >= maxOutLength)
+		return false;
+	payloadLength = min(payloadLength, maxOutLength - startAddress);
+	if(!claimGap(startAddress, payloadLength))
+		return false;
 
+	placePayload(buffer + startAddress, payload, codedLength, payloadLength);
 	return true;
 }
 
@@ -1786,11 +3966,11 @@ BOOL ETH_SIRC::checkWriteAndRunData(PACKET* packet, uint32_t* currAddress, uint3
 BOOL ETH_SIRC::createResetRequestAndTransmit(){
 
 	//The packet will be 1 bytes long (1 byte command)
-    if (!allocateAndFillPacket(1))
+    if (!allocateAndFillPacket(SircWire::Reset::headerLength))
         return false;
 
 	//Set the command byte to 'm'
-	currentBuffer[0] = 'm';
+	SircWire::Reset::start(currentBuffer);
 
 	//Keep track of this message
 	outstandingPackets.push_back(currentPacket);
@@ -1804,7 +3984,81 @@ BOOL ETH_SIRC::createResetRequestAndTransmit(){
 //If the packet matches the one in the outstandingPacket list, return true.
 //If not, return false.
 BOOL ETH_SIRC::checkResetAck(PACKET* packet, uint32_t *unused){
-    return checkSimpleResponse(packet,'m',1);
+    return checkSimpleResponse(packet, SircWire::Reset::command, SircWire::Reset::headerLength);
+}
+
+//See if this is the answer to the outstanding negotiate, and what it accepted
+//If the packet matches the one in the outstandingPacket list, return true.
+//If not, return false.
+BOOL ETH_SIRC::checkNegotiateResponse(PACKET* packet, uint32_t *accepted){
+	uint8_t *message = packet->Buffer;
+	uint8_t *frame = SircWire::Ethernet::payload(message);
+
+	//This should be exactly 5 bytes long (command byte + feature mask)
+	if(!SircWire::Negotiate::valid(frame, SircWire::Ethernet::Length::get(message)))
+		return false;
+
+	*accepted = SircWire::Negotiate::Mask::get(frame);
+
+	markPacketAcked(outstandingPackets.front());
+	outstandingPackets.pop_front();
+	return true;
+}
+
+//See if this is the answer to the outstanding credit setup, and whether it took them
+BOOL ETH_SIRC::checkCreditResponse(PACKET* packet, uint32_t *accepted){
+	uint8_t *message = packet->Buffer;
+	uint8_t *frame = SircWire::Ethernet::payload(message);
+
+	//This should be exactly 2 bytes long (command byte + on/off)
+	if(!SircWire::CreditSetup::valid(frame, SircWire::Ethernet::Length::get(message)))
+		return false;
+
+	*accepted = SircWire::CreditSetup::On::get(frame);
+
+	markPacketAcked(outstandingPackets.front());
+	outstandingPackets.pop_front();
+	return true;
+}
+
+//See if this is the answer to the outstanding checksum request, and take its CRC
+BOOL ETH_SIRC::checkChecksumResponse(PACKET* packet, uint32_t *crc){
+	uint8_t *message = packet->Buffer;
+	uint8_t *frame = SircWire::Ethernet::payload(message);
+	uint8_t *request = SircWire::Ethernet::payload(outstandingPackets.front()->Buffer);
+
+	//This should be exactly 14 bytes long (the request + CRC)
+	if(!SircWire::ChecksumResponse::valid(frame, SircWire::Ethernet::Length::get(message)))
+		return false;
+
+	//..and about the same part of the same buffer
+	static_assert((SircWire::Checksum::Buffer::offset == SircWire::ChecksumResponse::Buffer::offset) &&
+	              (SircWire::Checksum::Length::end == SircWire::ChecksumResponse::Crc::offset),
+	              "checksum responses must echo the request");
+	if(memcmp(frame + 1, request + 1, SircWire::Checksum::headerLength - 1) != 0)
+		return false;
+
+	*crc = SircWire::ChecksumResponse::Crc::get(frame);
+
+	markPacketAcked(outstandingPackets.front());
+	outstandingPackets.pop_front();
+	return true;
+}
+
+//See if this is the answer to the outstanding FEC setup, and the group it accepted
+BOOL ETH_SIRC::checkFecResponse(PACKET* packet, uint32_t *accepted){
+	uint8_t *message = packet->Buffer;
+	uint8_t *frame = SircWire::Ethernet::payload(message);
+
+	//This should be exactly 2 bytes long (command byte + group)
+	if(!SircWire::FecSetup::valid(frame, SircWire::Ethernet::Length::get(message)))
+		return false;
+
+	*accepted = SircWire::FecSetup::Group::get(frame);
+
+	markPacketAcked(outstandingPackets.front());
+	outstandingPackets.pop_front();
+	return true;
 }
 
 //Generic method for receiving and checking a response packet
@@ -1812,7 +4066,7 @@ BOOL ETH_SIRC::receiveGenericAck(uint32_t timeOut, uint32_t *arg2, BOOL (ETH_SIR
 	PACKET *        Packet;
 
 	for(;;){
-        Packet = PacketDriver->GetNextReceivedPacket(timeOut);
+        Packet = receiveOn(controlLane, timeOut);
         if (Packet == NULL)
             break;
 
@@ -1820,16 +4074,21 @@ BOOL ETH_SIRC::receiveGenericAck(uint32_t timeOut, uint32_t *arg2, BOOL (ETH_SIR
         assert(Packet->Mode == PacketModeReceiving);
         BIGDEBUG_packet_received(Packet,0);
 
-        //Check if this is a good response
-        if((this->*checkFunction)(Packet, arg2)){
-            //This is a good response, repost the packet.
-            if (addReceive(Packet)){
-                //We have gotten the response we wanted, so we are done
-                return true;
+        //Check if this is a good response, and not a late one to something we gave up on
+        if(!lateResponse(Packet)){
+            if((this->*checkFunction)(Packet, arg2)){
+                //This is a good response, repost the packet.
+                if (addReceive(Packet)){
+                    //We have gotten the response we wanted, so we are done
+                    return true;
+                }
+
+                //Something went wrong posting a receive, bail out.
+                return false;
             }
 
-            //Something went wrong posting a receive, bail out.
-            return false;
+            //Could be the answer to a control command another thread queued with us
+            (void) deliverControlResponse(Packet);
         }
 	
         //This isn't a response to something we sent, but we should free the packet anyways.
@@ -1856,17 +4115,15 @@ BOOL ETH_SIRC::checkResponseWithValue(PACKET *packet, uint32_t *value, uint8_t c
 
 	message = packet->Buffer;
 
-	//See if the packet is from the expected source
-    if (memcmp(message+6,ethHeader.FPGA_MACAddress,6) != 0)
-        return false;
+	//The steering table only lets through packets from our FPGA
 
 	//See if the packet is the correct length
 	//This should be exactly 6 bytes long (command byte + reg address + value)
-	if(message[12] != 0 || message[13] != 6)
+	if(SircWire::Ethernet::Length::get(message) != SircWire::RegReadResponse::headerLength)
 		return false;
 
 	//Check the command byte
-	if(message[14] != commandCode)
+	if(message[SircWire::Ethernet::headerLength] != commandCode)
 		return false;
 
 	//So far, so good - let's try to match this against the one outstanding write
@@ -1877,10 +4134,7 @@ BOOL ETH_SIRC::checkResponseWithValue(PACKET *packet, uint32_t *value, uint8_t c
 	if(message[15] == testMessage[15]){
         BIGDEBUG_packet_matched(testPacket);
 		//Copy the value over
-		*value = 0;
-		for(int i = 0; i < 4; i++){
-			*value += message[i + 16] << (3 - i) * 8;
-		}
+		*value = SircWire::RegReadResponse::Value::get(SircWire::Ethernet::payload(message));
 
 		//We matched a transmission, so see if that command was completed already.
         markPacketAcked(testPacket);
@@ -1904,13 +4158,11 @@ BOOL ETH_SIRC::checkSimpleResponse(PACKET *packet, uint8_t commandCode, uint8_t
 
 	message = packet->Buffer;
 
-	//See if the packet is from the expected source
-    if (memcmp(message+6,ethHeader.FPGA_MACAddress,6) != 0)
-        return false;
+	//The steering table only lets through packets from our FPGA
 
 	//See if the packet is the correct length
 	//This should be exactly length bytes long
-	if(message[12] != 0 || message[13] != length)
+	if(SircWire::Ethernet::Length::get(message) != length)
 		return false;
 
 	//So far, so good - let's try to match this against one of the outstanding requests
@@ -1940,6 +4192,9 @@ BOOL ETH_SIRC::checkSimpleResponse(PACKET *packet, uint8_t commandCode, uint8_t
 
 //Common function to handle retransmissions
 BOOL ETH_SIRC::resendOutstandingPackets(int errorCode, char *callerName, int *counter){
+    //Control traffic goes first
+    serviceControlLane();
+
     for(packetIter = outstandingPackets.begin(); packetIter != outstandingPackets.end(); packetIter++){
         PACKET *packet = *packetIter;
 
@@ -1959,6 +4214,234 @@ BOOL ETH_SIRC::resendOutstandingPackets(int errorCode, char *callerName, int *co
     return true;
 }
 
+//Priority lanes
+
+//Fill in a control request, before we know which lane will send it
+void ETH_SIRC::initControlRequest(CONTROL_REQUEST *request, uint8_t command, uint8_t regNumber,
+                                  uint32_t value, uint32_t timeOut, uint32_t retries, int8_t failCode){
+    request->command     = command;
+    request->regNumber   = regNumber;
+    request->value       = value;
+    request->timeOut     = timeOut;
+    request->retriesLeft = retries;
+    request->failCode    = failCode;
+    request->error       = 0;
+    request->sentAt      = 0;
+    request->packet      = NULL;
+    request->done        = NULL;
+}
+
+//Wait for the bulk command holding the wire to take care of our request
+//Return true on success, return false w/error code on failure
+BOOL ETH_SIRC::delegateControl(CONTROL_REQUEST *request, uint32_t *value){
+    //Could not even queue it
+    if (!request->done) {
+        setLastError(request->error);
+        return false;
+    }
+
+    //The I/O thread might be asleep
+    if (io)
+        io->wakeUp();
+
+    //The bulk lane always completes it, one way or another.
+    WaitForSingleObject(request->done, INFINITE);
+    CloseHandle(request->done);
+
+    //The bulk lane keeps its own error (see getLastError), ours is only for the caller
+    setLastError(request->error);
+    if (request->error)
+        return false;
+    if (value)
+        *value = request->value;
+    return true;
+}
+
+//Called by the bulk lane between frames.
+//Transmit any newly queued control requests, then retransmit or give up on the overdue ones.
+void ETH_SIRC::serviceControlLane(){
+    std::list <CONTROL_REQUEST *> newRequests;
+    std::list <CONTROL_REQUEST *>::iterator iter;
+
+    if (controlPending == 0)
+        return;
+
+    EnterCriticalSection(&laneLock);
+    newRequests.splice(newRequests.end(), controlQueue);
+    LeaveCriticalSection(&laneLock);
+
+    DWORD now = GetTickCount();
+
+    for (iter = newRequests.begin(); iter != newRequests.end(); iter++) {
+        CONTROL_REQUEST *request = *iter;
+
+        //Same formats as createParamWrite/ParamRead/ResetRequest...
+        if (!allocateAndFillPacket((request->command == SircWire::RegWrite::command) ? SircWire::RegWrite::headerLength :
+                                   (request->command == SircWire::RegRead::command) ? SircWire::RegRead::headerLength :
+                                   SircWire::Reset::headerLength)) {
+            completeControlRequest(request, FAILMEMALLOC);
+            continue;
+        }
+        SircWire::RegWrite::Command::put(currentBuffer, request->command);
+        if (request->command != SircWire::Reset::command)
+            SircWire::RegWrite::Register::put(currentBuffer, request->regNumber);
+        if (request->command == SircWire::RegWrite::command)
+            setValueField(request->value);
+
+        //Do not let it sit behind anything
+        currentPacket->Flush = true;
+        request->packet = currentPacket;
+        if (!addTransmit(request->packet)) {
+            PacketDriver->FreePacket(request->packet,false);
+            completeControlRequest(request, request->failCode);
+            continue;
+        }
+        LogIt("sirc::ctl %u %u",request->command,request->regNumber);
+        request->sentAt = now;
+        controlInFlight.push_back(request);
+    }
+
+    for (iter = controlInFlight.begin(); iter != controlInFlight.end();) {
+        CONTROL_REQUEST *request = *iter;
+
+        if (now - request->sentAt < request->timeOut) {
+            iter++;
+            continue;
+        }
+        if (request->retriesLeft == 0) {
+            iter = controlInFlight.erase(iter);
+            PacketDriver->FreePacket(request->packet,false);
+            completeControlRequest(request, request->failCode);
+            continue;
+        }
+        request->retriesLeft--;
+        LogIt("sirc::ctl.retries %u",request->retriesLeft);
+        (void) addTransmit(request->packet);
+        request->sentAt = now;
+        iter++;
+    }
+}
+
+//The bulk command is done but someone might still be waiting on us.
+void ETH_SIRC::drainControlLane(){
+    while (controlPending != 0) {
+        serviceControlLane();
+
+        PACKET *Packet = receiveOn(controlLane, CONTROLPOLLSLICE);
+        if (Packet == NULL)
+            continue;
+        (void) deliverControlResponse(Packet);
+        (void) addReceive(Packet);
+    }
+}
+
+//Try to complete a queued control request with this control lane packet.
+//Return true if it matched one.  Either way the caller still owns the packet.
+BOOL ETH_SIRC::deliverControlResponse(PACKET *packet){
+    std::list <CONTROL_REQUEST *>::iterator iter;
+    uint8_t *frame = SircWire::Ethernet::payload(packet->Buffer);
+    uint32_t length = SircWire::Ethernet::Length::get(packet->Buffer);
+
+    if (lateResponse(packet) || (controlPending == 0))
+        return false;
+
+    for (iter = controlInFlight.begin(); iter != controlInFlight.end(); iter++) {
+        CONTROL_REQUEST *request = *iter;
+        uint8_t *testFrame = SircWire::Ethernet::payload(request->packet->Buffer);
+
+        //Same checks as checkSimpleResponse and checkResponseWithValue
+        if (request->command == SircWire::Reset::command) {
+            if (!SircWire::Reset::valid(frame, length))
+                continue;
+        }
+        else if (request->command == SircWire::RegWrite::command) {
+            if (!SircWire::RegWrite::valid(frame, length) ||
+                (memcmp(frame,testFrame,SircWire::RegWrite::headerLength) != 0))
+                continue;
+        }
+        else {
+            if (!SircWire::RegReadResponse::valid(frame, length) ||
+                (SircWire::RegReadResponse::Register::get(frame) != SircWire::RegRead::Register::get(testFrame)))
+                continue;
+            request->value = SircWire::RegReadResponse::Value::get(frame);
+        }
+
+        controlInFlight.erase(iter);
+        PacketDriver->FreePacket(request->packet,false);
+        completeControlRequest(request, 0);
+        return true;
+    }
+
+    //A late duplicate
+    return false;
+}
+
+//The thread with the wire sees its own error, everyone else the one SIRC keeps
+int8_t __stdcall ETH_SIRC::getLastError(){
+    if (wireOwner == GetCurrentThreadId())
+        return wireError;
+    return SIRC::getLastError();
+}
+
+void __stdcall ETH_SIRC::setLastError(int8_t code){
+    if (wireOwner == GetCurrentThreadId())
+        wireError = code;
+    SIRC::setLastError(code);
+}
+
+//Wake up the caller.  The request lives on its stack, do not touch it after this.
+void ETH_SIRC::completeControlRequest(CONTROL_REQUEST *request, int8_t error){
+    request->error = error;
+    InterlockedDecrement(&controlPending);
+    SetEvent(request->done);
+}
+
+//Bulk lane version of GetNextReceivedPacket.
+//Control responses the steering table set aside are handed to their requests, and
+// queued control requests are sent/retransmitted while we wait.
+//Returns NULL if no bulk packet came in timeOut msec, or on error (w/error code).
+//With a timeOut of 0 it only takes what is already there.
+PACKET *ETH_SIRC::nextBulkPacket(uint32_t timeOut){
+    DWORD startTime = GetTickCount();
+    BOOL looked = false;
+
+    for (;;) {
+        serviceControlLane();
+
+        uint32_t elapsed = GetTickCount() - startTime;
+        if (looked && (elapsed >= timeOut))
+            return NULL;
+        looked = true;
+        uint32_t remaining = (elapsed < timeOut) ? timeOut - elapsed : 0;
+        uint32_t slice = remaining;
+        if ((controlPending != 0) && (slice > CONTROLPOLLSLICE))
+            slice = CONTROLPOLLSLICE;
+
+        //If someone is waiting on a control response do not sit on it
+        PACKET *Packet = receiveOn(bulkLane, slice, controlPending != 0);
+
+        while (lanePending(controlLane)) {
+            PACKET *Response = receiveOn(controlLane, 0);
+            (void) deliverControlResponse(Response);
+            if (!addReceive(Response)) {
+                if (Packet)
+                    (void) addReceive(Packet);
+                return NULL;
+            }
+        }
+
+        if (Packet == NULL)
+            continue;
+        //Answers to what we gave up on go straight back
+        if (lateResponse(Packet)) {
+            if (!addReceive(Packet))
+                return NULL;
+            continue;
+        }
+        return Packet;
+    }
+}
+
 void ETH_SIRC::incrementCurrIterLocation(){
 	assert(packetIter != outstandingPackets.end());
 	packetIter++;
@@ -1974,6 +4457,74 @@ void ETH_SIRC::removeReadRequestCurrentIterLocation(){
 	lengthIter = outstandingReadLengths.erase(lengthIter);
 }
 
+//With FEC on, data frames go into the current group, and a parity frame is replaced by
+// the frame its group lost if there was exactly one.
+//Return false if there is nothing left in the packet to look at, true otherwise (rebuilt
+// tells whether the packet now holds a rebuilt frame).
+BOOL ETH_SIRC::takeFec(PACKET *packet, BOOL *rebuilt){
+	uint8_t *message = packet->Buffer;
+	uint8_t *frame = SircWire::Ethernet::payload(message);
+	uint32_t length = SircWire::Ethernet::Length::get(message);
+
+	*rebuilt = false;
+	if(!fecGroup)
+		return true;
+
+	if(!SircWire::Parity::valid(frame, length)){
+		//Not a data frame either, leave the group alone
+		(void) sircFecAdd(fec, frame, length);
+		return true;
+	}
+
+	fecParityFrames++;
+	length = sircFecRebuild(fec, frame, length, frame);
+	if(length == 0)
+		return false;
+	SircWire::Ethernet::Length::put(message, (uint16_t) length);
+	*rebuilt = true;
+	return true;
+}
+
+//Is the parity frame of the group coming in still to come?
+inline BOOL ETH_SIRC::awaitingParity(){
+	return (fecGroup != 0) && (fec->frames != 0);
+}
+
+//Take [startAddress, startAddress + length) out of a read request before packetIter,
+// those are requests for what we missed and are not sent yet.  The request is dropped if
+// that was all of it, or trimmed if it was its beginning or end.
+//Return true if there was such a request.
+BOOL ETH_SIRC::claimGap(uint32_t startAddress, uint32_t length){
+	std::list <PACKET *>::iterator packets = outstandingPackets.begin();
+	std::list <uint32_t>::iterator startAddresses = outstandingReadStartAddresses.begin();
+	std::list <uint32_t>::iterator lengths = outstandingReadLengths.begin();
+
+	for(; packets != packetIter && startAddresses != outstandingReadStartAddresses.end();
+		packets++, startAddresses++, lengths++){
+		uint8_t *frame = SircWire::Ethernet::payload((*packets)->Buffer);
+
+		if(*startAddresses == startAddress && *lengths == length){
+			markPacketAcked(*packets);
+			outstandingPackets.erase(packets);
+			outstandingReadStartAddresses.erase(startAddresses);
+			outstandingReadLengths.erase(lengths);
+			return true;
+		}
+		if(*startAddresses == startAddress && *lengths > length){
+			*startAddresses += length;
+			*lengths -= length;
+		}
+		else if(*lengths > length && *startAddresses + *lengths == startAddress + length)
+			*lengths -= length;
+		else
+			continue;
+		SircWire::Read::Address::put(frame, *startAddresses);
+		SircWire::Read::Length::put(frame, *lengths);
+		return true;
+	}
+	return false;
+}
+
 //Mark this packet acked and free it if the transmission has been completed.
 inline void ETH_SIRC::markPacketAcked(PACKET* packet){
     assert((packet->Mode == PacketModeTransmitting) ||
@@ -34,7 +34,26 @@ public:
 	//	It has been done this way since most people like to read left to right {MSB, .. , LSB}
 	//Check error code with getLastError() to make certain constructor
 	// succeeded fully.
-	SIRC_DLL_LINKAGE __stdcall ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wchar_t *nicName);
+	//Control commands (register access, run, waitDone, reset) can be issued from
+	// a second thread while a bulk transfer (write, read, write and run) is in
+	// progress.  They are sent ahead of the remaining bulk traffic.  When that happens
+	// each thread sees the error of its own commands in getLastError().
+	//With PARAMETERS::ioThread set, a dedicated thread does all of the sending and
+	// receiving, and the methods below hand their commands to it.
+	//contact: soft reset the board before returning, with the usual timeouts.  Without it
+	// nothing is sent yet, the caller should probe() before anything else.
+	SIRC_DLL_LINKAGE __stdcall ETH_SIRC(uint8_t *FPGA_ID, uint32_t driverVersion, wchar_t *nicName,
+		BOOL contact = true);
+
+	//Same, for a session on a NIC shared with other boards (see eth_nic.h).
+	//The driver limits in PARAMETERS are this session's share.
+	SIRC_DLL_LINKAGE __stdcall ETH_SIRC(ETH_NIC *nic, uint8_t *FPGA_ID, BOOL contact = true);
+
+	//Make first contact: a soft reset, with short timeouts.  Meant for discovery (see
+	// sirc_discovery.h), where a missing board must not hold up the other interfaces.
+	//Returns true if the board answered.
+	//If it did not, returns false.  Check error code with getLastError().
+	SIRC_DLL_LINKAGE BOOL __stdcall probe(void);
 
 	//Destructor for the class
     __stdcall ~ETH_SIRC();
@@ -64,6 +83,13 @@ public:
 	// Check error code with getLastError().
 	BOOL __stdcall sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer);
 
+	//Vectored sendWrite and sendRead, see SIRC.
+	//All of the segments go through one window and scoreboard.  Address adjacent
+	// segments shorter than a frame share frames, read responses land directly in
+	// the caller's buffers otherwise.  Nothing is sent if any segment is invalid.
+	BOOL __stdcall sendWriteV(const SIRC_SEGMENT *segments, uint32_t count);
+	BOOL __stdcall sendReadV(const SIRC_SEGMENT *segments, uint32_t count);
+
 	//Send a 32-bit value from the PC to the parameter register file on the FPGA
 	// regNumber: register to which value should be sent (between 0 and 254)
 	// value: value to be written
@@ -115,14 +141,38 @@ public:
 		uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength, 
 		uint32_t *outputLength);
 
+	//Failed commands return without waiting for their last responses, those are
+	// recognized and dropped when they show up.  This waits for them, see SIRC.
+	BOOL __stdcall quiesce(uint32_t maxWaitTimeInMsec);
+
+	//Have the FPGA checksum part of one of its buffers, see SIRC
+	BOOL __stdcall sendChecksum(BOOL output, uint32_t startAddress, uint32_t length, uint32_t *crc);
+
     //Retrieve the active set of parameters and limits for this instance
     BOOL __stdcall getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength);
 
     //Modify the active set of parameters and limits for this instance
     BOOL __stdcall setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length);
 
+    //As SIRC's, but the thread that has the wire works on an error of its own, so that
+    // control commands failing on other threads in the meantime cannot change its course.
+    //Both end up in the one SIRC::getLastError sees.
+    int8_t __stdcall getLastError(void);
+    void __stdcall setLastError(int8_t code);
+
+protected:
+    //Submitted requests run on a pool thread that holds the wire like any bulk command.
+    //Back to back writes go through the scoreboard together (see sendWrites).
+    SIRC_ASYNC * __stdcall createAsync(void);
+
 private:
 	PACKET_DRIVER *PacketDriver;
+    //Sorts what we receive into the bulk and control lanes, drops everything else.
+    //Sharing a NIC, the ETH_NIC does that for all of its sessions and Steering is NULL.
+    PACKET_STEERING *Steering;
+    ETH_NIC *nic;
+    int bulkLane;
+    int controlLane;
     struct {
         uint8_t FPGA_MACAddress[6];
         uint8_t My_MACAddress[6];
@@ -133,6 +183,8 @@ private:
 	//We could just do outstandingPackets.size(), but that might be slow
 	int outstandingTransmits;
 	std::list <PACKET *>::iterator packetIter;
+	//Transmits we are done with that the driver still has (see retireTransmit)
+	std::list <PACKET *> retiredTransmits;
 
     //How many can we have anyways?
     uint32_t maxOutstandingReads;
@@ -143,6 +195,116 @@ private:
     uint32_t maxInputDataBytes;
     uint32_t maxOutputDataBytes;
 
+    //Online tuner state.  The two limits above are hard caps (driver or user),
+    // these are what we are actually using right now.
+    BOOL autoTune;
+    uint32_t postedReceives;    //receives the driver is holding for us
+    uint32_t targetReceives;    //how many the tuner wants posted
+    uint32_t writeWindow;       //writes we send before scoreboarding
+    BOOL slowStart;             //no drops seen yet, grow the window fast
+    uint32_t burstHighWater;    //largest response burst in this tuning epoch
+    uint32_t cleanBursts;       //bursts without drops in this tuning epoch
+    uint32_t tunerDecisions;
+
+    //Payload compression (sirc_codec.h), SIRC_COMPRESS_* bits the FPGA agreed to
+    uint32_t compression;
+    uint32_t codingMisses;      //plain frames to send before trying to code again
+    uint8_t *codeBuffer;        //coded payload of the next write frame
+
+    //Forward error correction (sirc_fec.h), data frames per parity frame the FPGA
+    // agreed to, 0 for none
+    uint32_t fecGroup;
+    SIRC_FEC_GROUP *fec;        //the group coming in
+    uint32_t fecRecovered;
+    uint32_t fecParityFrames;
+
+    //Receive credits (SircWire::Credit), on if the FPGA agreed.  What the next read
+    // request advertises, and the receives reposted since the last credit frame.
+    BOOL creditFlow;
+    uint32_t readCredits;
+    uint32_t creditBatch;       //reposts per credit frame
+    uint32_t creditsOwed;
+    uint32_t creditGrants;
+
+    //Priority lanes.  Register access, run/done polling and reset are the control lane,
+    // everything else is the bulk lane (outstandingPackets).  The thread holding the wire
+    // runs the scoreboard.  Control commands from other threads are queued here and
+    // are sent ahead of the next bulk frame.
+    typedef struct {
+        uint8_t command;        //'k', 'y' or 'm'
+        uint8_t regNumber;
+        uint32_t value;         //sent for 'k', received for 'y'
+        uint32_t timeOut;       //for each attempt
+        uint32_t retriesLeft;
+        int8_t failCode;        //what to report if we give up
+        int8_t error;
+        DWORD sentAt;
+        PACKET *packet;
+        HANDLE done;
+    } CONTROL_REQUEST;
+
+    class LaneGuard;
+    friend class LaneGuard;
+
+    class Async;
+    friend class Async;
+
+    //Multicast groups send through us and collect the acks of their members from us
+    friend class ETH_MULTICAST;
+
+    //The dedicated I/O thread, if PARAMETERS::ioThread asked for one.
+    //It holds the wire for as long as it runs.
+    class IoThread;
+    friend class IoThread;
+    IoThread *io;
+    uint32_t ioThread;
+
+    //Streaming write acks (I/O thread only), see streamWriteAcks
+    DWORD streamSweep;          //when we last looked for overdue frames
+    uint32_t streamAcks;        //acks since the tuner last heard from us
+    BOOL streamResent;
+    BOOL streamWaited;
+
+    //One block of a (batched) write
+    typedef struct {
+        uint32_t startAddress;
+        uint32_t length;
+        uint8_t *buffer;
+        SIRC_ASYNC_REQUEST *request;    //completed when done, if any
+        int8_t error;
+    } WRITE_SEGMENT;
+
+    //Segments of a vectored transfer that travel together, see packSegments
+    typedef struct {
+        uint32_t startAddress;
+        uint32_t length;
+        uint32_t first;         //segments [first, last], in address order
+        uint32_t last;
+        BOOL staged;            //through a copy, buffer is ours
+        uint8_t *buffer;
+    } PACKED_RUN;
+
+    CRITICAL_SECTION wireLock;          //held by whoever runs the scoreboard
+    CRITICAL_SECTION laneLock;          //protects controlQueue, bulkDepth and wireWaiters
+    uint32_t bulkDepth;
+    std::list <HANDLE> wireWaiters;     //control commands waiting for another one to finish
+    volatile DWORD wireOwner;           //thread holding wireLock, 0 for none
+    uint32_t wireDepth;                 //times it took it
+    int8_t wireError;                   //its error, see getLastError
+    volatile LONG controlPending;       //queued plus in flight
+    std::list <CONTROL_REQUEST *> controlQueue;
+    std::list <CONTROL_REQUEST *> controlInFlight;
+
+    //Responses still due to packets we gave up on (abandonOutstandingPackets).
+    //Frames carry no request id, so each one is known by what it is about.
+    typedef struct {
+        uint8_t command;        //of the response, plain ('w' for coded write acks too)
+        uint32_t startAddress;  //register number for register responses
+        uint32_t length;        //data still due, 0 for header-only responses
+        DWORD expires;          //nothing can come after this
+    } ABANDONED;
+    std::list <ABANDONED> abandoned;
+
 	//These are the parameters used when we are doing reads.
 	std::list <uint32_t> outstandingReadStartAddresses;
 	std::list <uint32_t> outstandingReadLengths;
@@ -173,14 +335,43 @@ private:
 	int writeAndRunResends;
 #endif
 
+    void initialize(PACKET_DRIVER *driver, uint8_t *FPGA_ID, BOOL contact);
+    inline PACKET *receiveOn(int lane, uint32_t timeOut, BOOL returnOnSteer = false);
+    inline BOOL lanePending(int lane);
+
     inline BOOL allocateAndFillPacket(uint16_t length);
     inline void setLengthAndAddress(uint32_t length, uint32_t address);
+    inline void setReadCredits(void);
     inline void setValueField(uint32_t value);
     inline BOOL sendCurrentPacket(int8_t errorCode, BOOL flushOutstanding, char *packetName = NULL);
 
 	inline BOOL addReceive(PACKET *Packet = NULL);
 	inline BOOL addTransmit(PACKET* Packet);
-	void emptyOutstandingPackets(void);
+    static void recycleReceive(PACKET *Packet, void *context);
+
+    BOOL resizeReceivePool(void);
+    BOOL ensureReceiveCapacity(uint32_t numResponses);
+    void tuneAfterBurst(uint32_t burstSize, BOOL sawDrops, BOOL windowLimited);
+    void clampTuner(void);
+
+    void initControlRequest(CONTROL_REQUEST *request, uint8_t command, uint8_t regNumber,
+                            uint32_t value, uint32_t timeOut, uint32_t retries, int8_t failCode);
+    BOOL delegateControl(CONTROL_REQUEST *request, uint32_t *value);
+    void serviceControlLane(void);
+    void drainControlLane(void);
+    BOOL deliverControlResponse(PACKET *packet);
+    void completeControlRequest(CONTROL_REQUEST *request, int8_t error);
+    PACKET *nextBulkPacket(uint32_t timeOut);
+    BOOL startIoThread(void);
+    void stopIoThread(void);
+    BOOL callIoThread(SIRC_ASYNC_REQUEST *request, uint32_t *value);
+	void abandonOutstandingPackets(void);
+	void retireTransmit(PACKET *packet);
+	void freeRetiredTransmits(void);
+	void abandonResponses(PACKET *packet, uint32_t readAddress, uint32_t readLength, DWORD expires);
+	BOOL lateResponse(PACKET *packet);
+	void forgetAbandoned(void);
+	void pruneAbandoned(void);
     BOOL bailOut(int8_t errorCode);
 
     BOOL receiveGenericAck(uint32_t timeOut, uint32_t *arg2, BOOL (ETH_SIRC::*checkFunction)(PACKET*,uint32_t *),int errorCode);
@@ -188,16 +379,54 @@ private:
     BOOL checkResponseWithValue(PACKET *packet, uint32_t *value, uint8_t commandCode);
     BOOL ETH_SIRC::resendOutstandingPackets(int errorCode, char *callerName = NULL, int *counter = NULL);
 
-
+    BOOL negotiateFeatures(uint32_t wanted);
+    BOOL checkNegotiateResponse(PACKET* packet, uint32_t *accepted);
+    BOOL negotiateFec(uint32_t group);
+    BOOL checkFecResponse(PACKET* packet, uint32_t *accepted);
+    BOOL takeFec(PACKET *packet, BOOL *rebuilt);
+    inline BOOL awaitingParity(void);
+    BOOL claimGap(uint32_t startAddress, uint32_t length);
+    BOOL fillReadGap(PACKET *packet, const SIRC_SEGMENT *targets, uint32_t count);
+    BOOL fillReadBackGap(PACKET *packet, uint8_t *buffer, uint32_t maxOutLength);
+    BOOL negotiateCredits(BOOL on);
+    BOOL checkCreditResponse(PACKET* packet, uint32_t *accepted);
+    uint32_t startCredits(void);
+    BOOL sendCredits(BOOL start, uint32_t credits);
+    inline BOOL grantCredit(void);
+    BOOL checkChecksumResponse(PACKET* packet, uint32_t *crc);
+
+    //Multicast groups (eth_multicast.h)
+    BOOL joinGroup(const uint8_t *groupMAC, BOOL join, BOOL *joined);
+    BOOL checkJoinAck(PACKET* packet, uint32_t *unused);
+    PACKET *createGroupWrite(const uint8_t *groupMAC, uint32_t startAddress, uint32_t length,
+                             uint8_t *buffer, uint32_t *sent);
+    PACKET *createGroupRegWrite(const uint8_t *groupMAC, uint8_t regNumber, uint32_t value);
+    BOOL transmitGroupFrame(PACKET *packet, BOOL flush);
+    void freeGroupFrame(PACKET *packet);
+    BOOL prepareGroupBurst(uint32_t numFrames);
+    uint32_t takeGroupAcks(PACKET **frames, uint32_t count, BOOL *acked, uint32_t timeOut);
+
+
+	BOOL checkSegments(const SIRC_SEGMENT *segments, uint32_t count, uint32_t bufferSize);
+	uint32_t packSegments(const std::vector <SIRC_SEGMENT> &sorted, uint32_t frameSize,
+		std::vector <PACKED_RUN> &runs);
+	BOOL sendWrites(WRITE_SEGMENT *segments, uint32_t count);
+	BOOL scoreboardWrites(BOOL moreToSend);
+	BOOL streamWriteAcks(BOOL drain);
+	BOOL resendOverdueWrites(uint32_t *timeOut);
+	void finishWrites(WRITE_SEGMENT *segments, uint32_t from, uint32_t to, int8_t error);
 	BOOL createWriteRequestBackAndTransmit(uint32_t startAddress, uint32_t length, uint8_t *buffer, BOOL flushQueue);
+	uint32_t codeWriteFrame(uint8_t *buffer, uint32_t length, uint32_t *currLength);
+	BOOL createCodedWriteRequestBackAndTransmit(uint32_t startAddress, uint32_t rawLength, uint32_t codedLength, BOOL flushQueue);
 	BOOL receiveWriteAcks(void);
 	BOOL checkWriteAck(PACKET* packet);
 
 	BOOL createReadRequestBackAndTransmit(uint32_t startAddress, uint32_t length);
 	BOOL createReadRequestCurrentIterLocation(uint32_t startAddress, uint32_t length);
-	BOOL receiveReadResponses(uint32_t initialStartAddress, uint8_t *buffer);
+	BOOL readTargets(const SIRC_SEGMENT *targets, uint32_t count);
+	BOOL receiveReadResponses(const SIRC_SEGMENT *targets, uint32_t count);
 	BOOL checkReadData(PACKET* packet, uint32_t* currAddress, uint32_t* currLength,  
-		uint8_t* buffer, uint32_t initialStartAddress);
+		const SIRC_SEGMENT *targets, uint32_t count);
 
 	BOOL createParamWriteRequestBackAndTransmit(uint8_t regNumber, uint32_t value);
 	inline BOOL receiveParamWriteAck(void)
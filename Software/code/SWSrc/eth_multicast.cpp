@@ -0,0 +1,316 @@
+// Title: ETH_MULTICAST class
+//
+// Description: Writes sent once to a multicast group of boards, with per-member
+// ack scoreboards and unicast repair.  See eth_multicast.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//While no acks come in, how long we wait on one member before looking at the others
+#define MULTICASTPOLLMSEC 2
+
+//PUBLIC FUNCTIONS
+//Constructor for the class
+//Return with an error code if anything goes wrong.
+SIRC_DLL_LINKAGE ETH_MULTICAST::ETH_MULTICAST(const uint8_t *groupMAC, ETH_SIRC **members, uint32_t count)
+{
+    lastError = 0;
+    this->count = 0;
+    sender = -1;
+    numFrames = 0;
+    memset(this->members, 0, sizeof(this->members));
+    memset(joined, 0, sizeof(joined));
+    memset(errors, 0, sizeof(errors));
+    memset(&statistics, 0, sizeof(statistics));
+
+    if (!groupMAC || !members) {
+        lastError = INVALIDBUFFER;
+        return;
+    }
+    //Must be a group address
+    if ((groupMAC[0] & 1) == 0) {
+        lastError = INVALIDFPGAMACADDRESS;
+        return;
+    }
+    if (count == 0 || count > ETH_MULTICAST_MAX_MEMBERS) {
+        lastError = INVALIDLENGTH;
+        return;
+    }
+    for (uint32_t m = 0; m < count; m++) {
+        if (!members[m]) {
+            lastError = INVALIDBUFFER;
+            return;
+        }
+    }
+    memcpy(this->groupMAC, groupMAC, 6);
+    memcpy(this->members, members, count * sizeof(ETH_SIRC *));
+    this->count = count;
+
+    for (uint32_t m = 0; m < count; m++) {
+        //Someone else holds the wire for good, we could not collect its acks
+        if (members[m]->io)
+            continue;
+        if (!members[m]->joinGroup(groupMAC, true, &joined[m])) {
+            lastError = members[m]->getLastError();
+            return;
+        }
+        if (joined[m]) {
+            statistics.members++;
+            if (sender < 0)
+                sender = (int) m;
+        }
+    }
+    LogIt("sirc::multicast.open %u %u",count,statistics.members);
+}
+
+SIRC_DLL_LINKAGE ETH_MULTICAST::~ETH_MULTICAST()
+{
+    BOOL stillJoined;
+
+    for (uint32_t m = 0; m < count; m++) {
+        if (joined[m])
+            (void) members[m]->joinGroup(groupMAC, false, &stillJoined);
+    }
+}
+
+//Write the buffer to every member: in bursts of group frames, then by unicast what
+// each member missed.  Boards not in the group get all of it by unicast.
+SIRC_DLL_LINKAGE BOOL ETH_MULTICAST::sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    uint32_t offset = 0;
+    uint32_t groupDone = 0;         //what every joined member has (or failed on)
+    uint32_t sent;
+    uint32_t window;
+
+    if (!buffer) {
+        lastError = INVALIDBUFFER;
+        return false;
+    }
+    for (uint32_t m = 0; m < count; m++) {
+        if (length == 0 || startAddress + length > members[m]->maxInputDataBytes ||
+            startAddress + length < startAddress) {
+            lastError = INVALIDLENGTH;
+            return false;
+        }
+    }
+    memset(errors, 0, sizeof(errors));
+
+    while ((sender >= 0) && (offset < length)) {
+        window = burstSize();
+        numFrames = 0;
+        while ((numFrames < window) && (offset < length)) {
+            frames[numFrames] = members[sender]->createGroupWrite(groupMAC, startAddress + offset,
+                                                                  length - offset, buffer + offset, &sent);
+            if (!frames[numFrames])
+                break;
+            numFrames++;
+            offset += sent;
+        }
+        //The rest goes by unicast
+        if ((numFrames == 0) || !sendBurst()) {
+            LogIt("sirc::multicast.fail %u %d",groupDone,(int) members[sender]->getLastError());
+            freeBurst();
+            break;
+        }
+
+        for (uint32_t m = 0; m < count; m++) {
+            uint32_t next;
+
+            if (!joined[m] || errors[m])
+                continue;
+            for (uint32_t f = 0; f < numFrames; f = next) {
+                if (acked[m][f]) {
+                    next = f + 1;
+                    continue;
+                }
+                //Consecutive frames it missed go together
+                for (next = f + 1; (next < numFrames) && !acked[m][next]; next++)
+                    ;
+                uint8_t *first = SircWire::Ethernet::payload(frames[f]->Buffer);
+                uint8_t *last = SircWire::Ethernet::payload(frames[next - 1]->Buffer);
+                uint32_t address = SircWire::Write::Address::get(first);
+                uint32_t repair = SircWire::Write::Address::get(last) + SircWire::Write::Length::get(last) - address;
+
+                LogIt("sirc::multicast.repair %u %u",m,address);
+                statistics.repairs += next - f;
+                statistics.unicastBytes += repair;
+                if (!members[m]->sendWrite(address, repair, buffer + (address - startAddress))) {
+                    errors[m] = members[m]->getLastError();
+                    break;
+                }
+            }
+        }
+        freeBurst();
+        groupDone = offset;
+    }
+
+    for (uint32_t m = 0; m < count; m++) {
+        uint32_t from = joined[m] ? groupDone : 0;
+
+        if (errors[m] || (from >= length))
+            continue;
+        statistics.unicastBytes += length - from;
+        if (!members[m]->sendWrite(startAddress + from, length - from, buffer + from))
+            errors[m] = members[m]->getLastError();
+    }
+    return finish();
+}
+
+//Same for a parameter register, one frame
+SIRC_DLL_LINKAGE BOOL ETH_MULTICAST::sendParamRegisterWrite(uint8_t regNumber, uint32_t value)
+{
+    BOOL grouped = false;
+
+    memset(errors, 0, sizeof(errors));
+
+    if (sender >= 0) {
+        numFrames = 0;
+        frames[0] = members[sender]->createGroupRegWrite(groupMAC, regNumber, value);
+        if (frames[0]) {
+            numFrames = 1;
+            grouped = sendBurst();
+        }
+        for (uint32_t m = 0; grouped && (m < count); m++) {
+            if (!joined[m] || errors[m] || acked[m][0])
+                continue;
+            LogIt("sirc::multicast.repair %u %u",m,(uint32_t) regNumber);
+            statistics.repairs++;
+            statistics.unicastBytes += sizeof(value);
+            if (!members[m]->sendParamRegisterWrite(regNumber, value))
+                errors[m] = members[m]->getLastError();
+        }
+        freeBurst();
+    }
+
+    for (uint32_t m = 0; m < count; m++) {
+        if (errors[m] || (joined[m] && grouped))
+            continue;
+        statistics.unicastBytes += sizeof(value);
+        if (!members[m]->sendParamRegisterWrite(regNumber, value))
+            errors[m] = members[m]->getLastError();
+    }
+    return finish();
+}
+
+SIRC_DLL_LINKAGE BOOL ETH_MULTICAST::isJoined(uint32_t member)
+{
+    return (member < count) && joined[member];
+}
+
+SIRC_DLL_LINKAGE int8_t ETH_MULTICAST::getMemberError(uint32_t member)
+{
+    if (member >= count)
+        return INVALIDLENGTH;
+    return errors[member];
+}
+
+SIRC_DLL_LINKAGE void ETH_MULTICAST::getStatistics(ETH_MULTICAST_STATISTICS *outStatistics)
+{
+    *outStatistics = statistics;
+}
+
+//PRIVATE FUNCTIONS
+
+//How many group frames we send before collecting acks.
+//Every member gets an ack per frame, and must have the receives for them.
+uint32_t ETH_MULTICAST::burstSize()
+{
+    uint32_t window = ETH_MULTICAST_BURST;
+
+    if (members[sender]->maxOutstandingWrites && (members[sender]->maxOutstandingWrites < window))
+        window = members[sender]->maxOutstandingWrites;
+    for (uint32_t m = 0; m < count; m++) {
+        if (joined[m] && members[m]->maxOutstandingReads && (members[m]->maxOutstandingReads < window))
+            window = members[m]->maxOutstandingReads;
+    }
+    return window;
+}
+
+//Send the burst to the group and check off the acks of every member, until the ones
+// still in good shape have all of them or nothing came for a write timeout.
+//Return true on success, return false w/error code if the frames could not be sent.
+BOOL ETH_MULTICAST::sendBurst()
+{
+    uint32_t missing[ETH_MULTICAST_MAX_MEMBERS];
+    uint32_t waiting = 0;
+    uint32_t timeOut = members[sender]->writeTimeout;
+    uint32_t wait = 0;
+    uint32_t taken;
+    DWORD lastAck;
+
+    for (uint32_t m = 0; m < count; m++) {
+        memset(acked[m], 0, sizeof(acked[m]));
+        missing[m] = 0;
+        if (!joined[m] || errors[m])
+            continue;
+        if (!members[m]->prepareGroupBurst(numFrames)) {
+            errors[m] = members[m]->getLastError();
+            continue;
+        }
+        missing[m] = numFrames;
+        waiting++;
+    }
+
+    for (uint32_t f = 0; f < numFrames; f++) {
+        if (!members[sender]->transmitGroupFrame(frames[f], f == numFrames - 1)) {
+            lastError = members[sender]->getLastError();
+            return false;
+        }
+    }
+    statistics.groupFrames += numFrames;
+
+    lastAck = GetTickCount();
+    while (waiting) {
+        taken = 0;
+        for (uint32_t m = 0; m < count; m++) {
+            if (missing[m] == 0)
+                continue;
+            uint32_t got = members[m]->takeGroupAcks(frames, numFrames, acked[m], wait);
+            wait = 0;
+            taken += got;
+            missing[m] -= got;
+            if (members[m]->getLastError()) {
+                errors[m] = members[m]->getLastError();
+                missing[m] = 0;
+            }
+            if (missing[m] == 0)
+                waiting--;
+        }
+        if (taken)
+            lastAck = GetTickCount();
+        else if (GetTickCount() - lastAck >= timeOut)
+            break;
+        //Nothing came in this round, wait a little on the first one still short
+        wait = taken ? 0 : MULTICASTPOLLMSEC;
+    }
+    return true;
+}
+
+void ETH_MULTICAST::freeBurst()
+{
+    for (uint32_t f = 0; f < numFrames; f++)
+        members[sender]->freeGroupFrame(frames[f]);
+    numFrames = 0;
+}
+
+//The call is over, the first member that failed has the error code
+//Return true if none did
+BOOL ETH_MULTICAST::finish()
+{
+    lastError = 0;
+    for (uint32_t m = 0; m < count; m++) {
+        if (errors[m]) {
+            lastError = errors[m];
+            break;
+        }
+    }
+    return (lastError == 0);
+}
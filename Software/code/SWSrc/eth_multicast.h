@@ -0,0 +1,104 @@
+// Title: ETH_MULTICAST class definition
+//
+// Description: One upload for many boards.  Characterization runs send the same
+// challenge bytes and the same operand registers to every board; unicast that costs
+// N times the frames.  An ETH_MULTICAST has the boards join a multicast group and
+// sends each 'w' and 'k' frame once, to the group MAC:
+//
+//      ETH_SIRC *boards[4] = { ... };              //sessions, see eth_nic.h
+//      uint8_t groupMAC[6] = { 0x03, 0xAA, 0xAA, 0xAA, 0xAA, 0x01 };
+//      ETH_MULTICAST group(groupMAC, boards, 4);
+//      group.sendParamRegisterWrite(0, A);
+//      group.sendWrite(0, length, challenges);
+//
+// Every board still acks every frame.  The acks are scoreboarded per member, and a
+// member that missed frames gets just those again by unicast, through its own
+// sendWrite (with the usual retries).  Boards that do not know the join command
+// (older hardware answers nothing) get everything by unicast.
+//
+// The members must not be used by anyone else during a call, nor run an I/O
+// thread (those get unicast).  Delete the group before its members.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINEETHMULTICASTH
+#define DEFINEETHMULTICASTH 1
+
+#include "sirc.h"
+
+//Most members one group can have
+#define ETH_MULTICAST_MAX_MEMBERS 32
+
+//Group frames sent before collecting the acks
+#define ETH_MULTICAST_BURST 16
+
+class PACKET;
+class ETH_SIRC;
+
+//What the group saved, and what it cost
+typedef struct {
+    uint32_t members;               //boards that joined the group
+    uint32_t groupFrames;           //frames sent once for all of them
+    uint32_t repairs;               //frames a member missed and got again by unicast
+    ULONGLONG unicastBytes;         //sent to single members: repairs and boards not in the group
+} ETH_MULTICAST_STATISTICS;
+
+class ETH_MULTICAST {
+public:
+	//groupMAC: a multicast MAC address (low bit of the first byte set)
+	//members: the boards that get the same data, each joins the group
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall ETH_MULTICAST(const uint8_t *groupMAC, ETH_SIRC **members, uint32_t count);
+
+	//The boards leave the group
+	SIRC_DLL_LINKAGE __stdcall ~ETH_MULTICAST();
+
+	//Same as the SIRC methods, for every member.
+	//Returns true if every member got it.
+	//If any did not, returns false.  Check getMemberError() for who.
+	SIRC_DLL_LINKAGE BOOL __stdcall sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	SIRC_DLL_LINKAGE BOOL __stdcall sendParamRegisterWrite(uint8_t regNumber, uint32_t value);
+
+	//Did the member's board join the group?
+	SIRC_DLL_LINKAGE BOOL __stdcall isJoined(uint32_t member);
+
+	//Error code of the member in the last call, 0 if it went through
+	SIRC_DLL_LINKAGE int8_t __stdcall getMemberError(uint32_t member);
+
+	//Retrieve the counters
+	SIRC_DLL_LINKAGE void __stdcall getStatistics(ETH_MULTICAST_STATISTICS *outStatistics);
+
+	//Retrieve the last error code.  Any value < 0 indicates a problem.
+	inline int8_t __stdcall getLastError(){
+		return(lastError);
+	}
+
+private:
+	int8_t lastError;
+	uint8_t groupMAC[6];
+	ETH_SIRC *members[ETH_MULTICAST_MAX_MEMBERS];
+	uint32_t count;
+	BOOL joined[ETH_MULTICAST_MAX_MEMBERS];
+	int8_t errors[ETH_MULTICAST_MAX_MEMBERS];
+	int sender;                     //member the group frames go out through, -1 if none joined
+	ETH_MULTICAST_STATISTICS statistics;
+
+	//The burst in progress, and which member acked what
+	PACKET *frames[ETH_MULTICAST_BURST];
+	uint32_t numFrames;
+	BOOL acked[ETH_MULTICAST_MAX_MEMBERS][ETH_MULTICAST_BURST];
+
+	uint32_t burstSize(void);
+	BOOL sendBurst(void);
+	void freeBurst(void);
+	BOOL finish(void);
+};
+
+#endif //DEFINEETHMULTICASTH
@@ -0,0 +1,401 @@
+// Title: ETH_NIC class
+//
+// Description: One packet driver shared by many ETH_SIRC sessions.
+// See eth_nic.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//Receive buffers go back to the driver this large (ETH_SIRC's MAXPACKETSIZE)
+#define ETHNICRECYCLELENGTH 1514
+
+//Each session has a bulk and a control lane, each a steering consumer
+static_assert(2 * ETH_NIC_MAX_SESSIONS <= PACKET_STEERING_MAX_CONSUMERS,
+              "not enough steering consumers for ETH_NIC_MAX_SESSIONS");
+static_assert(ETH_NIC_MAX_SESSIONS <= PACKET_STEERING_MAX_SOURCES,
+              "not enough steering sources for ETH_NIC_MAX_SESSIONS");
+
+//The packet driver, for many threads.
+//Packets are allocated, freed and posted under a lock.  Waiting for received frames is
+// left alone: only one thread at a time does it (see ETH_NIC::receive), and the drivers
+// hand frames over through interlocked queues.
+//The limits each session sees are its share of the driver's.
+class SHARED_PACKET_DRIVER : public PACKET_DRIVER {
+public:
+    SHARED_PACKET_DRIVER(PACKET_DRIVER *Driver, const uint32_t *Sessions)
+    {
+        this->Driver = Driver;
+        this->Sessions = Sessions;
+        InitializeCriticalSection(&Lock);
+    }
+
+    //The driver stays with the ETH_NIC
+    ~SHARED_PACKET_DRIVER(void)
+    {
+        DeleteCriticalSection(&Lock);
+    }
+
+    //Already open
+    BOOL Open(IN const wchar_t *AdapterName)
+    {
+        return FALSE;
+    }
+
+    BOOL Flush(void)
+    {
+        EnterCriticalSection(&Lock);
+        BOOL Result = Driver->Flush();
+        LeaveCriticalSection(&Lock);
+        return Result;
+    }
+
+    PACKET *AllocatePacket(IN BYTE *Buffer, IN UINT Length, IN BOOL bForReceive)
+    {
+        EnterCriticalSection(&Lock);
+        PACKET *Packet = Driver->AllocatePacket(Buffer, Length, bForReceive);
+        LeaveCriticalSection(&Lock);
+        return Packet;
+    }
+
+    void FreePacket(IN PACKET *Packet, IN BOOL bForReceiving)
+    {
+        EnterCriticalSection(&Lock);
+        Driver->FreePacket(Packet, bForReceiving);
+        LeaveCriticalSection(&Lock);
+    }
+
+    HRESULT PostReceivePacket(IN PACKET *Packet)
+    {
+        EnterCriticalSection(&Lock);
+        HRESULT Result = Driver->PostReceivePacket(Packet);
+        LeaveCriticalSection(&Lock);
+        return Result;
+    }
+
+    //One transmit queue: frames from all sessions go out in the order they come in
+    HRESULT PostTransmitPacket(IN PACKET *Packet)
+    {
+        EnterCriticalSection(&Lock);
+        HRESULT Result = Driver->PostTransmitPacket(Packet);
+        LeaveCriticalSection(&Lock);
+        return Result;
+    }
+
+    PACKET_MODE GetNextCompletedPacket(OUT PACKET **pPacket, IN UINT32 TimeOutInMsec)
+    {
+        return Driver->GetNextCompletedPacket(pPacket, TimeOutInMsec);
+    }
+
+    PACKET *GetNextReceivedPacket(IN UINT32 TimeOutInMsec)
+    {
+        return Driver->GetNextReceivedPacket(TimeOutInMsec);
+    }
+
+    BOOL GetMacAddress(OUT UINT8 *MacAddress)
+    {
+        EnterCriticalSection(&Lock);
+        BOOL Result = Driver->GetMacAddress(MacAddress);
+        LeaveCriticalSection(&Lock);
+        return Result;
+    }
+
+    //Every session would change it for all of them
+    BOOL ChangeMacAddress(IN UINT8 *MacAddress)
+    {
+        return FALSE;
+    }
+
+    HRESULT SetFilter(IN UINT32 Filter)
+    {
+        EnterCriticalSection(&Lock);
+        HRESULT Result = Driver->SetFilter(Filter);
+        LeaveCriticalSection(&Lock);
+        return Result;
+    }
+
+    //A fair share of the posted packets.  Unlimited stays unlimited.
+    BOOL GetMaxOutstanding(OUT UINT32 *NumReads, OUT UINT32 *NumWrites)
+    {
+        UINT32 Shares = (*Sessions > 1) ? *Sessions : 1;
+
+        EnterCriticalSection(&Lock);
+        BOOL Result = Driver->GetMaxOutstanding(NumReads, NumWrites);
+        LeaveCriticalSection(&Lock);
+        if (!Result)
+            return FALSE;
+        if (*NumReads)
+            *NumReads = max(*NumReads / Shares, (UINT32) 1);
+        if (*NumWrites)
+            *NumWrites = max(*NumWrites / Shares, (UINT32) 1);
+        return TRUE;
+    }
+
+private:
+    PACKET_DRIVER *Driver;
+    const uint32_t *Sessions;
+    CRITICAL_SECTION Lock;
+};
+
+//PUBLIC FUNCTIONS
+//Constructor for the class
+//Return with an error code if anything goes wrong.
+SIRC_DLL_LINKAGE ETH_NIC::ETH_NIC(uint32_t driverVersion, wchar_t *nicName)
+{
+    lastError = 0;
+    shared = NULL;
+    steering = NULL;
+    pulling = false;
+    nextHandoff = 0;
+    surplusReceives = 0;
+    memset(&statistics, 0, sizeof(statistics));
+    memset(waiting, 0, sizeof(waiting));
+    memset(wakeups, 0, sizeof(wakeups));
+    memset(boards, 0, sizeof(boards));
+    InitializeCriticalSection(&lock);
+
+    //Make connection to NIC driver
+    driver = OpenPacketDriver(nicName, driverVersion, false);
+    if (!driver) {
+        lastError = FAILDRIVERPRESENT;
+        return;
+    }
+    shared = new SHARED_PACKET_DRIVER(driver, &statistics.sessions);
+    steering = new PACKET_STEERING(shared, ETHNICRECYCLELENGTH, recycleReceive, this);
+
+    for (int lane = 0; lane < 2 * ETH_NIC_MAX_SESSIONS; lane++) {
+        watching[lane] = -1;
+        wakeups[lane] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (!wakeups[lane]) {
+            lastError = FAILMEMALLOC;
+            return;
+        }
+    }
+}
+
+SIRC_DLL_LINKAGE ETH_NIC::~ETH_NIC()
+{
+    assert(statistics.sessions == 0);
+
+    //Queued frames go back through the driver, before it goes
+    delete steering;
+    delete shared;
+    delete driver;
+    for (int lane = 0; lane < 2 * ETH_NIC_MAX_SESSIONS; lane++) {
+        if (wakeups[lane])
+            CloseHandle(wakeups[lane]);
+    }
+    DeleteCriticalSection(&lock);
+}
+
+//New ETH_SIRC on this NIC
+SIRC_DLL_LINKAGE SIRC * __stdcall ETH_NIC::openSession(uint8_t *FPGA_ID)
+{
+    if (lastError != 0)
+        return NULL;
+    return new ETH_SIRC(this, FPGA_ID);
+}
+
+//Retrieve the counters
+SIRC_DLL_LINKAGE void __stdcall ETH_NIC::getStatistics(ETH_NIC_STATISTICS *outStatistics)
+{
+    EnterCriticalSection(&lock);
+    *outStatistics = statistics;
+    if (steering) {
+        outStatistics->steered = steering->nSteered;
+        outStatistics->discarded = steering->nDiscarded;
+    }
+    LeaveCriticalSection(&lock);
+}
+
+//PRIVATE FUNCTIONS, for ETH_SIRC
+
+//Route the frames from FPGA_ID to two new lanes.
+//Return 0 on success, an error code on failure
+int8_t ETH_NIC::addSession(const uint8_t *FPGA_ID, const char *bulkCommands, const char *controlCommands,
+                           int *bulkLane, int *controlLane)
+{
+    int slot = -1;
+    int8_t error = 0;
+
+    EnterCriticalSection(&lock);
+    for (int b = 0; b < ETH_NIC_MAX_SESSIONS; b++) {
+        if (!boards[b].open) {
+            if (slot < 0)
+                slot = b;
+            continue;
+        }
+        //Two sessions would fight over the same frames
+        if (memcmp(boards[b].FPGA_ID, FPGA_ID, 6) == 0) {
+            LeaveCriticalSection(&lock);
+            return INVALIDFPGAMACADDRESS;
+        }
+    }
+
+    *bulkLane = (slot < 0) ? -1 : steering->AddConsumer(FPGA_ID, bulkCommands);
+    *controlLane = (*bulkLane < 0) ? -1 : steering->AddConsumer(FPGA_ID, controlCommands);
+    if (*controlLane < 0) {
+        steering->RemoveConsumer(*bulkLane);
+        *bulkLane = -1;
+        error = FAILMEMALLOC;
+    } else {
+        boards[slot].open = true;
+        memcpy(boards[slot].FPGA_ID, FPGA_ID, 6);
+        boards[slot].bulkLane = *bulkLane;
+        statistics.sessions++;
+        LogIt("nic::add %u %u",(uint32_t) *bulkLane,statistics.sessions);
+    }
+    LeaveCriticalSection(&lock);
+    return error;
+}
+
+//The session is going away.  Its receives stay posted, the next ones that come back
+// are freed instead of recycled (see retireReceive).
+void ETH_NIC::removeSession(int bulkLane, int controlLane, uint32_t postedReceives)
+{
+    EnterCriticalSection(&lock);
+    steering->RemoveConsumer(bulkLane);
+    steering->RemoveConsumer(controlLane);
+    waiting[bulkLane] = waiting[controlLane] = false;
+    watching[bulkLane] = watching[controlLane] = -1;
+    for (int b = 0; b < ETH_NIC_MAX_SESSIONS; b++) {
+        if (boards[b].open && (boards[b].bulkLane == bulkLane)) {
+            boards[b].open = false;
+            statistics.sessions--;
+        }
+    }
+    LogIt("nic::remove %u %u",(uint32_t) bulkLane,statistics.sessions);
+    LeaveCriticalSection(&lock);
+
+    InterlockedExchangeAdd(&surplusReceives, (LONG) postedReceives);
+}
+
+//What one session may have posted, see SHARED_PACKET_DRIVER
+BOOL ETH_NIC::getShares(uint32_t *maxReads, uint32_t *maxWrites)
+{
+    return shared->GetMaxOutstanding(maxReads, maxWrites);
+}
+
+//Next frame for a lane, as PACKET_STEERING::GetNextReceivedPacket.
+//If no session thread is waiting in the driver we do, and sort what comes in for the
+// others.  Otherwise we wait for whoever is to hand us a frame or the driver.
+// alsoLane: give up (return NULL) as soon as a frame for this lane is here, -1 for none
+PACKET *ETH_NIC::receive(int lane, uint32_t timeOut, int alsoLane)
+{
+    DWORD startTime = GetTickCount();
+    BOOL looked = false;
+    PACKET *packet = NULL;
+
+    EnterCriticalSection(&lock);
+    for (;;) {
+        if (steering->HasPackets(lane)) {
+            packet = steering->GetNextReceivedPacket(lane, 0);
+            break;
+        }
+        if ((alsoLane >= 0) && steering->HasPackets(alsoLane))
+            break;
+
+        uint32_t elapsed = GetTickCount() - startTime;
+        if (looked && (elapsed >= timeOut))
+            break;
+        looked = true;
+        uint32_t remaining = (elapsed < timeOut) ? timeOut - elapsed : 0;
+
+        if (!pulling) {
+            pulling = true;
+            LeaveCriticalSection(&lock);
+            packet = driver->GetNextReceivedPacket(remaining);
+            EnterCriticalSection(&lock);
+            pulling = false;
+
+            //Ours too go through the queue, in order with what is already there
+            if (packet) {
+                int target = steering->Steer(packet);
+                if ((target >= 0) && (target != lane))
+                    wake(target);
+                packet = NULL;
+            }
+            continue;
+        }
+
+        waiting[lane] = true;
+        watching[lane] = alsoLane;
+        LeaveCriticalSection(&lock);
+        (void) WaitForSingleObject(wakeups[lane], remaining);
+        EnterCriticalSection(&lock);
+        waiting[lane] = false;
+        watching[lane] = -1;
+    }
+
+    //Whoever is still waiting needs someone in the driver
+    if (!pulling)
+        handOff();
+    LeaveCriticalSection(&lock);
+    return packet;
+}
+
+//Anything queued for this lane?
+BOOL ETH_NIC::pending(int lane)
+{
+    EnterCriticalSection(&lock);
+    BOOL any = steering->HasPackets(lane);
+    LeaveCriticalSection(&lock);
+    return any;
+}
+
+//Should this receive coming back be freed rather than posted again?
+BOOL ETH_NIC::retireReceive()
+{
+    LONG left = surplusReceives;
+
+    while (left > 0) {
+        if (InterlockedCompareExchange(&surplusReceives, left - 1, left) == left)
+            return true;
+        left = surplusReceives;
+    }
+    return false;
+}
+
+//A frame no session wants.  It may be one of the receives a session that left still had.
+void ETH_NIC::recycleReceive(PACKET *packet, void *context)
+{
+    ETH_NIC *nic = (ETH_NIC *) context;
+
+    if (nic->retireReceive()) {
+        nic->shared->FreePacket(packet, true);
+        return;
+    }
+    packet->Length = ETHNICRECYCLELENGTH;
+    nic->shared->PostReceivePacket(packet);
+}
+
+//A frame was queued for target, wake up whoever waits for it.  Called with the lock held.
+void ETH_NIC::wake(int target)
+{
+    for (int lane = 0; lane < 2 * ETH_NIC_MAX_SESSIONS; lane++) {
+        if (waiting[lane] && ((lane == target) || (watching[lane] == target)))
+            SetEvent(wakeups[lane]);
+    }
+}
+
+//Nobody is in the driver any more, wake one of the waiting lanes (round robin) to take
+// over.  Called with the lock held.
+void ETH_NIC::handOff()
+{
+    for (uint32_t i = 0; i < 2 * ETH_NIC_MAX_SESSIONS; i++) {
+        uint32_t lane = (nextHandoff + i) % (2 * ETH_NIC_MAX_SESSIONS);
+        if (waiting[lane]) {
+            nextHandoff = lane + 1;
+            statistics.handoffs++;
+            SetEvent(wakeups[lane]);
+            return;
+        }
+    }
+}
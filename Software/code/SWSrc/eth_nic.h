@@ -0,0 +1,114 @@
+// Title: ETH_NIC class definition
+//
+// Description: Session manager for many boards on one network adapter.
+// Each ETH_SIRC normally opens a packet driver of its own and throws away what
+// is not from its board, so ten boards mean ten drivers competing for the NIC
+// and for the few packets the V3 driver lets us post.  An ETH_NIC opens the
+// driver once and hands out sessions that share it:
+//
+//      ETH_NIC nic(driverVersion, NULL);
+//      SIRC *board0 = nic.openSession(FPGA_ID0);
+//      SIRC *board1 = nic.openSession(FPGA_ID1);
+//
+// Received frames are sorted by source MAC (and command) to the sessions, by
+// whichever session thread happens to be waiting in the driver.  All sessions
+// post into the one receive ring and send through the one transmit queue, each
+// with a fair share of what the driver allows (its receive pool and write window
+// are capped to the driver limits divided by the number of sessions).
+//
+// Sessions are ordinary ETH_SIRC objects, use them from one thread per board
+// as usual and delete them before the ETH_NIC.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINEETHNICH
+#define DEFINEETHNICH 1
+
+#include "sirc.h"
+
+//Sessions one NIC can carry
+#define ETH_NIC_MAX_SESSIONS 32
+
+class PACKET;
+class PACKET_DRIVER;
+class PACKET_STEERING;
+
+//How the shared NIC is doing
+typedef struct {
+    uint32_t sessions;              //open right now
+    uint32_t steered;               //frames sorted to a session
+    uint32_t discarded;             //frames for nobody (other hosts, broadcasts)
+    uint32_t handoffs;              //times a session was woken to take over the driver
+} ETH_NIC_STATISTICS;
+
+class ETH_NIC {
+public:
+	//Open the packet driver on nicName (NULL: the first one that works).
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall ETH_NIC(uint32_t driverVersion = 0, wchar_t *nicName = NULL);
+
+	//All sessions must be deleted first
+	SIRC_DLL_LINKAGE __stdcall ~ETH_NIC();
+
+	//Open a session with the board at FPGA_ID (see ETH_SIRC) and make first contact.
+	//Returns NULL if the NIC did not open, otherwise check the session's getLastError():
+	// INVALIDFPGAMACADDRESS if the board has a session already, FAILMEMALLOC if all
+	// ETH_NIC_MAX_SESSIONS are taken.  Delete the session when done.
+	SIRC_DLL_LINKAGE SIRC * __stdcall openSession(uint8_t *FPGA_ID);
+
+	//Retrieve the counters
+	SIRC_DLL_LINKAGE void __stdcall getStatistics(ETH_NIC_STATISTICS *outStatistics);
+
+	//Retrieve the last error code.  Any value < 0 indicates a problem.
+	inline int8_t __stdcall getLastError(){
+		return(lastError);
+	}
+
+private:
+	//Sessions use everything below
+	friend class ETH_SIRC;
+
+	int8_t lastError;
+	PACKET_DRIVER *driver;          //the real one
+	PACKET_DRIVER *shared;          //the same, safe for many threads (see eth_nic.cpp)
+	PACKET_STEERING *steering;
+	CRITICAL_SECTION lock;          //protects steering and the receive state below
+	BOOL pulling;                   //a session thread is waiting in the driver
+	//By lane: is its owner waiting in receive(), on what other lane, and how to wake it
+	BOOL waiting[2 * ETH_NIC_MAX_SESSIONS];
+	int watching[2 * ETH_NIC_MAX_SESSIONS];
+	HANDLE wakeups[2 * ETH_NIC_MAX_SESSIONS];       //auto reset
+	uint32_t nextHandoff;
+	struct {
+		BOOL open;
+		uint8_t FPGA_ID[6];
+		int bulkLane;
+	} boards[ETH_NIC_MAX_SESSIONS];
+	volatile LONG surplusReceives;  //posted by sessions that are gone
+	ETH_NIC_STATISTICS statistics;
+
+	//For ETH_SIRC
+	PACKET_DRIVER *getDriver(void){
+		return(shared);
+	}
+	int8_t addSession(const uint8_t *FPGA_ID, const char *bulkCommands, const char *controlCommands,
+		int *bulkLane, int *controlLane);
+	void removeSession(int bulkLane, int controlLane, uint32_t postedReceives);
+	BOOL getShares(uint32_t *maxReads, uint32_t *maxWrites);
+	PACKET *receive(int lane, uint32_t timeOut, int alsoLane);
+	BOOL pending(int lane);
+	BOOL retireReceive(void);
+
+	static void recycleReceive(PACKET *packet, void *context);
+	void wake(int target);
+	void handOff(void);
+};
+
+#endif //DEFINEETHNICH
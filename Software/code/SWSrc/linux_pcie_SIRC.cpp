@@ -0,0 +1,626 @@
+// Title: LINUX_PCIE_SIRC class definition
+//
+// Description: The PCIE2_SIRC interface on Linux, over the device's BAR mapped into the
+// process, and a file-backed emulator of the device.  See linux_pcie_SIRC.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#if !defined(_WIN32)
+
+//BAR offsets go past 2GB on 32-bit builds too
+#define _FILE_OFFSET_BITS 64
+
+#include "sirc_internal.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/vfio.h>
+#include <linux/futex.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIRC_PCIE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//Same layout as the Windows driver, see pcie2_SIRC.cpp
+#define INPUT_OFFSET 0x00000000
+#define OUTPUT_OFFSET 0x08000000
+#define PARAMETER_REG_OFFSET 0xF0000000
+#define MAX_BUFFER_LENGTH 1024*1024*128
+
+//256 registers, one every 32 bytes
+#define REGISTER_WINDOW (256 * 32)
+
+//Polls of the run register before waitDone starts giving up the CPU in between
+#define SPINPOLLS 256
+
+//Longest the idle emulator sleeps without a wake, in case run was raised by someone
+// who does not ring (msec)
+#define IDLEWAIT 100
+
+static volatile uint8_t *mapWindow(int fd, uint64_t offset, size_t length)
+{
+    void *window = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t) offset);
+
+    return (window == MAP_FAILED) ? NULL : (volatile uint8_t *) window;
+}
+
+static void unmapWindow(volatile uint8_t *window, size_t length)
+{
+    if (window != NULL)
+        munmap((void *) window, length);
+}
+
+//Everything stored to the BAR so far reaches the device before anything stored after.
+//Write-combined stores sit in the CPU's buffers until this.
+static inline void storeFence()
+{
+#if defined(SIRC_PCIE_SSE2)
+    _mm_sfence();
+#else
+    __sync_synchronize();
+#endif
+}
+
+static inline void spinPause()
+{
+#if defined(SIRC_PCIE_SSE2)
+    _mm_pause();
+#endif
+}
+
+//Sleep while a register of the emulator's file still holds value, or until woken.
+//Not private futexes: the host may have the file mapped elsewhere, or in another process.
+static void doorbellWait(volatile uint32_t *word, uint32_t value, uint32_t maxWaitTimeInMsec)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = maxWaitTimeInMsec / 1000;
+    timeout.tv_nsec = (long) (maxWaitTimeInMsec % 1000) * 1000000;
+    (void) syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+static void doorbellRing(volatile uint32_t *word)
+{
+    (void) syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+//Stores of the widest size the CPU has for the aligned middle, single bytes at the
+// edges.  PCIe carries byte enables, so the bytes around the edges are left alone
+// (PCIE2_SIRC has to zero them).
+static void copyToDevice(volatile uint8_t *device, const uint8_t *buffer, uint32_t length)
+{
+    while ((length != 0) && (((uintptr_t) device & 15) != 0)) {
+        *device++ = *buffer++;
+        length--;
+    }
+#if defined(SIRC_PCIE_SSE2)
+    for (; length >= 16; length -= 16, device += 16, buffer += 16)
+        _mm_store_si128((__m128i *) device, _mm_loadu_si128((const __m128i *) buffer));
+#else
+    for (; length >= 8; length -= 8, device += 8, buffer += 8) {
+        uint64_t word;
+
+        memcpy(&word, buffer, 8);
+        *(volatile uint64_t *) device = word;
+    }
+#endif
+    while (length != 0) {
+        *device++ = *buffer++;
+        length--;
+    }
+}
+
+//Each load from the BAR is a round trip, so the middle goes 16 bytes at a time
+static void copyFromDevice(uint8_t *buffer, volatile uint8_t *device, uint32_t length)
+{
+    while ((length != 0) && (((uintptr_t) device & 15) != 0)) {
+        *buffer++ = *device++;
+        length--;
+    }
+#if defined(SIRC_PCIE_SSE2)
+    for (; length >= 16; length -= 16, device += 16, buffer += 16)
+        _mm_storeu_si128((__m128i *) buffer, _mm_load_si128((const __m128i *) device));
+#else
+    for (; length >= 8; length -= 8, device += 8, buffer += 8) {
+        uint64_t word = *(volatile uint64_t *) device;
+
+        memcpy(buffer, &word, 8);
+    }
+#endif
+    while (length != 0) {
+        *buffer++ = *device++;
+        length--;
+    }
+}
+
+LINUX_PCIE_SIRC::LINUX_PCIE_SIRC(const char *device, int bar)
+{
+    char path[256];
+    struct stat status;
+    uint64_t regionOffset = 0;
+    uint64_t regionSize = 0;
+    BOOL opened;
+
+    fd = -1;
+    wcFd = -1;
+    vfioContainer = -1;
+    vfioGroup = -1;
+    input = NULL;
+    output = NULL;
+    registers = NULL;
+    inputMapped = 0;
+    outputMapped = 0;
+    registersMapped = 0;
+    maxInputDataBytes = 0;
+    maxOutputDataBytes = 0;
+    emulated = false;
+
+    if (device == NULL)
+        device = getenv("SIRC_PCIE_DEVICE");
+    if (device == NULL) {
+        setLastError(FAILDRIVERPRESENT);
+        return;
+    }
+
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s", device);
+    if (strncmp(device, "vfio:", 5) == 0)
+        opened = openVfio(device + 5, bar, &regionOffset, &regionSize);
+    else if ((strchr(device, '/') == NULL) && (stat(path, &status) == 0))
+        opened = openSysfs(device, bar, &regionOffset, &regionSize);
+    else {
+        //A file standing in for the BAR
+        fd = open(device, O_RDWR);
+        opened = (fd >= 0) && (fstat(fd, &status) == 0);
+        if (opened)
+            regionSize = status.st_size;
+        emulated = true;
+    }
+
+    if (!opened || !mapWindows(regionOffset, regionSize)) {
+        setLastError(FAILDRIVERPRESENT);
+        return;
+    }
+
+    maxInputDataBytes = (uint32_t) inputMapped;
+    maxOutputDataBytes = (uint32_t) outputMapped;
+}
+
+LINUX_PCIE_SIRC::~LINUX_PCIE_SIRC()
+{
+    //Submitted requests still use the device
+    finishAsync();
+
+    unmapWindow(input, inputMapped);
+    unmapWindow(output, outputMapped);
+    unmapWindow(registers, registersMapped);
+
+    if (wcFd >= 0)
+        close(wcFd);
+    if (fd >= 0)
+        close(fd);
+    if (vfioGroup >= 0)
+        close(vfioGroup);
+    if (vfioContainer >= 0)
+        close(vfioContainer);
+}
+
+//The kernel's resource file for the BAR, and its write-combined twin if the BAR is
+// prefetchable
+BOOL LINUX_PCIE_SIRC::openSysfs(const char *bdf, int bar, uint64_t *regionOffset, uint64_t *regionSize)
+{
+    char path[256];
+    struct stat status;
+    int enable;
+
+    //Memory decoding is off until something enables the function.  Already on is fine.
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/enable", bdf);
+    enable = open(path, O_WRONLY);
+    if (enable >= 0) {
+        if (write(enable, "1", 1) != 1)
+            LogIt("sirc::pcie.enable failed %s", (UINT_PTR) bdf);
+        close(enable);
+    }
+
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/resource%d", bdf, bar);
+    fd = open(path, O_RDWR | O_SYNC);
+    if ((fd < 0) || (fstat(fd, &status) != 0))
+        return false;
+
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/resource%d_wc", bdf, bar);
+    wcFd = open(path, O_RDWR);
+
+    *regionOffset = 0;
+    *regionSize = status.st_size;
+    return true;
+}
+
+//The function bound to vfio-pci: its IOMMU group into a container of our own, then the
+// BAR is a region of the device file
+BOOL LINUX_PCIE_SIRC::openVfio(const char *bdf, int bar, uint64_t *regionOffset, uint64_t *regionSize)
+{
+    char link[256];
+    char path[sizeof(link) + 16];
+    const char *group;
+    ssize_t linkLength;
+    struct vfio_group_status groupStatus;
+    struct vfio_region_info region;
+
+    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/iommu_group", bdf);
+    linkLength = readlink(path, link, sizeof(link) - 1);
+    if (linkLength < 0)
+        return false;
+    link[linkLength] = '\0';
+    group = strrchr(link, '/');
+    group = (group == NULL) ? link : group + 1;
+
+    vfioContainer = open("/dev/vfio/vfio", O_RDWR);
+    if ((vfioContainer < 0) ||
+        (ioctl(vfioContainer, VFIO_GET_API_VERSION) != VFIO_API_VERSION) ||
+        !ioctl(vfioContainer, VFIO_CHECK_EXTENSION, VFIO_TYPE1_IOMMU))
+        return false;
+
+    snprintf(path, sizeof(path), "/dev/vfio/%s", group);
+    vfioGroup = open(path, O_RDWR);
+    if (vfioGroup < 0)
+        return false;
+
+    //Every device in the group has to be bound to vfio-pci (or nothing)
+    memset(&groupStatus, 0, sizeof(groupStatus));
+    groupStatus.argsz = sizeof(groupStatus);
+    if ((ioctl(vfioGroup, VFIO_GROUP_GET_STATUS, &groupStatus) != 0) ||
+        !(groupStatus.flags & VFIO_GROUP_FLAGS_VIABLE))
+        return false;
+
+    if ((ioctl(vfioGroup, VFIO_GROUP_SET_CONTAINER, &vfioContainer) != 0) ||
+        (ioctl(vfioContainer, VFIO_SET_IOMMU, VFIO_TYPE1_IOMMU) != 0))
+        return false;
+
+    fd = ioctl(vfioGroup, VFIO_GROUP_GET_DEVICE_FD, bdf);
+    if (fd < 0)
+        return false;
+
+    memset(&region, 0, sizeof(region));
+    region.argsz = sizeof(region);
+    region.index = VFIO_PCI_BAR0_REGION_INDEX + bar;
+    if ((ioctl(fd, VFIO_DEVICE_GET_REGION_INFO, &region) != 0) ||
+        !(region.flags & VFIO_REGION_INFO_FLAG_MMAP))
+        return false;
+
+    *regionOffset = region.offset;
+    *regionSize = region.size;
+    return true;
+}
+
+//Only the three windows are mapped, not the unused space between them
+BOOL LINUX_PCIE_SIRC::mapWindows(uint64_t regionOffset, uint64_t regionSize)
+{
+    if (regionSize < (uint64_t) PARAMETER_REG_OFFSET + REGISTER_WINDOW) {
+        LogIt("sirc::pcie.bar too small %u", (uint32_t) (regionSize >> 20));
+        return false;
+    }
+
+    input = mapWindow((wcFd >= 0) ? wcFd : fd, regionOffset + INPUT_OFFSET, MAX_BUFFER_LENGTH);
+    if (input == NULL)
+        return false;
+    inputMapped = MAX_BUFFER_LENGTH;
+
+    output = mapWindow(fd, regionOffset + OUTPUT_OFFSET, MAX_BUFFER_LENGTH);
+    if (output == NULL)
+        return false;
+    outputMapped = MAX_BUFFER_LENGTH;
+
+    registers = mapWindow(fd, regionOffset + PARAMETER_REG_OFFSET, REGISTER_WINDOW);
+    if (registers == NULL)
+        return false;
+    registersMapped = REGISTER_WINDOW;
+    return true;
+}
+
+//Dynamic parameters
+//Retrieve the active set of parameters and limits for this instance
+BOOL LINUX_PCIE_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength)
+{
+    SIRC::PARAMETERS params;
+
+    params.myVersion            = SIRC_PARAMETERS_CURRENT_VERSION;
+    params.maxInputDataBytes    = maxInputDataBytes;
+    params.maxOutputDataBytes   = maxOutputDataBytes;
+    params.writeTimeout         = 0; // unlimited
+    params.readTimeout          = 0;
+    params.maxRetries           = 0;
+    params.maxOutstandingReads  = 0;
+    params.maxOutstandingWrites = 0;
+    params.autoTune             = 0; // nothing to tune
+    params.postedReceives       = 0;
+    params.writeWindow          = 0;
+    params.tunerDecisions       = 0;
+    params.compression          = 0;
+    params.ioThread             = 0;
+    params.fecGroup             = 0;
+    params.fecRecovered         = 0;
+    params.fecParityFrames      = 0;
+    params.receiveCredits       = 0;
+    params.creditGrants         = 0;
+
+    if (copyParameters(&params, outParameters, maxOutLength)) {
+        setLastError(0);
+        return true;
+    }
+    setLastError(INVALIDLENGTH);
+    return false;
+}
+
+//Modify the active set of parameters and limits for this instance
+BOOL LINUX_PCIE_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
+{
+    //What we look at is all in version 1.
+    if (!parametersLengthValid(inParameters, length)){
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    //Nothing past the mapped windows
+    if ((inParameters->maxInputDataBytes > inputMapped) ||
+        (inParameters->maxOutputDataBytes > outputMapped)) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+    maxInputDataBytes    = inParameters->maxInputDataBytes;
+    maxOutputDataBytes   = inParameters->maxOutputDataBytes;
+
+    //Ignored: the timeouts, retries and windows, there is no wire
+
+    setLastError(0);
+    return true;
+}
+
+BOOL LINUX_PCIE_SIRC::sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    if (buffer == NULL) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if ((uint64_t) startAddress + length > maxInputDataBytes) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    copyToDevice(input + startAddress, buffer, length);
+    storeFence();
+    return true;
+}
+
+BOOL LINUX_PCIE_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    if (buffer == NULL) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if ((uint64_t) startAddress + length > maxOutputDataBytes) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    copyFromDevice(buffer, output + startAddress, length);
+    return true;
+}
+
+BOOL LINUX_PCIE_SIRC::sendParamRegisterWrite(uint8_t regNumber, uint32_t value)
+{
+    if (registers == NULL) {
+        setLastError(INVALIDPARAMWRITETRANSMIT);
+        return false;
+    }
+    *reg(regNumber) = value;
+    if (emulated && (regNumber == 255))
+        doorbellRing(reg(255));
+    return true;
+}
+
+BOOL LINUX_PCIE_SIRC::sendParamRegisterRead(uint8_t regNumber, uint32_t *value)
+{
+    if (registers == NULL) {
+        setLastError(INVALIDPARAMREADTRANSMIT);
+        return false;
+    }
+    *value = *reg(regNumber);
+    return true;
+}
+
+BOOL LINUX_PCIE_SIRC::sendRun()
+{
+    //sendWrite fenced already, so the input is there before run goes up
+    return (sendParamRegisterWrite(255, 1));
+}
+
+BOOL LINUX_PCIE_SIRC::waitDone(uint32_t maxWaitTimeInMsec)
+{
+    uint32_t startTime = GetTickCount();
+    uint32_t polls = 0;
+
+    setLastError(0);
+    if (registers == NULL) {
+        setLastError(FAILDONE);
+        return false;
+    }
+
+    //Wait for the system to finish execution
+    do {
+        if (*reg(255) == 0) {
+            //Nothing read from the output before this
+            __sync_synchronize();
+            return true;
+        }
+        if (++polls < SPINPOLLS)
+            spinPause();
+        else
+            sched_yield();
+    } while (GetTickCount() - startTime < maxWaitTimeInMsec);
+
+    setLastError(FAILDONE);
+    return false;
+}
+
+//There is no soft reset in this BAR layout
+BOOL LINUX_PCIE_SIRC::sendReset()
+{
+    setLastError(FAILRESETACK);
+    return false;
+}
+
+//Send a block of data to the FPGA, raise the execution signal, wait for the execution
+// signal to be lowered, then read back maxOutLength bytes of results
+// See SIRC::sendWriteAndRun.
+BOOL LINUX_PCIE_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+                                      uint32_t maxWaitTimeInMsec, uint8_t *outData, uint32_t maxOutLength,
+                                      uint32_t *outputLength)
+{
+    setLastError(0);
+
+    //Check the input parameters
+    if (!inData) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (startAddress > maxInputDataBytes) {
+        setLastError(INVALIDADDRESS);
+        return false;
+    }
+    if (inLength == 0 || (uint64_t) startAddress + inLength > maxInputDataBytes) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    //Check the output parameters
+    if (!outData) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (maxOutLength == 0 || maxOutLength > maxOutputDataBytes) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    if (!sendWrite(startAddress, inLength, inData))
+        return false;
+    if (!sendRun())
+        return false;
+    if (!waitDone(maxWaitTimeInMsec))
+        return false;
+    if (!sendRead(0, maxOutLength, outData))
+        return false;
+    *outputLength = maxOutLength;
+    return true;
+}
+
+//The emulator
+
+LINUX_PCIE_EMULATOR::LINUX_PCIE_EMULATOR(const char *path)
+{
+    fd = -1;
+    devicePath[0] = '\0';
+    input = NULL;
+    output = NULL;
+    registers = NULL;
+    stop = false;
+    threadStarted = false;
+    lastError = 0;
+
+    if (path == NULL) {
+        fd = memfd_create("sirc_pcie", 0);
+        snprintf(devicePath, sizeof(devicePath), "/proc/self/fd/%d", fd);
+    } else {
+        fd = open(path, O_RDWR | O_CREAT, 0600);
+        snprintf(devicePath, sizeof(devicePath), "%s", path);
+    }
+
+    //Sparse, only what gets touched takes memory
+    if ((fd < 0) || (ftruncate(fd, (off_t) PARAMETER_REG_OFFSET + REGISTER_WINDOW) != 0)) {
+        lastError = FAILDRIVERPRESENT;
+        return;
+    }
+
+    input = mapWindow(fd, INPUT_OFFSET, MAX_BUFFER_LENGTH);
+    output = mapWindow(fd, OUTPUT_OFFSET, MAX_BUFFER_LENGTH);
+    registers = mapWindow(fd, PARAMETER_REG_OFFSET, REGISTER_WINDOW);
+    if ((input == NULL) || (output == NULL) || (registers == NULL)) {
+        lastError = FAILDRIVERPRESENT;
+        return;
+    }
+
+    if (pthread_create(&thread, NULL, deviceThread, this) != 0) {
+        lastError = FAILDRIVERPRESENT;
+        return;
+    }
+    threadStarted = true;
+}
+
+LINUX_PCIE_EMULATOR::~LINUX_PCIE_EMULATOR()
+{
+    if (threadStarted) {
+        stop = true;
+        doorbellRing((volatile uint32_t *) (registers + 32 * 255));
+        pthread_join(thread, NULL);
+    }
+
+    unmapWindow(input, MAX_BUFFER_LENGTH);
+    unmapWindow(output, MAX_BUFFER_LENGTH);
+    unmapWindow(registers, REGISTER_WINDOW);
+    if (fd >= 0)
+        close(fd);
+}
+
+void *LINUX_PCIE_EMULATOR::deviceThread(void *lpParam)
+{
+    ((LINUX_PCIE_EMULATOR *) lpParam)->device();
+    return NULL;
+}
+
+//The circuit srv_main.cpp runs
+void LINUX_PCIE_EMULATOR::device()
+{
+    volatile uint32_t *runRegister = (volatile uint32_t *) (registers + 32 * 255);
+    uint32_t polls = 0;
+    uint32_t run;
+
+    while (!stop) {
+        run = *runRegister;
+        if (run != 1) {
+            //A short spin for back to back runs, then sleep until the host rings
+            if (++polls < SPINPOLLS)
+                spinPause();
+            else
+                doorbellWait(runRegister, run, IDLEWAIT);
+            continue;
+        }
+        polls = 0;
+
+        //The host's input is all there once run is up
+        __sync_synchronize();
+        uint32_t numOps = *(volatile uint32_t *) (registers + 32 * 0);
+        uint32_t multiplier = *(volatile uint32_t *) (registers + 32 * 1);
+        if (multiplier != 0) {
+            numOps = min(numOps, (uint32_t) MAX_BUFFER_LENGTH);
+            for (uint32_t i = 0; i < numOps; i++)
+                output[i] = input[i] * multiplier;
+        }
+
+        //Results out before done
+        __sync_synchronize();
+        *runRegister = 0;
+    }
+}
+
+#endif //!_WIN32
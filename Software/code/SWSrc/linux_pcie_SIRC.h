@@ -0,0 +1,174 @@
+// Title: LINUX_PCIE_SIRC class definition
+//
+// Description: The PCIE2_SIRC interface on Linux, without a driver.  The device's BAR
+// is mapped into the process and transfers are plain loads and stores, so there is no
+// system call per transfer.  Also LINUX_PCIE_EMULATOR, a file that stands in for the
+// BAR with a thread that plays the device.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// The BAR has the layout the Windows driver exposes (see pcie2_SIRC.cpp):
+//   0x00000000  input buffer, written by the host
+//   0x08000000  output buffer, read by the host
+//   0xF0000000  parameter registers, one every 32 bytes, register 255 is run/done
+// The device can be:
+//   "0000:03:00.0"       the sysfs resource file of that PCI function.  Needs root or
+//                        a udev rule.  When the kernel offers a write-combined file
+//                        (resourceN_wc) the input buffer is mapped through it.
+//   "vfio:0000:03:00.0"  the same function bound to vfio-pci, through its IOMMU group
+//   anything else        a file to map, e.g. LINUX_PCIE_EMULATOR::getPath()
+// With no device the SIRC_PCIE_DEVICE environment variable names it.
+//----------------------------------------------------------------------------
+
+#ifndef DEFINELINUXPCIESIRCH
+#define DEFINELINUXPCIESIRCH 1
+
+#include "sirc.h"
+
+class LINUX_PCIE_SIRC : public SIRC {
+public:
+	//Constructor for the class
+	// device: see above
+	// bar: which BAR of the PCI function holds the buffers
+	//Check error code with getLastError() to make certain constructor
+	// succeeded fully.
+    LINUX_PCIE_SIRC(const char *device = NULL, int bar = 0);
+
+	//Destructor for the class
+    ~LINUX_PCIE_SIRC();
+
+	//Send a block of data to an input buffer on the FPGA
+	// startAddress: local address on FPGA input buffer to begin writing at
+	// length: # of bytes to write
+	// buffer: data to be sent to FPGA
+	//Returns true if write is successful.
+	//If write fails for any reason, returns false.
+	// Check error code with getLastError().
+	BOOL sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+
+	//Read a block of data from the output buffer of the FPGA
+	// startAddress: local address on FPGA output buffer to begin reading from
+	// length: # of bytes to read
+	// buffer: data received from FPGA
+	//Returns true if read is successful.
+	//If read fails for any reason, returns false.
+	// Check error code with getLastError().
+	BOOL sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+
+	//Send a 32-bit value from the PC to the parameter register file on the FPGA
+	// regNumber: register to which value should be sent (between 0 and 254)
+	// value: value to be written
+	//Returns true if write is successful.
+	//If write fails for any reason, returns false.
+	// Check error code with getLastError()
+	BOOL sendParamRegisterWrite(uint8_t regNumber, uint32_t value);
+
+	//Read a 32-bit value from the parameter register file on the FPGA back to the PC
+	// regNumber: register to which value should be read (between 0 and 254)
+	// value: value received from FPGA
+	//Returns true if read is successful.
+	//If read fails for any reason, returns false.
+	// Check error code with getLastError().
+	BOOL sendParamRegisterRead(uint8_t regNumber, uint32_t *value);
+
+	//Raise execution signal on FPGA
+	//Returns true if signal is raised.
+	//If signal is not raised for any reason, returns false.
+	// Check error code with getLastError()
+	BOOL sendRun();
+
+	//Wait until execution signal on FPGA is lowered
+	// maxWaitTimeInMsec: # of milliseconds to wait until timeout (from 1 to 4M sec).
+	//Returns true if signal is lowered.
+	//If function fails for any reason, returns false.
+	// Check error code with getLastError().
+	BOOL waitDone(uint32_t maxWaitTimeInMsec);
+
+	//Send a soft reset to the user circuit.  Not in this BAR layout, like PCIE2_SIRC.
+	//Returns false with FAILRESETACK.
+	BOOL sendReset();
+
+	//Send a block of data to the FPGA, raise the execution signal, wait for the execution
+	// signal to be lowered, then read back maxOutLength bytes of results
+	// See SIRC::sendWriteAndRun.
+	BOOL sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+		uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+		uint32_t *outputLength);
+
+    //Retrieve the active set of parameters and limits for this instance
+    BOOL getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength);
+
+    //Modify the active set of parameters and limits for this instance
+    BOOL setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length);
+
+private:
+    int fd;
+    int wcFd;
+    int vfioContainer;
+    int vfioGroup;
+
+    //The three windows of the BAR, and how much of each is mapped
+    volatile uint8_t *input;
+    volatile uint8_t *output;
+    volatile uint8_t *registers;
+    size_t inputMapped;
+    size_t outputMapped;
+    size_t registersMapped;
+
+    uint32_t maxInputDataBytes;
+    uint32_t maxOutputDataBytes;
+
+    //The device is a file: raising run also wakes the emulator behind it
+    BOOL emulated;
+
+    BOOL openSysfs(const char *bdf, int bar, uint64_t *regionOffset, uint64_t *regionSize);
+    BOOL openVfio(const char *bdf, int bar, uint64_t *regionOffset, uint64_t *regionSize);
+    BOOL mapWindows(uint64_t regionOffset, uint64_t regionSize);
+
+    volatile uint32_t *reg(uint8_t regNumber)
+    {
+        return (volatile uint32_t *) (registers + 32 * (uint32_t) regNumber);
+    }
+};
+
+//A BAR-sized sparse file and a thread that acts as the device behind it, running the
+// SRV_SIRC test circuit: when run is raised, output[i] = input[i] * reg1 for reg0 bytes.
+//Lets LINUX_PCIE_SIRC be used with no hardware.
+//While idle the thread sleeps on the run register (a futex, so the host can be in
+// another process), and LINUX_PCIE_SIRC wakes it when it raises run.
+class LINUX_PCIE_EMULATOR {
+public:
+	// path: the file to use, NULL for an anonymous one (memfd)
+	//Check error code with getLastError() to make certain constructor
+	// succeeded fully.
+    LINUX_PCIE_EMULATOR(const char *path = NULL);
+    ~LINUX_PCIE_EMULATOR();
+
+    //The device to give LINUX_PCIE_SIRC
+    const char *getPath() { return devicePath; }
+
+    int8_t getLastError() { return lastError; }
+
+private:
+    int fd;
+    char devicePath[256];
+    volatile uint8_t *input;
+    volatile uint8_t *output;
+    volatile uint8_t *registers;
+    volatile BOOL stop;
+    pthread_t thread;
+    BOOL threadStarted;
+    int8_t lastError;
+
+    static void *deviceThread(void *lpParam);
+    void device();
+};
+
+#endif //DEFINELINUXPCIESIRCH
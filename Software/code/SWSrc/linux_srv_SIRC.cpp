@@ -0,0 +1,1170 @@
+// Title: LINUX_SRV_SIRC class definition
+//
+// Description: The SRV_SIRC software board on Linux, over a raw socket with epoll, one
+// session per host.  See linux_srv_SIRC.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#if !defined(_WIN32)
+
+#include "sirc_internal.h"
+#include <sched.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/filter.h>
+
+//With receive credits on, how long (msec) a response waits for the host to grant more
+// before the rest of it is dropped.  The host asks for what is missing again.
+#define CREDITTIMEOUT 250
+
+//How often (msec) a worker with responses waiting for credits looks for expired ones
+#define CREDITPOLL 10
+
+//Socket buffers, deep enough for a few batches from every host at 10Gb/s
+#define SOCKETBUFFERBYTES (4 * 1024 * 1024)
+
+//******These only change with the network protocol
+//This is the maximum packet size (entire packet including header)
+#define MAXPACKETSIZE 1514
+
+//This is the maximum packet payload size (entire packet minus header)
+#define MAXPACKETDATASIZE (MAXPACKETSIZE-14)
+
+//This should be the maximum packet data size minus 5 for the read command and start address
+#define MAXREADSIZE (MAXPACKETDATASIZE - 5)
+
+//Room for each received frame.  Anything longer is not ours and is dropped.
+#define RECEIVESIZE 2048
+
+//Buckets of the session hash, per worker
+#define SESSIONBUCKETS 4096
+
+#ifdef DEBUG
+#define PRINTF(x) printf x
+#else
+#define PRINTF(x)
+#endif
+
+//Which bucket a host's session is in
+static inline uint32_t sessionBucket(const uint8_t *hostMAC)
+{
+    uint32_t low = ((uint32_t) hostMAC[2] << 24) | ((uint32_t) hostMAC[3] << 16) |
+                   ((uint32_t) hostMAC[4] << 8) | hostMAC[5];
+
+    return ((low ^ ((uint32_t) hostMAC[1] << 5)) * 2654435761u) >> 20;
+}
+
+//PUBLIC FUNCTIONS
+//Constructor for the class
+//Return with an error code if anything goes wrong.
+LINUX_SRV_SIRC::LINUX_SRV_SIRC(const char *interfaceName, CIRCUIT circuit, void *context,
+                               const uint8_t *boardMAC, uint32_t workers, BOOL shared)
+{
+    lastError = 0;
+    this->circuit = circuit;
+    this->context = context;
+    this->shared = shared;
+    promiscuous = false;
+    stopEvent = -1;
+    stopping = false;
+    numWorkers = 0;
+    numGroups = 0;
+    sharedRegFile = NULL;
+    sharedInputBuf = NULL;
+    sharedOutputBuf = NULL;
+    maxInputDataBytes = LINUX_SRV_INPUT_BYTES;
+    maxOutputDataBytes = LINUX_SRV_OUTPUT_BYTES;
+    InitializeCriticalSection(&sharedLock);
+    InitializeCriticalSection(&groupLock);
+    memset(pool, 0, sizeof(pool));
+    for (uint32_t w = 0; w < LINUX_SRV_MAX_WORKERS; w++) {
+        pool[w].sock = -1;
+        pool[w].epoll = -1;
+    }
+
+    if ((interfaceName == NULL) || (circuit == NULL) || (workers < 1) || (workers > LINUX_SRV_MAX_WORKERS)) {
+        lastError = INVALIDLENGTH;
+        return;
+    }
+
+    //Which NIC, and what MAC address it has
+    ifindex = (int) if_nametoindex(interfaceName);
+    if (ifindex == 0) {
+        lastError = FAILVMNSDRIVERACTIVE;
+        return;
+    }
+    if (boardMAC) {
+        //Pretend to be a board with one of its own
+        memcpy(My_MACAddress, boardMAC, 6);
+        promiscuous = true;
+    } else {
+        struct ifreq request;
+        int sock = socket(AF_PACKET, SOCK_RAW, 0);
+
+        memset(&request, 0, sizeof(request));
+        snprintf(request.ifr_name, sizeof(request.ifr_name), "%s", interfaceName);
+        if ((sock < 0) || (ioctl(sock, SIOCGIFHWADDR, &request) != 0)) {
+            if (sock >= 0)
+                close(sock);
+            lastError = (sock < 0) ? FAILDRIVERPRESENT : FAILVMNSDRIVERMACADD;
+            return;
+        }
+        close(sock);
+        memcpy(My_MACAddress, request.ifr_hwaddr.sa_data, 6);
+    }
+
+    stopEvent = eventfd(0, EFD_NONBLOCK);
+    if (stopEvent < 0) {
+        lastError = FAILVMNSDRIVERCOMPLETION;
+        return;
+    }
+
+    if (shared) {
+        sharedRegFile = (uint32_t *) calloc(256, sizeof(uint32_t));
+        sharedInputBuf = (uint8_t *) calloc(maxInputDataBytes, sizeof(uint8_t));
+        sharedOutputBuf = (uint8_t *) calloc(maxOutputDataBytes, sizeof(uint8_t));
+        if (!sharedRegFile || !sharedInputBuf || !sharedOutputBuf) {
+            lastError = FAILMEMALLOC;
+            return;
+        }
+    }
+
+    numWorkers = workers;
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        WORKER *worker = &pool[w];
+
+        worker->server = this;
+        worker->index = w;
+        worker->sessions = (SESSION *) calloc(LINUX_SRV_MAX_SESSIONS, sizeof(SESSION));
+        worker->buckets = (int32_t *) malloc(SESSIONBUCKETS * sizeof(int32_t));
+        worker->receiveBuffers = (uint8_t *) malloc(LINUX_SRV_BATCH * RECEIVESIZE);
+        worker->sendBuffers = (uint8_t *) malloc(LINUX_SRV_BATCH * MAXPACKETSIZE);
+        if (!worker->sessions || !worker->buckets || !worker->receiveBuffers || !worker->sendBuffers) {
+            lastError = FAILMEMALLOC;
+            return;
+        }
+        for (uint32_t b = 0; b < SESSIONBUCKETS; b++)
+            worker->buckets[b] = -1;
+
+        //Each batch entry always uses the same buffer
+        for (uint32_t i = 0; i < LINUX_SRV_BATCH; i++) {
+            worker->receiveVectors[i].iov_base = worker->receiveBuffers + i * RECEIVESIZE;
+            worker->receiveVectors[i].iov_len = RECEIVESIZE;
+            worker->receiveHeaders[i].msg_hdr.msg_iov = &worker->receiveVectors[i];
+            worker->receiveHeaders[i].msg_hdr.msg_iovlen = 1;
+            worker->receiveHeaders[i].msg_hdr.msg_name = &worker->receiveFrom[i];
+
+            worker->sendVectors[i].iov_base = worker->sendBuffers + i * MAXPACKETSIZE;
+            worker->sendHeaders[i].msg_hdr.msg_iov = &worker->sendVectors[i];
+            worker->sendHeaders[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        if (!openSocket(worker))
+            return;
+    }
+
+    printf("My MAC Address is %02x", My_MACAddress[0]);
+    for (int i = 1; i < 6; i++)
+        printf(":%02x", My_MACAddress[i]);
+    printf("\n");
+}
+
+LINUX_SRV_SIRC::~LINUX_SRV_SIRC()
+{
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        WORKER *worker = &pool[w];
+
+        if (worker->sessions && !shared) {
+            for (uint32_t s = 0; s < worker->numSessions; s++) {
+                free(worker->sessions[s].regFileP);
+                free(worker->sessions[s].inputBufP);
+                free(worker->sessions[s].outputBufP);
+            }
+        }
+        if (worker->epoll >= 0)
+            close(worker->epoll);
+        if (worker->sock >= 0)
+            close(worker->sock);
+        free(worker->sessions);
+        free(worker->buckets);
+        free(worker->receiveBuffers);
+        free(worker->sendBuffers);
+    }
+    if (stopEvent >= 0)
+        close(stopEvent);
+    free(sharedRegFile);
+    free(sharedInputBuf);
+    free(sharedOutputBuf);
+    DeleteCriticalSection(&sharedLock);
+    DeleteCriticalSection(&groupLock);
+}
+
+//Serve hosts until stop() is called or the circuit returns false
+BOOL LINUX_SRV_SIRC::serve()
+{
+    if (lastError != 0)
+        return false;
+
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        if (pthread_create(&pool[w].thread, NULL, workerThread, &pool[w]) != 0) {
+            lastError = FAILVMNSDRIVERCOMPLETION;
+            stop();
+            break;
+        }
+        pool[w].threadStarted = true;
+    }
+
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        if (!pool[w].threadStarted)
+            continue;
+        pthread_join(pool[w].thread, NULL);
+        pool[w].threadStarted = false;
+        if ((lastError == 0) && (pool[w].lastError != 0))
+            lastError = pool[w].lastError;
+    }
+    return (lastError == 0);
+}
+
+//Make serve() return, from any thread
+void LINUX_SRV_SIRC::stop()
+{
+    uint64_t one = 1;
+
+    stopping = true;
+    //Every worker's epoll has it, and it stays readable
+    if (write(stopEvent, &one, sizeof(one)) != sizeof(one)) {
+        PRINTF(("Stop not signaled!\n"));
+    }
+}
+
+//Totals since the constructor, over all workers
+void LINUX_SRV_SIRC::getCounters(uint64_t *framesIn, uint64_t *bytesIn, uint64_t *framesOut, uint64_t *bytesOut,
+                                 uint32_t *sessions)
+{
+    *framesIn = *bytesIn = *framesOut = *bytesOut = 0;
+    *sessions = 0;
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        *framesIn += pool[w].framesIn;
+        *bytesIn += pool[w].bytesIn;
+        *framesOut += pool[w].framesOut;
+        *bytesOut += pool[w].bytesOut;
+        *sessions += pool[w].numSessions;
+    }
+}
+
+//PRIVATE FUNCTIONS
+
+//A raw socket on our NIC that takes in SIRC frames only, and the worker's epoll over it
+BOOL LINUX_SRV_SIRC::openSocket(WORKER *worker)
+{
+    struct sockaddr_ll address;
+    int value;
+
+    worker->sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (worker->sock < 0) {
+        lastError = FAILDRIVERPRESENT;
+        return false;
+    }
+
+    //SIRC frames carry a length where others have an ethertype, leave the rest in the kernel
+    static struct sock_filter sircOnly[] = {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 1536, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, RECEIVESIZE),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog filter = { sizeof(sircOnly) / sizeof(sircOnly[0]), sircOnly };
+    if (setsockopt(worker->sock, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) != 0) {
+        lastError = FAILVMNSDRIVERFILTER;
+        return false;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons(ETH_P_ALL);
+    address.sll_ifindex = ifindex;
+    if (bind(worker->sock, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        lastError = FAILVMNSDRIVERACTIVE;
+        return false;
+    }
+
+    //Nice to have, not needed: bigger buffers, no copy of what we send coming back in,
+    // and frames handed straight to the NIC rather than through the queueing discipline
+    value = SOCKETBUFFERBYTES;
+    (void) setsockopt(worker->sock, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value));
+    (void) setsockopt(worker->sock, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+    value = 1;
+#if defined(PACKET_IGNORE_OUTGOING)
+    (void) setsockopt(worker->sock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &value, sizeof(value));
+#endif
+    (void) setsockopt(worker->sock, SOL_PACKET, PACKET_QDISC_BYPASS, &value, sizeof(value));
+
+    //As a board of our own, frames for it are not for the NIC
+    if (promiscuous) {
+        struct packet_mreq membership;
+
+        memset(&membership, 0, sizeof(membership));
+        membership.mr_ifindex = ifindex;
+        membership.mr_type = PACKET_MR_PROMISC;
+        if (setsockopt(worker->sock, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+            lastError = FAILVMNSDRIVERFILTER;
+            return false;
+        }
+    }
+
+    //Each host to one worker, always the same
+    if ((numWorkers > 1) && !joinFanout(worker))
+        return false;
+
+    struct epoll_event event;
+    worker->epoll = epoll_create1(0);
+    if (worker->epoll < 0) {
+        lastError = FAILVMNSDRIVERCOMPLETION;
+        return false;
+    }
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = worker->sock;
+    if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, worker->sock, &event) != 0) {
+        lastError = FAILVMNSDRIVERCOMPLETION;
+        return false;
+    }
+    event.data.fd = stopEvent;
+    if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, stopEvent, &event) != 0) {
+        lastError = FAILVMNSDRIVERCOMPLETION;
+        return false;
+    }
+    return true;
+}
+
+//Put the worker's socket in the server's fanout group, which hands a frame to the
+// worker its source MAC address picks.  Keeps each host on one worker, so sessions
+// need no locks.
+BOOL LINUX_SRV_SIRC::joinFanout(WORKER *worker)
+{
+    //A = the last 2 bytes of the source MAC, mod workers.  Link layer relative, as the
+    // kernel may have moved past the Ethernet header by then.
+    struct sock_filter pickWorker[] = {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, (uint32_t) (SKF_LL_OFF + 10)),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, numWorkers),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog program = { sizeof(pickWorker) / sizeof(pickWorker[0]), pickWorker };
+    //Unique on the NIC, the same for all our workers
+    int group = (getpid() & 0xFFFF) | (PACKET_FANOUT_CBPF << 16);
+
+    if ((setsockopt(worker->sock, SOL_PACKET, PACKET_FANOUT, &group, sizeof(group)) != 0) ||
+        (setsockopt(worker->sock, SOL_PACKET, PACKET_FANOUT_DATA, &program, sizeof(program)) != 0)) {
+        lastError = FAILVMNSDRIVERFILTER;
+        return false;
+    }
+    return true;
+}
+
+//Let frames for groupMAC in, or stop them, on every worker's socket
+BOOL LINUX_SRV_SIRC::setGroup(const uint8_t *groupMAC, BOOL join)
+{
+    struct packet_mreq membership;
+
+    memset(&membership, 0, sizeof(membership));
+    membership.mr_ifindex = ifindex;
+    membership.mr_type = PACKET_MR_MULTICAST;
+    membership.mr_alen = 6;
+    memcpy(membership.mr_address, groupMAC, 6);
+
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        if ((setsockopt(pool[w].sock, SOL_PACKET, join ? PACKET_ADD_MEMBERSHIP : PACKET_DROP_MEMBERSHIP,
+                        &membership, sizeof(membership)) != 0) && join)
+            return false;
+    }
+    return true;
+}
+
+void *LINUX_SRV_SIRC::workerThread(void *lpParam)
+{
+    WORKER *worker = (WORKER *) lpParam;
+
+    if (!worker->server->work(worker))
+        worker->server->stop();
+    return NULL;
+}
+
+//A worker's event loop: take in what is there, answer it all, send the answers in one go
+BOOL LINUX_SRV_SIRC::work(WORKER *worker)
+{
+    struct epoll_event events[2];
+    uint32_t received;
+
+    worker->lastError = 0;
+    while (!stopping) {
+        //Only a response waiting for credits can time out
+        int ready = epoll_wait(worker->epoll, events, 2, worker->waiting ? CREDITPOLL : -1);
+
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            worker->lastError = FAILVMNSDRIVERCOMPLETION;
+            return false;
+        }
+
+        for (int e = 0; e < ready; e++) {
+            if (events[e].data.fd != worker->sock)
+                return true;        //stopEvent
+        }
+
+        if (ready > 0) {
+            //Until the socket is empty
+            do {
+                if (!receiveBatch(worker, &received))
+                    return false;
+
+                for (uint32_t i = 0; i < received; i++) {
+                    struct mmsghdr *header = &worker->receiveHeaders[i];
+
+                    //Our own frames coming back, on kernels that show them
+                    if ((worker->receiveFrom[i].sll_pkttype == PACKET_OUTGOING) ||
+                        (header->msg_hdr.msg_flags & MSG_TRUNC))
+                        continue;
+
+                    worker->framesIn++;
+                    worker->bytesIn += header->msg_len;
+
+                    //With one set for everybody, a frame at a time
+                    if (shared)
+                        EnterCriticalSection(&sharedLock);
+                    BOOL ok = processPacket(worker, (uint8_t *) worker->receiveVectors[i].iov_base, header->msg_len);
+                    if (shared)
+                        LeaveCriticalSection(&sharedLock);
+                    if (!ok)
+                        return false;
+                }
+
+                if (!flush(worker))
+                    return false;
+            } while (received == LINUX_SRV_BATCH);
+        }
+
+        if (worker->waiting && !checkExpired(worker))
+            return false;
+    }
+    return true;
+}
+
+//Whatever frames are waiting, up to a batch
+BOOL LINUX_SRV_SIRC::receiveBatch(WORKER *worker, uint32_t *received)
+{
+    for (uint32_t i = 0; i < LINUX_SRV_BATCH; i++)
+        worker->receiveHeaders[i].msg_hdr.msg_namelen = sizeof(worker->receiveFrom[i]);
+
+    int count = recvmmsg(worker->sock, worker->receiveHeaders, LINUX_SRV_BATCH, MSG_DONTWAIT, NULL);
+    if (count < 0) {
+        *received = 0;
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+            return true;
+        worker->lastError = FAILVMNSCOMPLETION;
+        return false;
+    }
+    *received = (uint32_t) count;
+    return true;
+}
+
+//Send every frame composed since the last flush.  Blocks while the NIC is behind.
+BOOL LINUX_SRV_SIRC::flush(WORKER *worker)
+{
+    uint32_t sent = 0;
+
+    while (sent < worker->numSends) {
+        int count = sendmmsg(worker->sock, worker->sendHeaders + sent, worker->numSends - sent, 0);
+
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            //Device queue full
+            if ((errno == ENOBUFS) || (errno == EAGAIN)) {
+                sched_yield();
+                continue;
+            }
+            PRINTF(("Frames not sent!\n"));
+            worker->numSends = 0;
+            worker->lastError = FAILVMNSCOMPLETION;
+            return false;
+        }
+        for (int i = 0; i < count; i++)
+            worker->bytesOut += worker->sendHeaders[sent + i].msg_len;
+        worker->framesOut += count;
+        sent += count;
+    }
+    worker->numSends = 0;
+    return true;
+}
+
+//Drop the rest of responses that waited too long for credits, the hosts will ask again
+BOOL LINUX_SRV_SIRC::checkExpired(WORKER *worker)
+{
+    DWORD now = GetTickCount();
+
+    for (uint32_t s = 0; (s < worker->numSessions) && worker->waiting; s++) {
+        RESPONSE *response = &worker->sessions[s].response;
+
+        if (response->parked && ((int32_t) (response->expires - now) <= 0)) {
+            PRINTF(("No credits from the host, response cut short\n"));
+            response->parked = false;
+            response->command = 0;
+            worker->waiting--;
+        }
+    }
+    return true;
+}
+
+//The session of hostMAC, a new one if we have not heard from it.
+//Returns NULL with an error code if it cannot have one.
+LINUX_SRV_SIRC::SESSION *LINUX_SRV_SIRC::findSession(WORKER *worker, const uint8_t *hostMAC)
+{
+    uint32_t bucket = sessionBucket(hostMAC);
+    SESSION *session;
+    int32_t s;
+
+    for (s = worker->buckets[bucket]; s >= 0; s = worker->sessions[s].next) {
+        if (memcmp(worker->sessions[s].hostMAC, hostMAC, 6) == 0)
+            return &worker->sessions[s];
+    }
+
+    if (worker->numSessions < LINUX_SRV_MAX_SESSIONS) {
+        s = (int32_t) worker->numSessions;
+        session = &worker->sessions[s];
+        if (!startSession(session, hostMAC)) {
+            worker->lastError = FAILMEMALLOC;
+            return NULL;
+        }
+        worker->numSessions++;
+    } else {
+        //All taken, the host heard from longest ago makes room
+        DWORD now = GetTickCount();
+        s = 0;
+        for (uint32_t o = 1; o < worker->numSessions; o++) {
+            if ((now - worker->sessions[o].lastHeard) > (now - worker->sessions[s].lastHeard))
+                s = (int32_t) o;
+        }
+        session = &worker->sessions[s];
+
+        int32_t *link = &worker->buckets[sessionBucket(session->hostMAC)];
+        while (*link != s)
+            link = &worker->sessions[*link].next;
+        *link = session->next;
+        if (session->response.parked)
+            worker->waiting--;
+
+        if (!startSession(session, hostMAC)) {
+            worker->lastError = FAILMEMALLOC;
+            return NULL;
+        }
+    }
+
+    session->next = worker->buckets[bucket];
+    worker->buckets[bucket] = s;
+    return session;
+}
+
+//Set up a session for hostMAC, as SRV_SIRC is before any host talks to it.
+//A session taken over keeps its buffers, with the register file cleared.
+BOOL LINUX_SRV_SIRC::startSession(SESSION *session, const uint8_t *hostMAC)
+{
+    memcpy(session->hostMAC, hostMAC, 6);
+    session->lastHeard = GetTickCount();
+    session->outputLength = 0;
+
+    if (shared) {
+        session->regFileP = sharedRegFile;
+        session->inputBufP = sharedInputBuf;
+        session->outputBufP = sharedOutputBuf;
+    } else {
+        if (session->regFileP == NULL) {
+            session->regFileP = (uint32_t *) malloc(256 * sizeof(uint32_t));
+            session->inputBufP = (uint8_t *) calloc(maxInputDataBytes, sizeof(uint8_t));
+            session->outputBufP = (uint8_t *) calloc(maxOutputDataBytes, sizeof(uint8_t));
+        }
+        if (!session->regFileP || !session->inputBufP || !session->outputBufP)
+            return false;
+        memset(session->regFileP, 0, 256 * sizeof(uint32_t));
+    }
+
+    //Plain frames, no parity, no credits until the host asks
+    session->compression = 0;
+    session->fecGroup = 0;
+    session->creditFlow = false;
+    session->creditsLeft = 0;
+    memset(&session->response, 0, sizeof(session->response));
+    return true;
+}
+
+//This function will return true if the frame was processed successfully and the ack
+//	was composed successfully
+BOOL LINUX_SRV_SIRC::processPacket(WORKER *worker, uint8_t *message, uint32_t frameLength)
+{
+    uint16_t length;
+    SESSION *session;
+
+    if (frameLength <= SircWire::Ethernet::headerLength)
+        return true;
+
+    //Make sure it is directed at specifically us, not just a broadcast packet.
+    //Groups we joined can only write.
+    if (memcmp(message, My_MACAddress, 6) != 0) {
+        uint8_t command = message[SircWire::Ethernet::headerLength];
+        if (((command != SircWire::Write::command) && (command != SircWire::RegWrite::command)) || !inGroup(message))
+            return true;
+    }
+
+    //Padding can make the frame longer, never shorter
+    length = SircWire::Ethernet::Length::get(message);
+    if ((length == 0) || (length > frameLength - SircWire::Ethernet::headerLength)) {
+        return sendErrorMessage(worker, RECEIVE_ERROR_PACKET_LENGTH, message);
+    }
+
+    session = findSession(worker, message + 6);
+    if (session == NULL)
+        return false;
+    session->lastHeard = GetTickCount();
+
+    switch (message[SircWire::Ethernet::headerLength]) {
+        case 'r':
+        case 'q':
+            return checkReadPacket(worker, session, message);
+        case 'w':
+            return checkWritePacket(worker, session, message);
+        case 'z':
+            return checkCodedWritePacket(worker, session, message);
+        case 'n':
+            return checkNegotiatePacket(worker, session, message);
+        case 'f':
+            return checkFecSetupPacket(worker, session, message);
+        case 'c':
+            return checkCreditPacket(worker, session, message);
+        case 'y':
+            return checkRegReadPacket(worker, session, message);
+        case 'k':
+            return checkRegWritePacket(worker, session, message);
+        case 'g':
+            return checkWriteAndRunPacket(worker, session, message);
+        case 'm':
+            //Is this reset command the right length?
+            if (length == SircWire::Reset::headerLength)
+                return sendEcho(worker, message, SircWire::Reset::headerLength);
+            return sendErrorMessage(worker, RECEIVE_ERROR_RESET_LENGTH, message);
+        case 'j':
+            return checkJoinPacket(worker, message);
+        case 'h':
+            return checkChecksumPacket(worker, session, message);
+        default:
+            break;
+    }
+    return true;
+}
+
+//Start a frame to destinationMAC with a payload of length bytes, in the next free send slot.
+//Returns the payload, NULL with an error code if the slots could not be flushed.
+uint8_t *LINUX_SRV_SIRC::allocateAndFillPacket(WORKER *worker, const uint8_t *destinationMAC, uint16_t length)
+{
+    uint8_t *packet;
+
+    if ((worker->numSends == LINUX_SRV_BATCH) && !flush(worker))
+        return NULL;
+
+    assert(length <= MAXPACKETDATASIZE);
+
+    packet = (uint8_t *) worker->sendVectors[worker->numSends].iov_base;
+    worker->sendVectors[worker->numSends].iov_len = length + SircWire::Ethernet::headerLength;
+    worker->numSends++;
+
+    //Set the destination and source addresses of the packet (0-5 and 6-11)
+    memcpy(packet, destinationMAC, 6);
+    memcpy(packet + 6, My_MACAddress, 6);
+
+    //The payload length field does not include the length of the header
+    SircWire::Ethernet::Length::put(packet, length);
+
+    return SircWire::Ethernet::payload(packet);
+}
+
+//Send a message in response to the provided source message with the included error number
+BOOL LINUX_SRV_SIRC::sendErrorMessage(WORKER *worker, int8_t errorNumber, uint8_t *sourceMessage)
+{
+    uint8_t *frame = allocateAndFillPacket(worker, sourceMessage + 6, SircWire::Error::headerLength);
+
+    if (frame == NULL)
+        return false;
+    SircWire::Error::start(frame);
+    SircWire::Error::Code::put(frame, errorNumber);
+    return true;
+}
+
+//Ack by sending back the first length bytes of the command
+BOOL LINUX_SRV_SIRC::sendEcho(WORKER *worker, uint8_t *sourceMessage, uint16_t length)
+{
+    uint8_t *frame = allocateAndFillPacket(worker, sourceMessage + 6, length);
+
+    if (frame == NULL)
+        return false;
+    memcpy(frame, SircWire::Ethernet::payload(sourceMessage), length);
+    return true;
+}
+
+BOOL LINUX_SRV_SIRC::checkRegWritePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+
+    //Is this reg write command the wrong length?
+    if (SircWire::Ethernet::Length::get(sourceMessage) != SircWire::RegWrite::headerLength)
+        return sendErrorMessage(worker, RECEIVE_ERROR_REG32_WRITE_LENGTH, sourceMessage);
+
+    uint8_t regAddress = SircWire::RegWrite::Register::get(frame);
+    uint32_t value = SircWire::RegWrite::Value::get(frame);
+
+    session->regFileP[regAddress] = value;
+
+    //Ack, then run if this started the circuit, as SRV_SIRC does
+    if (!sendEcho(worker, sourceMessage, SircWire::RegWrite::headerLength))
+        return false;
+    if ((regAddress == 255) && (value == 1))
+        return run(worker, session, false);
+    return true;
+}
+
+BOOL LINUX_SRV_SIRC::checkRegReadPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame;
+
+    //Is this reg read command the wrong length?
+    if (SircWire::Ethernet::Length::get(sourceMessage) != SircWire::RegRead::headerLength)
+        return sendErrorMessage(worker, RECEIVE_ERROR_REG32_READ_LENGTH, sourceMessage);
+
+    uint8_t regAddress = SircWire::RegRead::Register::get(SircWire::Ethernet::payload(sourceMessage));
+
+    frame = allocateAndFillPacket(worker, sourceMessage + 6, SircWire::RegReadResponse::headerLength);
+    if (frame == NULL)
+        return false;
+    SircWire::RegReadResponse::start(frame);
+    SircWire::RegReadResponse::Register::put(frame, regAddress);
+    SircWire::RegReadResponse::Value::put(frame, session->regFileP[regAddress]);
+    return true;
+}
+
+BOOL LINUX_SRV_SIRC::checkNegotiatePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame;
+
+    //Is this negotiate command the wrong length?
+    if (SircWire::Ethernet::Length::get(sourceMessage) != SircWire::Negotiate::headerLength)
+        return sendErrorMessage(worker, RECEIVE_ERROR_NEGOTIATE_LENGTH, sourceMessage);
+
+    //We know all there is so far
+    uint32_t wanted = SircWire::Negotiate::Mask::get(SircWire::Ethernet::payload(sourceMessage));
+    session->compression = wanted & (SIRC_COMPRESS_WRITES | SIRC_COMPRESS_READS);
+
+    frame = allocateAndFillPacket(worker, sourceMessage + 6, SircWire::Negotiate::headerLength);
+    if (frame == NULL)
+        return false;
+    SircWire::Negotiate::start(frame);
+    SircWire::Negotiate::Mask::put(frame, session->compression);
+    return true;
+}
+
+//Start or stop sending parity frames (sirc_fec.h), and tell the host which group size we use
+BOOL LINUX_SRV_SIRC::checkFecSetupPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+
+    //Is this FEC setup command the wrong length?
+    if (!SircWire::FecSetup::valid(frame, SircWire::Ethernet::Length::get(sourceMessage)))
+        return sendErrorMessage(worker, RECEIVE_ERROR_NEGOTIATE_LENGTH, sourceMessage);
+
+    //A single parity frame per group, however big the host wants it
+    session->fecGroup = min((uint32_t) SircWire::FecSetup::Group::get(frame), (uint32_t) SIRC_FEC_MAXGROUP);
+
+    frame = allocateAndFillPacket(worker, sourceMessage + 6, SircWire::FecSetup::headerLength);
+    if (frame == NULL)
+        return false;
+    SircWire::FecSetup::start(frame);
+    SircWire::FecSetup::Group::put(frame, (uint8_t) session->fecGroup);
+    return true;
+}
+
+//Turn receive credits on or off and tell the host ('c' + on), or take more of them
+// from the host ('c' + start + credits, not answered) and go on with a parked response
+BOOL LINUX_SRV_SIRC::checkCreditPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+    uint16_t length = SircWire::Ethernet::Length::get(sourceMessage);
+
+    if (SircWire::Credit::valid(frame, length)) {
+        if (SircWire::Credit::Start::get(frame))
+            session->creditsLeft = 0;
+        session->creditsLeft += SircWire::Credit::Credits::get(frame);
+
+        if (!session->response.parked)
+            return true;
+        session->response.parked = false;
+        worker->waiting--;
+        return continueResponse(worker, session);
+    }
+
+    //Is this credit setup command the wrong length?
+    if (!SircWire::CreditSetup::valid(frame, length))
+        return sendErrorMessage(worker, RECEIVE_ERROR_NEGOTIATE_LENGTH, sourceMessage);
+
+    //Until the first read or write & run says otherwise, we can send nothing
+    session->creditFlow = (SircWire::CreditSetup::On::get(frame) != 0);
+    session->creditsLeft = 0;
+
+    frame = allocateAndFillPacket(worker, sourceMessage + 6, SircWire::CreditSetup::headerLength);
+    if (frame == NULL)
+        return false;
+    SircWire::CreditSetup::start(frame);
+    SircWire::CreditSetup::On::put(frame, session->creditFlow ? 1 : 0);
+    return true;
+}
+
+//Send the host the CRC32C (sirc_crc.h) of part of the input or output buffer
+BOOL LINUX_SRV_SIRC::checkChecksumPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+    uint32_t startAddress, length, bufferBytes;
+    uint8_t *buffer;
+
+    //Is this checksum command the wrong length?
+    if (!SircWire::Checksum::valid(frame, SircWire::Ethernet::Length::get(sourceMessage)))
+        return sendErrorMessage(worker, RECEIVE_ERROR_CHECKSUM, sourceMessage);
+
+    startAddress = SircWire::Checksum::Address::get(frame);
+    length = SircWire::Checksum::Length::get(frame);
+    if (SircWire::Checksum::Buffer::get(frame) == SircWire::Checksum::output) {
+        buffer = session->outputBufP;
+        bufferBytes = maxOutputDataBytes;
+    } else {
+        buffer = session->inputBufP;
+        bufferBytes = maxInputDataBytes;
+    }
+
+    //..or not within the buffer?
+    if ((startAddress > bufferBytes) || (length > bufferBytes - startAddress))
+        return sendErrorMessage(worker, RECEIVE_ERROR_CHECKSUM, sourceMessage);
+
+    //The command echoed + 4 bytes CRC
+    uint8_t *response = allocateAndFillPacket(worker, sourceMessage + 6, SircWire::ChecksumResponse::headerLength);
+    if (response == NULL)
+        return false;
+    memcpy(response, frame, SircWire::Checksum::headerLength);
+    SircWire::ChecksumResponse::Crc::put(response, sircCrc32c(0, buffer + startAddress, length));
+    return true;
+}
+
+//Join or leave a multicast group, and ack it.
+//A host that gets no ack (we are in too many groups) sends us everything by unicast.
+BOOL LINUX_SRV_SIRC::checkJoinPacket(WORKER *worker, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+    uint8_t *group = SircWire::Join::group(frame);
+
+    //Is this join command the wrong length, or not about a group address?
+    if (!SircWire::Join::valid(frame, SircWire::Ethernet::Length::get(sourceMessage)) || ((group[0] & 1) == 0))
+        return sendErrorMessage(worker, RECEIVE_ERROR_JOIN, sourceMessage);
+
+    //Groups are the server's, whichever worker the host came in on
+    EnterCriticalSection(&groupLock);
+    if (SircWire::Join::Op::get(frame) == SircWire::Join::leave) {
+        for (uint32_t g = 0; g < numGroups; g++) {
+            if (memcmp(groups[g], group, 6) == 0) {
+                memcpy(groups[g], groups[--numGroups], 6);
+                if (!promiscuous)
+                    (void) setGroup(group, false);
+                break;
+            }
+        }
+    } else if (!inGroup(group)) {
+        if (numGroups == LINUX_SRV_MAX_GROUPS) {
+            LeaveCriticalSection(&groupLock);
+            PRINTF(("Too many groups!\n"));
+            return true;
+        }
+        //Group frames are not for our MAC, the NIC must let them in
+        if (!promiscuous && !setGroup(group, true)) {
+            LeaveCriticalSection(&groupLock);
+            PRINTF(("Cannot see multicast frames!\n"));
+            return true;
+        }
+        memcpy(groups[numGroups++], group, 6);
+    }
+    LeaveCriticalSection(&groupLock);
+
+    return sendEcho(worker, sourceMessage, SircWire::Join::headerLength);
+}
+
+//Did we join the group at groupMAC?
+BOOL LINUX_SRV_SIRC::inGroup(const uint8_t *groupMAC)
+{
+    BOOL found = false;
+
+    EnterCriticalSection(&groupLock);
+    for (uint32_t g = 0; (g < numGroups) && !found; g++)
+        found = (memcmp(groups[g], groupMAC, 6) == 0);
+    LeaveCriticalSection(&groupLock);
+    return found;
+}
+
+BOOL LINUX_SRV_SIRC::checkWritePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+    uint16_t packetLength = SircWire::Ethernet::Length::get(sourceMessage);
+
+    //Is this write command the wrong length, or past the buffer?
+    if (!SircWire::Write::valid(frame, packetLength))
+        return sendErrorMessage(worker, RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
+
+    uint32_t startAddress = SircWire::Write::Address::get(frame);
+    uint32_t writeLength = SircWire::Write::Length::get(frame);
+
+    if ((SircWire::Write::dataLength(packetLength) != writeLength) ||
+        (startAddress > maxInputDataBytes) || (writeLength > maxInputDataBytes - startAddress))
+        return sendErrorMessage(worker, RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
+
+    //Perform the write
+    memcpy(session->inputBufP + startAddress, SircWire::Write::data(frame), writeLength);
+
+    //Ack by echoing the write header
+    return sendEcho(worker, sourceMessage, SircWire::Write::headerLength);
+}
+
+BOOL LINUX_SRV_SIRC::checkCodedWritePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+    uint16_t packetLength = SircWire::Ethernet::Length::get(sourceMessage);
+
+    //Is this write command the wrong length?
+    if (!SircWire::CodedWrite::valid(frame, packetLength))
+        return sendErrorMessage(worker, RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
+
+    uint32_t startAddress = SircWire::CodedWrite::Address::get(frame);
+    //This is the length after expansion
+    uint32_t writeLength = SircWire::CodedWrite::Length::get(frame);
+
+    if ((startAddress > maxInputDataBytes) || (writeLength > maxInputDataBytes - startAddress))
+        return sendErrorMessage(worker, RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
+
+    if (sircRleDecodedLength(SircWire::CodedWrite::data(frame), SircWire::CodedWrite::dataLength(packetLength)) != writeLength)
+        return sendErrorMessage(worker, RECEIVE_ERROR_CODED_WRITE, sourceMessage);
+
+    //Perform the write
+    sircRleDecode(SircWire::CodedWrite::data(frame), SircWire::CodedWrite::dataLength(packetLength),
+                  session->inputBufP + startAddress, writeLength);
+
+    //Ack the same as for 'w'
+    return sendEcho(worker, sourceMessage, SircWire::Write::headerLength);
+}
+
+BOOL LINUX_SRV_SIRC::checkWriteAndRunPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+    uint16_t packetLength = SircWire::Ethernet::Length::get(sourceMessage);
+
+    //Is this write command the wrong length?
+    if (!SircWire::WriteAndRun::valid(frame, packetLength))
+        return sendErrorMessage(worker, RECEIVE_ERROR_WRITE_AND_EXECUTE_LENGTH, sourceMessage);
+
+    uint32_t startAddress = SircWire::WriteAndRun::Address::get(frame);
+    uint32_t writeLength = SircWire::WriteAndRun::Length::get(frame);
+
+    if ((SircWire::WriteAndRun::dataLength(packetLength) != writeLength) ||
+        (startAddress > maxInputDataBytes) || (writeLength > maxInputDataBytes - startAddress))
+        return sendErrorMessage(worker, RECEIVE_ERROR_WRITE_AND_EXECUTE_LENGTH, sourceMessage);
+
+    //Perform the write
+    memcpy(session->inputBufP + startAddress, SircWire::WriteAndRun::data(frame), writeLength);
+
+    //There is no ack, the readback is the ack
+    session->regFileP[255] = 1;
+    return run(worker, session, true);
+}
+
+BOOL LINUX_SRV_SIRC::checkReadPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage)
+{
+    uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+    uint16_t packetLength = SircWire::Ethernet::Length::get(sourceMessage);
+
+    //With credits on it may say how many frames the host can take, see SRV_SIRC::checkReadPacket
+    if (session->creditFlow && (packetLength == SircWire::CreditRead::headerLength)) {
+        uint32_t credits = SircWire::CreditRead::Credits::get(frame);
+        if (credits != SircWire::CreditRead::keep)
+            session->creditsLeft = credits;
+    } else if (packetLength != SircWire::Read::headerLength) {
+        return sendErrorMessage(worker, RECEIVE_ERROR_READ_LENGTH, sourceMessage);
+    }
+
+    uint32_t startAddress = SircWire::Read::Address::get(frame);
+    uint32_t readLength = SircWire::Read::Length::get(frame);
+
+    if ((startAddress > maxOutputDataBytes) || (readLength > maxOutputDataBytes - startAddress))
+        return sendErrorMessage(worker, RECEIVE_ERROR_READ_LENGTH, sourceMessage);
+
+    //Send the appropriate read values back
+    return startResponse(worker, session, frame[0], startAddress, readLength);
+}
+
+//Run the circuit for a session, lower the run signal and, for a write & run, send the
+// output back
+BOOL LINUX_SRV_SIRC::run(WORKER *worker, SESSION *session, BOOL readBack)
+{
+    if (!circuit(session->regFileP, session->inputBufP, session->outputBufP, &session->outputLength, context))
+        stop();
+
+    session->regFileP[255] = 0;
+
+    if (!readBack)
+        return true;
+    return startResponse(worker, session, SircWire::WriteAndRun::command, 0,
+                         min(session->outputLength, maxOutputDataBytes));
+}
+
+//Answer a read ('r' or 'q') or a write & run ('g') with length bytes of output at
+// address.  A response the host has not yet taken all of is dropped, the host has moved on.
+BOOL LINUX_SRV_SIRC::startResponse(WORKER *worker, SESSION *session, uint8_t command, uint32_t address, uint32_t length)
+{
+    RESPONSE *response = &session->response;
+
+    if (response->parked)
+        worker->waiting--;
+    response->command = command;
+    response->address = address;
+    response->remaining = length;
+    response->parked = false;
+
+    if (session->fecGroup)
+        sircFecStart(&session->fec);
+
+    return continueResponse(worker, session);
+}
+
+//Send what the host has credits for of the session's response, the rest when more come in
+BOOL LINUX_SRV_SIRC::continueResponse(WORKER *worker, SESSION *session)
+{
+    RESPONSE *response = &session->response;
+    SIRC_FEC_GROUP *fec = &session->fec;
+
+    while (response->command != 0) {
+        //A group is complete, or the response
+        BOOL parityDue = session->fecGroup && (fec->frames != 0) &&
+                         ((fec->frames == session->fecGroup) || (response->remaining == 0));
+
+        if (!parityDue && (response->remaining == 0)) {
+            response->command = 0;
+            break;
+        }
+
+        //Out of credits, the rest waits for more or for the timeout
+        if (session->creditFlow) {
+            if (session->creditsLeft == 0) {
+                response->parked = true;
+                response->expires = GetTickCount() + CREDITTIMEOUT;
+                worker->waiting++;
+                return true;
+            }
+            session->creditsLeft--;
+        }
+
+        if (parityDue ? !sendParity(worker, session) : !sendResponseFrame(worker, session))
+            return false;
+    }
+    return true;
+}
+
+//The next frame of the session's response, coded if the host takes that and it carries more
+BOOL LINUX_SRV_SIRC::sendResponseFrame(WORKER *worker, SESSION *session)
+{
+    RESPONSE *response = &session->response;
+    BOOL readBack = (response->command == SircWire::WriteAndRun::command);
+    uint8_t *source = session->outputBufP + response->address;
+    uint8_t *frame;
+    //Room for the parity frame header, if there is one, and a readback's remaining count
+    uint32_t plainMax = MAXREADSIZE - (session->fecGroup ? SIRC_FEC_OVERHEAD : 0) - (readBack ? 4 : 0);
+    uint32_t codedMax = MAXPACKETDATASIZE - (session->fecGroup ? SIRC_FEC_OVERHEAD : 0) -
+                        (readBack ? (uint32_t) SircWire::CodedReadBack::headerLength : (uint32_t) SircWire::CodedReadResponse::headerLength);
+    uint32_t currLength = min(response->remaining, plainMax);
+    uint32_t codedLength = 0;
+
+    if (readBack ? ((session->compression & SIRC_COMPRESS_READS) != 0) : (response->command == SircWire::CodedRead::command))
+        codedLength = sircRleEncodeFrame(source, response->remaining, plainMax, worker->codeBuffer, codedMax, &currLength);
+
+    if (readBack && codedLength) {
+        frame = allocateAndFillPacket(worker, session->hostMAC, SircWire::CodedReadBack::frameLength(codedLength));
+        if (frame == NULL)
+            return false;
+        SircWire::CodedReadBack::start(frame);
+        SircWire::CodedReadBack::Address::put(frame, response->address);
+        SircWire::CodedReadBack::Remaining::put(frame, response->remaining);
+        SircWire::CodedReadBack::Length::put(frame, currLength);
+        memcpy(SircWire::CodedReadBack::data(frame), worker->codeBuffer, codedLength);
+    } else if (readBack) {
+        frame = allocateAndFillPacket(worker, session->hostMAC, SircWire::ReadBack::frameLength(currLength));
+        if (frame == NULL)
+            return false;
+        SircWire::ReadBack::start(frame);
+        SircWire::ReadBack::Address::put(frame, response->address);
+        SircWire::ReadBack::Remaining::put(frame, response->remaining);
+        memcpy(SircWire::ReadBack::data(frame), source, currLength);
+    } else if (codedLength) {
+        frame = allocateAndFillPacket(worker, session->hostMAC, SircWire::CodedReadResponse::frameLength(codedLength));
+        if (frame == NULL)
+            return false;
+        SircWire::CodedReadResponse::start(frame);
+        SircWire::CodedReadResponse::Address::put(frame, response->address);
+        SircWire::CodedReadResponse::Length::put(frame, currLength);
+        memcpy(SircWire::CodedReadResponse::data(frame), worker->codeBuffer, codedLength);
+    } else {
+        frame = allocateAndFillPacket(worker, session->hostMAC, SircWire::ReadResponse::frameLength(currLength));
+        if (frame == NULL)
+            return false;
+        SircWire::ReadResponse::start(frame);
+        SircWire::ReadResponse::Address::put(frame, response->address);
+        memcpy(SircWire::ReadResponse::data(frame), source, currLength);
+    }
+
+    //Into the parity of its group
+    if (session->fecGroup)
+        sircFecAdd(&session->fec, frame, SircWire::Ethernet::Length::get(frame - SircWire::Ethernet::headerLength));
+
+    response->address += currLength;
+    response->remaining -= currLength;
+    return true;
+}
+
+//Send the parity of the data frames since the last one, and start a new group
+BOOL LINUX_SRV_SIRC::sendParity(WORKER *worker, SESSION *session)
+{
+    SIRC_FEC_GROUP *fec = &session->fec;
+
+    //As long as the longest frame of the group + 12 bytes
+    uint8_t *frame = allocateAndFillPacket(worker, session->hostMAC, SircWire::Parity::frameLength(fec->length));
+    if (frame == NULL)
+        return false;
+
+    SircWire::Parity::start(frame);
+    SircWire::Parity::First::put(frame, fec->first);
+    SircWire::Parity::End::put(frame, fec->end);
+    SircWire::Parity::Count::put(frame, (uint8_t) fec->frames);
+    SircWire::Parity::LengthXor::put(frame, fec->lengthXor);
+    memcpy(SircWire::Parity::data(frame), fec->sum, fec->length);
+
+    sircFecStart(fec);
+    return true;
+}
+
+#endif //!_WIN32
@@ -0,0 +1,228 @@
+// Title: LINUX_SRV_SIRC class definition
+//
+// Description: The SRV_SIRC software board on Linux, for many hosts at once.  Frames
+// come and go on a raw socket, each worker thread runs an epoll loop over its own, and
+// every host (source MAC) gets a session of its own, so one server can stand in for a
+// board under load from any number of ETH_SIRC clients.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// Speaks the SRV_SIRC side of sirc_wire.h: reads, writes, coded reads and writes,
+// register reads and writes, write & run with readback, reset, negotiate, FEC setup,
+// receive credits, checksums and multicast joins.
+// Sessions keep what SRV_SIRC keeps once per server: the host's negotiated options and
+// its response in progress.  A response waiting for receive credits is put aside rather
+// than waited for, so other hosts keep being served meanwhile.
+// Register file and buffers are per session, or with shared one set for all hosts,
+// used one frame at a time (a host then sees every other host's writes, like a board).
+// Frames are received and sent in batches (recvmmsg, sendmmsg), so a worker makes a few
+// system calls per batch rather than per frame.  With several workers the socket is a
+// fanout group that hands each host to the same worker every time, by its MAC address.
+// When the circuit is started ('k' to register 255, or 'g') the worker calls circuit
+// with that session's register file and buffers, then clears register 255 and, for a
+// write & run, sends back outputLength bytes of the output buffer.
+// Needs CAP_NET_RAW.
+//----------------------------------------------------------------------------
+
+#ifndef DEFINELINUXSRVSIRCH
+#define DEFINELINUXSRVSIRCH 1
+
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+//Bytes in each input and output buffer, the hardware-side SRV_SIRC emulates
+#define LINUX_SRV_INPUT_BYTES (1024 * 128)
+#define LINUX_SRV_OUTPUT_BYTES (1024 * 8)
+
+//Hosts one server keeps sessions for.  When they are all taken the one heard from
+// longest ago is given to the new host.
+#define LINUX_SRV_MAX_SESSIONS 1024
+
+//Worker threads one server can have
+#define LINUX_SRV_MAX_WORKERS 16
+
+//Frames per recvmmsg and per sendmmsg
+#define LINUX_SRV_BATCH 64
+
+//Multicast groups (see eth_multicast.h) one server can be in
+#define LINUX_SRV_MAX_GROUPS 8
+
+class LINUX_SRV_SIRC {
+public:
+    //The user circuit, run on one session's register file and buffers.
+    // outputLength: bytes of output a write & run sends back.  Keeps its value from the
+    //  last run of the session, 0 before the first.
+    //Returns false to stop the server.
+    typedef BOOL (*CIRCUIT)(uint32_t *registerFile, uint8_t *inputBuffer, uint8_t *outputBuffer,
+                            uint32_t *outputLength, void *context);
+
+	//Constructor for the class
+	// interfaceName: the NIC to serve on, e.g. "eth1"
+	// circuit, context: what runs when a host starts the circuit
+	// boardMAC: answer as the board with this MAC address rather than as the NIC.
+	//  The NIC is put in promiscuous mode.
+	// workers: threads serving, each with its share of the hosts (1 to LINUX_SRV_MAX_WORKERS)
+	// shared: one register file and set of buffers for all hosts instead of one per host
+	//Check error code with getLastError() to make certain constructor
+	// succeeded fully.
+    LINUX_SRV_SIRC(const char *interfaceName, CIRCUIT circuit, void *context = NULL,
+                   const uint8_t *boardMAC = NULL, uint32_t workers = 1, BOOL shared = false);
+
+	//Destructor for the class
+    ~LINUX_SRV_SIRC();
+
+    //Serve hosts until stop() is called or the circuit returns false
+    //Returns false if a worker failed.
+    // Check error code with getLastError().
+    BOOL serve();
+
+    //Make serve() return, from any thread
+    void stop();
+
+    //Totals since the constructor, over all workers
+    void getCounters(uint64_t *framesIn, uint64_t *bytesIn, uint64_t *framesOut, uint64_t *bytesOut,
+                     uint32_t *sessions);
+
+    void getMACAddress(uint8_t *MAC) { memcpy(MAC, My_MACAddress, 6); }
+
+    int8_t getLastError() { return lastError; }
+
+private:
+    //A response frame by frame: read acks or a readback
+    typedef struct {
+        uint8_t command;            //of the request, 0 for none
+        uint32_t address;           //next byte to send
+        uint32_t remaining;
+        BOOL parked;                //waiting for credits..
+        DWORD expires;              //..until then
+    } RESPONSE;
+
+    //One host
+    typedef struct {
+        uint8_t hostMAC[6];
+        int32_t next;               //in its hash bucket, -1 for the last
+        DWORD lastHeard;
+
+        uint32_t *regFileP;
+        uint8_t *inputBufP;
+        uint8_t *outputBufP;
+        uint32_t outputLength;
+
+        //What SRV_SIRC keeps, see srv_SIRC.h
+        uint32_t compression;
+        uint32_t fecGroup;
+        SIRC_FEC_GROUP fec;
+        BOOL creditFlow;
+        uint32_t creditsLeft;
+
+        RESPONSE response;
+    } SESSION;
+
+    //One thread, its socket and its hosts
+    typedef struct {
+        LINUX_SRV_SIRC *server;
+        uint32_t index;
+        int sock;
+        int epoll;
+        pthread_t thread;
+        BOOL threadStarted;
+        int8_t lastError;
+
+        SESSION *sessions;
+        uint32_t numSessions;
+        int32_t *buckets;           //first session of each, -1 for none
+        uint32_t waiting;           //sessions with a parked response
+
+        //Received frames
+        uint8_t *receiveBuffers;
+        struct mmsghdr receiveHeaders[LINUX_SRV_BATCH];
+        struct iovec receiveVectors[LINUX_SRV_BATCH];
+        struct sockaddr_ll receiveFrom[LINUX_SRV_BATCH];
+
+        //Frames to send, out with the next flush
+        uint8_t *sendBuffers;
+        struct mmsghdr sendHeaders[LINUX_SRV_BATCH];
+        struct iovec sendVectors[LINUX_SRV_BATCH];
+        uint32_t numSends;
+        uint8_t codeBuffer[SIRC_FEC_MAXFRAME];      //one frame payload
+
+        volatile uint64_t framesIn;
+        volatile uint64_t bytesIn;
+        volatile uint64_t framesOut;
+        volatile uint64_t bytesOut;
+    } WORKER;
+
+    CIRCUIT circuit;
+    void *context;
+    BOOL shared;
+    int ifindex;
+    uint8_t My_MACAddress[6];
+    BOOL promiscuous;
+    int stopEvent;                  //eventfd, every worker's epoll has it
+    volatile BOOL stopping;
+    int8_t lastError;
+
+    uint32_t numWorkers;
+    WORKER pool[LINUX_SRV_MAX_WORKERS];
+
+    //With shared, the one set and who is using it
+    uint32_t *sharedRegFile;
+    uint8_t *sharedInputBuf;
+    uint8_t *sharedOutputBuf;
+    CRITICAL_SECTION sharedLock;
+
+    //Multicast groups we joined, all workers'
+    uint8_t groups[LINUX_SRV_MAX_GROUPS][6];
+    uint32_t numGroups;
+    CRITICAL_SECTION groupLock;
+
+    uint32_t maxInputDataBytes;
+    uint32_t maxOutputDataBytes;
+
+    BOOL openSocket(WORKER *worker);
+    BOOL joinFanout(WORKER *worker);
+    BOOL setGroup(const uint8_t *groupMAC, BOOL join);
+
+    static void *workerThread(void *lpParam);
+    BOOL work(WORKER *worker);
+    BOOL receiveBatch(WORKER *worker, uint32_t *received);
+    BOOL flush(WORKER *worker);
+    BOOL checkExpired(WORKER *worker);
+
+    SESSION *findSession(WORKER *worker, const uint8_t *hostMAC);
+    BOOL startSession(SESSION *session, const uint8_t *hostMAC);
+
+    BOOL processPacket(WORKER *worker, uint8_t *message, uint32_t frameLength);
+    uint8_t *allocateAndFillPacket(WORKER *worker, const uint8_t *destinationMAC, uint16_t length);
+    BOOL sendErrorMessage(WORKER *worker, int8_t errorNumber, uint8_t *sourceMessage);
+    BOOL sendEcho(WORKER *worker, uint8_t *sourceMessage, uint16_t length);
+
+    BOOL checkRegWritePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkRegReadPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkNegotiatePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkFecSetupPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkCreditPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkChecksumPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkJoinPacket(WORKER *worker, uint8_t *sourceMessage);
+    BOOL inGroup(const uint8_t *groupMAC);
+    BOOL checkWritePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkCodedWritePacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkWriteAndRunPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+    BOOL checkReadPacket(WORKER *worker, SESSION *session, uint8_t *sourceMessage);
+
+    BOOL run(WORKER *worker, SESSION *session, BOOL readBack);
+    BOOL startResponse(WORKER *worker, SESSION *session, uint8_t command, uint32_t address, uint32_t length);
+    BOOL continueResponse(WORKER *worker, SESSION *session);
+    BOOL sendResponseFrame(WORKER *worker, SESSION *session);
+    BOOL sendParity(WORKER *worker, SESSION *session);
+};
+
+#endif //DEFINELINUXSRVSIRCH
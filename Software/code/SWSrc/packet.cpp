@@ -1614,8 +1614,11 @@ VirtualPcDriver2::PostTransmitPacket(
 
     //
     //  Call NT WriteFile().
+    //  The packet is the kernel's until its completion comes off the port,
+    //  even if the write completes right away.
     //
     Packet->Result = ERROR_IO_PENDING;
+    Packet->KernelOwned = TRUE;
 
     bResult = WriteFile(
                     this->hFileHandle, 
@@ -1646,6 +1649,11 @@ VirtualPcDriver2::PostTransmitPacket(
         return Result;
     } 
 
+    //
+    //  Failed, nothing will complete.
+    //
+    Packet->KernelOwned = FALSE;
+
     //
     //  Check for EOF. 
     //
@@ -1742,6 +1750,7 @@ VirtualPcDriver2::GetNextCompletedPacket(
     //
     //  Mark the transmission complete
     //
+    Packet->KernelOwned = FALSE;
     *pPacket = Packet;
     LogIt("pkt::xc %p",(UINT_PTR)Packet);
     return PacketModeTransmitting;
@@ -3725,3 +3734,274 @@ OpenPacketDriver(
 
     return NULL;
 }
+
+//=============================================================================
+//    SubSection: PACKET_STEERING::
+//
+//    Description: Receive steering table, classify once and queue per consumer.
+//=============================================================================
+
+PACKET_STEERING::PACKET_STEERING(
+    IN PACKET_DRIVER *Driver,
+    IN UINT32 RecycleLength,
+    IN PACKET_RECYCLE Recycle,
+    IN void *RecycleContext
+    )
+{
+    this->Driver         = Driver;
+    this->RecycleLength  = RecycleLength;
+    this->Recycle        = Recycle;
+    this->RecycleContext = RecycleContext;
+    this->nSources      = 0;
+    this->nConsumers    = 0;
+    this->nSteered      = 0;
+    this->nDiscarded    = 0;
+    memset(Sources, 0, sizeof Sources);
+    memset(Queues, 0, sizeof Queues);
+}
+
+PACKET_STEERING::~PACKET_STEERING(void)
+{
+    //
+    // Whatever nobody picked up goes back to the driver's free list
+    //
+    for (int i = 0; i < nConsumers; i++) {
+        while (Queues[i].Head != NULL) {
+            PACKET *Packet = Queues[i].Head;
+            Queues[i].Head = Packet->Next;
+            Driver->FreePacket(Packet, TRUE);
+        }
+    }
+}
+
+//=============================================================================
+//    Method: PACKET_STEERING::AddConsumer().
+//
+//    Description: Add a route (source MAC, command bytes) to a new consumer.
+//=============================================================================
+
+int
+PACKET_STEERING::AddConsumer(
+    IN const UINT8 *SourceMac,
+    IN const char *Commands
+    )
+{
+    int Source, Consumer, Command;
+
+    //
+    // Reuse the id of a consumer that went away, if any
+    //
+    for (Consumer = 0; Consumer < nConsumers; Consumer++)
+        if (!Queues[Consumer].InUse)
+            break;
+    if (Consumer >= PACKET_STEERING_MAX_CONSUMERS)
+        return -1;
+
+    //
+    // One entry per source MAC, shared by all its consumers
+    //
+    for (Source = 0; Source < nSources; Source++)
+        if (memcmp(Sources[Source].Mac, SourceMac, 6) == 0)
+            break;
+    if (Source == nSources) {
+        //
+        // A source without routes left can take the new MAC
+        //
+        for (Source = 0; Source < nSources; Source++) {
+            for (Command = 0; Command < 256; Command++)
+                if (Sources[Source].Route[Command])
+                    break;
+            if (Command == 256)
+                break;
+        }
+        if (Source == nSources) {
+            if (nSources >= PACKET_STEERING_MAX_SOURCES)
+                return -1;
+            nSources++;
+        }
+        memcpy(Sources[Source].Mac, SourceMac, 6);
+    }
+
+    for (; *Commands; Commands++)
+        Sources[Source].Route[(UINT8)*Commands] = (UINT8)(Consumer + 1);
+
+    Queues[Consumer].InUse = TRUE;
+    if (Consumer == nConsumers)
+        nConsumers++;
+    return Consumer;
+}
+
+//=============================================================================
+//    Method: PACKET_STEERING::RemoveConsumer().
+//
+//    Description: Drop a consumer's routes and give its frames back.
+//=============================================================================
+
+void
+PACKET_STEERING::RemoveConsumer(
+    IN int Consumer
+    )
+{
+    if ((Consumer < 0) || (Consumer >= nConsumers) || !Queues[Consumer].InUse)
+        return;
+
+    for (int Source = 0; Source < nSources; Source++)
+        for (int Command = 0; Command < 256; Command++)
+            if (Sources[Source].Route[Command] == (UINT8)(Consumer + 1))
+                Sources[Source].Route[Command] = 0;
+
+    while (Queues[Consumer].Head != NULL) {
+        PACKET *Packet = Queues[Consumer].Head;
+        Queues[Consumer].Head = Packet->Next;
+        Repost(Packet);
+    }
+    Queues[Consumer].Tail = NULL;
+    Queues[Consumer].InUse = FALSE;
+}
+
+//=============================================================================
+//    Method: PACKET_STEERING::Classify().
+//
+//    Description: Which consumer (if any) wants this frame.
+//=============================================================================
+
+int
+PACKET_STEERING::Classify(
+    IN PACKET *Packet
+    )
+{
+    //
+    // Must have a header and a command byte
+    //
+    if (Packet->nBytesAvail < 15)
+        return -1;
+
+    for (int Source = 0; Source < nSources; Source++) {
+        if (memcmp(Packet->Buffer + 6, Sources[Source].Mac, 6) == 0)
+            return (int)Sources[Source].Route[Packet->Buffer[14]] - 1;
+    }
+    return -1;
+}
+
+//=============================================================================
+//    Method: PACKET_STEERING::GetNextReceivedPacket().
+//
+//    Description: Dequeue the next frame for a consumer, steer the others.
+//=============================================================================
+
+PACKET *
+PACKET_STEERING::GetNextReceivedPacket(
+    IN int Consumer,
+    IN UINT32 TimeOutInMsec,
+    IN BOOL ReturnOnSteer
+    )
+{
+    PACKET *Packet = Queues[Consumer].Head;
+
+    //
+    // Already have one?
+    //
+    if (Packet != NULL) {
+        Queues[Consumer].Head = Packet->Next;
+        if (Queues[Consumer].Head == NULL)
+            Queues[Consumer].Tail = NULL;
+        return Packet;
+    }
+
+    DWORD StartTime = GetTickCount();
+    for (;;) {
+        UINT32 Elapsed = GetTickCount() - StartTime;
+        if (Elapsed > TimeOutInMsec)
+            return NULL;
+
+        Packet = Driver->GetNextReceivedPacket(TimeOutInMsec - Elapsed);
+        if (Packet == NULL)
+            return NULL;
+
+        int Target = Classify(Packet);
+        if (Target == Consumer)
+            return Packet;
+
+        if (Target < 0) {
+            //
+            // Nobody wants it, recycle.
+            //
+            nDiscarded++;
+            Repost(Packet);
+            continue;
+        }
+
+        //
+        // Someone else's, queue it for them
+        //
+        nSteered++;
+        Enqueue(Target, Packet);
+
+        if (ReturnOnSteer)
+            return NULL;
+    }
+}
+
+//=============================================================================
+//    Method: PACKET_STEERING::Steer().
+//
+//    Description: Queue a frame received elsewhere for its consumer.
+//=============================================================================
+
+int
+PACKET_STEERING::Steer(
+    IN PACKET *Packet
+    )
+{
+    int Target = Classify(Packet);
+
+    if (Target < 0) {
+        nDiscarded++;
+        Repost(Packet);
+        return -1;
+    }
+
+    nSteered++;
+    Enqueue(Target, Packet);
+    return Target;
+}
+
+//=============================================================================
+//    Method: PACKET_STEERING::Enqueue().
+//
+//    Description: Append a frame to a consumer's queue.
+//=============================================================================
+
+void
+PACKET_STEERING::Enqueue(
+    IN int Consumer,
+    IN PACKET *Packet
+    )
+{
+    Packet->Next = NULL;
+    if (Queues[Consumer].Tail != NULL)
+        Queues[Consumer].Tail->Next = Packet;
+    else
+        Queues[Consumer].Head = Packet;
+    Queues[Consumer].Tail = Packet;
+}
+
+//=============================================================================
+//    Method: PACKET_STEERING::Repost().
+//
+//    Description: Give a frame nobody wants back, through the owner if it
+//                 keeps count.
+//=============================================================================
+
+void
+PACKET_STEERING::Repost(
+    IN PACKET *Packet
+    )
+{
+    if (Recycle != NULL) {
+        Recycle(Packet, RecycleContext);
+        return;
+    }
+    Packet->Length = RecycleLength;
+    Driver->PostReceivePacket(Packet);
+}
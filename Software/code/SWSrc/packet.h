@@ -119,7 +119,7 @@ class PACKET {
     void        *DriverState;
     UINT8       *Buffer;
     BOOL         Flush;
-    BOOL         KernelOwned;
+    volatile BOOL KernelOwned;                 // posted, completion not yet taken off the driver
 };
 
 //
@@ -166,6 +166,101 @@ public:
 
 };
 
+//
+// Receive steering table.
+// Classifies each received frame once, by source MAC and command byte (first
+// payload byte), into per-consumer queues.  Frames that match no consumer
+// (broadcasts, other boards, other protocols) are re-posted on the spot, through
+// Recycle if the owner keeps count of its receives.
+// Not thread safe: only one thread at a time should be receiving.
+// Large enough for a NIC shared by many boards (eth_nic.h), two consumers each.
+// There is no pre-filter in the kernel: every packet driver here is a Windows one,
+// and SetFilter only takes NDIS flags.  On Linux only LINUX_SRV_SIRC captures
+// frames, and its raw socket has a filter of its own (linux_srv_SIRC.cpp).
+//
+#define PACKET_STEERING_MAX_CONSUMERS 64
+#define PACKET_STEERING_MAX_SOURCES   32
+
+//
+// Gives a frame nobody wants back to the driver.  Without one it is re-posted
+// as is, RecycleLength long.
+//
+typedef void (*PACKET_RECYCLE)(IN PACKET *Packet, IN void *Context);
+
+class PACKET_STEERING {
+public:
+    PACKET_STEERING(IN PACKET_DRIVER *Driver,
+                    IN UINT32 RecycleLength,
+                    IN PACKET_RECYCLE Recycle = NULL,
+                    IN void *RecycleContext = NULL);
+    ~PACKET_STEERING(void);
+
+    //
+    // Route frames from SourceMac whose command byte is in Commands (a NUL
+    // terminated string) to a new consumer.  Returns the consumer id, or -1.
+    //
+    int AddConsumer(IN const UINT8 *SourceMac,
+                    IN const char *Commands);
+
+    //
+    // Drop a consumer's routes.  Frames still queued for it are re-posted,
+    // and the id goes to the next AddConsumer.
+    //
+    void RemoveConsumer(IN int Consumer);
+
+    //
+    // Next frame for this consumer, pulling from the driver (and steering
+    // the frames for other consumers to their queues) for up to TimeOutInMsec.
+    // With ReturnOnSteer we give up as soon as someone else got a frame.
+    //
+    PACKET *GetNextReceivedPacket(IN int Consumer,
+                                  IN UINT32 TimeOutInMsec,
+                                  IN BOOL ReturnOnSteer = FALSE);
+
+    //
+    // Classify a frame someone else took from the driver and queue it for
+    // its consumer.  Returns the consumer, or -1 if it was re-posted.
+    //
+    int Steer(IN PACKET *Packet);
+
+    //
+    // Any frames already waiting for this consumer?
+    //
+    BOOL HasPackets(IN int Consumer)
+    {
+        return (Queues[Consumer].Head != NULL);
+    }
+
+    //
+    // Statistics
+    //
+    UINT32 nSteered;
+    UINT32 nDiscarded;
+
+private:
+    int Classify(IN PACKET *Packet);
+    void Enqueue(IN int Consumer, IN PACKET *Packet);
+    void Repost(IN PACKET *Packet);
+
+    PACKET_DRIVER *Driver;
+    UINT32 RecycleLength;
+    PACKET_RECYCLE Recycle;
+    void *RecycleContext;
+
+    struct {
+        UINT8 Mac[6];
+        UINT8 Route[256];               // consumer id + 1, 0 for none
+    } Sources[PACKET_STEERING_MAX_SOURCES];
+    int nSources;
+
+    struct {
+        PACKET *Head;
+        PACKET *Tail;
+        BOOL InUse;
+    } Queues[PACKET_STEERING_MAX_CONSUMERS];
+    int nConsumers;
+};
+
 // Contructor function
 extern PACKET_DRIVER * OpenPacketDriver(const wchar_t *PreferredNicName,
                                         UINT PreferredPacketDriverVersion,
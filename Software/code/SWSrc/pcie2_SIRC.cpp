@@ -61,7 +61,7 @@ DEFINE_GUID(TOASTER_NOTIFY_DEVICE_ARRIVAL_EVENT, 0x2cb1e0e9, 0xa4c7, 0x42d9, 0xa
 
 SIRC_DLL_LINKAGE PCIE2_SIRC::PCIE2_SIRC(int desiredInstance)
 {
-    wholeWordBuffer = NULL;
+    dma = NULL;
     hFile = NULL;
 	hFile = INVALID_HANDLE_VALUE;
 	if(!FindDevice(desiredInstance)){
@@ -69,22 +69,27 @@ SIRC_DLL_LINKAGE PCIE2_SIRC::PCIE2_SIRC(int desiredInstance)
         return;
 	}
 
+    //All transfers go through the queue
+    dma = new SIRC_DMA(hFile);
+    if (!dma->valid()) {
+        setLastError( FAILMEMALLOC);
+        return;
+    }
+
     maxInputDataBytes = MAX_BUFFER_LENGTH;
     maxOutputDataBytes = MAX_BUFFER_LENGTH;
-
-	wholeWordBuffer = (uint8_t*)VirtualAlloc(NULL, MAX_BUFFER_LENGTH, MEM_RESERVE | MEM_PHYSICAL, PAGE_EXECUTE_READWRITE);
-	wholeWordBuffer = (uint8_t *)VirtualAlloc(NULL, MAX_BUFFER_LENGTH, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
 }
 
 PCIE2_SIRC::~PCIE2_SIRC()
 {
+    //Submitted requests still use the device
+    finishAsync();
+
+    if (dma)
+        delete dma;
+
 	if (hFile != NULL)
 		CloseHandle( hFile );
-
-    if (wholeWordBuffer) {
-        VirtualFree (wholeWordBuffer, MAX_BUFFER_LENGTH, MEM_DECOMMIT);
-        VirtualFree (wholeWordBuffer, 0, MEM_RELEASE);
-    }
 }
 
 //Dynamic parameters
@@ -101,14 +106,24 @@ BOOL PCIE2_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutL
     params.maxRetries           = 0;
     params.maxOutstandingReads  = 0;
     params.maxOutstandingWrites = 0;
-
-    if (maxOutLength >= sizeof(*outParameters)) {
-        *outParameters = params;
+    if (dma)
+        dma->getDepth(&params.maxOutstandingReads, &params.maxOutstandingWrites);
+    params.autoTune             = 0; // nothing to tune
+    params.postedReceives       = 0;
+    params.writeWindow          = 0;
+    params.tunerDecisions       = 0;
+    params.compression          = 0;
+    params.ioThread             = 0;
+    params.fecGroup             = 0;
+    params.fecRecovered         = 0;
+    params.fecParityFrames      = 0;
+    params.receiveCredits       = 0;
+    params.creditGrants         = 0;
+
+    if (copyParameters(&params, outParameters, maxOutLength)) {
         setLastError(0);
         return true;
     }
-    //Wants to know version or partial (or error)
-    memcpy(outParameters,&params,maxOutLength);
     setLastError(INVALIDLENGTH);
     return false;
 }
@@ -117,16 +132,16 @@ BOOL PCIE2_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutL
 BOOL PCIE2_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
 {
     //Sometimes you got to know what you are doing.
-    if ((length < sizeof(*inParameters)) ||
-        (inParameters->myVersion < SIRC_PARAMETERS_CURRENT_VERSION)){
+    //What we look at is all in version 1.
+    if (!parametersLengthValid(inParameters, length)){
         setLastError(INVALIDLENGTH);
         return false;
     }
 
-    //Ignored: maxOutstandingReads  = inParameters->maxOutstandingReads;
-    //Ignored: maxOutstandingWrites  = inParameters->maxOutstandingWrites;
+    //Depth of the DMA queue, each way
+    if (dma)
+        dma->setDepth(inParameters->maxOutstandingReads, inParameters->maxOutstandingWrites);
     
-    //BUGBUG: Should reallocate unaligned buffer..which is a bad idea anyways..
     maxInputDataBytes    = inParameters->maxInputDataBytes;
     maxOutputDataBytes   = inParameters->maxOutputDataBytes;
 
@@ -139,6 +154,13 @@ BOOL PCIE2_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t le
 }
 
 
+SIRC_ASYNC *PCIE2_SIRC::createAsync()
+{
+    if (dma == NULL)
+        return SIRC::createAsync();
+    return new SIRC_DMA_ASYNC(this, dma, INPUT_OFFSET, OUTPUT_OFFSET);
+}
+
 void PCIE2_SIRC::PrintError(char *pszRoutineName, char *pszComment)
 {
 #ifdef BIGDEBUG
@@ -286,201 +308,37 @@ bool PCIE2_SIRC::FindDevice(int instance)
 
 //Reads from the PCIe need to start word-aligned (startAddress must be a multiple of 4)
 // and the length of the read must also be a multiple of 4.
-//We have to fix things up if this is not the case.
-//Start Address		Length offset			
-//address offset	0	1	2	3
-//				0	0	0	0	0
-//				1	-1	-1	-1	-1
-//				2	-2	-2	-2	-2
-//				3	-3	-3	-3	-3	
-//Length			Length offset			
-//address offset	0	1	2	3
-//				0	0	+3	+2	+1
-//				1	+4	+3	+2	+1
-//				2	+4	+3	+2	+1
-//				3	+4	+3	+2	+1
+//The whole words in the middle go straight into readBackData, a partial word at
+// either end is read whole and the bytes we want copied out of it.
 BOOL PCIE2_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *readBackData)
 {
-	DWORD dwBytesRead, dwTotalBytesRead, dwRequestSize;
-	OVERLAPPED OverlapStructure;
-	int lengthWholeWord;
-	int startAddressWholeWord;
-	int addressOffset = startAddress % 4;
-	int lengthOffset = length % 4;
-
 	//printf("Sending read, %d, %d\n", startAddress, length);
 
-	// Start at the user specified address
-	OverlapStructure.Offset = ((DWORD) startAddress) + OUTPUT_OFFSET;
-	OverlapStructure.OffsetHigh = 0;
-	OverlapStructure.hEvent = 0;
-
-	dwTotalBytesRead = 0;
-
-	//There is something wrong with the read we have to fix it up
-	if(addressOffset != 0 || lengthOffset != 0){
-		//Fix the starting address
-		startAddressWholeWord = startAddress - addressOffset;
-
-		//Fix the length
-        lengthWholeWord = length + (4 - lengthOffset);
-
-		while (dwTotalBytesRead != (DWORD) lengthWholeWord){
-#ifndef _WIN64
-			// Transfer sizes over 63 MegaBytes don't seem to work in 32-bit mode
-			if (lengthWholeWord - dwTotalBytesRead >= 32*1024*1024)
-				dwRequestSize = 32*1024*1024;
-			else
-#endif
-				dwRequestSize = lengthWholeWord - dwTotalBytesRead;
-
-			ReadFile(hFile, wholeWordBuffer + dwTotalBytesRead, dwRequestSize, NULL, &OverlapStructure );
-			GetOverlappedResult( hFile, &OverlapStructure, &dwBytesRead, TRUE );
-			if (GetLastError() != 0 && GetLastError() != ERROR_IO_PENDING){
-				PrintError( "Read", "" );
-                setLastError( INVALIDREADTRANSMIT);
-				return false;
-			}
-			OverlapStructure.Offset += dwBytesRead;
-			dwTotalBytesRead += dwBytesRead;
-		}
-
-		//Copy the word-aligned data into the non-word aligned request buffer
-		memcpy(readBackData, wholeWordBuffer + addressOffset, length);
-	}
-
-	else{
-		while (dwTotalBytesRead != (DWORD) length){
-#ifndef _WIN64
-			// Transfer sizes over 63 MegaBytes don't seem to work in 32-bit mode
-			if (length - dwTotalBytesRead >= 32*1024*1024)
-				dwRequestSize = 32*1024*1024;
-			else
-#endif
-				dwRequestSize = length - dwTotalBytesRead;
-
-			ReadFile( hFile, readBackData + dwTotalBytesRead, dwRequestSize, NULL, &OverlapStructure );
-			GetOverlappedResult( hFile, &OverlapStructure, &dwBytesRead, TRUE );
-			if (GetLastError() != 0 && GetLastError() != ERROR_IO_PENDING){
-				PrintError( "Read", "" );
-                setLastError( INVALIDREADTRANSMIT);
-				return false;
-			}
-			OverlapStructure.Offset += dwBytesRead;
-			dwTotalBytesRead += dwBytesRead;
-		}
+	if (dma == NULL ||
+		!dma->transferWords(false, (uint64_t) startAddress + OUTPUT_OFFSET, readBackData, length)){
+		PrintError( "Read", "" );
+        setLastError( INVALIDREADTRANSMIT);
+		return false;
 	}
 	return true;
 }
 
 //Writes from the PCIe need to start word-aligned (startAddress must be a multiple of 4)
-// and the length of the read must also be a multiple of 4.
-//We have to fix things up if this is not the case.
-//Start Address		Length offset			
-//address offset	0	1	2	3
-//				0	0	0	0	0
-//				1	-1	-1	-1	-1
-//				2	-2	-2	-2	-2
-//				3	-3	-3	-3	-3	
-//Length			Length offset			
-//address offset	0	1	2	3
-//				0	0	+3	+2	+1
-//				1	+4	+3	+2	+1
-//				2	+4	+3	+2	+1
-//				3	+4	+3	+2	+1
+// and the length of the write must also be a multiple of 4.
+//The whole words in the middle go straight from buffer, a partial word at either end
+// is sent whole with our bytes in it.
 //NOTICE - We can't fix the case in which the starting address or length ends up not being word-aligned but
 // we don't want to disturb the data in the earlier/later bytes.  We are going to overwrite them
 // with zeros!
 BOOL PCIE2_SIRC::sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer)
 {
-	DWORD dwBytesWritten, dwTotalBytesWritten, dwRequestSize;
-	OVERLAPPED OverlapStructure;
-
-	int lengthWholeWord;
-	int startAddressWholeWord;
-	int addressOffset = startAddress % 4;
-	int lengthOffset = length % 4;
-
-	// Start at the user specified address
-	OverlapStructure.Offset = ((DWORD) startAddress) + INPUT_OFFSET;
-	OverlapStructure.OffsetHigh = 0;
-	OverlapStructure.hEvent = 0;
+	//printf("Sending Write, %d, %d\n", startAddress, length);
 
-	dwTotalBytesWritten = 0;
-
-	//There is something wrong with the write we have to fix it up
-	if(addressOffset != 0 || lengthOffset != 0){
-		//Fix the starting address
-		startAddressWholeWord = startAddress - addressOffset;
-
-		//Fix the length
-        lengthWholeWord = length + (4 - lengthOffset);
-
-		//Copy the non-word aligned request buffer into the word-aligned data buffer
-		//Zero out the earlier bytes
-		memset(wholeWordBuffer, 0, addressOffset);
-		//Copy over the data
-		memcpy(wholeWordBuffer + addressOffset, buffer, length);
-		//Zero out the later bytes
-		memset(wholeWordBuffer + addressOffset + length, 0, lengthWholeWord - length);
-
-		//printf("Sending corrected Write, %d, %d\n", startAddressWholeWord, lengthWholeWord);
-
-		while (dwTotalBytesWritten != (DWORD) lengthWholeWord){
-			// hFile is opened for asynchronous I/O...
-			//	...I have to call GetOverlappedResult() to find out how big the transfer was, and that won't return
-			//	until the operation is done.
-#ifndef _WIN64
-			// Transfer sizes over 63 MegaBytes don't seem to work in 32-bit mode
-			if (lengthWholeWord - dwTotalBytesWritten >= 32*1024*1024)
-				dwRequestSize = 32*1024*1024;
-			else
-#endif
-				dwRequestSize = lengthWholeWord - dwTotalBytesWritten;
-
-			WriteFile( hFile, wholeWordBuffer + dwTotalBytesWritten, dwRequestSize, NULL, &OverlapStructure );
-			GetOverlappedResult( hFile, &OverlapStructure, &dwBytesWritten, TRUE );
-			// Because I'm using overlapped I/O to pass the file pointer, ERROR_IO_PENDING is returned from WriteFile() even
-			//	when it succeeds.
-			if (GetLastError() != 0 && GetLastError() != ERROR_IO_PENDING){
-				PrintError( "Write", "" );
-                setLastError( INVALIDWRITETRANSMIT);
-				return false;
-			}
-			// I have to manually update the starting address in the overlapped structure
-			OverlapStructure.Offset += dwBytesWritten;
-			dwTotalBytesWritten += dwBytesWritten;
-		}
-	}
-	else{
-		//printf("Sending Write, %d, %d\n", startAddress, length);
-
-		while (dwTotalBytesWritten != (DWORD) length){
-			// hFile is opened for asynchronous I/O...
-			//	...I have to call GetOverlappedResult() to find out how big the transfer was, and that won't return
-			//	until the operation is done.
-#ifndef _WIN64
-			// Transfer sizes over 63 MegaBytes don't seem to work in 32-bit mode
-			if (length - dwTotalBytesWritten >= 32*1024*1024)
-				dwRequestSize = 32*1024*1024;
-			else
-#endif
-				dwRequestSize = length - dwTotalBytesWritten;
-
-			WriteFile( hFile, buffer + dwTotalBytesWritten, dwRequestSize, NULL, &OverlapStructure );
-			GetOverlappedResult( hFile, &OverlapStructure, &dwBytesWritten, TRUE );
-			// Because I'm using overlapped I/O to pass the file pointer, ERROR_IO_PENDING is returned from WriteFile() even
-			//	when it succeeds.
-			if (GetLastError() != 0 && GetLastError() != ERROR_IO_PENDING)
-			{
-				PrintError( "Write", "" );
-                setLastError( INVALIDWRITETRANSMIT);
-				return false;
-			}
-			// I have to manually update the starting address in the overlapped structure
-			OverlapStructure.Offset += dwBytesWritten;
-			dwTotalBytesWritten += dwBytesWritten;
-		}
+	if (dma == NULL ||
+		!dma->transferWords(true, (uint64_t) startAddress + INPUT_OFFSET, buffer, length)){
+		PrintError( "Write", "" );
+        setLastError( INVALIDWRITETRANSMIT);
+		return false;
 	}
 	return true;
 }
@@ -116,9 +116,13 @@ public:
     //Modify the active set of parameters and limits for this instance
     BOOL __stdcall setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length);
 
+protected:
+    //Submitted reads and writes share the DMA queue
+    SIRC_ASYNC * __stdcall createAsync(void);
+
 private:
 	HANDLE hFile;
-	uint8_t *wholeWordBuffer;
+    SIRC_DMA *dma;
     uint32_t maxInputDataBytes;
     uint32_t maxOutputDataBytes;
 
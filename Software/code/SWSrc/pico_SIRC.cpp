@@ -50,6 +50,9 @@ SIRC_DLL_LINKAGE PICO_SIRC::PICO_SIRC(int desiredInstance, const char *configura
 
 PICO_SIRC::~PICO_SIRC()
 {
+    //Submitted requests still use the device
+    finishAsync();
+
     delete channel;
 }
 
@@ -67,14 +70,22 @@ BOOL PICO_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLe
     params.maxRetries           = 0;
     params.maxOutstandingReads  = 0;
     params.maxOutstandingWrites = 0;
-
-    if (maxOutLength >= sizeof(*outParameters)) {
-        *outParameters = params;
+    params.autoTune             = 0; // nothing to tune
+    params.postedReceives       = 0;
+    params.writeWindow          = 0;
+    params.tunerDecisions       = 0;
+    params.compression          = 0;
+    params.ioThread             = 0;
+    params.fecGroup             = 0;
+    params.fecRecovered         = 0;
+    params.fecParityFrames      = 0;
+    params.receiveCredits       = 0;
+    params.creditGrants         = 0;
+
+    if (copyParameters(&params, outParameters, maxOutLength)) {
         setLastError(0);
         return true;
     }
-    //Wants to know version or partial (or error)
-    memcpy(outParameters,&params,maxOutLength);
     setLastError(INVALIDLENGTH);
     return false;
 }
@@ -83,8 +94,7 @@ BOOL PICO_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLe
 BOOL PICO_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
 {
     //Sometimes you got to know what you are doing.
-    if ((length < sizeof(*inParameters)) ||
-        (inParameters->myVersion < SIRC_PARAMETERS_CURRENT_VERSION)){
+    if (!parametersLengthValid(inParameters, length)){
         setLastError(INVALIDLENGTH);
         return false;
     }
@@ -0,0 +1,88 @@
+// proxy_main.cpp : Defines the entry point for the proxy console application.
+//
+// Usage: proxy_main [-<driverVersion>] [-p<port>] [FPGA_MAC_addr]
+// Opens the board and serves it to REMOTE_SIRC clients on other machines, on TCP
+// port port (default SIRC_REMOTE_PORT), until Ctrl-C.  See sirc_remote.h.
+//
+
+#include "sirc_internal.h"
+
+using namespace std;
+
+static SIRC_PROXY * volatile proxy;
+
+void error(string inErr){
+	cerr << "Error:" << endl;
+	cerr << "\t" << inErr << endl;
+
+    PrintZeLog();
+	exit(-1);
+}
+
+//Ctrl-C, Ctrl-Break, closing the console
+BOOL WINAPI stopProxy(DWORD ctrlType)
+{
+    SIRC_PROXY *running = proxy;
+
+    if (running)
+        running->stop();
+    return TRUE;
+}
+
+int main(int argc, char* argv[])
+{
+    uint8_t FPGA_ID[6];
+    uint32_t driverVersion = 0;
+    uint32_t port = SIRC_REMOTE_PORT;
+    SIRC *device;
+    SIRC_PROXY_STATISTICS statistics;
+
+	std::ostringstream tempStream;
+
+    /* args? */
+    memset(FPGA_ID, 0xAA, sizeof(FPGA_ID));
+    for (int a = 1; a < argc; a++) {
+        if (argv[a][0] != '-') {
+            if (hexToFpgaId(argv[a], FPGA_ID, sizeof(FPGA_ID)) != 6)
+                error("Invalid MAC address " + (string) argv[a]);
+        } else if (argv[a][1] == 'p') {
+            port = atoi(argv[a]+2);
+            if ((port == 0) || (port > 0xFFFF))
+                error("Invalid port " + (string) (argv[a]+2));
+        } else
+            driverVersion = atoi(argv[a]+1);
+    }
+
+    device = openSirc(FPGA_ID, driverVersion);
+    if (device == NULL)
+        error("Unable to find a suitable SIRC driver");
+    if (device->getLastError() != 0) {
+        tempStream << "Constructor failed with code " << (int) device->getLastError();
+        error(tempStream.str());
+    }
+
+    proxy = new SIRC_PROXY(device, (uint16_t) port, true);
+    if (proxy->getLastError() != 0) {
+        tempStream << "Cannot listen on port " << port << ", code " << (int) proxy->getLastError();
+        error(tempStream.str());
+    }
+    SetConsoleCtrlHandler(stopProxy, TRUE);
+
+    printf("Serving the board on TCP port %u, Ctrl-C to stop\n", port);
+    if (!proxy->run()) {
+        tempStream << "Stopped serving, code " << (int) proxy->getLastError();
+        error(tempStream.str());
+    }
+
+    proxy->getStatistics(&statistics);
+    printf("%u clients, %I64u commands, %I64u bytes in, %I64u bytes out\n",
+           statistics.connects, statistics.commands, statistics.bytesIn, statistics.bytesOut);
+
+    SIRC_PROXY *stopped = proxy;
+    proxy = NULL;
+    delete stopped;
+
+    PrintZeLog();
+
+	return 0;
+}
@@ -15,35 +15,62 @@
 
 #include "sirc_internal.h"
 
-//Open the first valid SIRC interface
-SIRC_DLL_LINKAGE SIRC * __stdcall openSirc(uint8_t *FPGA_ID, uint32_t driverVersion)
-{
-    // Try first for the new PCIe
-    PCIE2_SIRC *pcie2 = new PCIE2_SIRC;
-    if (pcie2->getLastError() == 0)
-        return pcie2;
-    delete pcie2;
+//Bytes of PARAMETERS each version has
+static const uint32_t parametersLength[SIRC_PARAMETERS_CURRENT_VERSION] = {
+    SIRC_PARAMETERS_V1_LENGTH,
+    SIRC_PARAMETERS_V2_LENGTH,
+    SIRC_PARAMETERS_V3_LENGTH,
+    SIRC_PARAMETERS_V4_LENGTH,
+    SIRC_PARAMETERS_V5_LENGTH,
+    sizeof(SIRC::PARAMETERS)
+};
 
-    // Try first for the PCIe
-    PCIE_SIRC *pcie = new PCIE_SIRC;
-    if (pcie->getLastError() == 0)
-        return pcie;
-    delete pcie;
-
-    // Then for a Pico card
-	//PICO_SIRC *pico = new PICO_SIRC(driverVersion);
-    //if (pico->getLastError() == 0)
-    //    return pico;
-    //delete pico;
+BOOL SIRC::parametersLengthValid(const SIRC::PARAMETERS *inParameters, uint32_t length)
+{
+    uint32_t version;
 
-    // Then for the network
-	ETH_SIRC *eth = new ETH_SIRC(FPGA_ID,driverVersion,NULL);
-    if (eth->getLastError() == 0)
-        return eth;
-    delete eth;
+    if ((length < SIRC_PARAMETERS_V1_LENGTH) || (inParameters->myVersion < 1))
+        return false;
+    //Newer callers than us: we need what we know of
+    version = inParameters->myVersion;
+    if (version > SIRC_PARAMETERS_CURRENT_VERSION)
+        version = SIRC_PARAMETERS_CURRENT_VERSION;
+    return (length >= parametersLength[version - 1]);
+}
 
-    // Ran out of ideas.
-    return NULL;
+BOOL SIRC::copyParameters(SIRC::PARAMETERS *params, SIRC::PARAMETERS *outParameters, uint32_t maxOutLength)
+{
+    if (maxOutLength >= sizeof(*outParameters)) {
+        *outParameters = *params;
+        return true;
+    }
+    //Caller built against an older structure?
+    for (uint32_t version = SIRC_PARAMETERS_CURRENT_VERSION - 1; version >= 1; version--)
+        if (maxOutLength == parametersLength[version - 1]) {
+            params->myVersion = version;
+            memcpy(outParameters,params,maxOutLength);
+            return true;
+        }
+    //Wants to know version or partial (or error)
+    memcpy(outParameters,params,maxOutLength);
+    return false;
 }
 
+//Open the first valid SIRC interface
+//The one that found this board last time goes first, then all of them at once
+// (see sirc_discovery.h).
+SIRC_DLL_LINKAGE SIRC * __stdcall openSirc(uint8_t *FPGA_ID, uint32_t driverVersion)
+{
+#if defined(_WIN32)
+    return discoverSirc(FPGA_ID, driverVersion);
+#else
+    //Only the mmap'd PCIe backend, on the device SIRC_PCIE_DEVICE names
+    LINUX_PCIE_SIRC *sirc = new LINUX_PCIE_SIRC();
 
+    if (sirc->getLastError() != 0) {
+        delete sirc;
+        return NULL;
+    }
+    return sirc;
+#endif
+}
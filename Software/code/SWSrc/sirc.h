@@ -19,6 +19,10 @@
 #ifndef DEFINESIRCH
 #define DEFINESIRCH 1
 
+#if !defined(_WIN32)
+#include "sirc_port.h"
+#endif
+
 #ifndef SIRC_DLL_LINKAGE
 #define SIRC_DLL_LINKAGE /* Auto-selected based on .lib file chosen */
 #endif
@@ -38,6 +42,55 @@ typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 #endif
 
+//Completion handle for the asynchronous (submit*) methods below.
+//Handles are signaled in the order the requests were submitted.
+class SIRC_REQUEST
+{
+public:
+	//Wait until the request completes
+	// maxWaitTimeInMsec: # of milliseconds to wait, INFINITE to wait for good.
+	//Returns true if the request has completed (successfully or not), false on timeout.
+	virtual BOOL __stdcall wait(uint32_t maxWaitTimeInMsec) = 0;
+
+	//Returns true if the request has completed, without waiting.
+	virtual BOOL __stdcall poll(void) = 0;
+
+	//Once completed: the error code the synchronous method would have left in getLastError(),
+	// 0 if the request succeeded.
+	virtual int8_t __stdcall getError(void) = 0;
+
+	//Once completed: the register value for submitParamRegisterRead, the output length
+	// for submitWriteAndRun (see sendWriteAndRun), 0 otherwise.
+	virtual uint32_t __stdcall getValue(void) = 0;
+
+	//Manual reset event signaled on completion, for WaitForMultipleObjects.
+	//Owned by the handle, do not close it.
+	virtual HANDLE __stdcall getEvent(void) = 0;
+
+	//Let go of the handle.  The request still runs if it has not completed yet.
+	//Every handle returned by a submit* method must be released exactly once.
+	virtual void __stdcall release(void) = 0;
+
+protected:
+	virtual __stdcall ~SIRC_REQUEST(){}
+};
+
+//Called on a SIRC worker thread as soon as a request completes, before its handle
+// is signaled.  It may submit more requests, but must not call the synchronous
+// methods of the same SIRC object or wait on its other handles.
+typedef void (__stdcall *SIRC_CALLBACK)(SIRC_REQUEST *request, void *context);
+
+//One block of a vectored transfer (sendWriteV, sendReadV)
+typedef struct {
+	uint32_t startAddress;
+	uint32_t length;
+	uint8_t *buffer;
+} SIRC_SEGMENT;
+
+//Internal
+class SIRC_ASYNC;
+class SIRC_ASYNC_REQUEST;
+
 class SIRC
 {
 public:
@@ -45,6 +98,7 @@ public:
     __stdcall SIRC(void)
     {
         lastError = 0;
+        async = NULL;
     }
 
 	//No Destructor for the base class
@@ -129,7 +183,7 @@ public:
     //Dynamically adjustable parameters and limits
     typedef struct {
         uint32_t myVersion;
-#define SIRC_PARAMETERS_CURRENT_VERSION 1
+#define SIRC_PARAMETERS_CURRENT_VERSION 6
         uint32_t maxInputDataBytes;         //Should match hw-side buffer
         uint32_t maxOutputDataBytes;        //Should match hw-side buffer
         uint32_t writeTimeout;              //..before we give up
@@ -137,6 +191,38 @@ public:
         uint32_t maxRetries;                //..before we give up
         uint32_t maxOutstandingReads;       //NB: In some cases these two can only be lowered.
         uint32_t maxOutstandingWrites;      //NB2: 0 means unlimited.
+#define SIRC_PARAMETERS_V1_LENGTH (8 * sizeof(uint32_t))
+        //Version 2: online tuning.  The tuner stays within the two limits above.
+        uint32_t autoTune;                  //Non-zero lets the instance tune the next two
+        uint32_t postedReceives;            //Receives currently kept posted (read-only)
+        uint32_t writeWindow;               //Writes sent before checking for acks (read-only)
+        uint32_t tunerDecisions;            //# of adjustments made so far (read-only)
+#define SIRC_PARAMETERS_V2_LENGTH (12 * sizeof(uint32_t))
+        //Version 3: payload compression.  Ask for any of the bits below, read back
+        // what the FPGA agreed to.  Uncompressible frames are always sent as is.
+        uint32_t compression;
+#define SIRC_COMPRESS_WRITES 0x1            //sendWrite payloads
+#define SIRC_COMPRESS_READS  0x2            //sendRead responses and write & run readbacks
+#define SIRC_PARAMETERS_V3_LENGTH (13 * sizeof(uint32_t))
+        //Version 4: who drives the wire (ETH_SIRC).  0: each calling thread, in turn.
+        // n: a dedicated I/O thread, pinned to CPU n-1.  Other threads hand it their
+        // bulk commands and queue their control commands for it, and never wait in the driver.
+        //Do not change it while other threads are using the instance.
+        uint32_t ioThread;
+#define SIRC_PARAMETERS_V4_LENGTH (14 * sizeof(uint32_t))
+        //Version 5: forward error correction of read responses (sirc_fec.h).  Ask for a
+        // parity frame every fecGroup data frames, read back what the FPGA agreed to, 0 for
+        // none.  A group that lost one frame is rebuilt without a resend.
+        uint32_t fecGroup;
+#define SIRC_FEC_MAXGROUP 64
+        uint32_t fecRecovered;              //Frames rebuilt so far (read-only)
+        uint32_t fecParityFrames;           //Parity frames received so far (read-only)
+#define SIRC_PARAMETERS_V5_LENGTH (17 * sizeof(uint32_t))
+        //Version 6: receive credits (SircWire::Credit).  Non-zero asks the FPGA to send no
+        // more response frames than we have receives posted for, read back whether it agreed.
+        // Large reads then do not overrun a small receive ring and wait out readTimeout.
+        uint32_t receiveCredits;
+        uint32_t creditGrants;              //Credit frames sent so far (read-only)
     } PARAMETERS;
 
     //Retrieve the active set of parameters and limits for this instance
@@ -145,6 +231,31 @@ public:
     //Modify the active set of parameters and limits for this instance
     virtual BOOL __stdcall setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length) = 0;
 
+	//Asynchronous versions of the methods above.
+	//Each queues the request and returns right away with a completion handle, or NULL
+	// (check getLastError()) if the request could not be queued.
+	//Requests run one after the other in the order they were submitted, so a sendRun
+	// submitted after a sendWrite sees the data.  Buffers must stay valid and untouched
+	// until the request completes.
+	//callback (optional) is called with context when the request completes.
+	//ETH_SIRC runs synchronous calls made while requests are outstanding in between them.
+	// With other interfaces wait for the outstanding requests first.
+	virtual SIRC_REQUEST * __stdcall submitWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer,
+		SIRC_CALLBACK callback = NULL, void *context = NULL);
+	virtual SIRC_REQUEST * __stdcall submitRead(uint32_t startAddress, uint32_t length, uint8_t *buffer,
+		SIRC_CALLBACK callback = NULL, void *context = NULL);
+	virtual SIRC_REQUEST * __stdcall submitParamRegisterWrite(uint8_t regNumber, uint32_t value,
+		SIRC_CALLBACK callback = NULL, void *context = NULL);
+	virtual SIRC_REQUEST * __stdcall submitParamRegisterRead(uint8_t regNumber,
+		SIRC_CALLBACK callback = NULL, void *context = NULL);
+	virtual SIRC_REQUEST * __stdcall submitRun(SIRC_CALLBACK callback = NULL, void *context = NULL);
+	virtual SIRC_REQUEST * __stdcall submitWaitDone(uint32_t maxWaitTimeInMsec,
+		SIRC_CALLBACK callback = NULL, void *context = NULL);
+	virtual SIRC_REQUEST * __stdcall submitReset(SIRC_CALLBACK callback = NULL, void *context = NULL);
+	virtual SIRC_REQUEST * __stdcall submitWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData, 
+		uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+		SIRC_CALLBACK callback = NULL, void *context = NULL);
+
 	//Retrieve the last error code.  Any value < 0 indicates a problem.
 	// A value === 0 indicates no error.
 	// See function prototype description above for further explanation.
@@ -157,11 +268,79 @@ public:
 		lastError = code;
 	}
 
+protected:
+	//Runs the submitted requests.  The default one calls the synchronous methods
+	// from the system thread pool, backends can return their own.
+	virtual SIRC_ASYNC * __stdcall createAsync(void);
+
+	//Complete everything submitted and free the runner.
+	//Derived destructors must call this before tearing anything down.
+	void __stdcall finishAsync(void);
+
+	//For getParameters and setParameters, so that callers built against an older
+	// PARAMETERS keep working with every interface.
+	//True if length holds all of the fields of the version inParameters says it is.
+	static BOOL __stdcall parametersLengthValid(const SIRC::PARAMETERS *inParameters, uint32_t length);
+	//Copy params (current version) out, as much of it as maxOutLength holds.  A length of
+	// an older version gets that version.
+	//True if the caller got all of the fields of some version.
+	static BOOL __stdcall copyParameters(SIRC::PARAMETERS *params, SIRC::PARAMETERS *outParameters,
+		uint32_t maxOutLength);
+
+public:
+	//Later additions to the interface.  New virtual methods go at the end, so that
+	// the ones above keep their places in the vtable for code built against older headers.
+
+	//Vectored versions of sendWrite and sendRead, for several blocks at once
+	// segments: count blocks, each as for sendWrite/sendRead
+	//Segments can come in any order.  Write segments must not overlap, read segments may.
+	//ETH_SIRC pipelines all of the segments and packs small neighbouring ones into shared
+	// frames, the other interfaces do one segment after the other.
+	//Returns true if every segment made it.
+	//If any fails, returns false.
+	// Check error code with getLastError().
+	virtual BOOL __stdcall sendWriteV(const SIRC_SEGMENT *segments, uint32_t count);
+	virtual BOOL __stdcall sendReadV(const SIRC_SEGMENT *segments, uint32_t count);
+
+	//Wait until nothing from earlier commands can still come back.
+	//A command that fails returns right away, and whatever it still had on its way is
+	// ignored as it arrives.  Callers that want a quiet line (before timing something,
+	// or before handing the board to someone else) can wait for it here.
+	// maxWaitTimeInMsec: # of milliseconds to wait at most
+	//Returns true if nothing is due any more.
+	//If something still is, returns false.  Check error code with getLastError().
+	virtual BOOL __stdcall quiesce(uint32_t maxWaitTimeInMsec);
+
+	//Have the device compute the CRC32C (see sirc_crc.h) of part of one of its buffers,
+	// so that it can be checked without reading it all back
+	// output: false for the input buffer, true for the output buffer
+	// startAddress: local address on the FPGA buffer to begin at
+	// length: # of bytes to checksum
+	// crc: the device's CRC32C of those bytes, as sircCrc32c(0, ...) would compute it
+	//Returns true if the device answered.
+	//If it did not, returns false.  Check error code with getLastError(),
+	// FAILNOCHECKSUM means the device (or the interface) does not compute checksums.
+	virtual BOOL __stdcall sendChecksum(BOOL output, uint32_t startAddress, uint32_t length, uint32_t *crc);
+
+	//sendWrite, then check with sendChecksum that the input buffer holds what was sent.
+	//Arguments as for sendWrite.
+	//Returns true if the write went through and the checksums match.
+	//If not, returns false.  Check error code with getLastError(),
+	// FAILCHECKSUM means the data was written but did not arrive intact,
+	// FAILNOCHECKSUM that it was written but could not be checked.
+	virtual BOOL __stdcall sendWriteVerified(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+
 private:
 	int8_t lastError;
+	SIRC_ASYNC * volatile async;
+	SIRC_ASYNC *getAsync(void);
+	SIRC_REQUEST *submit(SIRC_ASYNC_REQUEST *request);
 };
 
-//Open the first valid SIRC interface
+//Open the first valid SIRC interface.
+//The interfaces are probed concurrently, and which one found the board is remembered
+// in %LOCALAPPDATA%\sirc_devices.txt (or the file SIRC_REGISTRY names) so that next
+// time it is tried first, alone.
 extern SIRC_DLL_LINKAGE SIRC * __stdcall openSirc(uint8_t *FPGA_ID, uint32_t driverVersion);
 
 #endif //DEFINESIRCH
@@ -0,0 +1,412 @@
+// Title: SIRC asynchronous requests
+//
+// Description: The SIRC submit* methods, their completion handles, and the default
+// request runner.  See sirc_async.h.  Also the default bodies of the other SIRC
+// methods that have one, so that every library with the base class has them.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//Completion handles
+
+SIRC_ASYNC_REQUEST::SIRC_ASYNC_REQUEST(OPERATION operation, SIRC_CALLBACK callback, void *context)
+{
+    this->operation = operation;
+    this->callback = callback;
+    this->context = context;
+    startAddress = 0;
+    length = 0;
+    buffer = NULL;
+    regNumber = 0;
+    value = 0;
+    maxWaitTime = 0;
+    outData = NULL;
+    maxOutLength = 0;
+    segments = NULL;
+    count = 0;
+
+    done = CreateEvent(NULL, TRUE, FALSE, NULL);
+    references = 2;
+    finished = 0;
+    error = 0;
+    result = 0;
+}
+
+SIRC_ASYNC_REQUEST::~SIRC_ASYNC_REQUEST()
+{
+    if (done)
+        CloseHandle(done);
+}
+
+void SIRC_ASYNC_REQUEST::complete(int8_t code, uint32_t value)
+{
+    error = code;
+    result = value;
+
+    //The callback gets to see it first
+    if (callback)
+        callback(this, context);
+
+    InterlockedExchange(&finished, 1);
+    SetEvent(done);
+    release();
+}
+
+BOOL SIRC_ASYNC_REQUEST::wait(uint32_t maxWaitTimeInMsec)
+{
+    return WaitForSingleObject(done, maxWaitTimeInMsec) == WAIT_OBJECT_0;
+}
+
+BOOL SIRC_ASYNC_REQUEST::poll()
+{
+    return finished != 0;
+}
+
+int8_t SIRC_ASYNC_REQUEST::getError()
+{
+    return error;
+}
+
+uint32_t SIRC_ASYNC_REQUEST::getValue()
+{
+    return result;
+}
+
+HANDLE SIRC_ASYNC_REQUEST::getEvent()
+{
+    return done;
+}
+
+void SIRC_ASYNC_REQUEST::release()
+{
+    if (InterlockedDecrement(&references) == 0)
+        delete this;
+}
+
+//The default runner
+
+SIRC_ASYNC::SIRC_ASYNC(SIRC *sirc)
+{
+    this->sirc = sirc;
+    working = false;
+    InitializeCriticalSection(&lock);
+    idle = CreateEvent(NULL, TRUE, TRUE, NULL);
+}
+
+SIRC_ASYNC::~SIRC_ASYNC()
+{
+    drain();
+    if (idle)
+        CloseHandle(idle);
+    DeleteCriticalSection(&lock);
+}
+
+BOOL SIRC_ASYNC::submit(SIRC_ASYNC_REQUEST *request)
+{
+    BOOL start = false;
+
+    if (idle == NULL)
+        return false;
+
+    EnterCriticalSection(&lock);
+    queue.push_back(request);
+    if (!working) {
+        working = true;
+        ResetEvent(idle);
+        start = true;
+    }
+    LeaveCriticalSection(&lock);
+
+    //No pool thread for us, do it here then
+    if (start && !QueueUserWorkItem(workerProc, this, WT_EXECUTELONGFUNCTION))
+        work();
+    return true;
+}
+
+void SIRC_ASYNC::drain()
+{
+    if (idle)
+        WaitForSingleObject(idle, INFINITE);
+}
+
+DWORD WINAPI SIRC_ASYNC::workerProc(LPVOID lpParam)
+{
+    ((SIRC_ASYNC *) lpParam)->work();
+    return 0;
+}
+
+void SIRC_ASYNC::work()
+{
+    std::list <SIRC_ASYNC_REQUEST *> batch;
+
+    for (;;) {
+        EnterCriticalSection(&lock);
+        if (queue.empty()) {
+            working = false;
+            SetEvent(idle);
+            LeaveCriticalSection(&lock);
+            return;
+        }
+        batch.swap(queue);
+        LeaveCriticalSection(&lock);
+
+        LogIt("sirc::async.batch %u",(uint32_t)batch.size());
+        run(batch);
+        batch.clear();
+    }
+}
+
+void SIRC_ASYNC::run(std::list <SIRC_ASYNC_REQUEST *> &batch)
+{
+    std::list <SIRC_ASYNC_REQUEST *>::iterator iter;
+
+    for (iter = batch.begin(); iter != batch.end(); iter++)
+        execute(*iter);
+}
+
+void SIRC_ASYNC::execute(SIRC_ASYNC_REQUEST *request)
+{
+    BOOL ok = false;
+    uint32_t value = 0;
+    int8_t failCode = FAILWRITEACK;
+    int8_t error = 0;
+
+    switch (request->operation) {
+    case SIRC_ASYNC_REQUEST::WRITE:
+        ok = sirc->sendWrite(request->startAddress, request->length, request->buffer);
+        break;
+    case SIRC_ASYNC_REQUEST::READ:
+        ok = sirc->sendRead(request->startAddress, request->length, request->buffer);
+        failCode = FAILREADACK;
+        break;
+    case SIRC_ASYNC_REQUEST::PARAMWRITE:
+        ok = sirc->sendParamRegisterWrite(request->regNumber, request->value);
+        break;
+    case SIRC_ASYNC_REQUEST::PARAMREAD:
+        ok = sirc->sendParamRegisterRead(request->regNumber, &value);
+        failCode = FAILREADACK;
+        break;
+    case SIRC_ASYNC_REQUEST::RUN:
+        ok = sirc->sendRun();
+        break;
+    case SIRC_ASYNC_REQUEST::WAITDONE:
+        ok = sirc->waitDone(request->maxWaitTime);
+        failCode = FAILDONE;
+        break;
+    case SIRC_ASYNC_REQUEST::RESET:
+        ok = sirc->sendReset();
+        failCode = FAILRESETACK;
+        break;
+    case SIRC_ASYNC_REQUEST::WRITEANDRUN:
+        ok = sirc->sendWriteAndRun(request->startAddress, request->length, request->buffer,
+                                   request->maxWaitTime, request->outData, request->maxOutLength, &value);
+        failCode = FAILWRITEANDRUNREADACK;
+        break;
+    case SIRC_ASYNC_REQUEST::WRITEV:
+        ok = sirc->sendWriteV(request->segments, request->count);
+        break;
+    case SIRC_ASYNC_REQUEST::READV:
+        ok = sirc->sendReadV(request->segments, request->count);
+        failCode = FAILREADACK;
+        break;
+    case SIRC_ASYNC_REQUEST::CHECKSUM:
+        ok = sirc->sendChecksum(request->regNumber != 0, request->startAddress, request->length, &value);
+        failCode = FAILNOCHECKSUM;
+        break;
+    }
+
+    //A synchronous call from another thread could have reset the code already
+    if (!ok) {
+        error = sirc->getLastError();
+        if (error == 0)
+            error = failCode;
+    }
+    request->complete(error, value);
+}
+
+//SIRC base class
+
+SIRC_ASYNC *SIRC::createAsync()
+{
+    return new SIRC_ASYNC(this);
+}
+
+void SIRC::finishAsync()
+{
+    if (async) {
+        delete async;
+        async = NULL;
+    }
+}
+
+SIRC_ASYNC *SIRC::getAsync()
+{
+    if (async == NULL) {
+        SIRC_ASYNC *runner = createAsync();
+        //Someone else got there first
+        if (InterlockedCompareExchangePointer((PVOID volatile *)&async, runner, NULL) != NULL)
+            delete runner;
+    }
+    return async;
+}
+
+SIRC_REQUEST *SIRC::submit(SIRC_ASYNC_REQUEST *request)
+{
+    SIRC_ASYNC *runner = getAsync();
+
+    if (!request->valid() || !runner->submit(request)) {
+        //Nobody will complete it, drop both references
+        request->release();
+        request->release();
+        setLastError(FAILMEMALLOC);
+        return NULL;
+    }
+    return request;
+}
+
+SIRC_REQUEST *SIRC::submitWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer,
+                                SIRC_CALLBACK callback, void *context)
+{
+    SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::WRITE, callback, context);
+
+    request->startAddress = startAddress;
+    request->length = length;
+    request->buffer = buffer;
+    return submit(request);
+}
+
+SIRC_REQUEST *SIRC::submitRead(uint32_t startAddress, uint32_t length, uint8_t *buffer,
+                               SIRC_CALLBACK callback, void *context)
+{
+    SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::READ, callback, context);
+
+    request->startAddress = startAddress;
+    request->length = length;
+    request->buffer = buffer;
+    return submit(request);
+}
+
+SIRC_REQUEST *SIRC::submitParamRegisterWrite(uint8_t regNumber, uint32_t value,
+                                             SIRC_CALLBACK callback, void *context)
+{
+    SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::PARAMWRITE, callback, context);
+
+    request->regNumber = regNumber;
+    request->value = value;
+    return submit(request);
+}
+
+SIRC_REQUEST *SIRC::submitParamRegisterRead(uint8_t regNumber, SIRC_CALLBACK callback, void *context)
+{
+    SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::PARAMREAD, callback, context);
+
+    request->regNumber = regNumber;
+    return submit(request);
+}
+
+SIRC_REQUEST *SIRC::submitRun(SIRC_CALLBACK callback, void *context)
+{
+    return submit(new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::RUN, callback, context));
+}
+
+SIRC_REQUEST *SIRC::submitWaitDone(uint32_t maxWaitTimeInMsec, SIRC_CALLBACK callback, void *context)
+{
+    SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::WAITDONE, callback, context);
+
+    request->maxWaitTime = maxWaitTimeInMsec;
+    return submit(request);
+}
+
+SIRC_REQUEST *SIRC::submitReset(SIRC_CALLBACK callback, void *context)
+{
+    return submit(new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::RESET, callback, context));
+}
+
+SIRC_REQUEST *SIRC::submitWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+                                      uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+                                      SIRC_CALLBACK callback, void *context)
+{
+    SIRC_ASYNC_REQUEST *request = new SIRC_ASYNC_REQUEST(SIRC_ASYNC_REQUEST::WRITEANDRUN, callback, context);
+
+    request->startAddress = startAddress;
+    request->length = inLength;
+    request->buffer = inData;
+    request->maxWaitTime = maxWaitTimeinMsec;
+    request->outData = outData;
+    request->maxOutLength = maxOutLength;
+    return submit(request);
+}
+
+//Defaults of the later additions to the SIRC interface
+
+//Interfaces without a wire have nothing in flight once a call returns
+BOOL SIRC::quiesce(uint32_t maxWaitTimeInMsec)
+{
+    setLastError(0);
+    return true;
+}
+
+//Vectored transfers for interfaces that have nothing better: one segment at a time
+BOOL SIRC::sendWriteV(const SIRC_SEGMENT *segments, uint32_t count)
+{
+    if (segments == NULL) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (count == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+    for (uint32_t s = 0; s < count; s++) {
+        if (!sendWrite(segments[s].startAddress, segments[s].length, segments[s].buffer))
+            return false;
+    }
+    return true;
+}
+
+BOOL SIRC::sendReadV(const SIRC_SEGMENT *segments, uint32_t count)
+{
+    if (segments == NULL) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (count == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+    for (uint32_t s = 0; s < count; s++) {
+        if (!sendRead(segments[s].startAddress, segments[s].length, segments[s].buffer))
+            return false;
+    }
+    return true;
+}
+
+//Interfaces that cannot ask the device for a checksum
+BOOL SIRC::sendChecksum(BOOL output, uint32_t startAddress, uint32_t length, uint32_t *crc)
+{
+    setLastError(FAILNOCHECKSUM);
+    return false;
+}
+
+//The device's checksum against ours, instead of reading the input back
+BOOL SIRC::sendWriteVerified(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    uint32_t crc;
+
+    if (!sendWrite(startAddress, length, buffer) ||
+        !sendChecksum(false, startAddress, length, &crc))
+        return false;
+    if (crc != sircCrc32c(0, buffer, length)) {
+        setLastError(FAILCHECKSUM);
+        return false;
+    }
+    return true;
+}
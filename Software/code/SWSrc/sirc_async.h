@@ -0,0 +1,114 @@
+// Title: SIRC asynchronous requests
+//
+// Description: Completion handles and the request runner behind the SIRC submit* methods.
+// The default runner executes requests through the synchronous methods, one at a time,
+// from the system thread pool.  Backends that can do better (ETH_SIRC) derive their own.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCASYNCH
+#define DEFINESIRCASYNCH 1
+
+//One submitted request, and its handle
+class SIRC_ASYNC_REQUEST : public SIRC_REQUEST {
+public:
+    typedef enum {
+        WRITE,
+        READ,
+        PARAMWRITE,
+        PARAMREAD,
+        RUN,
+        WAITDONE,
+        RESET,
+        WRITEANDRUN,
+        WRITEV,
+        READV,
+        CHECKSUM
+    } OPERATION;
+
+    SIRC_ASYNC_REQUEST(OPERATION operation, SIRC_CALLBACK callback, void *context);
+
+    //Arguments, as for the synchronous method
+    OPERATION operation;
+    uint32_t startAddress;
+    uint32_t length;
+    uint8_t *buffer;            //inData for WRITEANDRUN
+    uint8_t regNumber;          //the buffer for CHECKSUM, 1 for output
+    uint32_t value;             //register value for PARAMWRITE
+    uint32_t maxWaitTime;
+    uint8_t *outData;
+    uint32_t maxOutLength;
+    const SIRC_SEGMENT *segments;   //WRITEV and READV
+    uint32_t count;
+
+    //Only the runner calls this, once
+    void complete(int8_t error, uint32_t value);
+
+    //SIRC_REQUEST
+    BOOL __stdcall wait(uint32_t maxWaitTimeInMsec);
+    BOOL __stdcall poll(void);
+    int8_t __stdcall getError(void);
+    uint32_t __stdcall getValue(void);
+    HANDLE __stdcall getEvent(void);
+    void __stdcall release(void);
+
+    inline BOOL valid(void) { return done != NULL; }
+
+protected:
+    __stdcall ~SIRC_ASYNC_REQUEST();
+
+private:
+    SIRC_CALLBACK callback;
+    void *context;
+    HANDLE done;
+    volatile LONG references;   //the caller's and the runner's
+    volatile LONG finished;
+    int8_t error;
+    uint32_t result;
+};
+
+//Runs the requests of one SIRC object in order.
+//At most one worker is active at any time.  It takes everything queued so far as a
+// batch, runs it, and comes back for more until the queue is empty.
+class SIRC_ASYNC {
+public:
+    SIRC_ASYNC(SIRC *sirc);
+    //Waits for everything submitted
+    virtual ~SIRC_ASYNC();
+
+    //Queue a request and make sure a worker is on it.
+    //Returns false if the runner could not be set up.
+    //Backends can send it somewhere else (ETH_SIRC's I/O thread).
+    virtual BOOL submit(SIRC_ASYNC_REQUEST *request);
+
+    //Wait until every request submitted so far has completed
+    void drain(void);
+
+protected:
+    //Run and complete every request in the batch, in order.
+    //The default runs them one at a time.
+    virtual void run(std::list <SIRC_ASYNC_REQUEST *> &batch);
+
+    //Run one request through the synchronous methods and complete it
+    void execute(SIRC_ASYNC_REQUEST *request);
+
+    SIRC *sirc;
+
+private:
+    CRITICAL_SECTION lock;      //protects queue and working
+    std::list <SIRC_ASYNC_REQUEST *> queue;
+    BOOL working;
+    HANDLE idle;                //set while there is no worker
+
+    static DWORD WINAPI workerProc(LPVOID lpParam);
+    void work(void);
+};
+
+#endif //DEFINESIRCASYNCH
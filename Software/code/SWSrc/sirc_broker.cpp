@@ -0,0 +1,790 @@
+// Title: SIRC broker
+//
+// Description: Serves one process's SIRC to clients in other processes, through a
+// named pipe and a shared memory section per client.  See sirc_broker.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//Calls over the pipe
+#define BROKER_HELLO 1
+#define BROKER_WRITE 2
+#define BROKER_READ 3
+#define BROKER_REGWRITE 4
+#define BROKER_REGREAD 5
+#define BROKER_RUN 6
+#define BROKER_WAITDONE 7
+#define BROKER_RESET 8
+#define BROKER_WRITEANDRUN 9
+#define BROKER_QUIESCE 10
+#define BROKER_GETPARAMETERS 11
+#define BROKER_SETPARAMETERS 12
+#define BROKER_LOCK 13
+#define BROKER_UNLOCK 14
+
+//Clients and broker must agree on the above
+#define BROKER_VERSION 1
+
+//How long a client waits for the broker to take another connection
+#define BROKERCONNECTMSEC 2000
+
+//How often stop() knocks until run() notices
+#define BROKERWAKEMSEC 10
+
+static void brokerPipeName(wchar_t *pipeName, size_t size, const wchar_t *name)
+{
+    _snwprintf_s(pipeName, size, _TRUNCATE, L"\\\\.\\pipe\\sirc_broker_%s", name);
+}
+
+//Each client's section, named for the broker process and the connection
+static void brokerSectionName(wchar_t *sectionName, size_t size, const wchar_t *name,
+                              DWORD process, uint32_t connection)
+{
+    _snwprintf_s(sectionName, size, _TRUNCATE, L"Local\\sirc_broker_%s_%u_%u",
+                 name, (uint32_t) process, connection);
+}
+
+static int8_t brokerCheckName(const wchar_t *name)
+{
+    size_t length;
+
+    if (!name)
+        return INVALIDBUFFER;
+    length = wcslen(name);
+    if (length == 0 || length > SIRC_BROKER_MAX_NAME || wcschr(name, L'\\'))
+        return INVALIDLENGTH;
+    return 0;
+}
+
+//PUBLIC FUNCTIONS
+//Constructor for the class
+//Return with an error code if anything goes wrong.
+SIRC_DLL_LINKAGE SIRC_BROKER::SIRC_BROKER(SIRC *device, const wchar_t *name, BOOL ownsDevice)
+{
+    lastError = 0;
+    this->device = device;
+    this->ownsDevice = ownsDevice;
+    this->name[0] = 0;
+    pipeName[0] = 0;
+    stopping = 0;
+    listening = 0;
+    owner = NULL;
+    virtualNow = 0;
+    connections = 0;
+    memset(&statistics, 0, sizeof(statistics));
+    QueryPerformanceFrequency(&frequency);
+    InitializeCriticalSection(&lock);
+
+    if (!device) {
+        lastError = INVALIDBUFFER;
+        return;
+    }
+    if (device->getLastError() != 0) {
+        lastError = device->getLastError();
+        return;
+    }
+    lastError = brokerCheckName(name);
+    if (lastError != 0)
+        return;
+    wcscpy_s(this->name, SIRC_BROKER_MAX_NAME + 1, name);
+    brokerPipeName(pipeName, sizeof(pipeName) / sizeof(pipeName[0]), name);
+}
+
+//run() must have returned
+SIRC_DLL_LINKAGE SIRC_BROKER::~SIRC_BROKER()
+{
+    DeleteCriticalSection(&lock);
+    if (ownsDevice)
+        delete device;
+}
+
+SIRC_DLL_LINKAGE BOOL SIRC_BROKER::run()
+{
+    HANDLE pipe;
+    DWORD first = FILE_FLAG_FIRST_PIPE_INSTANCE;
+    BOOL connected;
+
+    if (lastError != 0)
+        return false;
+
+    LogIt("sirc::broker.run %u",(uint32_t) GetCurrentProcessId());
+    InterlockedExchange(&listening, 1);
+    while (!stopping) {
+        pipe = CreateNamedPipeW(pipeName, PIPE_ACCESS_DUPLEX | first,
+                                PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                PIPE_UNLIMITED_INSTANCES, sizeof(SIRC_BROKER_REPLY), sizeof(SIRC_BROKER_CALL),
+                                0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            LogIt("sirc::broker.pipe %u",(uint32_t) GetLastError());
+            lastError = FAILBROKER;
+            break;
+        }
+        first = 0;
+        connected = ConnectNamedPipe(pipe, NULL) || (GetLastError() == ERROR_PIPE_CONNECTED);
+        if (stopping || !connected || !accept(pipe))
+            CloseHandle(pipe);
+    }
+    InterlockedExchange(&listening, 0);
+
+    //Hang up on everyone.  Calls in progress finish, the next read or reply fails.
+    EnterCriticalSection(&lock);
+    for (std::list<CLIENT *>::iterator c = clients.begin(); c != clients.end(); c++) {
+        DisconnectNamedPipe((*c)->pipe);
+        CancelSynchronousIo((*c)->thread);
+    }
+    LeaveCriticalSection(&lock);
+    for (std::list<HANDLE>::iterator t = threads.begin(); t != threads.end(); t++) {
+        WaitForSingleObject(*t, INFINITE);
+        CloseHandle(*t);
+    }
+    threads.clear();
+    LogIt("sirc::broker.stop %u",statistics.connects);
+    return (lastError == 0);
+}
+
+SIRC_DLL_LINKAGE void SIRC_BROKER::stop()
+{
+    HANDLE wake;
+
+    InterlockedExchange(&stopping, 1);
+    //Get run() out of ConnectNamedPipe.  Between two pipe instances there is none to
+    // connect to, so knock until it has left the loop.
+    while (listening) {
+        wake = CreateFileW(pipeName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (wake != INVALID_HANDLE_VALUE)
+            CloseHandle(wake);
+        Sleep(BROKERWAKEMSEC);
+    }
+}
+
+SIRC_DLL_LINKAGE void SIRC_BROKER::getStatistics(SIRC_BROKER_STATISTICS *outStatistics)
+{
+    EnterCriticalSection(&lock);
+    *outStatistics = statistics;
+    LeaveCriticalSection(&lock);
+}
+
+//PRIVATE FUNCTIONS
+
+//A client connected on the pipe, give it a thread.
+//Returns false if it cannot have one, the caller hangs up.
+BOOL SIRC_BROKER::accept(HANDLE pipe)
+{
+    CLIENT *client;
+    HANDLE thread;
+
+    //Forget the threads of clients long gone
+    for (std::list<HANDLE>::iterator t = threads.begin(); t != threads.end(); ) {
+        if (WaitForSingleObject(*t, 0) == WAIT_OBJECT_0) {
+            CloseHandle(*t);
+            t = threads.erase(t);
+        } else
+            t++;
+    }
+
+    client = new CLIENT;
+    if (!client)
+        return false;
+    memset(client, 0, sizeof(*client));
+    client->broker = this;
+    client->pipe = pipe;
+    client->priority = SIRC_BROKER_PRIORITY_NORMAL;
+    client->turn = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!client->turn) {
+        delete client;
+        return false;
+    }
+
+    //The thread cannot leave before it is on the list, it needs the lock for that
+    EnterCriticalSection(&lock);
+    client->connection = ++connections;
+    thread = CreateThread(NULL, 0, serveClient, client, 0, NULL);
+    if (thread) {
+        client->thread = thread;
+        clients.push_back(client);
+        threads.push_back(thread);
+        statistics.clients++;
+        statistics.connects++;
+    }
+    LeaveCriticalSection(&lock);
+
+    if (!thread) {
+        CloseHandle(client->turn);
+        delete client;
+        return false;
+    }
+    return true;
+}
+
+DWORD WINAPI SIRC_BROKER::serveClient(LPVOID lpParam)
+{
+    CLIENT *client = (CLIENT *) lpParam;
+    SIRC_BROKER *broker = client->broker;
+    SIRC_BROKER_CALL call;
+    SIRC_BROKER_REPLY reply;
+    DWORD got, put;
+
+    if (broker->hello(client)) {
+        while (ReadFile(client->pipe, &call, sizeof(call), &got, NULL) && (got == sizeof(call))) {
+            memset(&reply, 0, sizeof(reply));
+            reply.ok = true;
+            if (call.op == BROKER_LOCK) {
+                if (!client->holding) {
+                    broker->acquire(client);
+                    client->holding = true;
+                }
+            } else if (call.op == BROKER_UNLOCK) {
+                if (client->holding) {
+                    client->holding = false;
+                    broker->release(client);
+                }
+            } else {
+                if (!client->holding)
+                    broker->acquire(client);
+                broker->execute(client, &call, &reply);
+                if (!client->holding)
+                    broker->release(client);
+            }
+            if (!WriteFile(client->pipe, &reply, sizeof(reply), &put, NULL))
+                break;
+        }
+    }
+    broker->drop(client);
+    return 0;
+}
+
+//First message from a new client: check its version, note its priority, and make
+// its section.  The reply has the connection number (for the section's name) and
+// the section's size.
+//Returns true if the client can go on.
+BOOL SIRC_BROKER::hello(CLIENT *client)
+{
+    SIRC_BROKER_CALL call;
+    SIRC_BROKER_REPLY reply;
+    SIRC::PARAMETERS parameters;
+    wchar_t sectionName[SIRC_BROKER_MAX_NAME + 64];
+    DWORD got, put;
+    BOOL known;
+
+    if (!ReadFile(client->pipe, &call, sizeof(call), &got, NULL) || (got != sizeof(call)))
+        return false;
+
+    memset(&reply, 0, sizeof(reply));
+    reply.error = FAILBROKER;
+    if ((call.op == BROKER_HELLO) && (call.address == BROKER_VERSION)) {
+        client->priority = call.value;
+        if (client->priority < SIRC_BROKER_PRIORITY_LOWEST)
+            client->priority = SIRC_BROKER_PRIORITY_LOWEST;
+        if (client->priority > SIRC_BROKER_PRIORITY_HIGHEST)
+            client->priority = SIRC_BROKER_PRIORITY_HIGHEST;
+
+        //Room for the largest input and the largest output at once
+        memset(&parameters, 0, sizeof(parameters));
+        parameters.myVersion = SIRC_PARAMETERS_CURRENT_VERSION;
+        acquire(client);
+        known = device->getParameters(&parameters, sizeof(parameters));
+        release(client);
+        client->sharedBytes = parameters.maxInputDataBytes + parameters.maxOutputDataBytes;
+        if (known && (client->sharedBytes >= parameters.maxInputDataBytes) &&
+            (client->sharedBytes >= sizeof(parameters))) {
+            brokerSectionName(sectionName, sizeof(sectionName) / sizeof(sectionName[0]), name,
+                              GetCurrentProcessId(), client->connection);
+            client->section = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                                 client->sharedBytes, sectionName);
+            if (client->section)
+                client->shared = (uint8_t *) MapViewOfFile(client->section, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+            reply.error = FAILMEMALLOC;
+        }
+        if (client->shared) {
+            reply.ok = true;
+            reply.error = 0;
+            reply.value = client->connection;
+            reply.length = client->sharedBytes;
+        }
+    }
+    LogIt("sirc::broker.hello %u %u",client->connection,client->priority);
+    return WriteFile(client->pipe, &reply, sizeof(reply), &put, NULL) && reply.ok;
+}
+
+//Wait for the client's turn on the device.
+//Turns go to the waiting client that used the least device time for its priority.
+void SIRC_BROKER::acquire(CLIENT *client)
+{
+    LARGE_INTEGER asked;
+    BOOL waits;
+
+    QueryPerformanceCounter(&asked);
+    EnterCriticalSection(&lock);
+    //An idle client does not save up turns
+    if (client->used < virtualNow)
+        client->used = virtualNow;
+    client->waiting = true;
+    waits = (owner != NULL);
+    if (!waits)
+        handOn();
+    LeaveCriticalSection(&lock);
+
+    WaitForSingleObject(client->turn, INFINITE);
+    QueryPerformanceCounter(&client->since);
+
+    if (waits) {
+        EnterCriticalSection(&lock);
+        statistics.waits++;
+        statistics.waitedUsec += (ULONGLONG) (client->since.QuadPart - asked.QuadPart) * 1000000 /
+                                 frequency.QuadPart;
+        LeaveCriticalSection(&lock);
+    }
+}
+
+//Charge the client for its turn and give the device to the next one
+void SIRC_BROKER::release(CLIENT *client)
+{
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+    EnterCriticalSection(&lock);
+    client->used += (ULONGLONG) (now.QuadPart - client->since.QuadPart) *
+                    SIRC_BROKER_PRIORITY_HIGHEST / client->priority;
+    owner = NULL;
+    handOn();
+    LeaveCriticalSection(&lock);
+}
+
+//The device is free, wake the next client.  Called with the lock held.
+void SIRC_BROKER::handOn()
+{
+    CLIENT *next = NULL;
+
+    for (std::list<CLIENT *>::iterator c = clients.begin(); c != clients.end(); c++) {
+        if ((*c)->waiting && (!next || ((*c)->used < next->used)))
+            next = *c;
+    }
+    owner = next;
+    if (!next)
+        return;
+    next->waiting = false;
+    if (next->used > virtualNow)
+        virtualNow = next->used;
+    SetEvent(next->turn);
+}
+
+//Run one call on the device, the client has it.
+//The payloads must lie within the client's section.
+BOOL SIRC_BROKER::execute(CLIENT *client, const SIRC_BROKER_CALL *call, SIRC_BROKER_REPLY *reply)
+{
+    uint8_t *in, *out;
+
+    if ((call->offset > client->sharedBytes) || (call->length > client->sharedBytes - call->offset) ||
+        (call->outOffset > client->sharedBytes) || (call->outLength > client->sharedBytes - call->outOffset)) {
+        reply->ok = false;
+        reply->error = INVALIDLENGTH;
+        return false;
+    }
+    in = client->shared + call->offset;
+    out = client->shared + call->outOffset;
+
+    switch (call->op) {
+    case BROKER_WRITE:
+        reply->ok = device->sendWrite(call->address, call->length, in);
+        break;
+    case BROKER_READ:
+        reply->ok = device->sendRead(call->address, call->outLength, out);
+        break;
+    case BROKER_REGWRITE:
+        reply->ok = device->sendParamRegisterWrite((uint8_t) call->address, call->value);
+        break;
+    case BROKER_REGREAD:
+        reply->ok = device->sendParamRegisterRead((uint8_t) call->address, &reply->value);
+        break;
+    case BROKER_RUN:
+        reply->ok = device->sendRun();
+        break;
+    case BROKER_WAITDONE:
+        reply->ok = device->waitDone(call->value);
+        break;
+    case BROKER_RESET:
+        reply->ok = device->sendReset();
+        break;
+    case BROKER_WRITEANDRUN:
+        reply->ok = device->sendWriteAndRun(call->address, call->length, in, call->value,
+                                            out, call->outLength, &reply->length);
+        break;
+    case BROKER_QUIESCE:
+        reply->ok = device->quiesce(call->value);
+        break;
+    case BROKER_GETPARAMETERS:
+        reply->ok = device->getParameters((SIRC::PARAMETERS *) out, call->outLength);
+        break;
+    case BROKER_SETPARAMETERS:
+        reply->ok = device->setParameters((const SIRC::PARAMETERS *) in, call->length);
+        break;
+    default:
+        reply->ok = false;
+        reply->error = FAILBROKER;
+        return false;
+    }
+    reply->error = reply->ok ? 0 : device->getLastError();
+
+    //Counted under the lock like the rest of statistics, which getStatistics reads
+    EnterCriticalSection(&lock);
+    statistics.calls++;
+    LeaveCriticalSection(&lock);
+    return reply->ok;
+}
+
+//The client hung up, or we did
+void SIRC_BROKER::drop(CLIENT *client)
+{
+    if (client->holding) {
+        client->holding = false;
+        release(client);
+    }
+
+    EnterCriticalSection(&lock);
+    clients.remove(client);
+    statistics.clients--;
+    DisconnectNamedPipe(client->pipe);
+    CloseHandle(client->pipe);
+    LeaveCriticalSection(&lock);
+
+    LogIt("sirc::broker.drop %u",client->connection);
+    if (client->shared)
+        UnmapViewOfFile(client->shared);
+    if (client->section)
+        CloseHandle(client->section);
+    CloseHandle(client->turn);
+    delete client;
+}
+
+//CLIENT SIDE
+//Constructor for the class
+//Return with an error code if anything goes wrong.
+SIRC_DLL_LINKAGE BROKER_SIRC::BROKER_SIRC(const wchar_t *name, uint32_t priority)
+{
+    wchar_t pipeName[SIRC_BROKER_MAX_NAME + 32];
+    wchar_t sectionName[SIRC_BROKER_MAX_NAME + 64];
+    SIRC_BROKER_CALL request;
+    SIRC_BROKER_REPLY reply;
+    SIRC::PARAMETERS parameters;
+    DWORD mode = PIPE_READMODE_MESSAGE;
+    ULONG server;
+
+    pipe = INVALID_HANDLE_VALUE;
+    section = NULL;
+    shared = NULL;
+    sharedBytes = 0;
+    outStage = 0;
+    InitializeCriticalSection(&lock);
+    setLastError(brokerCheckName(name));
+    if (getLastError() != 0)
+        return;
+    if (priority < SIRC_BROKER_PRIORITY_LOWEST || priority > SIRC_BROKER_PRIORITY_HIGHEST) {
+        setLastError(INVALIDLENGTH);
+        return;
+    }
+
+    brokerPipeName(pipeName, sizeof(pipeName) / sizeof(pipeName[0]), name);
+    pipe = CreateFileW(pipeName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    //All instances taken, the broker is about to make another
+    if ((pipe == INVALID_HANDLE_VALUE) && (GetLastError() == ERROR_PIPE_BUSY) &&
+        WaitNamedPipeW(pipeName, BROKERCONNECTMSEC))
+        pipe = CreateFileW(pipeName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if ((pipe == INVALID_HANDLE_VALUE) || !SetNamedPipeHandleState(pipe, &mode, NULL, NULL) ||
+        !GetNamedPipeServerProcessId(pipe, &server)) {
+        setLastError(FAILBROKER);
+        return;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.op = BROKER_HELLO;
+    request.address = BROKER_VERSION;
+    request.value = priority;
+    if (!call(&request, &reply))
+        return;
+
+    sharedBytes = reply.length;
+    brokerSectionName(sectionName, sizeof(sectionName) / sizeof(sectionName[0]), name,
+                      server, reply.value);
+    section = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, sectionName);
+    if (section)
+        shared = (uint8_t *) MapViewOfFile(section, FILE_MAP_ALL_ACCESS, 0, 0, sharedBytes);
+    if (!shared) {
+        setLastError(FAILBROKER);
+        return;
+    }
+
+    //Output is staged past the largest input
+    parameters.myVersion = SIRC_PARAMETERS_CURRENT_VERSION;
+    if (!getParameters(&parameters, sizeof(parameters)))
+        return;
+    outStage = (parameters.maxInputDataBytes < sharedBytes) ? parameters.maxInputDataBytes : sharedBytes;
+    LogIt("sirc::broker.connect %u %u",reply.value,sharedBytes);
+}
+
+SIRC_DLL_LINKAGE BROKER_SIRC::~BROKER_SIRC()
+{
+    //Submitted requests still come through us
+    finishAsync();
+
+    //The broker lets go of the device if we held it
+    if (pipe != INVALID_HANDLE_VALUE)
+        CloseHandle(pipe);
+    if (shared)
+        UnmapViewOfFile(shared);
+    if (section)
+        CloseHandle(section);
+    DeleteCriticalSection(&lock);
+}
+
+BOOL BROKER_SIRC::sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    SIRC_BROKER_CALL request;
+    SIRC_BROKER_REPLY reply;
+    BOOL staged;
+    BOOL ok;
+
+    memset(&request, 0, sizeof(request));
+    EnterCriticalSection(&lock);
+    ok = place(buffer, length, false, &request.offset, &staged);
+    if (ok) {
+        if (staged)
+            memcpy(shared + request.offset, buffer, length);
+        request.op = BROKER_WRITE;
+        request.address = startAddress;
+        request.length = length;
+        ok = call(&request, &reply);
+    }
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+BOOL BROKER_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    SIRC_BROKER_CALL request;
+    SIRC_BROKER_REPLY reply;
+    BOOL staged;
+    BOOL ok;
+
+    memset(&request, 0, sizeof(request));
+    EnterCriticalSection(&lock);
+    ok = place(buffer, length, true, &request.outOffset, &staged);
+    if (ok) {
+        request.op = BROKER_READ;
+        request.address = startAddress;
+        request.outLength = length;
+        ok = call(&request, &reply);
+        if (ok && staged)
+            memcpy(buffer, shared + request.outOffset, length);
+    }
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+BOOL BROKER_SIRC::sendParamRegisterWrite(uint8_t regNumber, uint32_t value)
+{
+    return control(BROKER_REGWRITE, regNumber, value, NULL);
+}
+
+BOOL BROKER_SIRC::sendParamRegisterRead(uint8_t regNumber, uint32_t *value)
+{
+    if (!value) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    return control(BROKER_REGREAD, regNumber, 0, value);
+}
+
+BOOL BROKER_SIRC::sendRun()
+{
+    return control(BROKER_RUN, 0, 0, NULL);
+}
+
+BOOL BROKER_SIRC::waitDone(uint32_t maxWaitTimeInMsec)
+{
+    return control(BROKER_WAITDONE, 0, maxWaitTimeInMsec, NULL);
+}
+
+BOOL BROKER_SIRC::sendReset()
+{
+    return control(BROKER_RESET, 0, 0, NULL);
+}
+
+BOOL BROKER_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+                                  uint32_t maxWaitTimeInMsec, uint8_t *outData, uint32_t maxOutLength,
+                                  uint32_t *outputLength)
+{
+    SIRC_BROKER_CALL request;
+    SIRC_BROKER_REPLY reply;
+    BOOL inStaged, outStaged;
+    BOOL ok;
+
+    if (!outputLength) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    memset(&request, 0, sizeof(request));
+    EnterCriticalSection(&lock);
+    ok = place(inData, inLength, false, &request.offset, &inStaged) &&
+         place(outData, maxOutLength, true, &request.outOffset, &outStaged);
+    if (ok) {
+        if (inStaged)
+            memcpy(shared + request.offset, inData, inLength);
+        request.op = BROKER_WRITEANDRUN;
+        request.address = startAddress;
+        request.length = inLength;
+        request.value = maxWaitTimeInMsec;
+        request.outLength = maxOutLength;
+        ok = call(&request, &reply);
+        *outputLength = reply.length;
+        //On FAILWRITEANDRUNCAPACITY the first maxOutLength bytes came back too
+        if (outStaged && (ok || getLastError() == FAILWRITEANDRUNCAPACITY))
+            memcpy(outData, shared + request.outOffset, (reply.length < maxOutLength) ? reply.length : maxOutLength);
+    }
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+BOOL BROKER_SIRC::quiesce(uint32_t maxWaitTimeInMsec)
+{
+    return control(BROKER_QUIESCE, 0, maxWaitTimeInMsec, NULL);
+}
+
+BOOL BROKER_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength)
+{
+    SIRC_BROKER_CALL request;
+    SIRC_BROKER_REPLY reply;
+    BOOL staged;
+    BOOL ok;
+
+    memset(&request, 0, sizeof(request));
+    EnterCriticalSection(&lock);
+    ok = place(outParameters, maxOutLength, true, &request.outOffset, &staged);
+    if (ok) {
+        //The device looks at myVersion
+        if (staged)
+            memcpy(shared + request.outOffset, outParameters, maxOutLength);
+        request.op = BROKER_GETPARAMETERS;
+        request.outLength = maxOutLength;
+        ok = call(&request, &reply);
+        if (ok && staged)
+            memcpy(outParameters, shared + request.outOffset, maxOutLength);
+    }
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+BOOL BROKER_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
+{
+    SIRC_BROKER_CALL request;
+    SIRC_BROKER_REPLY reply;
+    BOOL staged;
+    BOOL ok;
+
+    memset(&request, 0, sizeof(request));
+    EnterCriticalSection(&lock);
+    ok = place(inParameters, length, false, &request.offset, &staged);
+    if (ok) {
+        if (staged)
+            memcpy(shared + request.offset, inParameters, length);
+        request.op = BROKER_SETPARAMETERS;
+        request.length = length;
+        ok = call(&request, &reply);
+    }
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+SIRC_DLL_LINKAGE BOOL BROKER_SIRC::lockDevice()
+{
+    return control(BROKER_LOCK, 0, 0, NULL);
+}
+
+SIRC_DLL_LINKAGE BOOL BROKER_SIRC::unlockDevice()
+{
+    return control(BROKER_UNLOCK, 0, 0, NULL);
+}
+
+SIRC_DLL_LINKAGE uint8_t *BROKER_SIRC::getSharedBuffer(uint32_t *size)
+{
+    if (size)
+        *size = sharedBytes;
+    return shared;
+}
+
+//Where a payload goes in the section: in place if the buffer lies within it, else
+// at its stage (input at 0, output at outStage), where it must fit.
+//Returns false w/error code if it does not.
+BOOL BROKER_SIRC::place(const void *buffer, uint32_t length, BOOL output, uint32_t *offset, BOOL *staged)
+{
+    const uint8_t *at = (const uint8_t *) buffer;
+    uint32_t room = output ? sharedBytes - outStage : outStage;
+
+    if (!buffer) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (shared && (at >= shared) && (at < shared + sharedBytes) &&
+        (length <= (uint32_t) (shared + sharedBytes - at))) {
+        *offset = (uint32_t) (at - shared);
+        *staged = false;
+        return true;
+    }
+    //Before the constructor knows the stages, everything goes at 0
+    if (outStage == 0)
+        room = sharedBytes;
+    if (length > room) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+    *offset = output ? outStage : 0;
+    *staged = true;
+    return true;
+}
+
+//A call without payloads
+BOOL BROKER_SIRC::control(uint32_t op, uint32_t address, uint32_t value, uint32_t *outValue)
+{
+    SIRC_BROKER_CALL request;
+    SIRC_BROKER_REPLY reply;
+    BOOL ok;
+
+    memset(&request, 0, sizeof(request));
+    request.op = op;
+    request.address = address;
+    request.value = value;
+    EnterCriticalSection(&lock);
+    ok = call(&request, &reply);
+    LeaveCriticalSection(&lock);
+    if (ok && outValue)
+        *outValue = reply.value;
+    return ok;
+}
+
+//One round trip to the broker
+//Return true on success, return false w/error code otherwise.
+BOOL BROKER_SIRC::call(SIRC_BROKER_CALL *request, SIRC_BROKER_REPLY *reply)
+{
+    DWORD got;
+
+    memset(reply, 0, sizeof(*reply));
+    if (pipe == INVALID_HANDLE_VALUE) {
+        setLastError(FAILBROKER);
+        return false;
+    }
+    if (!TransactNamedPipe(pipe, request, sizeof(*request), reply, sizeof(*reply), &got, NULL) ||
+        (got != sizeof(*reply))) {
+        LogIt("sirc::broker.lost %u %u",request->op,(uint32_t) GetLastError());
+        setLastError(FAILBROKER);
+        return false;
+    }
+    setLastError(reply->ok ? 0 : reply->error);
+    return reply->ok;
+}
@@ -0,0 +1,193 @@
+// Title: SIRC broker
+//
+// Description: One process owns the board, any number of others use it.  An ETH_SIRC
+// binds the NIC and the board inside the process that opened it; the broker is that
+// process, and clients in other processes reach the board through it:
+//
+//      //The owner (see broker_main.cpp)
+//      SIRC_BROKER broker(openSirc(FPGA_ID, 0), L"board0", true);
+//      broker.run();                               //until stop()
+//
+//      //Any client
+//      BROKER_SIRC sirc(L"board0", SIRC_BROKER_PRIORITY_NORMAL);
+//      sirc.sendWrite(0, length, input);
+//
+// Clients connect over a local named pipe and get a shared memory section of their own,
+// big enough for the largest input and output buffers together.  The call arguments go
+// over the pipe, the payloads through the section: the broker hands the device pointers
+// into it.  Payloads a client builds in getSharedBuffer() are not copied on its side
+// either, anything else is staged through the section.
+//
+// The device runs one client call at a time.  Waiting clients take turns by the device
+// time they have used so far, divided by their priority: while both are busy, a priority
+// 8 client gets twice the device time of a priority 4 one.  An idle client does not save
+// up turns.  A client that needs several calls in a row without anyone in between (write,
+// run, read back the same buffers) holds the device with lockDevice(), and all of that
+// time is charged to it.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCBROKERH
+#define DEFINESIRCBROKERH 1
+
+//Client priorities, device time is shared in proportion
+#define SIRC_BROKER_PRIORITY_LOWEST 1
+#define SIRC_BROKER_PRIORITY_NORMAL 4
+#define SIRC_BROKER_PRIORITY_HIGHEST 16
+
+//Longest broker name
+#define SIRC_BROKER_MAX_NAME 64
+
+//Internal: one call over the pipe, its payloads are in the client's section
+typedef struct {
+    uint32_t op;
+    uint32_t address;               //start address, register number
+    uint32_t value;                 //register value, wait time, priority
+    uint32_t offset;                //input payload in the section
+    uint32_t length;
+    uint32_t outOffset;             //output payload in the section
+    uint32_t outLength;
+} SIRC_BROKER_CALL;
+
+//Internal: what came of it
+typedef struct {
+    BOOL ok;
+    int8_t error;
+    uint32_t value;                 //register value, connection number
+    uint32_t length;                //output length, section size
+} SIRC_BROKER_REPLY;
+
+//How the broker is doing
+typedef struct {
+    uint32_t clients;               //connected now
+    uint32_t connects;              //since it started
+    ULONGLONG calls;
+    ULONGLONG waits;                //calls that waited for another client's turn
+    ULONGLONG waitedUsec;           //..and for how long
+} SIRC_BROKER_STATISTICS;
+
+class SIRC_BROKER {
+public:
+	//device: the board clients get, opened by this process
+	//name: what clients connect to, at most SIRC_BROKER_MAX_NAME characters
+	//ownsDevice: delete the device with the broker
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall SIRC_BROKER(SIRC *device, const wchar_t *name, BOOL ownsDevice = false);
+	SIRC_DLL_LINKAGE __stdcall ~SIRC_BROKER();
+
+	//Serve clients until stop() is called from another thread.
+	//Returns true once stopped, with every client disconnected.
+	//If the pipe cannot be created (another broker has the name), returns false.
+	// Check error code with getLastError().
+	SIRC_DLL_LINKAGE BOOL __stdcall run(void);
+
+	//Have run() return.  Calls in progress finish first.
+	SIRC_DLL_LINKAGE void __stdcall stop(void);
+
+	//Retrieve the counters
+	SIRC_DLL_LINKAGE void __stdcall getStatistics(SIRC_BROKER_STATISTICS *outStatistics);
+
+	//Retrieve the last error code.  Any value < 0 indicates a problem.
+	inline int8_t __stdcall getLastError(){
+		return(lastError);
+	}
+
+private:
+	//One connected client
+	typedef struct {
+		SIRC_BROKER *broker;
+		HANDLE pipe;
+		HANDLE thread;
+		uint32_t connection;
+		uint32_t priority;
+		HANDLE section;
+		uint8_t *shared;
+		uint32_t sharedBytes;
+		HANDLE turn;                //set when the device is its
+		BOOL waiting;
+		BOOL holding;               //lockDevice()
+		LARGE_INTEGER since;        //got the device
+		ULONGLONG used;             //device time / priority so far, in counter ticks
+	} CLIENT;
+
+	int8_t lastError;
+	SIRC *device;
+	BOOL ownsDevice;
+	wchar_t name[SIRC_BROKER_MAX_NAME + 1];
+	wchar_t pipeName[SIRC_BROKER_MAX_NAME + 32];
+	volatile LONG stopping;
+	volatile LONG listening;        //run() may be waiting for a connection
+	LARGE_INTEGER frequency;
+	std::list<HANDLE> threads;      //of the clients, joined by run()
+	CRITICAL_SECTION lock;          //protects everything below
+	std::list<CLIENT *> clients;
+	CLIENT *owner;                  //running on the device, NULL if no one
+	ULONGLONG virtualNow;           //used of the latest client given the device
+	uint32_t connections;
+	SIRC_BROKER_STATISTICS statistics;
+
+	BOOL accept(HANDLE pipe);
+	BOOL hello(CLIENT *client);
+	void acquire(CLIENT *client);
+	void release(CLIENT *client);
+	void handOn(void);
+	BOOL execute(CLIENT *client, const SIRC_BROKER_CALL *call, SIRC_BROKER_REPLY *reply);
+	void drop(CLIENT *client);
+	static DWORD WINAPI serveClient(LPVOID lpParam);
+};
+
+class BROKER_SIRC : public SIRC {
+public:
+	//name: the broker's
+	//priority: from SIRC_BROKER_PRIORITY_LOWEST to SIRC_BROKER_PRIORITY_HIGHEST
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall BROKER_SIRC(const wchar_t *name,
+		uint32_t priority = SIRC_BROKER_PRIORITY_NORMAL);
+	SIRC_DLL_LINKAGE __stdcall ~BROKER_SIRC();
+
+	//Same as the SIRC methods, run by the broker on its device.
+	//If the broker goes away, they fail with FAILBROKER.
+	BOOL __stdcall sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	BOOL __stdcall sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	BOOL __stdcall sendParamRegisterWrite(uint8_t regNumber, uint32_t value);
+	BOOL __stdcall sendParamRegisterRead(uint8_t regNumber, uint32_t *value);
+	BOOL __stdcall sendRun();
+	BOOL __stdcall waitDone(uint32_t maxWaitTimeInMsec);
+	BOOL __stdcall sendReset();
+	BOOL __stdcall sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+		uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+		uint32_t *outputLength);
+	BOOL __stdcall quiesce(uint32_t maxWaitTimeInMsec);
+	//NB: setParameters changes the device for every client
+	BOOL __stdcall getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength);
+	BOOL __stdcall setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length);
+
+	//Keep the device until unlockDevice(), waiting for our turn first.
+	//Other clients' calls wait meanwhile.
+	SIRC_DLL_LINKAGE BOOL __stdcall lockDevice(void);
+	SIRC_DLL_LINKAGE BOOL __stdcall unlockDevice(void);
+
+	//The shared section.  Buffers passed in that lie within it are used in place.
+	SIRC_DLL_LINKAGE uint8_t * __stdcall getSharedBuffer(uint32_t *size);
+
+private:
+	HANDLE pipe;
+	HANDLE section;
+	uint8_t *shared;
+	uint32_t sharedBytes;
+	uint32_t outStage;              //where output is staged, input goes at 0
+	CRITICAL_SECTION lock;          //one call at a time on the pipe and the stages
+
+	BOOL place(const void *buffer, uint32_t length, BOOL output, uint32_t *offset, BOOL *staged);
+	BOOL control(uint32_t op, uint32_t address, uint32_t value, uint32_t *outValue);
+	BOOL call(SIRC_BROKER_CALL *request, SIRC_BROKER_REPLY *reply);
+};
+
+#endif //DEFINESIRCBROKERH
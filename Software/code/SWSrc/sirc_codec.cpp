@@ -0,0 +1,127 @@
+// Title: SIRC payload codec
+//
+// Description: Run-length coding of write payloads and read responses.
+// See sirc_codec.h for the stream format.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//Token limits, see the format description
+#define MAXLITERAL 128
+#define MINRUN 3
+#define MAXRUN (0x7F + MINRUN)
+
+uint32_t sircRleEncode(const uint8_t *src, uint32_t srcLength,
+                       uint8_t *dst, uint32_t dstMax, uint32_t *consumed)
+{
+    uint32_t in = 0, out = 0;
+
+    while (in < srcLength) {
+        //How long is the run starting here?
+        uint32_t run = 1;
+        while ((in + run < srcLength) && (run < MAXRUN) && (src[in + run] == src[in]))
+            run++;
+
+        if (run >= MINRUN) {
+            if (out + 2 > dstMax)
+                break;
+            dst[out++] = (uint8_t)(0x80 | (run - MINRUN));
+            dst[out++] = src[in];
+            in += run;
+            continue;
+        }
+
+        //Literal, up to where the next run starts
+        uint32_t literal = 0;
+        while ((in + literal < srcLength) && (literal < MAXLITERAL)) {
+            uint32_t j = in + literal;
+            if ((j + 2 < srcLength) && (src[j] == src[j + 1]) && (src[j] == src[j + 2]))
+                break;
+            literal++;
+        }
+
+        //Take whatever still fits
+        if (out + 2 > dstMax)
+            break;
+        if (out + 1 + literal > dstMax)
+            literal = dstMax - out - 1;
+        dst[out++] = (uint8_t)(literal - 1);
+        memcpy(dst + out, src + in, literal);
+        out += literal;
+        in += literal;
+    }
+
+    *consumed = in;
+    return out;
+}
+
+uint32_t sircRleEncodeFrame(const uint8_t *src, uint32_t length, uint32_t plainMax,
+                            uint8_t *dst, uint32_t dstMax, uint32_t *rawLength)
+{
+    uint32_t consumed;
+    uint32_t coded = sircRleEncode(src, min(length, (uint32_t)SIRC_RLE_MAXSEGMENT),
+                                   dst, dstMax, &consumed);
+    uint32_t plain = min(length, plainMax);
+
+    //Coded wins if it carries more, or the same in fewer bytes
+    if ((consumed > plain) || ((consumed == plain) && (coded < plain))) {
+        *rawLength = consumed;
+        return coded;
+    }
+    return 0;
+}
+
+uint32_t sircRleDecodedLength(const uint8_t *src, uint32_t srcLength)
+{
+    uint32_t in = 0, total = 0;
+
+    while (in < srcLength) {
+        uint8_t control = src[in++];
+        if (control & 0x80) {
+            if (in + 1 > srcLength)
+                return 0;
+            in++;
+            total += (control & 0x7F) + MINRUN;
+        } else {
+            uint32_t literal = control + 1;
+            if (in + literal > srcLength)
+                return 0;
+            in += literal;
+            total += literal;
+        }
+    }
+    return total;
+}
+
+uint32_t sircRleDecode(const uint8_t *src, uint32_t srcLength,
+                       uint8_t *dst, uint32_t dstMax)
+{
+    uint32_t in = 0, out = 0;
+
+    while ((in < srcLength) && (out < dstMax)) {
+        uint8_t control = src[in++];
+        if (control & 0x80) {
+            if (in + 1 > srcLength)
+                break;
+            uint32_t run = min((uint32_t)((control & 0x7F) + MINRUN), dstMax - out);
+            memset(dst + out, src[in++], run);
+            out += run;
+        } else {
+            uint32_t literal = control + 1;
+            if (in + literal > srcLength)
+                break;
+            memcpy(dst + out, src + in, min(literal, dstMax - out));
+            out += min(literal, dstMax - out);
+            in += literal;
+        }
+    }
+    return out;
+}
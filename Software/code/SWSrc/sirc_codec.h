@@ -0,0 +1,62 @@
+// Title: SIRC payload codec
+//
+// Description: Run-length coding of write payloads and read responses, used by
+// ETH_SIRC and SRV_SIRC once both sides have agreed to it (see SIRC::PARAMETERS).
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// Coded stream format.  This is all a hardware decoder needs to implement.
+// The stream is a sequence of tokens, each starting with a control byte C:
+//   C = 0x00..0x7F  literal: the next C+1 bytes (1..128) are copied to the output.
+//   C = 0x80..0xFF  run:     the next byte is written (C & 0x7F)+3 times (3..130).
+// Output is strictly sequential, so a decoder is a byte counter in front of the
+// buffer write port and never needs to look back at what it wrote.
+// A token that runs past the end of the frame makes the frame invalid.
+//
+// Wire commands (payload bytes, after the 14-byte Ethernet header):
+//   'n' + mask[4]                          host asks for SIRC_COMPRESS_* features
+//   'n' + mask[4]                          reply: the subset the FPGA accepts
+//   'z' + addr[4] + rawLength[4] + coded   write; acked by echoing the first 9 bytes,
+//                                          like 'w'.  rawLength is what coded expands to.
+//   'q' + addr[4] + length[4]              read; answered with 'r' and/or 'q' frames
+//   'q' + addr[4] + rawLength[4] + coded   read response
+//   'u' + addr[4] + remaining[4] + rawLength[4] + coded
+//                                          write & run readback, otherwise like 'g'
+// All integers are big-endian.  A device that does not know 'n' ignores it (or
+// answers 'e'), the host then simply never sends the other three.
+// The sender picks coded or plain frames one at a time, whichever carries more.
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCCODECH
+#define DEFINESIRCCODECH 1
+
+//Most raw bytes a single coded frame may stand for
+#define SIRC_RLE_MAXSEGMENT (32 * 1024)
+
+//Code as much of src (up to srcLength bytes) as fits in dstMax bytes.
+//Returns the number of coded bytes, *consumed is how many bytes of src they hold.
+extern uint32_t sircRleEncode(const uint8_t *src, uint32_t srcLength,
+                              uint8_t *dst, uint32_t dstMax, uint32_t *consumed);
+
+//Code the next frame of a transfer of length bytes, if that beats a plain frame
+// that can hold plainMax bytes.
+//Returns the number of coded bytes (and *rawLength), or 0 to send a plain frame.
+extern uint32_t sircRleEncodeFrame(const uint8_t *src, uint32_t length, uint32_t plainMax,
+                                   uint8_t *dst, uint32_t dstMax, uint32_t *rawLength);
+
+//Returns how many bytes the coded stream expands to, 0 if it is malformed.
+extern uint32_t sircRleDecodedLength(const uint8_t *src, uint32_t srcLength);
+
+//Expand a coded stream, writing at most dstMax bytes.
+//Returns the number of bytes written.  Check the stream with sircRleDecodedLength first.
+extern uint32_t sircRleDecode(const uint8_t *src, uint32_t srcLength,
+                              uint8_t *dst, uint32_t dstMax);
+
+#endif //DEFINESIRCCODECH
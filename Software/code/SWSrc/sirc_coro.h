@@ -0,0 +1,324 @@
+// Title: SIRC coroutine front end
+//
+// Description: co_await wrappers around the SIRC submit* methods, and a single threaded
+// event loop to run many coroutines (logical experiments) over one or more SIRC objects.
+//
+//      SircCoro::EventLoop loop;
+//      SircCoro::Board board(loop, sirc);
+//
+//      SircCoro::Task experiment(SircCoro::Board &board, uint8_t *in, uint8_t *out) {
+//          co_await board.write(0, 16, in);                //throws SircCoro::Error
+//          co_await board.run();
+//          SircCoro::Result done = co_await board.waitDone(1000).result();    //does not
+//          if (done)
+//              co_await board.read(0, 2, out);
+//      }
+//
+//      loop.spawn(experiment(board, in, out));
+//      loop.run();
+//
+// All coroutines run on the thread that calls run().  The SIRC runners move the packets,
+// the loop only sleeps until one of them completes a request, then resumes its coroutine.
+// Requests on one board still run in the order they were submitted, coroutines that
+// share a board share its buffers and registers too.
+//
+// Needs a C++20 compiler (Visual Studio 2019 16.8 or later, /std:c++latest).  The
+// library itself does not use this header.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCCOROH
+#define DEFINESIRCCOROH 1
+
+#if !defined(__cpp_impl_coroutine)
+#error "sirc_coro.h needs C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "sirc.h"
+#include "sirc_error.h"
+
+namespace SircCoro {
+
+//What a failed request throws, code is what getLastError() would have said
+class Error : public std::exception {
+public:
+    explicit Error(int8_t code) : code(code) {}
+    const char *what() const noexcept { return "SIRC request failed"; }
+    int8_t code;
+};
+
+//What a request gives back when asked not to throw (see Awaitable::result)
+struct Result {
+    int8_t error;
+    uint32_t value;     //as SIRC_REQUEST::getValue
+    explicit operator bool() const { return error == 0; }
+};
+
+class EventLoop;
+
+//A coroutine started with EventLoop::spawn.
+//The loop owns it from then on.
+class Task {
+public:
+    struct promise_type {
+        EventLoop *loop;
+
+        promise_type() : loop(NULL) {}
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        //Nothing runs until the loop does
+        std::suspend_always initial_suspend() noexcept { return std::suspend_always(); }
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            inline void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return FinalAwaiter(); }
+        void return_void() {}
+        inline void unhandled_exception();
+    };
+
+    Task(Task &&other) : handle(other.handle) { other.handle = NULL; }
+    ~Task() {
+        //Never spawned
+        if (handle)
+            handle.destroy();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(const Task &);
+    Task &operator=(const Task &);
+
+    std::coroutine_handle<promise_type> handle;
+    friend class EventLoop;
+};
+
+//Resumes coroutines as their requests complete, all on the thread inside run()
+class EventLoop {
+public:
+    EventLoop() : live(0), failed(0) {
+        InitializeCriticalSection(&lock);
+        wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    }
+    ~EventLoop() {
+        CloseHandle(wake);
+        DeleteCriticalSection(&lock);
+    }
+
+    //Start a coroutine on the next run()
+    void spawn(Task task) {
+        task.handle.promise().loop = this;
+        live++;
+        post(task.handle);
+        task.handle = NULL;
+    }
+
+    //Run until every spawned coroutine has finished.
+    //Returns how many of them ended with an exception.
+    uint32_t run() {
+        std::vector <std::coroutine_handle<> > batch;
+
+        while (live) {
+            EnterCriticalSection(&lock);
+            batch.swap(ready);
+            LeaveCriticalSection(&lock);
+
+            if (batch.empty()) {
+                WaitForSingleObject(wake, INFINITE);
+                continue;
+            }
+            for (size_t i = 0; i < batch.size(); i++)
+                batch[i].resume();
+            batch.clear();
+        }
+        return failed;
+    }
+
+    //Make a coroutine ready.  Called from SIRC runner threads.
+    void post(std::coroutine_handle<> handle) {
+        EnterCriticalSection(&lock);
+        ready.push_back(handle);
+        LeaveCriticalSection(&lock);
+        SetEvent(wake);
+    }
+
+private:
+    friend struct Task::promise_type;
+
+    void finished(std::coroutine_handle<> handle) {
+        live--;
+        handle.destroy();
+    }
+
+    CRITICAL_SECTION lock;      //protects ready
+    HANDLE wake;
+    std::vector <std::coroutine_handle<> > ready;
+    uint32_t live;              //loop thread only
+    uint32_t failed;
+};
+
+inline void Task::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+{
+    handle.promise().loop->finished(handle);
+}
+
+inline void Task::promise_type::unhandled_exception()
+{
+    //Counted here, final_suspend still runs
+    loop->failed++;
+}
+
+//co_await on one request.  It is submitted when awaited.
+//THROWS: resume with the value or throw Error, or resume with a Result.
+template <bool THROWS> class Awaitable {
+public:
+    typedef std::function<SIRC_REQUEST *(SIRC_CALLBACK, void *)> SUBMIT;
+
+    Awaitable(EventLoop *loop, SIRC *sirc, SUBMIT submit)
+        : loop(loop), sirc(sirc), submit(submit), request(NULL), error(0) {}
+
+    //Same request, but resume with a Result instead of throwing
+    Awaitable<false> result() { return Awaitable<false>(loop, sirc, submit); }
+
+    bool await_ready() { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        waiter = handle;
+        request = submit(&Awaitable::completed, this);
+        if (request == NULL) {
+            //Not queued, resume right away
+            error = sirc->getLastError();
+            if (error == 0)
+                error = FAILMEMALLOC;
+            return false;
+        }
+        return true;
+    }
+
+    typename std::conditional<THROWS, uint32_t, Result>::type await_resume() {
+        Result done = { error, 0 };
+        if (request) {
+            done.error = request->getError();
+            done.value = request->getValue();
+            request->release();
+            request = NULL;
+        }
+        return finish(done, std::integral_constant<bool, THROWS>());
+    }
+
+private:
+    static uint32_t finish(Result done, std::true_type) {
+        if (done.error)
+            throw Error(done.error);
+        return done.value;
+    }
+    static Result finish(Result done, std::false_type) {
+        return done;
+    }
+
+    //On the runner thread
+    static void __stdcall completed(SIRC_REQUEST *, void *context) {
+        Awaitable *self = (Awaitable *) context;
+        self->loop->post(self->waiter);
+    }
+
+    EventLoop *loop;
+    SIRC *sirc;
+    SUBMIT submit;
+    SIRC_REQUEST *request;
+    int8_t error;
+    std::coroutine_handle<> waiter;
+};
+
+//One SIRC object, as seen from coroutines on a loop.
+//Same arguments as the synchronous methods, values come back from co_await.
+class Board {
+public:
+    Board(EventLoop &loop, SIRC *sirc) : loop(&loop), sirc(sirc) {}
+
+    Awaitable<true> write(uint32_t startAddress, uint32_t length, uint8_t *buffer) {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitWrite(startAddress, length, buffer, callback, context);
+        });
+    }
+
+    Awaitable<true> read(uint32_t startAddress, uint32_t length, uint8_t *buffer) {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitRead(startAddress, length, buffer, callback, context);
+        });
+    }
+
+    Awaitable<true> paramRegisterWrite(uint8_t regNumber, uint32_t value) {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitParamRegisterWrite(regNumber, value, callback, context);
+        });
+    }
+
+    //co_await gives the register value
+    Awaitable<true> paramRegisterRead(uint8_t regNumber) {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitParamRegisterRead(regNumber, callback, context);
+        });
+    }
+
+    Awaitable<true> run() {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitRun(callback, context);
+        });
+    }
+
+    Awaitable<true> waitDone(uint32_t maxWaitTimeInMsec) {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitWaitDone(maxWaitTimeInMsec, callback, context);
+        });
+    }
+
+    Awaitable<true> reset() {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitReset(callback, context);
+        });
+    }
+
+    //co_await gives the output length.  FAILWRITEANDRUNCAPACITY is an error here,
+    // use result() to get the length anyway.
+    Awaitable<true> writeAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+                                uint32_t maxWaitTimeInMsec, uint8_t *outData, uint32_t maxOutLength) {
+        SIRC *s = sirc;
+        return Awaitable<true>(loop, sirc, [=](SIRC_CALLBACK callback, void *context) {
+            return s->submitWriteAndRun(startAddress, inLength, inData, maxWaitTimeInMsec,
+                                        outData, maxOutLength, callback, context);
+        });
+    }
+
+    SIRC *getSirc() { return sirc; }
+
+private:
+    EventLoop *loop;
+    SIRC *sirc;
+};
+
+} //namespace SircCoro
+
+#endif //DEFINESIRCCOROH
@@ -0,0 +1,36 @@
+// Title: SIRC payload checksums
+//
+// Description: CRC32C (Castagnoli) over buffer contents, so the host can check what the
+// FPGA holds against what it meant to send without reading it all back.
+// See SIRC::sendChecksum and SIRC::sendWriteVerified.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// Wire commands (payload bytes, after the 14-byte Ethernet header):
+//   'h' + buffer[1] + address[4] + length[4]
+//                                          host asks for the CRC32C of [address,
+//                                          address + length) of the input (0) or
+//                                          output (1) buffer
+//   'h' + buffer[1] + address[4] + length[4] + crc[4]
+//                                          reply, the request echoed with its CRC
+// The CRC is the usual CRC32C (reflected polynomial 0x82F63B78, initial value and
+// final XOR all ones), the one iSCSI and SSE4.2 use.  Hardware computes it as the
+// bytes stream by, at one 32-bit word per clock.
+// A device that does not know 'h' does not answer.
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCCRCH
+#define DEFINESIRCCRCH 1
+
+//CRC32C of length bytes at data, going on from crc (0 to start).
+//Uses the SSE4.2 or ARMv8 CRC instructions when the CPU has them.
+extern uint32_t sircCrc32c(uint32_t crc, const uint8_t *data, uint32_t length);
+
+#endif //DEFINESIRCCRCH
@@ -0,0 +1,298 @@
+// Title: SIRC device discovery
+//
+// Description: Concurrent probing and the registry of known boards behind openSirc.
+// See sirc_discovery.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//Names in the registry file
+static const char *backendNames[SIRC_BACKEND_COUNT] = { "pcie2", "pcie", "eth" };
+
+//One discovery, shared by the caller and the probe threads.
+//Whoever lets go of it last frees it.
+typedef struct DISCOVERY DISCOVERY;
+
+typedef struct {
+    DISCOVERY *discovery;
+    SIRC_BACKEND backend;
+} PROBE;
+
+struct DISCOVERY {
+    volatile LONG references;       //the caller's and one per probe thread
+    CRITICAL_SECTION lock;          //protects found and decided
+    BOOL decided;                   //the caller has its board, probes still out clean up after themselves
+    SIRC *found[SIRC_BACKEND_COUNT];
+    HANDLE done[SIRC_BACKEND_COUNT];    //NULL if that interface is not probed
+    PROBE probes[SIRC_BACKEND_COUNT];
+    uint8_t FPGA_ID[6];
+    BOOL haveId;
+    uint32_t driverVersion;
+};
+
+static void releaseDiscovery(DISCOVERY *discovery)
+{
+    if (InterlockedDecrement(&discovery->references) != 0)
+        return;
+    for (int b = 0; b < SIRC_BACKEND_COUNT; b++) {
+        if (discovery->done[b])
+            CloseHandle(discovery->done[b]);
+    }
+    DeleteCriticalSection(&discovery->lock);
+    delete discovery;
+}
+
+//Has someone with a better claim found the board already?
+//Only the network talks to the board while probing, so it waits for the PCIe probes:
+// a board that is on PCIe should not see a reset come in over the wire.
+static BOOL outranked(DISCOVERY *discovery, SIRC_BACKEND backend)
+{
+    BOOL taken;
+
+    for (int b = 0; b < backend; b++) {
+        if (discovery->done[b])
+            WaitForSingleObject(discovery->done[b], INFINITE);
+    }
+    EnterCriticalSection(&discovery->lock);
+    taken = discovery->decided;
+    for (int b = 0; b < backend; b++)
+        taken = taken || (discovery->found[b] != NULL);
+    LeaveCriticalSection(&discovery->lock);
+    return taken;
+}
+
+//Open one interface.
+//Returns NULL if the board is not there, or if discovery is given and someone beat us to it.
+static SIRC *probeBackend(SIRC_BACKEND backend, uint8_t *FPGA_ID, uint32_t driverVersion,
+                          DISCOVERY *discovery)
+{
+    SIRC *sirc = NULL;
+
+    switch (backend) {
+    case SIRC_BACKEND_PCIE2:
+        sirc = new PCIE2_SIRC;
+        break;
+    case SIRC_BACKEND_PCIE:
+        sirc = new PCIE_SIRC;
+        break;
+    case SIRC_BACKEND_ETH: {
+        //Setting up (driver, receives) overlaps with the other probes, contact does not
+        ETH_SIRC *eth = new ETH_SIRC(FPGA_ID, driverVersion, NULL, false);
+        if ((eth->getLastError() == 0) && discovery && outranked(discovery, backend)) {
+            delete eth;
+            return NULL;
+        }
+        if (eth->getLastError() == 0)
+            eth->probe();
+        sirc = eth;
+        break;
+    }
+    //Pico cards (PICO_SIRC) are not built in
+    default:
+        return NULL;
+    }
+
+    if (sirc->getLastError() == 0)
+        return sirc;
+    LogIt("sirc::discover.miss %d %d",(int) backend,(int) sirc->getLastError());
+    delete sirc;
+    return NULL;
+}
+
+static DWORD WINAPI probeThreadProc(LPVOID lpParam)
+{
+    PROBE *probe = (PROBE *) lpParam;
+    DISCOVERY *discovery = probe->discovery;
+    SIRC *sirc;
+
+    sirc = probeBackend(probe->backend, discovery->haveId ? discovery->FPGA_ID : NULL,
+                        discovery->driverVersion, discovery);
+
+    EnterCriticalSection(&discovery->lock);
+    if (!discovery->decided) {
+        discovery->found[probe->backend] = sirc;
+        sirc = NULL;
+    }
+    LeaveCriticalSection(&discovery->lock);
+
+    //Nobody wants it any more
+    delete sirc;
+
+    SetEvent(discovery->done[probe->backend]);
+    releaseDiscovery(discovery);
+    return 0;
+}
+
+SIRC *discoverSirc(uint8_t *FPGA_ID, uint32_t driverVersion)
+{
+    SIRC_BACKEND cached = SIRC_BACKEND_NONE;
+    SIRC_BACKEND winner = SIRC_BACKEND_NONE;
+    DISCOVERY *discovery;
+    SIRC *sirc = NULL;
+    SIRC *losers[SIRC_BACKEND_COUNT];
+    int b;
+
+    LogIt(LOGIT_TIME_MARKER);
+
+    //Warm start: whatever worked last time, on its own
+    if (FPGA_ID)
+        cached = lookupSircBackend(FPGA_ID);
+    if (cached != SIRC_BACKEND_NONE) {
+        sirc = probeBackend(cached, FPGA_ID, driverVersion, NULL);
+        if (sirc) {
+            LogIt("sirc::discover.warm %d",(int) cached);
+            return sirc;
+        }
+    }
+
+    //Cold start: everything else, at once
+    discovery = new DISCOVERY;
+    discovery->references = 1;
+    InitializeCriticalSection(&discovery->lock);
+    discovery->decided = false;
+    discovery->haveId = (FPGA_ID != NULL);
+    if (FPGA_ID)
+        memcpy(discovery->FPGA_ID, FPGA_ID, sizeof(discovery->FPGA_ID));
+    discovery->driverVersion = driverVersion;
+    for (b = 0; b < SIRC_BACKEND_COUNT; b++) {
+        discovery->found[b] = NULL;
+        discovery->probes[b].discovery = discovery;
+        discovery->probes[b].backend = (SIRC_BACKEND) b;
+        discovery->done[b] = (b == cached) ? NULL : CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+
+    for (b = 0; b < SIRC_BACKEND_COUNT; b++) {
+        HANDLE thread;
+
+        if (!discovery->done[b])
+            continue;
+        InterlockedIncrement(&discovery->references);
+        thread = CreateThread(NULL, 0, probeThreadProc, &discovery->probes[b], 0, NULL);
+        //No thread, probe it here
+        if (thread == NULL)
+            probeThreadProc(&discovery->probes[b]);
+        else
+            CloseHandle(thread);
+    }
+
+    //First one that works, in order of preference
+    for (b = 0; (b < SIRC_BACKEND_COUNT) && !sirc; b++) {
+        if (!discovery->done[b])
+            continue;
+        WaitForSingleObject(discovery->done[b], INFINITE);
+        EnterCriticalSection(&discovery->lock);
+        sirc = discovery->found[b];
+        discovery->found[b] = NULL;
+        LeaveCriticalSection(&discovery->lock);
+        if (sirc)
+            winner = (SIRC_BACKEND) b;
+    }
+
+    //Whatever else finished already goes, the rest goes when it finishes
+    EnterCriticalSection(&discovery->lock);
+    discovery->decided = true;
+    for (b = 0; b < SIRC_BACKEND_COUNT; b++) {
+        losers[b] = discovery->found[b];
+        discovery->found[b] = NULL;
+    }
+    LeaveCriticalSection(&discovery->lock);
+    for (b = 0; b < SIRC_BACKEND_COUNT; b++)
+        delete losers[b];
+    releaseDiscovery(discovery);
+
+    if (sirc && FPGA_ID)
+        rememberSircBackend(FPGA_ID, winner);
+    LogIt("sirc::discover.cold %d",(int) winner);
+    return sirc;
+}
+
+//Where the registry lives, empty if nowhere
+static string registryPath(void)
+{
+    char path[MAX_PATH];
+    DWORD length;
+
+    length = GetEnvironmentVariableA("SIRC_REGISTRY", path, sizeof(path));
+    if ((length > 0) && (length < sizeof(path)))
+        return path;
+    length = GetEnvironmentVariableA("LOCALAPPDATA", path, sizeof(path));
+    if ((length == 0) || (length >= sizeof(path)))
+        return "";
+    return string(path) + "\\sirc_devices.txt";
+}
+
+//aa:bb:cc:dd:ee:ff
+static string boardKey(const uint8_t *FPGA_ID)
+{
+    std::ostringstream key;
+
+    key << hex << setfill('0');
+    for (int i = 0; i < 6; i++)
+        key << (i ? ":" : "") << setw(2) << (int) FPGA_ID[i];
+    return key.str();
+}
+
+SIRC_BACKEND lookupSircBackend(const uint8_t *FPGA_ID)
+{
+    string path = registryPath();
+    string key = boardKey(FPGA_ID);
+    string board, name;
+
+    if (path.empty())
+        return SIRC_BACKEND_NONE;
+    ifstream file(path.c_str());
+    while (file >> board >> name) {
+        if (board != key)
+            continue;
+        for (int b = 0; b < SIRC_BACKEND_COUNT; b++) {
+            if (name == backendNames[b])
+                return (SIRC_BACKEND) b;
+        }
+        break;
+    }
+    return SIRC_BACKEND_NONE;
+}
+
+//Rewrite the registry with this board's line replaced.
+//The new file replaces the old one in one go, so readers never see half of it.
+//The registry is only a hint, failing to write it is not an error.
+void rememberSircBackend(const uint8_t *FPGA_ID, SIRC_BACKEND backend)
+{
+    string path = registryPath();
+    string key = boardKey(FPGA_ID);
+    string board, name;
+    std::ostringstream temporary;
+
+    if (path.empty() || (backend < 0) || (backend >= SIRC_BACKEND_COUNT))
+        return;
+    if (lookupSircBackend(FPGA_ID) == backend)
+        return;
+
+    temporary << path << "." << GetCurrentProcessId();
+    {
+        ifstream in(path.c_str());
+        ofstream out(temporary.str().c_str());
+        if (!out)
+            return;
+        while (in >> board >> name) {
+            if (board != key)
+                out << board << " " << name << endl;
+        }
+        out << key << " " << backendNames[backend] << endl;
+        if (!out) {
+            out.close();
+            DeleteFileA(temporary.str().c_str());
+            return;
+        }
+    }
+    if (!MoveFileExA(temporary.str().c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+        DeleteFileA(temporary.str().c_str());
+}
@@ -0,0 +1,39 @@
+// Title: SIRC device discovery
+//
+// Description: What openSirc does to find a board.  The interface that found it last
+// time is tried first, see the registry below.  Otherwise every interface is probed at
+// once, each on its own thread, and the first one that works (in the usual order:
+// new PCIe, PCIe, then the network) wins.  The losers are cleaned up as they finish.
+//
+// The registry is a text file, one line per board: MAC address and interface.
+// It lives in %LOCALAPPDATA%\sirc_devices.txt unless SIRC_REGISTRY names another file.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCDISCOVERYH
+#define DEFINESIRCDISCOVERYH 1
+
+//The interfaces we look for, in order of preference
+typedef enum {
+    SIRC_BACKEND_NONE = -1,
+    SIRC_BACKEND_PCIE2 = 0,
+    SIRC_BACKEND_PCIE,
+    SIRC_BACKEND_ETH,
+    SIRC_BACKEND_COUNT
+} SIRC_BACKEND;
+
+//Find the board and open it.  Returns NULL if no interface found it.
+SIRC *discoverSirc(uint8_t *FPGA_ID, uint32_t driverVersion);
+
+//The registry.  Boards are known by their MAC address (FPGA_ID).
+SIRC_BACKEND lookupSircBackend(const uint8_t *FPGA_ID);
+void rememberSircBackend(const uint8_t *FPGA_ID, SIRC_BACKEND backend);
+
+#endif //DEFINESIRCDISCOVERYH
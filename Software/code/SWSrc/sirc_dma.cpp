@@ -0,0 +1,405 @@
+// Title: SIRC queued DMA
+//
+// Description: Several DMA segments in flight on a PCIe driver handle, and the request
+// runner that feeds submitted transfers through them.  See sirc_dma.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+SIRC_DMA::SIRC_DMA(SIRC_DMA_FILE file)
+{
+    this->file = file;
+    ready = true;
+    readDepth = SIRC_DMA_DEPTH;
+    writeDepth = SIRC_DMA_DEPTH;
+    InitializeCriticalSection(&lock);
+
+    memset(slots, 0, sizeof(slots));
+#if defined(_WIN32)
+    //Manual reset: ReadFile and WriteFile clear it when they start
+    for (uint32_t i = 0; i < SIRC_DMA_MAXDEPTH; i++) {
+        slots[i].overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (slots[i].overlapped.hEvent == NULL)
+            ready = false;
+    }
+#else
+    //Its own descriptor for every slot, or they all queue up behind each other
+    for (uint32_t i = 0; i < SIRC_DMA_MAXDEPTH; i++) {
+        slots[i].file = dup(file);
+        if (slots[i].file < 0)
+            ready = false;
+    }
+#endif
+}
+
+SIRC_DMA::~SIRC_DMA()
+{
+#if defined(_WIN32)
+    for (uint32_t i = 0; i < SIRC_DMA_MAXDEPTH; i++) {
+        if (slots[i].overlapped.hEvent != NULL)
+            CloseHandle(slots[i].overlapped.hEvent);
+    }
+#else
+    for (uint32_t i = 0; i < SIRC_DMA_MAXDEPTH; i++) {
+        if (slots[i].file >= 0)
+            close(slots[i].file);
+    }
+#endif
+    DeleteCriticalSection(&lock);
+}
+
+void SIRC_DMA::setDepth(uint32_t reads, uint32_t writes)
+{
+    EnterCriticalSection(&lock);
+    readDepth = ((reads == 0) || (reads > SIRC_DMA_MAXDEPTH)) ? SIRC_DMA_MAXDEPTH : reads;
+    writeDepth = ((writes == 0) || (writes > SIRC_DMA_MAXDEPTH)) ? SIRC_DMA_MAXDEPTH : writes;
+    LeaveCriticalSection(&lock);
+}
+
+void SIRC_DMA::getDepth(uint32_t *reads, uint32_t *writes)
+{
+    *reads = readDepth;
+    *writes = writeDepth;
+}
+
+BOOL SIRC_DMA::issue(SLOT *slot)
+{
+    SIRC_DMA_TRANSFER *transfer = slot->transfer;
+    uint8_t *buffer = transfer->buffer + slot->offset;
+    uint64_t offset = transfer->deviceOffset + slot->offset;
+
+#if defined(_WIN32)
+    BOOL ok;
+
+    slot->overlapped.Internal = 0;
+    slot->overlapped.InternalHigh = 0;
+    slot->overlapped.Offset = (DWORD) offset;
+    slot->overlapped.OffsetHigh = (DWORD) (offset >> 32);
+    if (transfer->write)
+        ok = WriteFile(file, buffer, slot->length, NULL, &slot->overlapped);
+    else
+        ok = ReadFile(file, buffer, slot->length, NULL, &slot->overlapped);
+    //Still going is what we want
+    return ok || (GetLastError() == ERROR_IO_PENDING);
+#else
+    memset(&slot->control, 0, sizeof(slot->control));
+    slot->control.aio_fildes = slot->file;
+    slot->control.aio_buf = buffer;
+    slot->control.aio_nbytes = slot->length;
+    slot->control.aio_offset = (off_t) offset;
+    return ((transfer->write) ? aio_write(&slot->control) : aio_read(&slot->control)) == 0;
+#endif
+}
+
+SIRC_DMA::SLOT *SIRC_DMA::reap(uint32_t *bytes)
+{
+    SLOT *busy[SIRC_DMA_MAXDEPTH];
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < SIRC_DMA_MAXDEPTH; i++) {
+        if (slots[i].transfer != NULL)
+            busy[count++] = &slots[i];
+    }
+
+#if defined(_WIN32)
+    HANDLE events[SIRC_DMA_MAXDEPTH];
+    DWORD moved = 0;
+    DWORD which;
+    SLOT *slot;
+
+    for (uint32_t i = 0; i < count; i++)
+        events[i] = busy[i]->overlapped.hEvent;
+    which = WaitForMultipleObjects(count, events, FALSE, INFINITE) - WAIT_OBJECT_0;
+    //Cannot wait on them all, take the first one then
+    slot = (which < count) ? busy[which] : busy[0];
+    if (!GetOverlappedResult(file, &slot->overlapped, &moved, TRUE))
+        moved = 0;
+    *bytes = moved;
+    return slot;
+#else
+    const struct aiocb *controls[SIRC_DMA_MAXDEPTH];
+
+    for (uint32_t i = 0; i < count; i++)
+        controls[i] = &busy[i]->control;
+    for (;;) {
+        for (uint32_t i = 0; i < count; i++) {
+            int error = aio_error(&busy[i]->control);
+
+            if (error != EINPROGRESS) {
+                ssize_t moved = aio_return(&busy[i]->control);
+
+                *bytes = ((error == 0) && (moved > 0)) ? (uint32_t) moved : 0;
+                return busy[i];
+            }
+        }
+        (void) aio_suspend(controls, count, NULL);
+    }
+#endif
+}
+
+BOOL SIRC_DMA::run(SIRC_DMA_TRANSFER *transfers, uint32_t count)
+{
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+    uint32_t busy = 0;
+    uint32_t first = 0;
+    uint32_t bytes;
+    BOOL ok = ready;
+
+    EnterCriticalSection(&lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        transfers[i].issued = 0;
+        transfers[i].completed = 0;
+        transfers[i].inFlight = 0;
+        transfers[i].failed = false;
+    }
+
+    for (;;) {
+        //Fill the queue in transfer order.  A direction that is full does not hold up
+        // the other one.
+        for (uint32_t i = first; ok && (i < count) && (busy < SIRC_DMA_MAXDEPTH); i++) {
+            SIRC_DMA_TRANSFER *transfer = &transfers[i];
+            uint32_t *inFlight = (transfer->write) ? &writes : &reads;
+            uint32_t depth = (transfer->write) ? writeDepth : readDepth;
+
+            while ((transfer->issued < transfer->length) && (*inFlight < depth) &&
+                   (busy < SIRC_DMA_MAXDEPTH)) {
+                SLOT *slot = slots;
+
+                while (slot->transfer != NULL)
+                    slot++;
+                slot->transfer = transfer;
+                slot->offset = transfer->issued;
+                slot->length = min(transfer->length - transfer->issued, (uint32_t) SIRC_DMA_SEGMENT);
+                if (!issue(slot)) {
+                    slot->transfer = NULL;
+                    transfer->failed = true;
+                    ok = false;
+                    break;
+                }
+                transfer->issued += slot->length;
+                transfer->inFlight++;
+                (*inFlight)++;
+                busy++;
+            }
+        }
+        while ((first < count) && (transfers[first].issued == transfers[first].length))
+            first++;
+
+        if (busy == 0)
+            break;
+
+        SLOT *slot = reap(&bytes);
+        SIRC_DMA_TRANSFER *transfer = slot->transfer;
+        uint32_t *inFlight = (transfer->write) ? &writes : &reads;
+
+        transfer->completed += bytes;
+        if (bytes == 0) {
+            transfer->failed = true;
+            ok = false;
+        } else if (bytes < slot->length) {
+            //Part of it, the rest goes again from the same slot
+            slot->offset += bytes;
+            slot->length -= bytes;
+            if (ok && issue(slot))
+                continue;
+            transfer->failed = true;
+            ok = false;
+        }
+        slot->transfer = NULL;
+        transfer->inFlight--;
+        (*inFlight)--;
+        busy--;
+
+        //Out of order is fine, each one is told as soon as its own data is in
+        if ((transfer->inFlight == 0) && (transfer->completed == transfer->length) &&
+            !transfer->failed && transfer->done)
+            transfer->done(transfer, true);
+    }
+
+    //Whatever a failure stopped (and anything empty)
+    for (uint32_t i = 0; i < count; i++) {
+        if (transfers[i].failed || (transfers[i].completed != transfers[i].length)) {
+            transfers[i].failed = true;
+            ok = false;
+            if (transfers[i].done)
+                transfers[i].done(&transfers[i], false);
+        } else if ((transfers[i].length == 0) && transfers[i].done)
+            transfers[i].done(&transfers[i], true);
+    }
+
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+BOOL SIRC_DMA::transfer(BOOL write, uint64_t deviceOffset, uint8_t *buffer, uint32_t length)
+{
+    SIRC_DMA_TRANSFER transfer;
+
+    transfer.write = write;
+    transfer.deviceOffset = deviceOffset;
+    transfer.buffer = buffer;
+    transfer.length = length;
+    transfer.done = NULL;
+    transfer.context = NULL;
+    return run(&transfer, 1);
+}
+
+BOOL SIRC_DMA::transferWords(BOOL write, uint64_t deviceOffset, uint8_t *buffer, uint32_t length)
+{
+    SIRC_DMA_TRANSFER transfers[3];
+    uint8_t head[4];
+    uint8_t tail[4];
+    uint64_t end = deviceOffset + length;
+    uint64_t headWord = deviceOffset & ~(uint64_t) 3;
+    uint64_t middle = (deviceOffset + 3) & ~(uint64_t) 3;
+    uint64_t tailWord = end & ~(uint64_t) 3;
+    uint32_t headBytes = (uint32_t) (min(end, headWord + 4) - deviceOffset);
+    uint32_t tailBytes = (uint32_t) (end - tailWord);
+    BOOL partialHead = ((deviceOffset & 3) != 0);
+    //A partial word at the end that is not the head word as well
+    BOOL partialTail = ((end & 3) != 0) && (tailWord >= middle);
+    uint32_t count = 0;
+    BOOL ok;
+
+    if ((length == 0) || (!partialHead && !partialTail))
+        return transfer(write, deviceOffset, buffer, length);
+
+    memset(transfers, 0, sizeof(transfers));
+    if (partialHead) {
+        if (write) {
+            memset(head, 0, sizeof(head));
+            memcpy(head + (deviceOffset - headWord), buffer, headBytes);
+        }
+        transfers[count].deviceOffset = headWord;
+        transfers[count].buffer = head;
+        transfers[count].length = sizeof(head);
+        count++;
+    }
+    if (tailWord > middle) {
+        transfers[count].deviceOffset = middle;
+        transfers[count].buffer = buffer + (middle - deviceOffset);
+        transfers[count].length = (uint32_t) (tailWord - middle);
+        count++;
+    }
+    if (partialTail) {
+        if (write) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, buffer + (tailWord - deviceOffset), tailBytes);
+        }
+        transfers[count].deviceOffset = tailWord;
+        transfers[count].buffer = tail;
+        transfers[count].length = sizeof(tail);
+        count++;
+    }
+    for (uint32_t i = 0; i < count; i++)
+        transfers[i].write = write;
+
+    ok = run(transfers, count);
+    if (ok && !write) {
+        if (partialHead)
+            memcpy(buffer, head + (deviceOffset - headWord), headBytes);
+        if (partialTail)
+            memcpy(buffer + (tailWord - deviceOffset), tail, tailBytes);
+    }
+    return ok;
+}
+
+//The runner
+
+SIRC_DMA_ASYNC::SIRC_DMA_ASYNC(SIRC *sirc, SIRC_DMA *dma, uint64_t inputOffset, uint64_t outputOffset)
+    : SIRC_ASYNC(sirc)
+{
+    this->dma = dma;
+    this->inputOffset = inputOffset;
+    this->outputOffset = outputOffset;
+    completed = 0;
+}
+
+//Transfers finish in whatever order the driver does them.  Each request waits for
+// the ones submitted before it, so that they complete in order.
+void SIRC_DMA_ASYNC::transferDone(SIRC_DMA_TRANSFER *transfer, BOOL ok)
+{
+    SIRC_DMA_ASYNC *runner = (SIRC_DMA_ASYNC *) transfer->context;
+    uint32_t index = (uint32_t) (transfer - &runner->group[0]);
+
+    if (!ok)
+        runner->errors[index] = (transfer->write) ? INVALIDWRITETRANSMIT : INVALIDREADTRANSMIT;
+    runner->finished[index] = true;
+    while ((runner->completed < runner->group.size()) && runner->finished[runner->completed]) {
+        runner->requests[runner->completed]->complete(runner->errors[runner->completed], 0);
+        runner->completed++;
+    }
+}
+
+//Whether a transfer has to wait for an earlier one of the same group to finish
+static BOOL conflicts(const SIRC_DMA_TRANSFER &earlier, const SIRC_DMA_TRANSFER &later)
+{
+    //Both write the same part of the device
+    if (earlier.write && later.write &&
+        (later.deviceOffset < earlier.deviceOffset + earlier.length) &&
+        (earlier.deviceOffset < later.deviceOffset + later.length))
+        return true;
+    //One of them fills host memory the other one uses
+    if ((!earlier.write || !later.write) &&
+        (later.buffer < earlier.buffer + earlier.length) &&
+        (earlier.buffer < later.buffer + later.length))
+        return true;
+    return false;
+}
+
+//Runs of reads and writes go through the queue together.  They have to be whole words,
+// anything else goes through the synchronous methods, which split off the partial words.
+void SIRC_DMA_ASYNC::run(std::list <SIRC_ASYNC_REQUEST *> &batch)
+{
+    std::list <SIRC_ASYNC_REQUEST *>::iterator iter = batch.begin();
+
+    while (iter != batch.end()) {
+        group.clear();
+        requests.clear();
+        for (; iter != batch.end(); iter++) {
+            SIRC_ASYNC_REQUEST *request = *iter;
+            SIRC_DMA_TRANSFER transfer;
+            BOOL clash = false;
+
+            if (((request->operation != SIRC_ASYNC_REQUEST::WRITE) &&
+                 (request->operation != SIRC_ASYNC_REQUEST::READ)) ||
+                (request->buffer == NULL) || (request->length == 0) ||
+                ((request->startAddress % 4) != 0) || ((request->length % 4) != 0))
+                break;
+
+            transfer.write = (request->operation == SIRC_ASYNC_REQUEST::WRITE);
+            transfer.deviceOffset = ((transfer.write) ? inputOffset : outputOffset) + request->startAddress;
+            transfer.buffer = request->buffer;
+            transfer.length = request->length;
+            transfer.done = transferDone;
+            transfer.context = this;
+            for (uint32_t i = 0; i < group.size(); i++)
+                clash = clash || conflicts(group[i], transfer);
+            if (clash)
+                break;
+            group.push_back(transfer);
+            requests.push_back(request);
+        }
+
+        if (!group.empty()) {
+            errors.assign(group.size(), 0);
+            finished.assign(group.size(), false);
+            completed = 0;
+            LogIt("sirc::dma.group %u",(uint32_t)group.size());
+            (void) dma->run(&group[0], (uint32_t) group.size());
+        } else {
+            execute(*iter);
+            iter++;
+        }
+    }
+}
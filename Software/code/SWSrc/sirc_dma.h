@@ -0,0 +1,142 @@
+// Title: SIRC queued DMA
+//
+// Description: Keeps several DMA transfers in flight on a PCIe driver handle, instead of
+// one ReadFile/WriteFile at a time.  Buffers are cut into segments, up to a set number of
+// segments per direction are outstanding, and each lands in the caller's buffer in
+// whatever order the driver finishes them.  PCIE_SIRC and PCIE2_SIRC move all their
+// data through it, and SIRC_DMA_ASYNC gives their submitRead/submitWrite the same queue.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// Windows uses overlapped ReadFile/WriteFile, one event per segment.  Elsewhere it is
+// POSIX aio on a file descriptor, which is how it gets tested against a plain file.
+// The queue depths are the PARAMETERS maxOutstandingReads and maxOutstandingWrites of
+// the backend, 0 meaning as deep as the engine goes (SIRC_DMA_MAXDEPTH).
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCDMAH
+#define DEFINESIRCDMAH 1
+
+#if !defined(_WIN32)
+#include <aio.h>
+#endif
+
+//Bytes per segment.  Small enough to start the device early, large enough that the
+// per-request overhead of the driver disappears.  Well under the 32MB that 32-bit
+// Windows could take in one request.
+#define SIRC_DMA_SEGMENT (1024 * 1024)
+
+//Segments in flight, both directions together.  WaitForMultipleObjects takes no more.
+#define SIRC_DMA_MAXDEPTH 64
+
+//Segments per direction unless told otherwise
+#define SIRC_DMA_DEPTH 4
+
+#if defined(_WIN32)
+typedef HANDLE SIRC_DMA_FILE;
+#else
+typedef int SIRC_DMA_FILE;
+#endif
+
+//One buffer to move.  The caller fills in the first part.
+typedef struct SIRC_DMA_TRANSFER {
+    BOOL write;
+    uint64_t deviceOffset;
+    uint8_t *buffer;
+    uint32_t length;
+    //Called from inside run() as soon as the last segment of this transfer is in
+    void (*done)(struct SIRC_DMA_TRANSFER *transfer, BOOL ok);
+    void *context;
+
+    //run()'s
+    uint32_t issued;
+    uint32_t completed;
+    uint32_t inFlight;
+    BOOL failed;
+} SIRC_DMA_TRANSFER;
+
+class SIRC_DMA {
+public:
+    SIRC_DMA(SIRC_DMA_FILE file);
+    ~SIRC_DMA();
+
+    //False if the events could not be made
+    BOOL valid(void) { return ready; }
+
+    //Segments in flight per direction, 0 for SIRC_DMA_MAXDEPTH.
+    //Together they never go past SIRC_DMA_MAXDEPTH.
+    void setDepth(uint32_t reads, uint32_t writes);
+    void getDepth(uint32_t *reads, uint32_t *writes);
+
+    //Move every transfer.  Returns when all of them are done, false if any failed.
+    //Calls from different threads take turns.
+    BOOL run(SIRC_DMA_TRANSFER *transfers, uint32_t count);
+
+    //One buffer
+    BOOL transfer(BOOL write, uint64_t deviceOffset, uint8_t *buffer, uint32_t length);
+
+    //One buffer, for a device that only moves whole 32-bit words.  The aligned middle
+    // goes straight to or from buffer, each partial word at the ends through 4 bytes of
+    // its own.  Writes fill the rest of a partial word with zeros.
+    BOOL transferWords(BOOL write, uint64_t deviceOffset, uint8_t *buffer, uint32_t length);
+
+private:
+    typedef struct {
+        SIRC_DMA_TRANSFER *transfer;
+        uint32_t offset;        //into the transfer
+        uint32_t length;
+#if defined(_WIN32)
+        OVERLAPPED overlapped;
+#else
+        struct aiocb control;
+        int file;               //glibc runs one request per descriptor at a time
+#endif
+    } SLOT;
+
+    SIRC_DMA_FILE file;
+    BOOL ready;
+    CRITICAL_SECTION lock;
+    uint32_t readDepth;
+    uint32_t writeDepth;
+    SLOT slots[SIRC_DMA_MAXDEPTH];
+
+    BOOL issue(SLOT *slot);
+    //Waits for one busy slot to finish, returns it with the bytes it moved (0 on failure)
+    SLOT *reap(uint32_t *bytes);
+};
+
+//Runs submitted reads and writes of a PCIe backend through its SIRC_DMA together:
+// the segments of every transfer in a batch share the queue.  Requests still complete
+// in the order they were submitted (see SIRC::submitWrite), one whose data is in
+// waiting for the earlier ones.  Everything else runs as before, in order.
+class SIRC_DMA_ASYNC : public SIRC_ASYNC {
+public:
+    // inputOffset, outputOffset: where the input and output buffers are on the handle
+    SIRC_DMA_ASYNC(SIRC *sirc, SIRC_DMA *dma, uint64_t inputOffset, uint64_t outputOffset);
+
+protected:
+    void run(std::list <SIRC_ASYNC_REQUEST *> &batch);
+
+private:
+    SIRC_DMA *dma;
+    uint64_t inputOffset;
+    uint64_t outputOffset;
+
+    //The group in the queue, a request and result per transfer
+    std::vector <SIRC_DMA_TRANSFER> group;
+    std::vector <SIRC_ASYNC_REQUEST *> requests;
+    std::vector <int8_t> errors;
+    std::vector <BOOL> finished;
+    uint32_t completed;             //requests of the group completed so far
+
+    static void transferDone(SIRC_DMA_TRANSFER *transfer, BOOL ok);
+};
+
+#endif //DEFINESIRCDMAH
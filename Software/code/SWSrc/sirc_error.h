@@ -150,6 +150,26 @@
 //The sendSystemACERegisterWrite was not acknowledged
 #define FAILSYSACEWRITEACK -30
 
+//Valid for quiesce
+//Responses to commands that failed were still due when it gave up
+#define FAILQUIESCE -31
+
+//Valid for BROKER_SIRC
+//The broker is not running, or went away during the call
+#define FAILBROKER -32
+
+//Valid for REMOTE_SIRC
+//The proxy is not running, or the connection to it broke
+#define FAILREMOTE -33
+
+//Valid for sendChecksum, sendWriteVerified
+//The device computed a different checksum than the host did, the data did not arrive intact
+#define FAILCHECKSUM -34
+
+//Valid for sendChecksum, sendWriteVerified
+//The device does not compute checksums (it never answered, or the interface has none)
+#define FAILNOCHECKSUM -35
+
 //******These error codes should not be returned.  If they do, something is wrong in the API code.
 //		Please send me mail with details regarding the conditions under which this occurred.
 #define FAILVMNSCOMPLETION -100
@@ -193,6 +213,10 @@
 #define RECEIVE_ERROR_SA_REG_READ_RUNNING 19		// This error occurs when we get a SystemACE reg read command, but the user application is still running
 #define RECEIVE_ERROR_SA_REG_READ_ADDRESS 20		// This error occurs when we get a SystemACE reg read command, but the address is not [0-47]
 #define RECEIVE_ERROR_RESET_LENGTH 21				// This error occurs when we get a soft reset command, but it's not the correct length packet
+#define RECEIVE_ERROR_NEGOTIATE_LENGTH 22			// This error occurs when we get a negotiate command, but it's not the correct length packet
+#define RECEIVE_ERROR_CODED_WRITE 23				// This error occurs when we get a coded write command, but the payload does not expand to its length
+#define RECEIVE_ERROR_JOIN 24						// This error occurs when we get a join command that is not the correct length, or not for a group address
+#define RECEIVE_ERROR_CHECKSUM 25					// This error occurs when we get a checksum command that is not the correct length, or not within the buffer
 
 #endif //DEFINESIRCERRORH
 
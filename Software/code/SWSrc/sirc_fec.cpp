@@ -0,0 +1,157 @@
+// Title: SIRC forward error correction
+//
+// Description: XOR parity over groups of read response frames.
+// See sirc_fec.h for the frame format.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIRC_FEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SIRC_FEC_SSE2)
+//Every x86 and x64 host we run on has SSE2.  16 bytes at a time, then the tail.
+void sircXor(uint8_t *dst, const uint8_t *src, uint32_t length)
+{
+    uint32_t i = 0;
+
+    for (; i + 64 <= length; i += 64) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(dst + i + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i *)(dst + i + 32));
+        __m128i a3 = _mm_loadu_si128((const __m128i *)(dst + i + 48));
+        a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i *)(src + i)));
+        a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i *)(src + i + 16)));
+        a2 = _mm_xor_si128(a2, _mm_loadu_si128((const __m128i *)(src + i + 32)));
+        a3 = _mm_xor_si128(a3, _mm_loadu_si128((const __m128i *)(src + i + 48)));
+        _mm_storeu_si128((__m128i *)(dst + i), a0);
+        _mm_storeu_si128((__m128i *)(dst + i + 16), a1);
+        _mm_storeu_si128((__m128i *)(dst + i + 32), a2);
+        _mm_storeu_si128((__m128i *)(dst + i + 48), a3);
+    }
+    for (; i + 16 <= length; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_xor_si128(_mm_loadu_si128((const __m128i *)(dst + i)),
+                                       _mm_loadu_si128((const __m128i *)(src + i))));
+    for (; i < length; i++)
+        dst[i] ^= src[i];
+}
+#else
+//Elsewhere 8 bytes at a time, then the tail.  memcpy since frames need not be aligned.
+void sircXor(uint8_t *dst, const uint8_t *src, uint32_t length)
+{
+    uint32_t i = 0;
+    uint64_t a, b;
+
+    for (; i + 8 <= length; i += 8) {
+        memcpy(&a, dst + i, 8);
+        memcpy(&b, src + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < length; i++)
+        dst[i] ^= src[i];
+}
+#endif
+
+BOOL sircFecDataFrame(const uint8_t *frame, uint32_t length, uint32_t *address, uint32_t *rawLength)
+{
+    uint8_t *f = (uint8_t *) frame;
+
+    static_assert((SircWire::ReadResponse::Address::offset == SircWire::CodedReadResponse::Address::offset) &&
+                  (SircWire::ReadResponse::Address::offset == SircWire::ReadBack::Address::offset) &&
+                  (SircWire::ReadResponse::Address::offset == SircWire::CodedReadBack::Address::offset),
+                  "data frames must share the address field");
+    if (SircWire::ReadResponse::valid(f, length))
+        *rawLength = SircWire::ReadResponse::dataLength(length);
+    else if (SircWire::CodedReadResponse::valid(f, length))
+        *rawLength = SircWire::CodedReadResponse::Length::get(f);
+    else if (SircWire::ReadBack::valid(f, length))
+        *rawLength = SircWire::ReadBack::dataLength(length);
+    else if (SircWire::CodedReadBack::valid(f, length))
+        *rawLength = SircWire::CodedReadBack::Length::get(f);
+    else
+        return false;
+    *address = SircWire::ReadResponse::Address::get(f);
+    return true;
+}
+
+//Bytes of sum past length are always zero
+void sircFecStart(SIRC_FEC_GROUP *group)
+{
+    memset(group->sum, 0, group->length);
+    group->frames = 0;
+    group->length = 0;
+    group->lengthXor = 0;
+    group->first = 0;
+    group->end = 0;
+}
+
+BOOL sircFecAdd(SIRC_FEC_GROUP *group, const uint8_t *frame, uint32_t length)
+{
+    uint32_t address, rawLength;
+
+    if ((length > SIRC_FEC_MAXFRAME) || !sircFecDataFrame(frame, length, &address, &rawLength))
+        return false;
+
+    if (group->frames == 0) {
+        group->first = address;
+        group->end = address + rawLength;
+    } else {
+        group->first = min(group->first, address);
+        group->end = max(group->end, address + rawLength);
+    }
+    sircXor(group->sum, frame, length);
+    group->length = max(group->length, length);
+    group->lengthXor ^= (uint16_t) length;
+    group->frames++;
+    return true;
+}
+
+uint32_t sircFecRebuild(SIRC_FEC_GROUP *group, const uint8_t *parity, uint32_t parityLength,
+                        uint8_t *frame)
+{
+    uint8_t *p = (uint8_t *) parity;
+    uint32_t first, end, count, sumLength, length;
+    uint32_t address, rawLength;
+
+    if (!SircWire::Parity::valid(p, parityLength) ||
+        (SircWire::Parity::dataLength(parityLength) > SIRC_FEC_MAXFRAME)) {
+        sircFecStart(group);
+        return 0;
+    }
+    first = SircWire::Parity::First::get(p);
+    end = SircWire::Parity::End::get(p);
+    count = SircWire::Parity::Count::get(p);
+    sumLength = SircWire::Parity::dataLength(parityLength);
+
+    //Exactly one of its frames missing, and nothing from elsewhere in the sum
+    if ((group->frames + 1 != count) || (sumLength < group->length) ||
+        ((group->frames != 0) && ((group->first < first) || (group->end > end)))) {
+        sircFecStart(group);
+        return 0;
+    }
+
+    sircXor(group->sum, SircWire::Parity::data(p), sumLength);
+    length = SircWire::Parity::LengthXor::get(p) ^ group->lengthXor;
+    group->length = sumLength;
+    if ((length == 0) || (length > sumLength) ||
+        !sircFecDataFrame(group->sum, length, &address, &rawLength) ||
+        (address < first) || (address + rawLength > end)) {
+        sircFecStart(group);
+        return 0;
+    }
+    memcpy(frame, group->sum, length);
+    sircFecStart(group);
+    return length;
+}
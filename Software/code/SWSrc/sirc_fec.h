@@ -0,0 +1,71 @@
+// Title: SIRC forward error correction
+//
+// Description: XOR parity over groups of read response frames, so the host can rebuild
+// a lost frame right away instead of waiting out readTimeout and asking for it again.
+// Used by ETH_SIRC and SRV_SIRC once both sides have agreed to a group size
+// (see SIRC::PARAMETERS).
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// Wire commands (payload bytes, after the 14-byte Ethernet header):
+//   'f' + group[1]                         host asks for a parity frame every group
+//                                          data frames, 0 for none
+//   'f' + group[1]                         reply: the group the FPGA will use, 0 if none
+//   'p' + first[4] + end[4] + count[1] + lengthXor[2] + parity
+//                                          parity of the count frames just sent
+// Data frames are the 'r', 'q', 'g' and 'u' responses.  A group is up to group of them
+// in a row, all answering the same read request (or write & run), and carrying
+// [first, end) of its output between them.  The parity is the XOR of the whole frames,
+// command byte on, each padded with zeroes to the longest; lengthXor is the XOR of
+// their lengths.  A group missing one frame gets it back as the XOR of the parity with
+// the others.  Hardware keeps one frame-sized XOR accumulator and a length register.
+// With a group set the FPGA makes its data frames SIRC_FEC_OVERHEAD bytes shorter, so
+// the parity frame fits.
+// A device that does not know 'f' does not answer, the host then never sees 'p'.
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCFECH
+#define DEFINESIRCFECH 1
+
+//Largest frame a group can hold (payload, after the Ethernet header)
+#define SIRC_FEC_MAXFRAME 1500
+
+//What parity costs each data frame
+#define SIRC_FEC_OVERHEAD SircWire::Parity::headerLength
+
+//Parity of the frames of one group so far
+typedef struct {
+    uint32_t frames;
+    uint32_t length;            //of the longest frame
+    uint16_t lengthXor;
+    uint32_t first;             //output covered, [first, end)
+    uint32_t end;
+    uint8_t sum[SIRC_FEC_MAXFRAME];
+} SIRC_FEC_GROUP;
+
+//dst ^= src, length bytes
+extern void sircXor(uint8_t *dst, const uint8_t *src, uint32_t length);
+
+//Is this a data frame?  If so, returns true with the output it carries.
+extern BOOL sircFecDataFrame(const uint8_t *frame, uint32_t length, uint32_t *address, uint32_t *rawLength);
+
+//Start a new group
+extern void sircFecStart(SIRC_FEC_GROUP *group);
+
+//Add a frame to the group.  Returns false, and leaves the group alone, if it is not a data frame.
+extern BOOL sircFecAdd(SIRC_FEC_GROUP *group, const uint8_t *frame, uint32_t length);
+
+//Rebuild the frame the group is missing from its parity frame, into frame (SIRC_FEC_MAXFRAME bytes).
+//Returns its length, 0 if the group is not missing exactly one frame of those the parity covers.
+//Either way the group is started over.
+extern uint32_t sircFecRebuild(SIRC_FEC_GROUP *group, const uint8_t *parity, uint32_t parityLength,
+                               uint8_t *frame);
+
+#endif //DEFINESIRCFECH
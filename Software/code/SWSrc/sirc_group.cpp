@@ -0,0 +1,640 @@
+// Title: SIRC device group
+//
+// Description: Shards calls over many SIRCs and runs batches of jobs on them.
+// See sirc_group.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//A member straggles when its part takes this many times the median...
+#define GROUPSTRAGGLERFACTOR 2
+
+//...and at least this much longer (GetTickCount moves in 10-16ms steps)
+#define GROUPSTRAGGLERMSEC 20
+
+SIRC_GROUP::SIRC_GROUP(SIRC **members, uint32_t count, uint32_t granule,
+                       uint8_t lengthRegister, BOOL ownsMembers)
+{
+    this->count = 0;
+    this->granule = (granule == 0) ? 1 : granule;
+    this->lengthRegister = lengthRegister;
+    this->ownsMembers = ownsMembers;
+    running = NULL;
+    InitializeCriticalSection(&lock);
+    memset(this->members, 0, sizeof(this->members));
+    memset(&statistics, 0, sizeof(statistics));
+    statistics.lastStraggler = SIRC_GROUP_MAX_MEMBERS;
+    setLastError(0);
+
+    if (!members) {
+        setLastError(INVALIDBUFFER);
+        return;
+    }
+    if (count == 0 || count > SIRC_GROUP_MAX_MEMBERS) {
+        setLastError(INVALIDLENGTH);
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!members[i]) {
+            setLastError(INVALIDBUFFER);
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        this->members[i].sirc = members[i];
+        this->members[i].group = this;
+        this->members[i].index = i;
+        //A member that did not open spoils the group
+        if (members[i]->getLastError() != 0 && getLastError() == 0)
+            setLastError(members[i]->getLastError());
+    }
+    this->count = count;
+}
+
+SIRC_GROUP::~SIRC_GROUP()
+{
+    //Submitted requests still come through us
+    finishAsync();
+
+    if (ownsMembers) {
+        for (uint32_t i = 0; i < count; i++)
+            delete members[i].sirc;
+    }
+    DeleteCriticalSection(&lock);
+}
+
+BOOL SIRC_GROUP::sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+
+    if (!buffer) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (length == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    started = begin(requests);
+    shard(length, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        MEMBER *member = &members[i];
+
+        if (!member->inCall)
+            continue;
+        if (lengthRegister != SIRC_GROUP_NOREGISTER) {
+            requests[i] = member->sirc->submitParamRegisterWrite(lengthRegister, member->length,
+                                                                 stampFinish, member);
+            if (!requests[i])
+                continue;
+        }
+        requests[count + i] = member->sirc->submitWrite(startAddress, member->length,
+                                                        buffer + member->offset, stampFinish, member);
+    }
+    return finish(requests, started);
+}
+
+BOOL SIRC_GROUP::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+
+    if (!buffer) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (length == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    started = begin(requests);
+    shard(length, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        MEMBER *member = &members[i];
+
+        if (member->inCall)
+            requests[count + i] = member->sirc->submitRead(startAddress, member->length,
+                                                           buffer + member->offset, stampFinish, member);
+    }
+    return finish(requests, started);
+}
+
+BOOL SIRC_GROUP::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+                                 uint32_t maxWaitTimeInMsec, uint8_t *outData, uint32_t maxOutLength,
+                                 uint32_t *outputLength)
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+    uint32_t gathered;
+    BOOL ok;
+
+    if (!inData || !outData || !outputLength) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (inLength == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    started = begin(requests);
+    shard(inLength, maxOutLength);
+    for (uint32_t i = 0; i < count; i++) {
+        MEMBER *member = &members[i];
+
+        if (!member->inCall)
+            continue;
+        if (lengthRegister != SIRC_GROUP_NOREGISTER) {
+            requests[i] = member->sirc->submitParamRegisterWrite(lengthRegister, member->length,
+                                                                 stampFinish, member);
+            if (!requests[i])
+                continue;
+        }
+        requests[count + i] = member->sirc->submitWriteAndRun(startAddress, member->length,
+                                                              inData + member->offset, maxWaitTimeInMsec,
+                                                              outData + member->outOffset, member->outLength,
+                                                              stampFinish, member);
+    }
+    ok = finish(requests, started);
+
+    //Close the gaps, each output window starts at or after where its data goes
+    gathered = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        MEMBER *member = &members[i];
+
+        if (!member->inCall)
+            continue;
+        if (ok)
+            memmove(outData + gathered, outData + member->outOffset, member->value);
+        gathered += member->value;
+    }
+    *outputLength = gathered;
+    return ok;
+}
+
+BOOL SIRC_GROUP::sendParamRegisterWrite(uint8_t regNumber, uint32_t value)
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+
+    started = begin(requests);
+    for (uint32_t i = 0; i < count; i++)
+        requests[count + i] = members[i].sirc->submitParamRegisterWrite(regNumber, value,
+                                                                        stampFinish, &members[i]);
+    return finish(requests, started);
+}
+
+BOOL SIRC_GROUP::sendParamRegisterRead(uint8_t regNumber, uint32_t *value)
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+
+    if (!value) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+
+    started = begin(requests);
+    for (uint32_t i = 0; i < count; i++)
+        requests[count + i] = members[i].sirc->submitParamRegisterRead(regNumber,
+                                                                       stampFinish, &members[i]);
+    if (!finish(requests, started))
+        return false;
+    *value = members[0].value;
+    return true;
+}
+
+BOOL SIRC_GROUP::sendRun()
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+
+    started = begin(requests);
+    for (uint32_t i = 0; i < count; i++)
+        requests[count + i] = members[i].sirc->submitRun(stampFinish, &members[i]);
+    return finish(requests, started);
+}
+
+BOOL SIRC_GROUP::waitDone(uint32_t maxWaitTimeInMsec)
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+
+    started = begin(requests);
+    for (uint32_t i = 0; i < count; i++)
+        requests[count + i] = members[i].sirc->submitWaitDone(maxWaitTimeInMsec,
+                                                              stampFinish, &members[i]);
+    return finish(requests, started);
+}
+
+BOOL SIRC_GROUP::sendReset()
+{
+    SIRC_REQUEST *requests[2 * SIRC_GROUP_MAX_MEMBERS];
+    DWORD started;
+
+    started = begin(requests);
+    for (uint32_t i = 0; i < count; i++)
+        requests[count + i] = members[i].sirc->submitReset(stampFinish, &members[i]);
+    return finish(requests, started);
+}
+
+//Quiescing is local to each member, one after the other is good enough
+BOOL SIRC_GROUP::quiesce(uint32_t maxWaitTimeInMsec)
+{
+    DWORD start = GetTickCount();
+    DWORD spent;
+
+    for (uint32_t i = 0; i < count; i++) {
+        spent = GetTickCount() - start;
+        if (!members[i].sirc->quiesce((spent < maxWaitTimeInMsec) ? maxWaitTimeInMsec - spent : 0)) {
+            setLastError(members[i].sirc->getLastError());
+            return false;
+        }
+    }
+    setLastError(0);
+    return true;
+}
+
+BOOL SIRC_GROUP::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength)
+{
+    SIRC::PARAMETERS params;
+    uint32_t maxInput = 0;
+    uint32_t maxOutput = 0;
+
+    if (!members[0].sirc->getParameters(outParameters, maxOutLength)) {
+        setLastError(members[0].sirc->getLastError());
+        return false;
+    }
+    if (maxOutLength < SIRC_PARAMETERS_V1_LENGTH) {
+        setLastError(0);
+        return true;
+    }
+    //Slices are equal, so the smallest member sets the size
+    for (uint32_t i = 0; i < count; i++) {
+        if (!members[i].sirc->getParameters(&params, sizeof(params))) {
+            setLastError(members[i].sirc->getLastError());
+            return false;
+        }
+        if (i == 0 || params.maxInputDataBytes < maxInput)
+            maxInput = params.maxInputDataBytes;
+        if (i == 0 || params.maxOutputDataBytes < maxOutput)
+            maxOutput = params.maxOutputDataBytes;
+    }
+    outParameters->maxInputDataBytes = maxInput * count;
+    outParameters->maxOutputDataBytes = maxOutput * count;
+    setLastError(0);
+    return true;
+}
+
+BOOL SIRC_GROUP::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
+{
+    SIRC::PARAMETERS params;
+
+    if (!inParameters) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (length < SIRC_PARAMETERS_V1_LENGTH) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!members[i].sirc->getParameters(&params, sizeof(params))) {
+            setLastError(members[i].sirc->getLastError());
+            return false;
+        }
+        params.maxInputDataBytes = inParameters->maxInputDataBytes / count;
+        params.maxOutputDataBytes = inParameters->maxOutputDataBytes / count;
+        params.writeTimeout = inParameters->writeTimeout;
+        params.readTimeout = inParameters->readTimeout;
+        params.maxRetries = inParameters->maxRetries;
+        if (!members[i].sirc->setParameters(&params, sizeof(params))) {
+            setLastError(members[i].sirc->getLastError());
+            return false;
+        }
+    }
+    setLastError(0);
+    return true;
+}
+
+BOOL SIRC_GROUP::runJobs(SIRC_GROUP_JOB *jobs, uint32_t count)
+{
+    JOBS run;
+    DWORD started;
+    int8_t error = 0;
+
+    if (!jobs) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (count == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+
+    for (uint32_t j = 0; j < count; j++) {
+        jobs[j].outputLength = 0;
+        jobs[j].error = 0;
+        jobs[j].member = SIRC_GROUP_MAX_MEMBERS;
+        jobs[j].elapsedMsec = 0;
+    }
+    run.jobs = jobs;
+    run.count = count;
+    run.next = 0;
+    run.left = count;
+    run.active = this->count;
+    run.allDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!run.allDone) {
+        setLastError(FAILMEMALLOC);
+        return false;
+    }
+    running = &run;
+
+    started = GetTickCount();
+    for (uint32_t i = 0; i < this->count; i++) {
+        members[i].inCall = true;
+        members[i].finished = started;
+    }
+    //From here on each member pulls its next job as it finishes one
+    for (uint32_t i = 0; i < this->count; i++)
+        startJob(&members[i]);
+    WaitForSingleObject(run.allDone, INFINITE);
+    CloseHandle(run.allDone);
+    running = NULL;
+
+    //Who kept the others waiting at the end
+    noteTimes(started, false);
+    EnterCriticalSection(&lock);
+    statistics.jobs += count;
+    LeaveCriticalSection(&lock);
+
+    for (uint32_t j = 0; j < count; j++) {
+        if (jobs[j].error != 0) {
+            error = jobs[j].error;
+            break;
+        }
+    }
+    setLastError(error);
+    return (error == 0);
+}
+
+uint32_t SIRC_GROUP::getMemberCount(void)
+{
+    return count;
+}
+
+SIRC *SIRC_GROUP::getMember(uint32_t member)
+{
+    if (member >= count)
+        return NULL;
+    return members[member].sirc;
+}
+
+void SIRC_GROUP::getStatistics(SIRC_GROUP_STATISTICS *outStatistics)
+{
+    EnterCriticalSection(&lock);
+    *outStatistics = statistics;
+    LeaveCriticalSection(&lock);
+}
+
+BOOL SIRC_GROUP::getMemberStatistics(uint32_t member, SIRC_GROUP_MEMBER_STATISTICS *outStatistics)
+{
+    if (member >= count) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+    EnterCriticalSection(&lock);
+    *outStatistics = members[member].statistics;
+    LeaveCriticalSection(&lock);
+    return true;
+}
+
+//Start a call that every member has a part in
+DWORD SIRC_GROUP::begin(SIRC_REQUEST **requests)
+{
+    DWORD started = GetTickCount();
+
+    memset(requests, 0, 2 * SIRC_GROUP_MAX_MEMBERS * sizeof(SIRC_REQUEST *));
+    for (uint32_t i = 0; i < count; i++) {
+        members[i].inCall = true;
+        members[i].value = 0;
+        members[i].finished = started;
+    }
+    return started;
+}
+
+//Cut length bytes (and outLength bytes of output room) into one slice per member.
+//Whole granules are dealt out evenly, the odd bytes go to the last member.
+//Members left without any take no part.
+void SIRC_GROUP::shard(uint32_t length, uint32_t outLength)
+{
+    uint32_t units = length / granule;
+    uint32_t outUnits = outLength / granule;
+    uint32_t offset = 0;
+    uint32_t outOffset = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        MEMBER *member = &members[i];
+
+        member->offset = offset;
+        member->length = (units / count + ((i < units % count) ? 1 : 0)) * granule;
+        member->outOffset = outOffset;
+        member->outLength = (outUnits / count + ((i < outUnits % count) ? 1 : 0)) * granule;
+        if (i == count - 1) {
+            member->length += length % granule;
+            member->outLength += outLength % granule;
+        }
+        member->inCall = (member->length != 0);
+        offset += member->length;
+        outOffset += member->outLength;
+    }
+}
+
+//Wait for every member's part, time it and let go of the handles.
+//Returns true if all of them succeeded.
+//If any failed, returns false w/the first error in member order.
+BOOL SIRC_GROUP::finish(SIRC_REQUEST **requests, DWORD started)
+{
+    int8_t error = 0;
+    int8_t memberError;
+
+    for (uint32_t i = 0; i < count; i++) {
+        MEMBER *member = &members[i];
+
+        if (!member->inCall)
+            continue;
+        memberError = 0;
+        //First request (if any), then the last one
+        for (uint32_t r = i; r < 2 * count; r += count) {
+            if (!requests[r])
+                continue;
+            requests[r]->wait(INFINITE);
+            if (memberError == 0)
+                memberError = requests[r]->getError();
+            member->value = requests[r]->getValue();
+            requests[r]->release();
+        }
+        //Did not get submitted
+        if (!requests[count + i] && memberError == 0)
+            memberError = member->sirc->getLastError();
+        if (memberError != 0) {
+            LogIt("sirc::group.fail %u %d",i,(int) memberError);
+            EnterCriticalSection(&lock);
+            member->statistics.lastError = memberError;
+            LeaveCriticalSection(&lock);
+            if (error == 0)
+                error = memberError;
+        }
+    }
+
+    noteTimes(started, true);
+    EnterCriticalSection(&lock);
+    statistics.calls++;
+    LeaveCriticalSection(&lock);
+
+    setLastError(error);
+    return (error == 0);
+}
+
+//Book each member's time since started, and see if one of them kept the others waiting
+void SIRC_GROUP::noteTimes(DWORD started, BOOL book)
+{
+    uint32_t sorted[SIRC_GROUP_MAX_MEMBERS];
+    uint32_t taking = 0;
+    uint32_t slowest = 0;
+    uint32_t slowestMsec = 0;
+    uint32_t elapsed;
+    uint32_t median;
+    uint32_t j;
+
+    EnterCriticalSection(&lock);
+    for (uint32_t i = 0; i < count; i++) {
+        MEMBER *member = &members[i];
+
+        if (!member->inCall)
+            continue;
+        elapsed = member->finished - started;
+        //runJobs books each job as it goes
+        if (book) {
+            member->statistics.calls++;
+            member->statistics.busyMsec += elapsed;
+        }
+        member->statistics.lastMsec = elapsed;
+        if (taking == 0 || elapsed > slowestMsec) {
+            slowest = i;
+            slowestMsec = elapsed;
+        }
+        //Insertion sort, there are few of them
+        for (j = taking; j > 0 && sorted[j - 1] > elapsed; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = elapsed;
+        taking++;
+    }
+
+    if (taking > 1) {
+        median = sorted[(taking - 1) / 2];
+        if (slowestMsec > GROUPSTRAGGLERFACTOR * median && slowestMsec - median >= GROUPSTRAGGLERMSEC) {
+            members[slowest].statistics.straggles++;
+            statistics.straggles++;
+            statistics.lastStraggler = slowest;
+            statistics.waitedMsec += slowestMsec - median;
+            LogIt("sirc::group.straggler %u %u",slowest,slowestMsec - median);
+        }
+    }
+    LeaveCriticalSection(&lock);
+}
+
+//Give the member the next job.  Returns once it has one running, or there are none
+// left for it.
+void SIRC_GROUP::startJob(MEMBER *member)
+{
+    JOBS *run = running;
+    SIRC_GROUP_JOB *job;
+    SIRC_REQUEST *request;
+    LONG next;
+    BOOL last;
+
+    next = InterlockedIncrement(&run->next) - 1;
+    if (next >= (LONG) run->count)
+        return;
+    job = &run->jobs[next];
+    job->member = member->index;
+    member->jobIndex = next;
+    member->jobStarted = GetTickCount();
+    request = member->sirc->submitWriteAndRun(job->startAddress, job->inLength, job->inData,
+                                              job->maxWaitTimeInMsec, job->outData, job->maxOutLength,
+                                              jobDone, member);
+    //jobDone has it from here, and may be done with it already
+    if (request) {
+        request->release();
+        return;
+    }
+
+    job->error = member->sirc->getLastError();
+    EnterCriticalSection(&lock);
+    member->statistics.lastError = job->error;
+    LeaveCriticalSection(&lock);
+    LogIt("sirc::group.fail %u %d",member->index,(int) job->error);
+    last = (InterlockedDecrement(&run->active) == 0);
+    if (InterlockedDecrement(&run->left) == 0) {
+        SetEvent(run->allDone);
+        return;
+    }
+    //The others carry on.  If nobody is left to take jobs, the rest fail the same way.
+    if (!last)
+        return;
+    while ((next = InterlockedIncrement(&run->next) - 1) < (LONG) run->count) {
+        run->jobs[next].member = member->index;
+        run->jobs[next].error = job->error;
+        if (InterlockedDecrement(&run->left) == 0) {
+            SetEvent(run->allDone);
+            return;
+        }
+    }
+}
+
+//Completion of a request that is the member's last in a call
+void SIRC_GROUP::stampFinish(SIRC_REQUEST *request, void *context)
+{
+    MEMBER *member = (MEMBER *) context;
+
+    member->finished = GetTickCount();
+}
+
+//Completion of a job: book it and start the member's next one
+void SIRC_GROUP::jobDone(SIRC_REQUEST *request, void *context)
+{
+    MEMBER *member = (MEMBER *) context;
+    SIRC_GROUP *group = member->group;
+    JOBS *run = group->running;
+    SIRC_GROUP_JOB *job = &run->jobs[member->jobIndex];
+    DWORD now = GetTickCount();
+
+    job->error = request->getError();
+    job->outputLength = request->getValue();
+    job->elapsedMsec = now - member->jobStarted;
+    member->finished = now;
+    EnterCriticalSection(&group->lock);
+    member->statistics.calls++;
+    member->statistics.busyMsec += job->elapsedMsec;
+    if (job->error != 0)
+        member->statistics.lastError = job->error;
+    LeaveCriticalSection(&group->lock);
+
+    group->startJob(member);
+    //The last one lets runJobs return, run is gone after that
+    if (InterlockedDecrement(&run->left) == 0)
+        SetEvent(run->allDone);
+}
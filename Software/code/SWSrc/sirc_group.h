@@ -0,0 +1,169 @@
+// Title: SIRC device group
+//
+// Description: Many boards behind one SIRC.  Each call is spread over the members,
+// whatever their backend, and all of them work on it at the same time:
+//
+//      SIRC *boards[4] = { ... };
+//      SIRC_GROUP group(boards, 4, 1, 0);          //reg 0 gets each board's length
+//      group.sendParamRegisterWrite(1, 3);         //all boards
+//      group.sendWrite(0, 32768, input);           //8KB each, at address 0 of each board
+//      group.sendRun();
+//      group.waitDone(4000);
+//      group.sendRead(0, 32768, output);           //gathered back in board order
+//
+// Writes and reads are sharded data-parallel: the bytes are cut into one contiguous
+// slice per member (in units of granule bytes), and each member gets its slice at the
+// start address of its own buffers.  Register writes, runs, waits and resets go to every
+// member.  sendWriteAndRun shards the input and gathers the outputs in member order.
+// runJobs instead hands out independent write and run jobs to whichever member is free.
+//
+// Every member's part of a call is timed.  A member that keeps the others waiting
+// (more than twice the median time) is counted as a straggler, see getMemberStatistics.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCGROUPH
+#define DEFINESIRCGROUPH 1
+
+//Most members one group can have (what WaitForMultipleObjects takes)
+#define SIRC_GROUP_MAX_MEMBERS 64
+
+//No length register
+#define SIRC_GROUP_NOREGISTER 255
+
+//One independent job for runJobs: a sendWriteAndRun on some member
+typedef struct {
+    uint32_t startAddress;
+    uint32_t inLength;
+    uint8_t *inData;
+    uint32_t maxWaitTimeInMsec;
+    uint8_t *outData;
+    uint32_t maxOutLength;
+    //Filled in by runJobs
+    uint32_t outputLength;          //as for sendWriteAndRun
+    int8_t error;                   //0 if the job went through
+    uint32_t member;                //who ran it
+    uint32_t elapsedMsec;
+} SIRC_GROUP_JOB;
+
+//How one member is doing
+typedef struct {
+    uint32_t calls;                 //calls and jobs it had a part in
+    ULONGLONG busyMsec;
+    uint32_t lastMsec;              //its part of the last call
+    uint32_t straggles;             //calls it finished far behind the others
+    int8_t lastError;               //of its last part that failed
+} SIRC_GROUP_MEMBER_STATISTICS;
+
+//How the group is doing
+typedef struct {
+    uint32_t calls;
+    uint32_t jobs;
+    uint32_t straggles;             //calls where someone kept the others waiting
+    uint32_t lastStraggler;         //member, SIRC_GROUP_MAX_MEMBERS if none yet
+    ULONGLONG waitedMsec;           //spent waiting on stragglers, past the median
+} SIRC_GROUP_STATISTICS;
+
+class SIRC_GROUP : public SIRC {
+public:
+	//members: the boards, in the order slices are handed out and gathered
+	//granule: slices are a multiple of this many bytes (the last one takes the rest)
+	//lengthRegister: before a sharded write, each member gets the length of its slice in
+	// this parameter register.  SIRC_GROUP_NOREGISTER for none.
+	//ownsMembers: delete the members with the group
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall SIRC_GROUP(SIRC **members, uint32_t count, uint32_t granule = 1,
+		uint8_t lengthRegister = SIRC_GROUP_NOREGISTER, BOOL ownsMembers = false);
+	SIRC_DLL_LINKAGE __stdcall ~SIRC_GROUP();
+
+	//Sharded, see above
+	BOOL __stdcall sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	BOOL __stdcall sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	//maxOutLength is shared out like the input, outputLength is the total gathered
+	BOOL __stdcall sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+		uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+		uint32_t *outputLength);
+
+	//Every member
+	BOOL __stdcall sendParamRegisterWrite(uint8_t regNumber, uint32_t value);
+	BOOL __stdcall sendRun();
+	BOOL __stdcall waitDone(uint32_t maxWaitTimeInMsec);
+	BOOL __stdcall sendReset();
+	BOOL __stdcall quiesce(uint32_t maxWaitTimeInMsec);
+	//Read from every member, value is the first member's
+	BOOL __stdcall sendParamRegisterRead(uint8_t regNumber, uint32_t *value);
+
+	//The first member's, with the buffer sizes of all members together
+	BOOL __stdcall getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength);
+	//The buffer sizes are shared out, timeouts and retries go to every member.
+	//The rest stays each member's own.
+	BOOL __stdcall setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length);
+
+	//Run count independent jobs, each on the next member that is free.
+	//Returns true if all of them went through.
+	//If any failed, returns false.  Check each job's error, getLastError() has the first.
+	SIRC_DLL_LINKAGE BOOL __stdcall runJobs(SIRC_GROUP_JOB *jobs, uint32_t count);
+
+	SIRC_DLL_LINKAGE uint32_t __stdcall getMemberCount(void);
+	SIRC_DLL_LINKAGE SIRC * __stdcall getMember(uint32_t member);
+
+	//Retrieve the counters
+	SIRC_DLL_LINKAGE void __stdcall getStatistics(SIRC_GROUP_STATISTICS *outStatistics);
+	SIRC_DLL_LINKAGE BOOL __stdcall getMemberStatistics(uint32_t member,
+		SIRC_GROUP_MEMBER_STATISTICS *outStatistics);
+
+private:
+	//One member, and its part of the call in progress
+	typedef struct {
+		SIRC *sirc;
+		SIRC_GROUP *group;
+		uint32_t index;
+		SIRC_GROUP_MEMBER_STATISTICS statistics;
+		BOOL inCall;                //has a part in it
+		uint32_t offset;            //its slice
+		uint32_t length;
+		uint32_t outOffset;         //where its output goes (sendWriteAndRun)
+		uint32_t outLength;
+		uint32_t value;             //of its last request
+		DWORD finished;             //stamped as its requests complete
+		uint32_t jobIndex;          //running this job (runJobs)
+		DWORD jobStarted;
+	} MEMBER;
+
+	//State of a runJobs
+	typedef struct {
+		SIRC_GROUP_JOB *jobs;
+		uint32_t count;
+		volatile LONG next;         //job to hand out next
+		volatile LONG left;         //not finished yet
+		volatile LONG active;       //members still taking jobs
+		HANDLE allDone;
+	} JOBS;
+
+	MEMBER members[SIRC_GROUP_MAX_MEMBERS];
+	uint32_t count;
+	uint32_t granule;
+	uint8_t lengthRegister;
+	BOOL ownsMembers;
+	SIRC_GROUP_STATISTICS statistics;
+	CRITICAL_SECTION lock;          //protects the statistics
+	JOBS *running;
+
+	//Per call: requests[i] is member i's first request, requests[count + i] its last
+	DWORD begin(SIRC_REQUEST **requests);
+	void shard(uint32_t length, uint32_t outLength);
+	BOOL finish(SIRC_REQUEST **requests, DWORD started);
+	void noteTimes(DWORD started, BOOL book);
+	void startJob(MEMBER *member);
+	static void __stdcall stampFinish(SIRC_REQUEST *request, void *context);
+	static void __stdcall jobDone(SIRC_REQUEST *request, void *context);
+};
+
+#endif //DEFINESIRCGROUPH
@@ -1,9 +1,16 @@
 #ifndef DEFINEINCLUDEH
 #define DEFINEINCLUDEH
 
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
 #include <WinIoctl.h>
 #include <setupapi.h>
+#include <direct.h>
+#else
+#include "sirc_port.h"
+#endif
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -12,8 +19,8 @@
 #include <assert.h>
 #include <list>
 #include <vector>
+#include <algorithm>
 #include <time.h>
-#include <direct.h>
 
 using namespace std;
 
@@ -27,12 +34,38 @@ using namespace std;
 
 #include "sirc_error.h"
 
+#include "sirc_async.h"
+
+#include "sirc_crc.h"
+
+#include "sirc_dma.h"
+
+#include "sirc_wire.h"
+
+#include "sirc_fec.h"
+
+#include "sirc_codec.h"
+
+#include "sirc_util.h"
+
+#if defined(_WIN32)
+#include "sirc_stream.h"
+
+#include "sirc_supervisor.h"
+#include "sirc_group.h"
+#include "sirc_broker.h"
+#include "sirc_remote.h"
+
 #include "log.h"
 
 #include "packet.h"
 
+#include "eth_nic.h"
+
 #include "eth_SIRC.h"
 
+#include "eth_multicast.h"
+
 #include "pcie_SIRC.h"
 
 //Newer driver
@@ -42,8 +75,18 @@ using namespace std;
 
 #include "srv_SIRC.h"
 
-#include "sirc_util.h"
+#include "sirc_discovery.h"
 
 #include "cputools.h"
 
+#else
+//Only the interface-independent part, the mmap'd PCIe backend and the raw socket
+// server (sirc_port.h)
+#include "log.h"
+
+#include "linux_pcie_SIRC.h"
+
+#include "linux_srv_SIRC.h"
+#endif
+
 #endif
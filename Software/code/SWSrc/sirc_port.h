@@ -0,0 +1,293 @@
+// Title: SIRC portability
+//
+// Description: The few Win32 types and calls the interface-independent part of the
+// API (SIRC, the submit* runner, checksums, the wire format) uses, on top of POSIX
+// threads, so that part, LINUX_PCIE_SIRC and LINUX_SRV_SIRC build on Linux.  Everything
+// else stays Windows only.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// Only what the portable files need is here, with the Win32 meaning:
+//   events (CreateEvent, SetEvent, ResetEvent, WaitForSingleObject, CloseHandle)
+//   critical sections (recursive, like Win32's)
+//   Interlocked* on LONG and pointers
+//   GetTickCount, GetTickCount64, Sleep
+//   QueueUserWorkItem (a detached thread per work item, there is no pool)
+// A HANDLE from here is always an event.
+// No min and max macros: they would break the C++ headers, use std::min and std::max.
+// Build on Linux with: g++ -O2 -pthread sirc.cpp sirc_async.cpp sirc_crc.cpp sirc_dma.cpp
+//   sirc_codec.cpp sirc_fec.cpp sirc_util.cpp linux_pcie_SIRC.cpp linux_srv_SIRC.cpp -lrt
+// and srv_main.cpp for the software board.
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCPORTH
+#define DEFINESIRCPORTH 1
+
+#if !defined(_WIN32)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+typedef int BOOL;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef unsigned long ULONG;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef uint64_t ULONGLONG;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef void *PVOID;
+typedef void *LPVOID;
+typedef void *HANDLE;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define __stdcall
+#define WINAPI
+
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WT_EXECUTELONGFUNCTION 0x10
+
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID lpParam);
+
+//Time
+
+inline ULONGLONG GetTickCount64(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ULONGLONG) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+inline DWORD GetTickCount(void)
+{
+    return (DWORD) GetTickCount64();
+}
+
+inline void Sleep(DWORD dwMilliseconds)
+{
+    struct timespec wait;
+
+    wait.tv_sec = dwMilliseconds / 1000;
+    wait.tv_nsec = (long) (dwMilliseconds % 1000) * 1000000;
+    while ((nanosleep(&wait, &wait) != 0) && (errno == EINTR))
+        ;
+}
+
+//Critical sections.  Win32's can be entered again by the thread that has one.
+
+typedef pthread_mutex_t CRITICAL_SECTION;
+
+inline void InitializeCriticalSection(CRITICAL_SECTION *section)
+{
+    pthread_mutexattr_t attributes;
+
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(section, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+inline void DeleteCriticalSection(CRITICAL_SECTION *section)
+{
+    pthread_mutex_destroy(section);
+}
+
+inline void EnterCriticalSection(CRITICAL_SECTION *section)
+{
+    pthread_mutex_lock(section);
+}
+
+inline BOOL TryEnterCriticalSection(CRITICAL_SECTION *section)
+{
+    return pthread_mutex_trylock(section) == 0;
+}
+
+inline void LeaveCriticalSection(CRITICAL_SECTION *section)
+{
+    pthread_mutex_unlock(section);
+}
+
+//Interlocked operations, all full barriers like Win32's
+
+inline LONG InterlockedIncrement(LONG volatile *addend)
+{
+    return __sync_add_and_fetch(addend, 1);
+}
+
+inline LONG InterlockedDecrement(LONG volatile *addend)
+{
+    return __sync_sub_and_fetch(addend, 1);
+}
+
+inline LONG InterlockedExchange(LONG volatile *target, LONG value)
+{
+    __sync_synchronize();
+    return __sync_lock_test_and_set(target, value);
+}
+
+inline LONG InterlockedCompareExchange(LONG volatile *destination, LONG exchange, LONG comparand)
+{
+    return __sync_val_compare_and_swap(destination, comparand, exchange);
+}
+
+inline PVOID InterlockedCompareExchangePointer(PVOID volatile *destination, PVOID exchange, PVOID comparand)
+{
+    return __sync_val_compare_and_swap(destination, comparand, exchange);
+}
+
+//Events
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    BOOL manualReset;
+    BOOL signaled;
+} SIRC_PORT_EVENT;
+
+inline HANDLE CreateEvent(void *attributes, BOOL manualReset, BOOL initialState, const char *name)
+{
+    SIRC_PORT_EVENT *event = (SIRC_PORT_EVENT *) malloc(sizeof(SIRC_PORT_EVENT));
+    pthread_condattr_t attributesCond;
+
+    if (event == NULL)
+        return NULL;
+    pthread_mutex_init(&event->lock, NULL);
+    //Timed waits go by the same clock as GetTickCount
+    pthread_condattr_init(&attributesCond);
+    pthread_condattr_setclock(&attributesCond, CLOCK_MONOTONIC);
+    pthread_cond_init(&event->changed, &attributesCond);
+    pthread_condattr_destroy(&attributesCond);
+    event->manualReset = manualReset;
+    event->signaled = initialState;
+    return event;
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+    SIRC_PORT_EVENT *event = (SIRC_PORT_EVENT *) handle;
+
+    pthread_cond_destroy(&event->changed);
+    pthread_mutex_destroy(&event->lock);
+    free(event);
+    return true;
+}
+
+inline BOOL SetEvent(HANDLE handle)
+{
+    SIRC_PORT_EVENT *event = (SIRC_PORT_EVENT *) handle;
+
+    pthread_mutex_lock(&event->lock);
+    event->signaled = true;
+    if (event->manualReset)
+        pthread_cond_broadcast(&event->changed);
+    else
+        pthread_cond_signal(&event->changed);
+    pthread_mutex_unlock(&event->lock);
+    return true;
+}
+
+inline BOOL ResetEvent(HANDLE handle)
+{
+    SIRC_PORT_EVENT *event = (SIRC_PORT_EVENT *) handle;
+
+    pthread_mutex_lock(&event->lock);
+    event->signaled = false;
+    pthread_mutex_unlock(&event->lock);
+    return true;
+}
+
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD dwMilliseconds)
+{
+    SIRC_PORT_EVENT *event = (SIRC_PORT_EVENT *) handle;
+    struct timespec deadline;
+    DWORD result = WAIT_OBJECT_0;
+
+    if (dwMilliseconds != INFINITE) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += dwMilliseconds / 1000;
+        deadline.tv_nsec += (long) (dwMilliseconds % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&event->lock);
+    while (!event->signaled) {
+        if (dwMilliseconds == INFINITE)
+            pthread_cond_wait(&event->changed, &event->lock);
+        else if (pthread_cond_timedwait(&event->changed, &event->lock, &deadline) == ETIMEDOUT) {
+            result = WAIT_TIMEOUT;
+            break;
+        }
+    }
+    if ((result == WAIT_OBJECT_0) && !event->manualReset)
+        event->signaled = false;
+    pthread_mutex_unlock(&event->lock);
+    return result;
+}
+
+//Work items
+
+typedef struct {
+    LPTHREAD_START_ROUTINE function;
+    PVOID context;
+} SIRC_PORT_WORK;
+
+inline void *sircPortWorker(void *lpParam)
+{
+    SIRC_PORT_WORK work = *(SIRC_PORT_WORK *) lpParam;
+
+    free(lpParam);
+    (void) work.function(work.context);
+    return NULL;
+}
+
+inline BOOL QueueUserWorkItem(LPTHREAD_START_ROUTINE function, PVOID context, ULONG flags)
+{
+    SIRC_PORT_WORK *work = (SIRC_PORT_WORK *) malloc(sizeof(SIRC_PORT_WORK));
+    pthread_attr_t attributes;
+    pthread_t thread;
+    int error;
+
+    if (work == NULL)
+        return false;
+    work->function = function;
+    work->context = context;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    error = pthread_create(&thread, &attributes, sircPortWorker, work);
+    pthread_attr_destroy(&attributes);
+    if (error != 0) {
+        free(work);
+        return false;
+    }
+    return true;
+}
+
+#endif //!_WIN32
+
+#endif //DEFINESIRCPORTH
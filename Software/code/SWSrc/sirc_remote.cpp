@@ -0,0 +1,1033 @@
+// Title: Remote SIRC
+//
+// Description: Serves a SIRC over TCP (SIRC_PROXY) and uses one served that way
+// (REMOTE_SIRC), with many commands in flight.  See sirc_remote.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//Commands on the wire
+#define REMOTE_HELLO 1
+#define REMOTE_WRITE 2
+#define REMOTE_READ 3
+#define REMOTE_REGWRITE 4
+#define REMOTE_REGREAD 5
+#define REMOTE_RUN 6
+#define REMOTE_WAITDONE 7
+#define REMOTE_RESET 8
+#define REMOTE_WRITEANDRUN 9
+#define REMOTE_QUIESCE 10
+#define REMOTE_GETPARAMETERS 11
+#define REMOTE_SETPARAMETERS 12
+
+//Clients and proxy must agree on the above
+#define REMOTE_VERSION 1
+
+//Larger payloads than any board has room for mean the stream is out of step
+#define REMOTEMAXPAYLOAD (256*1024*1024)
+
+//Socket buffers, enough to keep a 10GbE link busy across the window
+#define REMOTESOCKETBYTES (4*1024*1024)
+
+//Commands gathered into one send at most
+#define REMOTEGATHER 32
+
+//Bytes asked of recv at once
+#define REMOTERECVBYTES (1024*1024)
+
+static void remoteTune(SOCKET sock)
+{
+    BOOL noDelay = true;
+    int bytes = REMOTESOCKETBYTES;
+
+    //Replies and small commands must not wait for more to come
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *) &noDelay, sizeof(noDelay));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char *) &bytes, sizeof(bytes));
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char *) &bytes, sizeof(bytes));
+}
+
+//Returns false if the connection closed or broke first
+static BOOL remoteReceive(SOCKET sock, void *buffer, uint32_t length)
+{
+    char *at = (char *) buffer;
+    int got;
+
+    while (length) {
+        got = recv(sock, at, (length > REMOTERECVBYTES) ? REMOTERECVBYTES : (int) length, 0);
+        if (got <= 0)
+            return false;
+        at += got;
+        length -= got;
+    }
+    return true;
+}
+
+//Send the gathered buffers, all of them (the socket blocks).
+//If that fails the connection is shut down, so the other side and our receiver notice.
+static BOOL remoteSend(SOCKET sock, WSABUF *buffers, uint32_t *numBuffers)
+{
+    DWORD sent;
+    BOOL ok = true;
+
+    if (*numBuffers && (WSASend(sock, buffers, *numBuffers, &sent, 0, NULL, NULL) != 0)) {
+        LogIt("sirc::remote.send %u",(uint32_t) WSAGetLastError());
+        shutdown(sock, SD_BOTH);
+        ok = false;
+    }
+    *numBuffers = 0;
+    return ok;
+}
+
+//PUBLIC FUNCTIONS
+//Constructor for the class
+//Return with an error code if anything goes wrong.
+SIRC_DLL_LINKAGE SIRC_PROXY::SIRC_PROXY(SIRC *device, uint16_t port, BOOL ownsDevice)
+{
+    WSADATA wsaData;
+    struct sockaddr_in address;
+    BOOL exclusive = true;
+
+    lastError = 0;
+    this->device = device;
+    this->ownsDevice = ownsDevice;
+    started = false;
+    listener = INVALID_SOCKET;
+    stopping = 0;
+    memset(&statistics, 0, sizeof(statistics));
+    InitializeCriticalSection(&lock);
+
+    if (!device) {
+        lastError = INVALIDBUFFER;
+        return;
+    }
+    if (device->getLastError() != 0) {
+        lastError = device->getLastError();
+        return;
+    }
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        lastError = FAILREMOTE;
+        return;
+    }
+    started = true;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET) {
+        lastError = FAILREMOTE;
+        return;
+    }
+    //Nobody else gets the port while we have it
+    setsockopt(listener, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, (const char *) &exclusive, sizeof(exclusive));
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if ((bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0) ||
+        (listen(listener, SOMAXCONN) != 0)) {
+        LogIt("sirc::proxy.listen %u %u",(uint32_t) port,(uint32_t) WSAGetLastError());
+        closesocket(listener);
+        listener = INVALID_SOCKET;
+        lastError = FAILREMOTE;
+    }
+}
+
+//run() must have returned
+SIRC_DLL_LINKAGE SIRC_PROXY::~SIRC_PROXY()
+{
+    if (listener != INVALID_SOCKET)
+        closesocket(listener);
+    if (started)
+        WSACleanup();
+    DeleteCriticalSection(&lock);
+    if (ownsDevice)
+        delete device;
+}
+
+SIRC_DLL_LINKAGE BOOL SIRC_PROXY::run()
+{
+    SOCKET sock;
+
+    if (lastError != 0)
+        return false;
+
+    LogIt("sirc::proxy.run");
+    while (!stopping) {
+        sock = ::accept(listener, NULL, NULL);
+        if (sock == INVALID_SOCKET) {
+            //stop() closed the listener
+            if (!stopping) {
+                LogIt("sirc::proxy.accept %u",(uint32_t) WSAGetLastError());
+                lastError = FAILREMOTE;
+            }
+            break;
+        }
+        if (stopping || !admit(sock))
+            closesocket(sock);
+    }
+
+    //Hang up on everyone.  Commands in flight complete, their replies go nowhere.
+    EnterCriticalSection(&lock);
+    for (std::list<CONNECTION *>::iterator c = connections.begin(); c != connections.end(); c++)
+        shutdown((*c)->sock, SD_BOTH);
+    LeaveCriticalSection(&lock);
+    for (std::list<HANDLE>::iterator t = threads.begin(); t != threads.end(); t++) {
+        WaitForSingleObject(*t, INFINITE);
+        CloseHandle(*t);
+    }
+    threads.clear();
+    LogIt("sirc::proxy.stop %u",statistics.connects);
+    return (lastError == 0);
+}
+
+SIRC_DLL_LINKAGE void SIRC_PROXY::stop()
+{
+    SOCKET closing = listener;
+
+    InterlockedExchange(&stopping, 1);
+    //Gets run() out of accept
+    listener = INVALID_SOCKET;
+    if (closing != INVALID_SOCKET)
+        closesocket(closing);
+}
+
+SIRC_DLL_LINKAGE void SIRC_PROXY::getStatistics(SIRC_PROXY_STATISTICS *outStatistics)
+{
+    EnterCriticalSection(&lock);
+    *outStatistics = statistics;
+    LeaveCriticalSection(&lock);
+}
+
+//PRIVATE FUNCTIONS
+
+//A client connected, give it a thread.
+//Returns false if it cannot have one, the caller hangs up.
+BOOL SIRC_PROXY::admit(SOCKET sock)
+{
+    CONNECTION *connection;
+    HANDLE thread;
+
+    //Forget the threads of connections long gone
+    for (std::list<HANDLE>::iterator t = threads.begin(); t != threads.end(); ) {
+        if (WaitForSingleObject(*t, 0) == WAIT_OBJECT_0) {
+            CloseHandle(*t);
+            t = threads.erase(t);
+        } else
+            t++;
+    }
+
+    connection = new CONNECTION;
+    if (!connection)
+        return false;
+    connection->proxy = this;
+    connection->sock = sock;
+    connection->thread = NULL;
+    connection->slots = CreateSemaphore(NULL, SIRC_REMOTE_WINDOW, SIRC_REMOTE_WINDOW, NULL);
+    if (!connection->slots) {
+        delete connection;
+        return false;
+    }
+    InitializeCriticalSection(&connection->sendLock);
+    remoteTune(sock);
+
+    //The thread cannot leave before it is on the list, it needs the lock for that
+    EnterCriticalSection(&lock);
+    thread = CreateThread(NULL, 0, connectionProc, connection, 0, NULL);
+    if (thread) {
+        connection->thread = thread;
+        connections.push_back(connection);
+        threads.push_back(thread);
+        statistics.connections++;
+        statistics.connects++;
+    }
+    LeaveCriticalSection(&lock);
+
+    if (!thread) {
+        DeleteCriticalSection(&connection->sendLock);
+        CloseHandle(connection->slots);
+        delete connection;
+        return false;
+    }
+    return true;
+}
+
+DWORD WINAPI SIRC_PROXY::connectionProc(LPVOID lpParam)
+{
+    CONNECTION *connection = (CONNECTION *) lpParam;
+    SIRC_PROXY *proxy = connection->proxy;
+
+    proxy->serve(connection);
+    proxy->drain(connection, 0);
+
+    EnterCriticalSection(&proxy->lock);
+    proxy->connections.remove(connection);
+    proxy->statistics.connections--;
+    closesocket(connection->sock);
+    LeaveCriticalSection(&proxy->lock);
+
+    DeleteCriticalSection(&connection->sendLock);
+    CloseHandle(connection->slots);
+    delete connection;
+    return 0;
+}
+
+//Take commands off the connection and start them, until it closes
+void SIRC_PROXY::serve(CONNECTION *connection)
+{
+    SIRC_REMOTE_COMMAND command;
+    SIRC_REMOTE_REPLY answer;
+    INFLIGHT *inflight;
+
+    if (!remoteReceive(connection->sock, &command, sizeof(command)))
+        return;
+    memset(&answer, 0, sizeof(answer));
+    answer.ok = (command.op == REMOTE_HELLO) && (command.value == REMOTE_VERSION) &&
+                (command.length == 0);
+    answer.error = answer.ok ? 0 : FAILREMOTE;
+    LogIt("sirc::proxy.hello %u %u",command.value,(uint32_t) answer.ok);
+    if (!reply(connection, &answer, NULL) || !answer.ok)
+        return;
+
+    while (remoteReceive(connection->sock, &command, sizeof(command))) {
+        if ((command.length > REMOTEMAXPAYLOAD) || (command.outLength > REMOTEMAXPAYLOAD)) {
+            LogIt("sirc::proxy.garbled %u %u",command.op,command.length);
+            break;
+        }
+        inflight = new INFLIGHT;
+        if (!inflight)
+            break;
+        inflight->connection = connection;
+        inflight->command = command;
+        inflight->data = (uint8_t *) malloc(command.length + command.outLength + 1);
+        if (!inflight->data ||
+            ((command.length != 0) && !remoteReceive(connection->sock, inflight->data, command.length))) {
+            free(inflight->data);
+            delete inflight;
+            break;
+        }
+
+        WaitForSingleObject(connection->slots, INFINITE);
+        if (!start(inflight))
+            break;
+    }
+}
+
+//Submit the command to the device, its reply goes out from commandDone.
+//The command has a slot, commandDone gives it back.
+//Returns false if the connection broke.
+BOOL SIRC_PROXY::start(INFLIGHT *inflight)
+{
+    SIRC_REMOTE_COMMAND *command = &inflight->command;
+    uint8_t *in = inflight->data;
+    uint8_t *out = inflight->data + command->length;
+    SIRC_REQUEST *request;
+
+    switch (command->op) {
+    case REMOTE_WRITE:
+        request = device->submitWrite(command->address, command->length, in, commandDone, inflight);
+        break;
+    case REMOTE_READ:
+        request = device->submitRead(command->address, command->outLength, out, commandDone, inflight);
+        break;
+    case REMOTE_REGWRITE:
+        request = device->submitParamRegisterWrite((uint8_t) command->address, command->value,
+                                                   commandDone, inflight);
+        break;
+    case REMOTE_REGREAD:
+        request = device->submitParamRegisterRead((uint8_t) command->address, commandDone, inflight);
+        break;
+    case REMOTE_RUN:
+        request = device->submitRun(commandDone, inflight);
+        break;
+    case REMOTE_WAITDONE:
+        request = device->submitWaitDone(command->value, commandDone, inflight);
+        break;
+    case REMOTE_RESET:
+        request = device->submitReset(commandDone, inflight);
+        break;
+    case REMOTE_WRITEANDRUN:
+        request = device->submitWriteAndRun(command->address, command->length, in, command->value,
+                                            out, command->outLength, commandDone, inflight);
+        break;
+    default:
+        //No asynchronous form, run it after the ones before it
+        return runNow(inflight);
+    }
+
+    if (!request)
+        return runNow(inflight);
+    //It completes without us
+    request->release();
+    return true;
+}
+
+//Run a command right here, once the others in flight are done, and reply.
+//Commands that could not be submitted get their error.
+//Returns false if the reply could not be sent.
+BOOL SIRC_PROXY::runNow(INFLIGHT *inflight)
+{
+    CONNECTION *connection = inflight->connection;
+    SIRC_REMOTE_COMMAND *command = &inflight->command;
+    uint8_t *in = inflight->data;
+    uint8_t *out = inflight->data + command->length;
+    SIRC_REMOTE_REPLY answer;
+    BOOL ok;
+
+    drain(connection, 1);
+    memset(&answer, 0, sizeof(answer));
+    switch (command->op) {
+    case REMOTE_QUIESCE:
+        answer.ok = device->quiesce(command->value);
+        break;
+    case REMOTE_GETPARAMETERS:
+        //The device looks at myVersion
+        memcpy(out, in, (command->length < command->outLength) ? command->length : command->outLength);
+        answer.ok = device->getParameters((SIRC::PARAMETERS *) out, command->outLength);
+        if (answer.ok)
+            answer.length = command->outLength;
+        break;
+    case REMOTE_SETPARAMETERS:
+        answer.ok = device->setParameters((const SIRC::PARAMETERS *) in, command->length);
+        break;
+    case REMOTE_WRITE:
+    case REMOTE_READ:
+    case REMOTE_REGWRITE:
+    case REMOTE_REGREAD:
+    case REMOTE_RUN:
+    case REMOTE_WAITDONE:
+    case REMOTE_RESET:
+    case REMOTE_WRITEANDRUN:
+        //The submit failed
+        answer.error = device->getLastError() ? device->getLastError() : FAILMEMALLOC;
+        break;
+    default:
+        answer.error = FAILREMOTE;
+        break;
+    }
+    if (answer.ok)
+        answer.error = 0;
+    else if (answer.error == 0)
+        answer.error = device->getLastError();
+
+    ok = reply(connection, &answer, out);
+    count(command->length, answer.length);
+    free(inflight->data);
+    delete inflight;
+    ReleaseSemaphore(connection->slots, 1, NULL);
+    return ok;
+}
+
+//Called on the device's worker thread when a command completes
+void __stdcall SIRC_PROXY::commandDone(SIRC_REQUEST *request, void *context)
+{
+    INFLIGHT *inflight = (INFLIGHT *) context;
+    CONNECTION *connection = inflight->connection;
+    SIRC_PROXY *proxy = connection->proxy;
+    SIRC_REMOTE_COMMAND *command = &inflight->command;
+    HANDLE slots = connection->slots;
+    SIRC_REMOTE_REPLY answer;
+
+    memset(&answer, 0, sizeof(answer));
+    answer.error = request->getError();
+    answer.ok = (answer.error == 0);
+    answer.value = request->getValue();
+    if ((command->op == REMOTE_READ) && answer.ok)
+        answer.length = command->outLength;
+    //On FAILWRITEANDRUNCAPACITY the first outLength bytes came back too
+    if ((command->op == REMOTE_WRITEANDRUN) && (answer.ok || (answer.error == FAILWRITEANDRUNCAPACITY)))
+        answer.length = (answer.value < command->outLength) ? answer.value : command->outLength;
+
+    (void) proxy->reply(connection, &answer, inflight->data + command->length);
+    proxy->count(command->length, answer.length);
+    free(inflight->data);
+    delete inflight;
+    //Last, the connection may go once all slots are back
+    ReleaseSemaphore(slots, 1, NULL);
+}
+
+//Send a reply and its payload in one go.
+//If that fails the connection is shut down, and serve() notices.
+BOOL SIRC_PROXY::reply(CONNECTION *connection, SIRC_REMOTE_REPLY *answer, uint8_t *payload)
+{
+    WSABUF buffers[2];
+    uint32_t numBuffers = 1;
+    BOOL ok;
+
+    buffers[0].buf = (char *) answer;
+    buffers[0].len = sizeof(*answer);
+    if (answer->length) {
+        buffers[1].buf = (char *) payload;
+        buffers[1].len = answer->length;
+        numBuffers = 2;
+    }
+    EnterCriticalSection(&connection->sendLock);
+    ok = remoteSend(connection->sock, buffers, &numBuffers);
+    LeaveCriticalSection(&connection->sendLock);
+    return ok;
+}
+
+//Wait until the connection has nothing in flight but the held slots
+void SIRC_PROXY::drain(CONNECTION *connection, uint32_t held)
+{
+    for (uint32_t s = held; s < SIRC_REMOTE_WINDOW; s++)
+        WaitForSingleObject(connection->slots, INFINITE);
+    if (held < SIRC_REMOTE_WINDOW)
+        ReleaseSemaphore(connection->slots, SIRC_REMOTE_WINDOW - held, NULL);
+}
+
+void SIRC_PROXY::count(uint32_t bytesIn, uint32_t bytesOut)
+{
+    EnterCriticalSection(&lock);
+    statistics.commands++;
+    statistics.bytesIn += bytesIn;
+    statistics.bytesOut += bytesOut;
+    LeaveCriticalSection(&lock);
+}
+
+//CLIENT SIDE
+
+static void remoteCommand(SIRC_REMOTE_COMMAND *command, uint32_t op, uint32_t address, uint32_t value,
+                          uint32_t length, uint32_t outLength)
+{
+    command->op = op;
+    command->address = address;
+    command->value = value;
+    command->length = length;
+    command->outLength = outLength;
+}
+
+//Request runner for the submit* methods.
+//Each batch goes out as one message, except vectored requests: those are pipelined
+// by sendWriteV/sendReadV themselves.
+class REMOTE_SIRC::Async : public SIRC_ASYNC {
+public:
+    Async(REMOTE_SIRC *sirc) : SIRC_ASYNC(sirc), owner(sirc) {
+        batchDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+    }
+
+    //The base class would wait too, but by then the event is gone
+    ~Async() {
+        drain();
+        if (batchDone)
+            CloseHandle(batchDone);
+    }
+
+protected:
+    void run(std::list <SIRC_ASYNC_REQUEST *> &batch) {
+        std::vector <PENDING> commands;
+        uint32_t posted;
+
+        while (!batch.empty()) {
+            SIRC_ASYNC_REQUEST *request = batch.front();
+
+            if (!batchDone || (request->operation == SIRC_ASYNC_REQUEST::WRITEV) ||
+                (request->operation == SIRC_ASYNC_REQUEST::READV)) {
+                batch.pop_front();
+                execute(request);
+                continue;
+            }
+
+            commands.clear();
+            while (!batch.empty() && (batch.front()->operation != SIRC_ASYNC_REQUEST::WRITEV) &&
+                   (batch.front()->operation != SIRC_ASYNC_REQUEST::READV)) {
+                PENDING command;
+
+                request = batch.front();
+                batch.pop_front();
+                memset(&command, 0, sizeof(command));
+                describe(request, &command);
+                command.request = request;
+                commands.push_back(command);
+            }
+            commands.back().done = batchDone;
+
+            LogIt("sirc::remote.batch %u",(uint32_t)commands.size());
+            posted = owner->post(&commands[0], (uint32_t)commands.size());
+            for (uint32_t c = posted; c < commands.size(); c++)
+                commands[c].request->complete(FAILREMOTE, 0);
+            //The replies come in order.  If the connection broke the receiver fails the
+            // ones that did go out, on its way out.
+            if (posted == commands.size())
+                WaitForSingleObject(batchDone, INFINITE);
+            else if (posted)
+                WaitForSingleObject(owner->receiver, INFINITE);
+        }
+    }
+
+private:
+    REMOTE_SIRC *owner;
+    HANDLE batchDone;
+
+    static void describe(SIRC_ASYNC_REQUEST *request, PENDING *command) {
+        switch (request->operation) {
+        case SIRC_ASYNC_REQUEST::WRITE:
+            remoteCommand(&command->command, REMOTE_WRITE, request->startAddress, 0, request->length, 0);
+            command->in = request->buffer;
+            break;
+        case SIRC_ASYNC_REQUEST::READ:
+            remoteCommand(&command->command, REMOTE_READ, request->startAddress, 0, 0, request->length);
+            command->out = request->buffer;
+            break;
+        case SIRC_ASYNC_REQUEST::PARAMWRITE:
+            remoteCommand(&command->command, REMOTE_REGWRITE, request->regNumber, request->value, 0, 0);
+            break;
+        case SIRC_ASYNC_REQUEST::PARAMREAD:
+            remoteCommand(&command->command, REMOTE_REGREAD, request->regNumber, 0, 0, 0);
+            break;
+        case SIRC_ASYNC_REQUEST::RUN:
+            remoteCommand(&command->command, REMOTE_RUN, 0, 0, 0, 0);
+            break;
+        case SIRC_ASYNC_REQUEST::WAITDONE:
+            remoteCommand(&command->command, REMOTE_WAITDONE, 0, request->maxWaitTime, 0, 0);
+            break;
+        case SIRC_ASYNC_REQUEST::RESET:
+            remoteCommand(&command->command, REMOTE_RESET, 0, 0, 0, 0);
+            break;
+        case SIRC_ASYNC_REQUEST::WRITEANDRUN:
+            remoteCommand(&command->command, REMOTE_WRITEANDRUN, request->startAddress, request->maxWaitTime,
+                          request->length, request->maxOutLength);
+            command->in = request->buffer;
+            command->out = request->outData;
+            break;
+        default:
+            break;
+        }
+    }
+};
+
+SIRC_ASYNC *REMOTE_SIRC::createAsync(){
+    return new Async(this);
+}
+
+//Constructor for the class
+//Return with an error code if anything goes wrong.
+SIRC_DLL_LINKAGE REMOTE_SIRC::REMOTE_SIRC(const char *host, uint16_t port)
+{
+    WSADATA wsaData;
+    struct addrinfo hints;
+    struct addrinfo *found, *at;
+    char service[8];
+    PENDING hello;
+
+    started = false;
+    sock = INVALID_SOCKET;
+    receiver = NULL;
+    broken = false;
+    window = CreateSemaphore(NULL, SIRC_REMOTE_WINDOW, SIRC_REMOTE_WINDOW, NULL);
+    syncDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+    InitializeCriticalSection(&sendLock);
+    InitializeCriticalSection(&pendingLock);
+    InitializeCriticalSection(&syncLock);
+    setLastError(0);
+
+    if (!host) {
+        setLastError(INVALIDBUFFER);
+        return;
+    }
+    if (!window || !syncDone) {
+        setLastError(FAILMEMALLOC);
+        return;
+    }
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        setLastError(FAILREMOTE);
+        return;
+    }
+    started = true;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    _snprintf_s(service, sizeof(service), _TRUNCATE, "%u", (uint32_t) port);
+    if (getaddrinfo(host, service, &hints, &found) != 0) {
+        setLastError(FAILREMOTE);
+        return;
+    }
+    for (at = found; at != NULL; at = at->ai_next) {
+        sock = socket(at->ai_family, at->ai_socktype, at->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        if (connect(sock, at->ai_addr, (int) at->ai_addrlen) == 0)
+            break;
+        closesocket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(found);
+    if (sock == INVALID_SOCKET) {
+        LogIt("sirc::remote.connect %u",(uint32_t) WSAGetLastError());
+        setLastError(FAILREMOTE);
+        return;
+    }
+    remoteTune(sock);
+
+    receiver = CreateThread(NULL, 0, receiveProc, this, 0, NULL);
+    if (!receiver) {
+        setLastError(FAILMEMALLOC);
+        return;
+    }
+
+    memset(&hello, 0, sizeof(hello));
+    remoteCommand(&hello.command, REMOTE_HELLO, 0, REMOTE_VERSION, 0, 0);
+    (void) transact(&hello, 1);
+}
+
+SIRC_DLL_LINKAGE REMOTE_SIRC::~REMOTE_SIRC()
+{
+    //Submitted requests still come through us
+    finishAsync();
+
+    //The receiver sees the connection close and leaves
+    if (sock != INVALID_SOCKET)
+        shutdown(sock, SD_BOTH);
+    if (receiver) {
+        WaitForSingleObject(receiver, INFINITE);
+        CloseHandle(receiver);
+    }
+    if (sock != INVALID_SOCKET)
+        closesocket(sock);
+    if (started)
+        WSACleanup();
+    if (window)
+        CloseHandle(window);
+    if (syncDone)
+        CloseHandle(syncDone);
+    DeleteCriticalSection(&sendLock);
+    DeleteCriticalSection(&pendingLock);
+    DeleteCriticalSection(&syncLock);
+}
+
+BOOL REMOTE_SIRC::sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    PENDING command;
+
+    if (!buffer) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_WRITE, startAddress, 0, length, 0);
+    command.in = buffer;
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    PENDING command;
+
+    if (!buffer) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_READ, startAddress, 0, 0, length);
+    command.out = buffer;
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::sendParamRegisterWrite(uint8_t regNumber, uint32_t value)
+{
+    PENDING command;
+
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_REGWRITE, regNumber, value, 0, 0);
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::sendParamRegisterRead(uint8_t regNumber, uint32_t *value)
+{
+    PENDING command;
+
+    if (!value) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_REGREAD, regNumber, 0, 0, 0);
+    if (!transact(&command, 1))
+        return false;
+    *value = command.reply.value;
+    return true;
+}
+
+BOOL REMOTE_SIRC::sendRun()
+{
+    PENDING command;
+
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_RUN, 0, 0, 0, 0);
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::waitDone(uint32_t maxWaitTimeInMsec)
+{
+    PENDING command;
+
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_WAITDONE, 0, maxWaitTimeInMsec, 0, 0);
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::sendReset()
+{
+    PENDING command;
+
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_RESET, 0, 0, 0, 0);
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+                                  uint32_t maxWaitTimeInMsec, uint8_t *outData, uint32_t maxOutLength,
+                                  uint32_t *outputLength)
+{
+    PENDING command;
+    BOOL ok;
+
+    if (!inData || !outData || !outputLength) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_WRITEANDRUN, startAddress, maxWaitTimeInMsec, inLength, maxOutLength);
+    command.in = inData;
+    command.out = outData;
+    ok = transact(&command, 1);
+    *outputLength = command.reply.value;
+    return ok;
+}
+
+BOOL REMOTE_SIRC::sendWriteV(const SIRC_SEGMENT *segments, uint32_t count)
+{
+    std::vector <PENDING> commands;
+
+    if (segments == NULL) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (count == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+    commands.resize(count);
+    memset(&commands[0], 0, count * sizeof(PENDING));
+    for (uint32_t s = 0; s < count; s++) {
+        if (!segments[s].buffer) {
+            setLastError(INVALIDBUFFER);
+            return false;
+        }
+        remoteCommand(&commands[s].command, REMOTE_WRITE, segments[s].startAddress, 0, segments[s].length, 0);
+        commands[s].in = segments[s].buffer;
+    }
+    return transact(&commands[0], count);
+}
+
+BOOL REMOTE_SIRC::sendReadV(const SIRC_SEGMENT *segments, uint32_t count)
+{
+    std::vector <PENDING> commands;
+
+    if (segments == NULL) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    if (count == 0) {
+        setLastError(INVALIDLENGTH);
+        return false;
+    }
+    commands.resize(count);
+    memset(&commands[0], 0, count * sizeof(PENDING));
+    for (uint32_t s = 0; s < count; s++) {
+        if (!segments[s].buffer) {
+            setLastError(INVALIDBUFFER);
+            return false;
+        }
+        remoteCommand(&commands[s].command, REMOTE_READ, segments[s].startAddress, 0, 0, segments[s].length);
+        commands[s].out = segments[s].buffer;
+    }
+    return transact(&commands[0], count);
+}
+
+BOOL REMOTE_SIRC::quiesce(uint32_t maxWaitTimeInMsec)
+{
+    PENDING command;
+
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_QUIESCE, 0, maxWaitTimeInMsec, 0, 0);
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength)
+{
+    PENDING command;
+
+    if (!outParameters) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    //What we ask for goes along, the device looks at myVersion
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_GETPARAMETERS, 0, 0, maxOutLength, maxOutLength);
+    command.in = (uint8_t *) outParameters;
+    command.out = (uint8_t *) outParameters;
+    return transact(&command, 1);
+}
+
+BOOL REMOTE_SIRC::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
+{
+    PENDING command;
+
+    if (!inParameters) {
+        setLastError(INVALIDBUFFER);
+        return false;
+    }
+    memset(&command, 0, sizeof(command));
+    remoteCommand(&command.command, REMOTE_SETPARAMETERS, 0, 0, length, 0);
+    command.in = (uint8_t *) inParameters;
+    return transact(&command, 1);
+}
+
+//PRIVATE FUNCTIONS
+
+//Send the commands as one message, as far as the window lets us: whatever is gathered
+// goes out before we wait for room.
+//Returns how many went out (or were taken by the receiver to fail).  Fewer than count
+// if the connection is broken.
+uint32_t REMOTE_SIRC::post(PENDING *commands, uint32_t count)
+{
+    WSABUF buffers[2 * REMOTEGATHER];
+    uint32_t numBuffers = 0;
+    uint32_t c;
+    BOOL ok = true;
+
+    EnterCriticalSection(&sendLock);
+    for (c = 0; ok && (c < count); c++) {
+        if (WaitForSingleObject(window, 0) != WAIT_OBJECT_0) {
+            if (!remoteSend(sock, buffers, &numBuffers))
+                break;
+            WaitForSingleObject(window, INFINITE);
+        }
+
+        EnterCriticalSection(&pendingLock);
+        if (!broken)
+            pending.push_back(&commands[c]);
+        ok = !broken;
+        LeaveCriticalSection(&pendingLock);
+        if (!ok) {
+            ReleaseSemaphore(window, 1, NULL);
+            break;
+        }
+
+        buffers[numBuffers].buf = (char *) &commands[c].command;
+        buffers[numBuffers].len = sizeof(commands[c].command);
+        numBuffers++;
+        if (commands[c].command.length) {
+            buffers[numBuffers].buf = (char *) commands[c].in;
+            buffers[numBuffers].len = commands[c].command.length;
+            numBuffers++;
+        }
+        if (numBuffers + 2 > 2 * REMOTEGATHER)
+            ok = remoteSend(sock, buffers, &numBuffers);
+    }
+    (void) remoteSend(sock, buffers, &numBuffers);
+    LeaveCriticalSection(&sendLock);
+    return c;
+}
+
+//Send the commands and wait for all of their replies.
+//Return true on success, return false w/error code of the first that failed.
+BOOL REMOTE_SIRC::transact(PENDING *commands, uint32_t count)
+{
+    uint32_t posted;
+
+    for (uint32_t c = 0; c < count; c++) {
+        commands[c].request = NULL;
+        commands[c].done = NULL;
+    }
+    commands[count - 1].done = syncDone;
+
+    EnterCriticalSection(&syncLock);
+    posted = post(commands, count);
+    //The replies come in order.  If the connection broke the receiver fails the ones
+    // that did go out, on its way out.
+    if (posted == count)
+        WaitForSingleObject(syncDone, INFINITE);
+    else if (posted)
+        WaitForSingleObject(receiver, INFINITE);
+    LeaveCriticalSection(&syncLock);
+
+    for (uint32_t c = 0; c < count; c++) {
+        if (c >= posted || !commands[c].reply.ok) {
+            setLastError((c < posted && commands[c].reply.error) ? commands[c].reply.error : FAILREMOTE);
+            return false;
+        }
+    }
+    setLastError(0);
+    return true;
+}
+
+//The reply is in, or never will be (error)
+void REMOTE_SIRC::finish(PENDING *command, int8_t error)
+{
+    if (error) {
+        command->reply.ok = false;
+        command->reply.error = error;
+    }
+    if (command->request)
+        command->request->complete(command->reply.ok ? 0 : command->reply.error, command->reply.value);
+    //A synchronous caller's command is gone after this
+    if (command->done)
+        SetEvent(command->done);
+}
+
+DWORD WINAPI REMOTE_SIRC::receiveProc(LPVOID lpParam)
+{
+    ((REMOTE_SIRC *) lpParam)->receive();
+    return 0;
+}
+
+//Take the replies as they come, output payloads straight into the callers' buffers
+void REMOTE_SIRC::receive()
+{
+    SIRC_REMOTE_REPLY reply;
+    PENDING *command;
+    std::list <PENDING *> failed;
+
+    while (remoteReceive(sock, &reply, sizeof(reply))) {
+        EnterCriticalSection(&pendingLock);
+        command = pending.empty() ? NULL : pending.front();
+        if (command)
+            pending.pop_front();
+        LeaveCriticalSection(&pendingLock);
+
+        //A reply nobody asked for, or more output than room: out of step
+        if (!command)
+            break;
+        if ((reply.length > command->command.outLength) ||
+            ((reply.length != 0) && !remoteReceive(sock, command->out, reply.length))) {
+            failed.push_back(command);
+            break;
+        }
+        command->reply = reply;
+        if (!reply.ok && (reply.error == 0))
+            command->reply.error = FAILREMOTE;
+        ReleaseSemaphore(window, 1, NULL);
+        finish(command, 0);
+    }
+
+    //Nobody will answer the rest
+    EnterCriticalSection(&pendingLock);
+    broken = true;
+    failed.splice(failed.end(), pending);
+    LeaveCriticalSection(&pendingLock);
+    shutdown(sock, SD_BOTH);
+    LogIt("sirc::remote.closed %u",(uint32_t)failed.size());
+    for (std::list <PENDING *>::iterator c = failed.begin(); c != failed.end(); c++) {
+        ReleaseSemaphore(window, 1, NULL);
+        finish(*c, FAILREMOTE);
+    }
+}
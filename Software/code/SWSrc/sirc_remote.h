@@ -0,0 +1,201 @@
+// Title: Remote SIRC
+//
+// Description: A board on another machine's wire.  Only the host on the board's
+// Ethernet segment can reach it.  SIRC_PROXY serves any SIRC of that host over TCP,
+// and REMOTE_SIRC uses it from anywhere else:
+//
+//      //On the board's host (see proxy_main.cpp)
+//      SIRC_PROXY proxy(openSirc(FPGA_ID, 0), SIRC_REMOTE_PORT, true);
+//      proxy.run();                                //until stop()
+//
+//      //Anywhere
+//      REMOTE_SIRC sirc("labhost", SIRC_REMOTE_PORT);
+//      sirc.sendWrite(0, length, input);
+//
+// Each command is a SIRC_REMOTE_COMMAND header followed by its input payload, each
+// reply a SIRC_REMOTE_REPLY header followed by its output payload, and replies come
+// back in command order.  Headers and payloads go out together in one gathered send,
+// and output payloads are received straight into the caller's buffers.
+//
+// Commands are pipelined, up to SIRC_REMOTE_WINDOW of them in flight per connection.
+// The proxy runs them through the submit* methods of its SIRC, so an ETH_SIRC keeps
+// its own write window full, and a receive thread on the client completes them as the
+// replies come in.  Everything in one sendWriteV/sendReadV, and requests submitted
+// together (submit*), goes out as one message: a run of submitted register writes
+// costs one round trip.
+//
+// No authentication, no encryption: for the lab network.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCREMOTEH
+#define DEFINESIRCREMOTEH 1
+
+//Where the proxy listens unless told otherwise
+#define SIRC_REMOTE_PORT 7531
+
+//Commands in flight per connection
+#define SIRC_REMOTE_WINDOW 64
+
+//Internal: one command on the wire, its input payload follows
+typedef struct {
+    uint32_t op;
+    uint32_t address;               //start address, register number
+    uint32_t value;                 //register value, wait time, protocol version
+    uint32_t length;                //input payload bytes that follow
+    uint32_t outLength;             //output room
+} SIRC_REMOTE_COMMAND;
+
+//Internal: its reply, the output payload follows
+typedef struct {
+    uint8_t ok;
+    int8_t error;
+    uint16_t reserved;
+    uint32_t value;                 //register value, write & run output length
+    uint32_t length;                //output payload bytes that follow
+} SIRC_REMOTE_REPLY;
+
+//How the proxy is doing
+typedef struct {
+    uint32_t connections;           //open now
+    uint32_t connects;              //since it started
+    ULONGLONG commands;
+    ULONGLONG bytesIn;              //payloads received
+    ULONGLONG bytesOut;             //payloads sent back
+} SIRC_PROXY_STATISTICS;
+
+class SIRC_PROXY {
+public:
+	//device: the board served
+	//port: TCP port to listen on, all interfaces
+	//ownsDevice: delete the device with the proxy
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall SIRC_PROXY(SIRC *device, uint16_t port = SIRC_REMOTE_PORT,
+		BOOL ownsDevice = false);
+	SIRC_DLL_LINKAGE __stdcall ~SIRC_PROXY();
+
+	//Serve connections until stop() is called from another thread.
+	//Returns true once stopped, with every connection closed.
+	//Returns false w/error code if it cannot accept connections.
+	SIRC_DLL_LINKAGE BOOL __stdcall run(void);
+
+	//Have run() return.  Commands in flight complete first.
+	SIRC_DLL_LINKAGE void __stdcall stop(void);
+
+	//Retrieve the counters
+	SIRC_DLL_LINKAGE void __stdcall getStatistics(SIRC_PROXY_STATISTICS *outStatistics);
+
+	//Retrieve the last error code.  Any value < 0 indicates a problem.
+	inline int8_t __stdcall getLastError(){
+		return(lastError);
+	}
+
+private:
+	//One client connection
+	typedef struct {
+		SIRC_PROXY *proxy;
+		SOCKET sock;
+		HANDLE thread;
+		HANDLE slots;               //semaphore, SIRC_REMOTE_WINDOW commands in flight
+		CRITICAL_SECTION sendLock;  //replies go out whole
+	} CONNECTION;
+
+	//One command in flight
+	typedef struct {
+		CONNECTION *connection;
+		SIRC_REMOTE_COMMAND command;
+		uint8_t *data;              //input payload, then room for the output
+	} INFLIGHT;
+
+	int8_t lastError;
+	SIRC *device;
+	BOOL ownsDevice;
+	BOOL started;                   //Winsock
+	SOCKET listener;
+	volatile LONG stopping;
+	std::list<HANDLE> threads;      //of the connections, joined by run()
+	CRITICAL_SECTION lock;          //protects everything below
+	std::list<CONNECTION *> connections;
+	SIRC_PROXY_STATISTICS statistics;
+
+	BOOL admit(SOCKET sock);
+	void serve(CONNECTION *connection);
+	BOOL start(INFLIGHT *inflight);
+	BOOL runNow(INFLIGHT *inflight);
+	BOOL reply(CONNECTION *connection, SIRC_REMOTE_REPLY *reply, uint8_t *payload);
+	void drain(CONNECTION *connection, uint32_t held);
+	void count(uint32_t bytesIn, uint32_t bytesOut);
+	static DWORD WINAPI connectionProc(LPVOID lpParam);
+	static void __stdcall commandDone(SIRC_REQUEST *request, void *context);
+};
+
+class REMOTE_SIRC : public SIRC {
+public:
+	//host: name or address of the proxy's machine
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall REMOTE_SIRC(const char *host, uint16_t port = SIRC_REMOTE_PORT);
+	SIRC_DLL_LINKAGE __stdcall ~REMOTE_SIRC();
+
+	//Same as the SIRC methods, run by the proxy on its SIRC.
+	//If the connection breaks, they fail with FAILREMOTE.
+	BOOL __stdcall sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	BOOL __stdcall sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	BOOL __stdcall sendParamRegisterWrite(uint8_t regNumber, uint32_t value);
+	BOOL __stdcall sendParamRegisterRead(uint8_t regNumber, uint32_t *value);
+	BOOL __stdcall sendRun();
+	BOOL __stdcall waitDone(uint32_t maxWaitTimeInMsec);
+	BOOL __stdcall sendReset();
+	BOOL __stdcall sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+		uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+		uint32_t *outputLength);
+	//All segments in flight at once
+	BOOL __stdcall sendWriteV(const SIRC_SEGMENT *segments, uint32_t count);
+	BOOL __stdcall sendReadV(const SIRC_SEGMENT *segments, uint32_t count);
+	BOOL __stdcall quiesce(uint32_t maxWaitTimeInMsec);
+	BOOL __stdcall getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength);
+	BOOL __stdcall setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length);
+
+protected:
+	//Sends each batch of submitted requests as one message
+	SIRC_ASYNC * __stdcall createAsync(void);
+
+private:
+	class Async;
+	friend class Async;
+
+	//A command sent and not answered yet
+	typedef struct {
+		SIRC_REMOTE_COMMAND command;
+		uint8_t *in;
+		uint8_t *out;               //command.outLength bytes
+		SIRC_REMOTE_REPLY reply;
+		SIRC_ASYNC_REQUEST *request;    //completed, and the command freed, on the reply
+		HANDLE done;                //set on the reply, if not NULL
+	} PENDING;
+
+	BOOL started;                   //Winsock
+	SOCKET sock;
+	HANDLE receiver;
+	HANDLE window;                  //semaphore, SIRC_REMOTE_WINDOW commands in flight
+	CRITICAL_SECTION sendLock;      //commands go out whole, in order
+	CRITICAL_SECTION pendingLock;   //protects pending and broken
+	std::list<PENDING *> pending;   //in the order sent, the replies come in that order
+	BOOL broken;
+	CRITICAL_SECTION syncLock;      //one synchronous call at a time waits on syncDone
+	HANDLE syncDone;
+
+	uint32_t post(PENDING *commands, uint32_t count);
+	BOOL transact(PENDING *commands, uint32_t count);
+	void finish(PENDING *command, int8_t error);
+	void receive(void);
+	static DWORD WINAPI receiveProc(LPVOID lpParam);
+};
+
+#endif //DEFINESIRCREMOTEH
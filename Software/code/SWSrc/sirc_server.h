@@ -65,7 +65,7 @@ public:
     //Dynamically adjustable parameters and limits
     typedef struct {
         uint32_t myVersion;
-#define SIRC_PARAMETERS_CURRENT_VERSION 1
+#define SIRC_SERVER_PARAMETERS_CURRENT_VERSION 1
         uint32_t maxInputDataBytes;
         uint32_t maxOutputDataBytes;
         uint32_t maxOutstandingReads;       //NB: In some cases these two can only be lowered.
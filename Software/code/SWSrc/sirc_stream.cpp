@@ -0,0 +1,330 @@
+// Title: SIRC streaming pipeline
+//
+// Description: Chunks an input stream into write and run requests and keeps a few of
+// them queued on the SIRC runner.  See sirc_stream.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+SIRC_STREAM::SIRC_STREAM(SIRC *sirc, const SIRC_STREAM_KERNEL *kernel)
+{
+    this->sirc = sirc;
+    lastError = 0;
+    failure = 0;
+    chunkBytes = 0;
+    outputBytes = 0;
+    source = NULL;
+    sourceContext = NULL;
+    memory = NULL;
+    memoryLeft = 0;
+    memset(slots, 0, sizeof(slots));
+    memset(&statistics, 0, sizeof(statistics));
+
+    if (!sirc || !kernel) {
+        lastError = INVALIDBUFFER;
+        return;
+    }
+    this->kernel = *kernel;
+
+    //Register 255 is the run register
+    if ((kernel->outputNumerator == 0) || (kernel->outputDenominator == 0) ||
+        (kernel->lengthRegister == 255)) {
+        lastError = INVALIDLENGTH;
+        return;
+    }
+}
+
+SIRC_STREAM::~SIRC_STREAM()
+{
+    for (int s = 0; s < SIRC_STREAM_SLOTS; s++) {
+        free(slots[s].input);
+        free(slots[s].output);
+    }
+}
+
+BOOL SIRC_STREAM::run(SIRC_STREAM_SOURCE source, void *sourceContext,
+                      SIRC_STREAM_SINK sink, void *sinkContext)
+{
+    if (!source) {
+        lastError = INVALIDBUFFER;
+        return false;
+    }
+    this->source = source;
+    this->sourceContext = sourceContext;
+    memory = NULL;
+    memoryLeft = 0;
+    return stream(sink, sinkContext);
+}
+
+BOOL SIRC_STREAM::runBuffer(const uint8_t *data, size_t length,
+                            SIRC_STREAM_SINK sink, void *sinkContext)
+{
+    if (!data && length) {
+        lastError = INVALIDBUFFER;
+        return false;
+    }
+    source = NULL;
+    sourceContext = NULL;
+    memory = data;
+    memoryLeft = length;
+    return stream(sink, sinkContext);
+}
+
+BOOL SIRC_STREAM::runFile(const wchar_t *path, SIRC_STREAM_SINK sink, void *sinkContext)
+{
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    void *view;
+    BOOL ok;
+
+    file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        lastError = INVALIDBUFFER;
+        return false;
+    }
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        lastError = INVALIDBUFFER;
+        return false;
+    }
+    if ((ULONGLONG) size.QuadPart > (ULONGLONG) (size_t) -1) {
+        CloseHandle(file);
+        lastError = FAILMEMALLOC;
+        return false;
+    }
+
+    //Empty files cannot be mapped
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return runBuffer(NULL, 0, sink, sinkContext);
+    }
+
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!view) {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        lastError = FAILMEMALLOC;
+        return false;
+    }
+    LogIt("sirc::stream.file %u",(uint32_t) size.QuadPart);
+
+    ok = runBuffer((const uint8_t *) view, (size_t) size.QuadPart, sink, sinkContext);
+
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return ok;
+}
+
+void SIRC_STREAM::getStatistics(SIRC_STREAM_STATISTICS *outStatistics)
+{
+    *outStatistics = statistics;
+}
+
+//Size the chunks for the current buffer sizes, and the slots for the chunks
+//Return true on success, return false w/error code on failure
+BOOL SIRC_STREAM::setup()
+{
+    SIRC::PARAMETERS params;
+    ULONGLONG fits;
+    uint32_t chunk;
+
+    if (!sirc->getParameters(&params, sizeof(params))) {
+        lastError = sirc->getLastError();
+        return false;
+    }
+
+    chunk = params.maxInputDataBytes;
+    if (kernel.maxChunkBytes && (kernel.maxChunkBytes < chunk))
+        chunk = kernel.maxChunkBytes;
+
+    //The results have to fit in the output buffer
+    fits = (ULONGLONG) params.maxOutputDataBytes * kernel.outputDenominator / kernel.outputNumerator;
+    if (fits < chunk)
+        chunk = (uint32_t) fits;
+    if (chunk == 0) {
+        lastError = INVALIDLENGTH;
+        return false;
+    }
+    chunkBytes = chunk;
+    outputBytes = (uint32_t) min(((ULONGLONG) chunk * kernel.outputNumerator + kernel.outputDenominator - 1) /
+                                 kernel.outputDenominator, (ULONGLONG) params.maxOutputDataBytes);
+
+    for (int s = 0; s < SIRC_STREAM_SLOTS; s++) {
+        free(slots[s].input);
+        free(slots[s].output);
+        //Memory sources are sent from where they are
+        slots[s].input = source ? (uint8_t *) malloc(chunkBytes) : NULL;
+        slots[s].output = (uint8_t *) malloc(outputBytes);
+        slots[s].request = NULL;
+        if ((source && !slots[s].input) || !slots[s].output) {
+            lastError = FAILMEMALLOC;
+            return false;
+        }
+    }
+    return true;
+}
+
+//Run the whole input through.
+//Chunk i goes in slot i % SIRC_STREAM_SLOTS.  Before a slot is filled again the chunk
+// that had it, the oldest one out, is waited for and its results go to the sink.
+//Return true on success, return false w/error code on failure
+BOOL SIRC_STREAM::stream(SIRC_STREAM_SINK sink, void *sinkContext)
+{
+    SIRC_REQUEST *lengthWrite;
+    uint32_t lastLength = 0;
+    uint32_t i, k;
+    BOOL ok = true;
+    DWORD start;
+
+    memset(&statistics, 0, sizeof(statistics));
+    failure = 0;
+    lastError = 0;
+    if (!setup())
+        return false;
+    statistics.chunkBytes = chunkBytes;
+
+    LogIt(LOGIT_TIME_MARKER);
+    start = GetTickCount();
+    for (i = 0; ; i++) {
+        SLOT *slot = &slots[i % SIRC_STREAM_SLOTS];
+        const uint8_t *data;
+        uint32_t length;
+
+        if (slot->request && !deliver(slot, true, sink, sinkContext)) {
+            ok = false;
+            break;
+        }
+
+        length = nextChunk(slot, &data);
+        if (length == 0)
+            break;
+
+        //The length register only changes for the last chunk, usually
+        lengthWrite = NULL;
+        if (length != lastLength) {
+            lengthWrite = sirc->submitParamRegisterWrite(kernel.lengthRegister, length, recordFailure, this);
+            if (!lengthWrite) {
+                fail(sirc->getLastError());
+                ok = false;
+                break;
+            }
+            lastLength = length;
+        }
+
+        slot->request = sirc->submitWriteAndRun(0, length, (uint8_t *) data, kernel.maxWaitTimeInMsec,
+                                                slot->output, outputBytes);
+        //Waiting for the write and run covers the register write, unless it was not queued
+        if (lengthWrite) {
+            if (!slot->request)
+                lengthWrite->wait(INFINITE);
+            lengthWrite->release();
+        }
+        if (!slot->request) {
+            fail(sirc->getLastError());
+            ok = false;
+            break;
+        }
+        statistics.inputBytes += length;
+        statistics.chunks++;
+
+        if (failure) {
+            ok = false;
+            break;
+        }
+    }
+
+    //The rest, oldest first.  Once something failed the results are dropped.
+    for (k = 1; k <= SIRC_STREAM_SLOTS; k++) {
+        SLOT *slot = &slots[(i + k) % SIRC_STREAM_SLOTS];
+        if (slot->request && !deliver(slot, ok, sink, sinkContext))
+            ok = false;
+    }
+
+    statistics.elapsedMsec = max(GetTickCount() - start, (DWORD) 1);
+    statistics.inputMBps = (double) statistics.inputBytes / (1024.0 * 1024.0) * 1000.0 / statistics.elapsedMsec;
+    LogIt("sirc::stream.done %u %u",statistics.chunks,statistics.elapsedMsec);
+
+    //A sink that said stop leaves 0
+    if (failure)
+        lastError = (int8_t) failure;
+    return ok;
+}
+
+//Next chunk of input, at most chunkBytes.
+// data: set to where the chunk is
+//Return its length, 0 at the end of the input.
+uint32_t SIRC_STREAM::nextChunk(SLOT *slot, const uint8_t **data)
+{
+    uint32_t length = 0;
+
+    if (!source) {
+        length = (uint32_t) min((size_t) chunkBytes, memoryLeft);
+        *data = memory;
+        memory += length;
+        memoryLeft -= length;
+        return length;
+    }
+
+    //Sources can give less than asked, fill the chunk up
+    while (length < chunkBytes) {
+        uint32_t got = source(slot->input + length, chunkBytes - length, sourceContext);
+        if (got == 0)
+            break;
+        length += min(got, chunkBytes - length);
+    }
+    *data = slot->input;
+    return length;
+}
+
+//Wait for the chunk in slot and, if wanted, hand its results to the sink.
+//Return true if the chunk made it and the sink wants more, false otherwise.
+BOOL SIRC_STREAM::deliver(SLOT *slot, BOOL wanted, SIRC_STREAM_SINK sink, void *sinkContext)
+{
+    SIRC_REQUEST *request = slot->request;
+    int8_t error;
+    uint32_t length;
+
+    slot->request = NULL;
+    request->wait(INFINITE);
+    error = request->getError();
+    length = request->getValue();
+    request->release();
+
+    if (error)
+        fail(error);
+    if (!wanted || failure)
+        return false;
+
+    statistics.outputBytes += length;
+    if (sink && !sink(slot->output, length, sinkContext))
+        return false;
+    return true;
+}
+
+//Remember the first thing that went wrong
+void SIRC_STREAM::fail(int8_t code)
+{
+    //Not queued, but no reason given
+    if (code == 0)
+        code = FAILMEMALLOC;
+    InterlockedCompareExchange(&failure, code, 0);
+}
+
+//Completion callback for the requests nobody waits on
+void SIRC_STREAM::recordFailure(SIRC_REQUEST *request, void *context)
+{
+    if (request->getError())
+        ((SIRC_STREAM *) context)->fail(request->getError());
+}
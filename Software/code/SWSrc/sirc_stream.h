@@ -0,0 +1,126 @@
+// Title: SIRC streaming pipeline
+//
+// Description: Push an input of any size through a circuit, one chunk at a time, and hand
+// the results to a sink as they come back.  The input can come from a callback, a block
+// of memory, or a file mapped into memory.
+//
+//      SIRC_STREAM_KERNEL multiply = { 0, 1, 1, 0, 4000 };    //reg 0 gets the length
+//      sirc->sendParamRegisterWrite(1, 3);                     //the rest is up to you
+//      SIRC_STREAM stream(sirc, &multiply);
+//      stream.runFile(L"input.bin", writeResults, resultFile);
+//
+// Each chunk is one sendWriteAndRun, so the circuit must answer a run with its results
+// (the write and execute readback).  The controller refuses transfers while the circuit
+// runs, so the device input buffer cannot be split between an upload and a run.  What
+// does overlap is everything else: the next chunks are queued behind the running one
+// (the runner sends them the moment it finishes, no round trip to this thread) while
+// this thread fills the chunk after that and the sink takes care of the last results.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCSTREAMH
+#define DEFINESIRCSTREAMH 1
+
+//What the circuit does with one chunk (the kernel contract).
+//A run takes length bytes at the start of the input buffer, with length in a
+// parameter register, and leaves its results at the start of the output buffer.
+//Other registers (e.g. the multiplier) are for the caller to set before streaming.
+typedef struct {
+    uint32_t maxChunkBytes;         //input bytes per run, 0: as many as fit
+    uint32_t outputNumerator;       //output bytes are at most input bytes * numerator
+    uint32_t outputDenominator;     // / denominator, this sizes the chunks
+    uint8_t lengthRegister;         //gets the input length of each chunk
+    uint32_t maxWaitTimeInMsec;     //for one run
+} SIRC_STREAM_KERNEL;
+
+//Fill buffer with up to maxLength bytes of input.
+//Return how many, 0 at the end of the input.
+typedef uint32_t (__stdcall *SIRC_STREAM_SOURCE)(uint8_t *buffer, uint32_t maxLength, void *context);
+
+//The results of the next chunk, in input order.  The data is only good during the call.
+//Return false to stop the stream.
+typedef BOOL (__stdcall *SIRC_STREAM_SINK)(const uint8_t *data, uint32_t length, void *context);
+
+//How the last stream went
+typedef struct {
+    ULONGLONG inputBytes;
+    ULONGLONG outputBytes;
+    uint32_t chunks;
+    uint32_t chunkBytes;            //input bytes per full chunk
+    uint32_t elapsedMsec;
+    double inputMBps;               //sustained, input megabytes per second
+} SIRC_STREAM_STATISTICS;
+
+//How many chunks are in the pipeline: one running, the next ones queued behind it,
+// and one being filled
+#define SIRC_STREAM_SLOTS 3
+
+class SIRC_STREAM
+{
+public:
+	//Stream through sirc with the given kernel.  The kernel is copied, sirc must outlive the stream.
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall SIRC_STREAM(SIRC *sirc, const SIRC_STREAM_KERNEL *kernel);
+	SIRC_DLL_LINKAGE __stdcall ~SIRC_STREAM();
+
+	//Stream everything source gives, until it gives 0 bytes.
+	//Returns true if all of it went through and the sink took all of the results.
+	//If anything fails, returns false.  Check error code with getLastError(),
+	// 0 means the sink stopped the stream.
+	SIRC_DLL_LINKAGE BOOL __stdcall run(SIRC_STREAM_SOURCE source, void *sourceContext,
+		SIRC_STREAM_SINK sink, void *sinkContext);
+
+	//Same, for a block of memory.  The chunks are sent from where they are.
+	SIRC_DLL_LINKAGE BOOL __stdcall runBuffer(const uint8_t *data, size_t length,
+		SIRC_STREAM_SINK sink, void *sinkContext);
+
+	//Same, for a file.  It is mapped into memory whole, so it must fit in the address space.
+	SIRC_DLL_LINKAGE BOOL __stdcall runFile(const wchar_t *path,
+		SIRC_STREAM_SINK sink, void *sinkContext);
+
+	//Retrieve the numbers for the last stream
+	SIRC_DLL_LINKAGE void __stdcall getStatistics(SIRC_STREAM_STATISTICS *outStatistics);
+
+	//Retrieve the last error code.  Any value < 0 indicates a problem.
+	inline int8_t __stdcall getLastError(){
+		return(lastError);
+	}
+
+private:
+	typedef struct {
+		uint8_t *input;             //ours, for callback sources
+		uint8_t *output;
+		SIRC_REQUEST *request;      //the chunk's write and run, NULL if none
+	} SLOT;
+
+	SIRC *sirc;
+	SIRC_STREAM_KERNEL kernel;
+	SLOT slots[SIRC_STREAM_SLOTS];
+	uint32_t chunkBytes;
+	uint32_t outputBytes;           //room for the results of one chunk
+	int8_t lastError;
+	volatile LONG failure;          //first error of a request nobody waits on
+	SIRC_STREAM_STATISTICS statistics;
+
+	//Where chunks come from
+	SIRC_STREAM_SOURCE source;
+	void *sourceContext;
+	const uint8_t *memory;
+	size_t memoryLeft;
+
+	BOOL setup(void);
+	BOOL stream(SIRC_STREAM_SINK sink, void *sinkContext);
+	uint32_t nextChunk(SLOT *slot, const uint8_t **data);
+	BOOL deliver(SLOT *slot, BOOL wanted, SIRC_STREAM_SINK sink, void *sinkContext);
+	void fail(int8_t code);
+	static void __stdcall recordFailure(SIRC_REQUEST *request, void *context);
+};
+
+#endif //DEFINESIRCSTREAMH
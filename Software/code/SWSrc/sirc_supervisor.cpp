@@ -0,0 +1,478 @@
+// Title: SIRC supervisor
+//
+// Description: Stall detection, recovery and replay around another SIRC.
+// See sirc_supervisor.h.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#include "sirc_internal.h"
+
+//Recoveries we try within one call before the error goes to the caller
+#define SUPERVISORMAXRECOVERIES 3
+
+//Missing acks in a row (each after the interface's own retries) that make a stall.
+//One can be a passing glitch, the call is simply tried again.
+#define SUPERVISORACKFAILURES 2
+
+//How long we let the line settle after the soft reset
+#define SUPERVISORQUIESCE 500
+
+SIRC_SUPERVISOR::SIRC_SUPERVISOR(SIRC *sirc, BOOL ownsSirc)
+{
+    SIRC::PARAMETERS params;
+
+    this->sirc = sirc;
+    this->ownsSirc = ownsSirc;
+    InitializeCriticalSection(&lock);
+    memset(&statistics, 0, sizeof(statistics));
+    memset(registers, 0, sizeof(registers));
+    memset(registerKnown, 0, sizeof(registerKnown));
+    input = NULL;
+    inputBytes = 0;
+    runPending = false;
+    haveResults = false;
+    lastRunWait = 0;
+    setLastError(0);
+
+    if (!sirc) {
+        setLastError(INVALIDBUFFER);
+        return;
+    }
+    //Nothing to supervise if that did not work
+    if (sirc->getLastError() != 0) {
+        setLastError(sirc->getLastError());
+        return;
+    }
+    if (!sirc->getParameters(&params, sizeof(params))) {
+        setLastError(sirc->getLastError());
+        return;
+    }
+    if (!resizeShadow(params.maxInputDataBytes))
+        setLastError(FAILMEMALLOC);
+}
+
+SIRC_SUPERVISOR::~SIRC_SUPERVISOR()
+{
+    //Submitted requests still come through us
+    finishAsync();
+
+    if (ownsSirc)
+        delete sirc;
+    free(input);
+    DeleteCriticalSection(&lock);
+}
+
+BOOL SIRC_SUPERVISOR::sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    CALL call;
+
+    initCall(&call, WRITE);
+    call.startAddress = startAddress;
+    call.length = length;
+    call.buffer = buffer;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer)
+{
+    CALL call;
+
+    initCall(&call, READ);
+    call.startAddress = startAddress;
+    call.length = length;
+    call.buffer = buffer;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendParamRegisterWrite(uint8_t regNumber, uint32_t value)
+{
+    CALL call;
+
+    initCall(&call, PARAMWRITE);
+    call.regNumber = regNumber;
+    call.value = value;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendParamRegisterRead(uint8_t regNumber, uint32_t *value)
+{
+    CALL call;
+
+    initCall(&call, PARAMREAD);
+    call.regNumber = regNumber;
+    call.valueOut = value;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendRun()
+{
+    CALL call;
+
+    initCall(&call, RUN);
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::waitDone(uint32_t maxWaitTimeInMsec)
+{
+    CALL call;
+
+    initCall(&call, WAITDONE);
+    call.maxWaitTime = maxWaitTimeInMsec;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendReset()
+{
+    CALL call;
+
+    initCall(&call, RESET);
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+                                      uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+                                      uint32_t *outputLength)
+{
+    CALL call;
+
+    initCall(&call, WRITEANDRUN);
+    call.startAddress = startAddress;
+    call.length = inLength;
+    call.buffer = inData;
+    call.maxWaitTime = maxWaitTimeinMsec;
+    call.outData = outData;
+    call.maxOutLength = maxOutLength;
+    call.outputLength = outputLength;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendWriteV(const SIRC_SEGMENT *segments, uint32_t count)
+{
+    CALL call;
+
+    initCall(&call, WRITEV);
+    call.segments = segments;
+    call.count = count;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::sendReadV(const SIRC_SEGMENT *segments, uint32_t count)
+{
+    CALL call;
+
+    initCall(&call, READV);
+    call.segments = segments;
+    call.count = count;
+    return supervise(&call);
+}
+
+BOOL SIRC_SUPERVISOR::quiesce(uint32_t maxWaitTimeInMsec)
+{
+    BOOL ok;
+
+    EnterCriticalSection(&lock);
+    ok = sirc->quiesce(maxWaitTimeInMsec);
+    setLastError(sirc->getLastError());
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+//Nothing to recover, a checksum that does not come back changes nothing on the board
+BOOL SIRC_SUPERVISOR::sendChecksum(BOOL output, uint32_t startAddress, uint32_t length, uint32_t *crc)
+{
+    BOOL ok;
+
+    EnterCriticalSection(&lock);
+    ok = sirc->sendChecksum(output, startAddress, length, crc);
+    setLastError(sirc->getLastError());
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+BOOL SIRC_SUPERVISOR::getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength)
+{
+    BOOL ok;
+
+    EnterCriticalSection(&lock);
+    ok = sirc->getParameters(outParameters, maxOutLength);
+    setLastError(sirc->getLastError());
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+BOOL SIRC_SUPERVISOR::setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length)
+{
+    SIRC::PARAMETERS params;
+    BOOL ok;
+
+    EnterCriticalSection(&lock);
+    ok = sirc->setParameters(inParameters, length);
+    setLastError(sirc->getLastError());
+    //The input buffer might have changed size
+    if (ok && sirc->getParameters(&params, sizeof(params)) &&
+        !resizeShadow(params.maxInputDataBytes)) {
+        setLastError(FAILMEMALLOC);
+        ok = false;
+    }
+    LeaveCriticalSection(&lock);
+    return ok;
+}
+
+void SIRC_SUPERVISOR::getStatistics(SIRC_SUPERVISOR_STATISTICS *outStatistics)
+{
+    EnterCriticalSection(&lock);
+    *outStatistics = statistics;
+    LeaveCriticalSection(&lock);
+}
+
+void SIRC_SUPERVISOR::initCall(CALL *call, OPERATION operation)
+{
+    memset(call, 0, sizeof(*call));
+    call->operation = operation;
+}
+
+//Make the call, and if it stalls recover and make it again.
+//Return true on success, return false w/error code on failure
+BOOL SIRC_SUPERVISOR::supervise(CALL *call)
+{
+    uint32_t recoveries = 0;
+    uint32_t ackFailures = 0;
+    DWORD attemptStart;
+    int8_t error;
+    BOOL stalled;
+
+    EnterCriticalSection(&lock);
+    shadow(call);
+
+    attemptStart = GetTickCount();
+    for (;;) {
+        if (attempt(call)) {
+            track(call);
+            if (recoveries)
+                statistics.recoveries++;
+            setLastError(0);
+            LeaveCriticalSection(&lock);
+            return true;
+        }
+
+        error = sirc->getLastError();
+        switch (error) {
+        case FAILDONE:
+        case FAILWAITACK:
+            stalled = true;
+            break;
+        case FAILWRITEACK:
+        case FAILREADACK:
+        case FAILWRITEANDRUNREADACK:
+        case FAILRESETACK:
+            stalled = (++ackFailures >= SUPERVISORACKFAILURES);
+            if (!stalled)
+                continue;
+            break;
+        default:
+            //Not something a reset fixes (bad arguments, capacity, ...)
+            stalled = false;
+            break;
+        }
+
+        //A soft reset that does not go through cannot be fixed by another one
+        if (!stalled || (call->operation == RESET) || (recoveries >= SUPERVISORMAXRECOVERIES)) {
+            if (recoveries)
+                statistics.failedRecoveries++;
+            if (recoveries)
+                statistics.lostMsec += GetTickCount() - attemptStart;
+            setLastError(error);
+            LeaveCriticalSection(&lock);
+            return false;
+        }
+
+        recoveries++;
+        ackFailures = 0;
+        statistics.lastCause = error;
+        if ((error == FAILDONE) || (error == FAILWAITACK))
+            statistics.stalls++;
+        LogIt("sirc::supervise.recover %d %u",(int) error,recoveries);
+
+        (void) recover(call);
+        statistics.lostMsec += GetTickCount() - attemptStart;
+        attemptStart = GetTickCount();
+        statistics.replays++;
+    }
+}
+
+//Hand the call to the interface we watch over
+BOOL SIRC_SUPERVISOR::attempt(CALL *call)
+{
+    switch (call->operation) {
+    case WRITE:
+        return sirc->sendWrite(call->startAddress, call->length, call->buffer);
+    case READ:
+        return sirc->sendRead(call->startAddress, call->length, call->buffer);
+    case PARAMWRITE:
+        return sirc->sendParamRegisterWrite(call->regNumber, call->value);
+    case PARAMREAD:
+        return sirc->sendParamRegisterRead(call->regNumber, call->valueOut);
+    case RUN:
+        return sirc->sendRun();
+    case WAITDONE:
+        return sirc->waitDone(call->maxWaitTime);
+    case RESET:
+        return sirc->sendReset();
+    case WRITEANDRUN:
+        return sirc->sendWriteAndRun(call->startAddress, call->length, call->buffer, call->maxWaitTime,
+                                     call->outData, call->maxOutLength, call->outputLength);
+    case WRITEV:
+        return sirc->sendWriteV(call->segments, call->count);
+    case READV:
+        return sirc->sendReadV(call->segments, call->count);
+    }
+    return false;
+}
+
+//Whatever the call is about to put on the FPGA goes in the shadow first, so that a
+// recovery in the middle of it restores what the caller meant.
+void SIRC_SUPERVISOR::shadow(CALL *call)
+{
+    switch (call->operation) {
+    case WRITE:
+    case WRITEANDRUN:
+        shadowWrite(call->startAddress, call->length, call->buffer);
+        break;
+    case WRITEV:
+        if (call->segments) {
+            for (uint32_t s = 0; s < call->count; s++)
+                shadowWrite(call->segments[s].startAddress, call->segments[s].length, call->segments[s].buffer);
+        }
+        break;
+    case PARAMWRITE:
+        if (call->regNumber < 255) {
+            registers[call->regNumber] = call->value;
+            registerKnown[call->regNumber] = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+//Keep up with the transaction after a call went through
+void SIRC_SUPERVISOR::track(CALL *call)
+{
+    switch (call->operation) {
+    case WRITE:
+    case WRITEV:
+    case PARAMWRITE:
+        haveResults = false;
+        break;
+    case RUN:
+        runPending = true;
+        haveResults = false;
+        break;
+    case WAITDONE:
+        if (runPending) {
+            runPending = false;
+            haveResults = true;
+            lastRunWait = call->maxWaitTime;
+        }
+        break;
+    case WRITEANDRUN:
+        runPending = false;
+        haveResults = true;
+        lastRunWait = call->maxWaitTime;
+        break;
+    case RESET:
+        runPending = false;
+        haveResults = false;
+        break;
+    default:
+        break;
+    }
+}
+
+//Soft reset, put the shadow back, and get the transaction back to where the call expects it.
+//Return true on success, return false w/error code on failure
+BOOL SIRC_SUPERVISOR::recover(CALL *call)
+{
+    BOOL rerun;
+
+    if (!sirc->sendReset())
+        return false;
+    (void) sirc->quiesce(SUPERVISORQUIESCE);
+
+    for (int r = 0; r < 255; r++) {
+        if (registerKnown[r] && !sirc->sendParamRegisterWrite((uint8_t) r, registers[r]))
+            return false;
+    }
+    //Only what was written, the rest of the input is whatever the circuit left there
+    for (uint32_t w = 0; w < written.size(); w++) {
+        if (!sirc->sendWrite(written[w].start, written[w].end - written[w].start, input + written[w].start))
+            return false;
+    }
+
+    //The reset stopped the run the caller is waiting on.  Results the caller is about to
+    // read came from a run that might not have survived the reset either, so do it again.
+    switch (call->operation) {
+    case WAITDONE:
+        return runPending ? sirc->sendRun() : true;
+    case READ:
+    case READV:
+        rerun = haveResults;
+        break;
+    default:
+        rerun = false;
+        break;
+    }
+    if (!rerun)
+        return true;
+    return sirc->sendRun() && sirc->waitDone(lastRunWait);
+}
+
+//Return true on success, false if out of memory (the shadow then stays as it was)
+BOOL SIRC_SUPERVISOR::resizeShadow(uint32_t bytes)
+{
+    uint8_t *buffer;
+
+    if (bytes == inputBytes)
+        return true;
+    buffer = (uint8_t *) realloc(input, bytes);
+    if (!buffer && bytes)
+        return false;
+    if (bytes > inputBytes)
+        memset(buffer + inputBytes, 0, bytes - inputBytes);
+    input = buffer;
+    inputBytes = bytes;
+    while (!written.empty() && (written.back().start >= inputBytes))
+        written.pop_back();
+    if (!written.empty())
+        written.back().end = min(written.back().end, inputBytes);
+    return true;
+}
+
+void SIRC_SUPERVISOR::shadowWrite(uint32_t startAddress, uint32_t length, const uint8_t *buffer)
+{
+    //Out of bounds writes fail anyway, the interface will say why
+    if (!buffer || (length == 0) || (startAddress >= inputBytes) || (length > inputBytes - startAddress))
+        return;
+    memcpy(input + startAddress, buffer, length);
+
+    //Merge with the ranges it overlaps or touches
+    RANGE range = { startAddress, startAddress + length };
+    uint32_t first = 0;
+    uint32_t last;
+
+    while ((first < written.size()) && (written[first].end < range.start))
+        first++;
+    for (last = first; (last < written.size()) && (written[last].start <= range.end); last++) {
+        range.start = min(range.start, written[last].start);
+        range.end = max(range.end, written[last].end);
+    }
+    written.erase(written.begin() + first, written.begin() + last);
+    written.insert(written.begin() + first, range);
+}
@@ -0,0 +1,134 @@
+// Title: SIRC supervisor
+//
+// Description: A SIRC that watches over another one and gets it going again when the
+// user circuit or the link stalls, so that long unattended runs do not have to stop
+// at the first glitch.
+//
+//      SIRC *sirc = new SIRC_SUPERVISOR(new ETH_SIRC(FPGA_ID, driverVersion, NULL), true);
+//
+// Everything written to the parameter registers and the input buffer is shadowed.
+// A call that fails with a stall (waitDone timing out, or acks missing twice in a row)
+// sets off a recovery: soft reset, the registers and the input buffer written back
+// from the shadow, and the interrupted transaction replayed.  A waitDone gets its run
+// again, a read of results gets the run that produced them again, everything else is
+// simply called again.  After SUPERVISORMAXRECOVERIES tries in one call the error goes
+// to the caller as usual.
+//
+// Calls are serialized, so control commands from other threads wait for the bulk
+// command in progress instead of going ahead of it.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCSUPERVISORH
+#define DEFINESIRCSUPERVISORH 1
+
+//What the supervisor had to do so far
+typedef struct {
+    uint32_t recoveries;            //resets that got the call through
+    uint32_t failedRecoveries;      //calls that failed anyway, the error went to the caller
+    uint32_t replays;               //calls made again after a recovery
+    uint32_t stalls;                //recoveries set off by waitDone timing out
+    ULONGLONG lostMsec;             //spent in failed attempts and recoveries
+    int8_t lastCause;               //error code behind the last recovery
+} SIRC_SUPERVISOR_STATISTICS;
+
+class SIRC_SUPERVISOR : public SIRC {
+public:
+	//Watch over sirc.  With ownsSirc the supervisor deletes it when it goes.
+	//Check error code with getLastError() to make certain constructor succeeded.
+	SIRC_DLL_LINKAGE __stdcall SIRC_SUPERVISOR(SIRC *sirc, BOOL ownsSirc);
+	SIRC_DLL_LINKAGE __stdcall ~SIRC_SUPERVISOR();
+
+	//SIRC, with recovery.  See sirc.h for the arguments.
+	BOOL __stdcall sendWrite(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	BOOL __stdcall sendRead(uint32_t startAddress, uint32_t length, uint8_t *buffer);
+	BOOL __stdcall sendParamRegisterWrite(uint8_t regNumber, uint32_t value);
+	BOOL __stdcall sendParamRegisterRead(uint8_t regNumber, uint32_t *value);
+	BOOL __stdcall sendRun();
+	BOOL __stdcall waitDone(uint32_t maxWaitTimeInMsec);
+	BOOL __stdcall sendReset();
+	BOOL __stdcall sendWriteAndRun(uint32_t startAddress, uint32_t inLength, uint8_t *inData,
+		uint32_t maxWaitTimeinMsec, uint8_t *outData, uint32_t maxOutLength,
+		uint32_t *outputLength);
+	BOOL __stdcall sendWriteV(const SIRC_SEGMENT *segments, uint32_t count);
+	BOOL __stdcall sendReadV(const SIRC_SEGMENT *segments, uint32_t count);
+
+	//Straight through
+	BOOL __stdcall quiesce(uint32_t maxWaitTimeInMsec);
+	BOOL __stdcall sendChecksum(BOOL output, uint32_t startAddress, uint32_t length, uint32_t *crc);
+	BOOL __stdcall getParameters(SIRC::PARAMETERS *outParameters, uint32_t maxOutLength);
+	BOOL __stdcall setParameters(const SIRC::PARAMETERS *inParameters, uint32_t length);
+
+	//Retrieve the recovery counters
+	SIRC_DLL_LINKAGE void __stdcall getStatistics(SIRC_SUPERVISOR_STATISTICS *outStatistics);
+
+private:
+	typedef enum {
+		WRITE,
+		READ,
+		PARAMWRITE,
+		PARAMREAD,
+		RUN,
+		WAITDONE,
+		RESET,
+		WRITEANDRUN,
+		WRITEV,
+		READV
+	} OPERATION;
+
+	//One call and its arguments, as for the method
+	typedef struct {
+		OPERATION operation;
+		uint32_t startAddress;
+		uint32_t length;
+		uint8_t *buffer;
+		uint8_t regNumber;
+		uint32_t value;
+		uint32_t *valueOut;
+		uint32_t maxWaitTime;
+		uint8_t *outData;
+		uint32_t maxOutLength;
+		uint32_t *outputLength;
+		const SIRC_SEGMENT *segments;
+		uint32_t count;
+	} CALL;
+
+	SIRC *sirc;
+	BOOL ownsSirc;
+	CRITICAL_SECTION lock;          //one call at a time, protects everything below
+	SIRC_SUPERVISOR_STATISTICS statistics;
+
+	//The shadow: what the circuit should see
+	uint32_t registers[255];
+	BOOL registerKnown[255];
+	uint8_t *input;
+	uint32_t inputBytes;
+	typedef struct {
+		uint32_t start;
+		uint32_t end;
+	} RANGE;
+	std::vector <RANGE> written;    //parts of input written so far, in order, none touching
+
+	//Where the current transaction is
+	BOOL runPending;                //sendRun went out, waitDone did not see it finish yet
+	BOOL haveResults;               //a run finished since the inputs last changed
+	uint32_t lastRunWait;           //what that run was given
+
+	void initCall(CALL *call, OPERATION operation);
+	BOOL supervise(CALL *call);
+	BOOL attempt(CALL *call);
+	void shadow(CALL *call);
+	void track(CALL *call);
+	BOOL recover(CALL *call);
+	BOOL resizeShadow(uint32_t bytes);
+	void shadowWrite(uint32_t startAddress, uint32_t length, const uint8_t *buffer);
+};
+
+#endif //DEFINESIRCSUPERVISORH
@@ -16,6 +16,8 @@
 #ifndef DEFINEUTILH
 #define DEFINEUTILH 1
 
+#include <stddef.h>
+
 extern int hexToFpgaId(const char *mac, unsigned char *id, size_t maxBytes);
 extern int hexToFpgaId(const wchar_t *mac, unsigned char *id, size_t maxBytes);
 
@@ -0,0 +1,286 @@
+// Title: SIRC wire format
+//
+// Description: Layout of every SIRC command and response frame, in one place.
+// Each frame type lists its fields and their offsets, and the templates below
+// generate big-endian loads, stores and checks from that.  No other code should
+// need to know byte positions or do shifts.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+// Offsets are relative to the frame payload, which starts right after the 14-byte
+// Ethernet header (dest MAC, source MAC, payload length).  All integers are big-endian.
+// Loads and stores may be unaligned, which is fine on the x86/x64 hosts we run on.
+// Everything here is inline and the offsets are template constants, so each
+// accessor is a single (byteswapped) load or store.
+//----------------------------------------------------------------------------
+
+#ifndef DEFINESIRCWIREH
+#define DEFINESIRCWIREH 1
+
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+#pragma intrinsic(_byteswap_ulong,_byteswap_ushort)
+#endif
+
+namespace SircWire {
+
+//8-bit field at OFFSET
+template <unsigned OFFSET> struct U8 {
+    enum { offset = OFFSET, end = OFFSET + 1 };
+    static inline uint8_t get(const uint8_t *p) {
+        return p[OFFSET];
+    }
+    static inline void put(uint8_t *p, uint8_t v) {
+        p[OFFSET] = v;
+    }
+};
+
+//16-bit big-endian field at OFFSET
+template <unsigned OFFSET> struct U16 {
+    enum { offset = OFFSET, end = OFFSET + 2 };
+    static inline uint16_t get(const uint8_t *p) {
+#if defined(_MSC_VER)
+        return _byteswap_ushort(*(const uint16_t *)(p + OFFSET));
+#else
+        return (uint16_t)((p[OFFSET] << 8) | p[OFFSET + 1]);
+#endif
+    }
+    static inline void put(uint8_t *p, uint16_t v) {
+#if defined(_MSC_VER)
+        *(uint16_t *)(p + OFFSET) = _byteswap_ushort(v);
+#else
+        p[OFFSET]     = (uint8_t)(v >> 8);
+        p[OFFSET + 1] = (uint8_t)(v);
+#endif
+    }
+};
+
+//32-bit big-endian field at OFFSET
+template <unsigned OFFSET> struct U32 {
+    enum { offset = OFFSET, end = OFFSET + 4 };
+    static inline uint32_t get(const uint8_t *p) {
+#if defined(_MSC_VER)
+        return _byteswap_ulong(*(const uint32_t *)(p + OFFSET));
+#else
+        return ((uint32_t)p[OFFSET] << 24) | ((uint32_t)p[OFFSET + 1] << 16) |
+               ((uint32_t)p[OFFSET + 2] << 8) | (uint32_t)p[OFFSET + 3];
+#endif
+    }
+    static inline void put(uint8_t *p, uint32_t v) {
+#if defined(_MSC_VER)
+        *(uint32_t *)(p + OFFSET) = _byteswap_ulong(v);
+#else
+        p[OFFSET]     = (uint8_t)(v >> 24);
+        p[OFFSET + 1] = (uint8_t)(v >> 16);
+        p[OFFSET + 2] = (uint8_t)(v >> 8);
+        p[OFFSET + 3] = (uint8_t)(v);
+#endif
+    }
+};
+
+//The Ethernet header in front of every frame
+struct Ethernet {
+    enum { headerLength = 14 };
+    typedef U16<12> Length;             //payload length, not counting this header
+
+    static inline uint8_t *payload(uint8_t *frame) {
+        return frame + headerLength;
+    }
+};
+
+//A command byte followed by HEADER-1 bytes of fields, then maybe data.
+//Frames without data have exactly HEADER bytes, frames with data at least one more.
+template <uint8_t COMMAND, unsigned HEADER, bool DATA> struct Frame {
+    enum { command = COMMAND, headerLength = HEADER, hasData = DATA };
+    typedef U8<0> Command;
+
+    //Start a frame of this type
+    static inline void start(uint8_t *p) {
+        p[0] = COMMAND;
+    }
+    //Where the data starts
+    static inline uint8_t *data(uint8_t *p) {
+        return p + HEADER;
+    }
+    //How much data a frame of this (payload) length carries
+    static inline uint32_t dataLength(uint32_t length) {
+        return length - HEADER;
+    }
+    //Frame length for this much data
+    static inline uint32_t frameLength(uint32_t dataLength) {
+        return HEADER + dataLength;
+    }
+    //Is this a frame of this type?  The length test folds at compile time.
+    static inline BOOL valid(const uint8_t *p, uint32_t length) {
+        return (p[0] == COMMAND) & (DATA ? (length > HEADER) : (length == HEADER));
+    }
+};
+
+//Host to FPGA
+
+//'w' write data at an address.  Acked by echoing the header.
+struct Write : Frame<'w', 9, true> {
+    typedef U32<1> Address;
+    typedef U32<5> Length;
+};
+
+//'z' coded write (sirc_codec.h), Length is after expansion.  Acked like 'w'.
+struct CodedWrite : Frame<'z', 9, true> {
+    typedef U32<1> Address;
+    typedef U32<5> Length;
+};
+
+//'g' write the last piece of data and run.  Answered with ReadBack frames.
+struct WriteAndRun : Frame<'g', 9, true> {
+    typedef U32<1> Address;
+    typedef U32<5> Length;
+};
+
+//'r' read request.  Answered with ReadResponse frames.
+struct Read : Frame<'r', 9, false> {
+    typedef U32<1> Address;
+    typedef U32<5> Length;
+};
+
+//'q' read request, answered with ReadResponse and/or CodedReadResponse frames
+struct CodedRead : Frame<'q', 9, false> {
+    typedef U32<1> Address;
+    typedef U32<5> Length;
+};
+
+//'r' or 'q' read request once receive credits are on (CreditSetup).  Credits is how many
+//response frames the host can take from here on, keep to go on with what is left.
+struct CreditRead : Frame<'r', 13, false> {
+    typedef U32<1> Address;
+    typedef U32<5> Length;
+    typedef U32<9> Credits;
+    enum { keep = 0xFFFFFFFF };
+};
+
+//'k' parameter register write.  Acked by echoing the whole frame.
+struct RegWrite : Frame<'k', 6, false> {
+    typedef U8<1> Register;
+    typedef U32<2> Value;
+};
+
+//'y' parameter register read
+struct RegRead : Frame<'y', 2, false> {
+    typedef U8<1> Register;
+};
+
+//'m' soft reset, acked by echoing it
+struct Reset : Frame<'m', 1, false> {
+};
+
+//'n' ask for SIRC_COMPRESS_* features, answered with the ones accepted
+struct Negotiate : Frame<'n', 5, false> {
+    typedef U32<1> Mask;
+};
+
+//'j' join (Op 1) or leave (Op 0) the multicast group at Group, acked by echoing it.
+//Hardware without groups does not answer.
+struct Join : Frame<'j', 8, false> {
+    typedef U8<1> Op;
+    enum { leave = 0, join = 1, groupOffset = 2 };
+
+    //The 6-byte group MAC address
+    static inline uint8_t *group(uint8_t *p) {
+        return p + groupOffset;
+    }
+};
+
+//'f' ask for a Parity frame every Group data frames (sirc_fec.h), 0 for none.
+//Answered by echoing it with the group the FPGA will use.  Hardware without FEC does not answer.
+struct FecSetup : Frame<'f', 2, false> {
+    typedef U8<1> Group;
+};
+
+//'c' turn receive credits on (On 1) or off (On 0).  With them on, response frames (read
+//responses, readbacks and parity) are only sent while the host has credits left for them.
+//Answered by echoing it with what the FPGA will do.  Hardware without credits does not answer.
+struct CreditSetup : Frame<'c', 2, false> {
+    typedef U8<1> On;
+};
+
+//'c' Credits more response frames may be sent.  With Start set they replace whatever was
+//left, at the beginning of a write & run or a resend.  Never answered.
+struct Credit : Frame<'c', 6, false> {
+    typedef U8<1> Start;
+    typedef U32<2> Credits;
+};
+
+//'h' ask for the CRC32C (sirc_crc.h) of Length bytes at Address of the input (Buffer 0)
+//or output (Buffer 1) buffer.  Answered with a ChecksumResponse.
+//Hardware without checksums does not answer.
+struct Checksum : Frame<'h', 10, false> {
+    typedef U8<1> Buffer;
+    typedef U32<2> Address;
+    typedef U32<6> Length;
+    enum { input = 0, output = 1 };
+};
+
+//FPGA to host
+
+//'r' read data
+struct ReadResponse : Frame<'r', 5, true> {
+    typedef U32<1> Address;
+};
+
+//'q' coded read data, Length is after expansion
+struct CodedReadResponse : Frame<'q', 9, true> {
+    typedef U32<1> Address;
+    typedef U32<5> Length;
+};
+
+//'g' write & run readback.  Remaining counts from Address to the end of the output.
+struct ReadBack : Frame<'g', 9, true> {
+    typedef U32<1> Address;
+    typedef U32<5> Remaining;
+};
+
+//'u' coded write & run readback, Length is after expansion
+struct CodedReadBack : Frame<'u', 13, true> {
+    typedef U32<1> Address;
+    typedef U32<5> Remaining;
+    typedef U32<9> Length;
+};
+
+//'p' XOR parity of the Count data frames before it, which carry [First, End) of one
+//response (sirc_fec.h).  LengthXor is the XOR of their frame lengths.
+struct Parity : Frame<'p', 12, true> {
+    typedef U32<1> First;
+    typedef U32<5> End;
+    typedef U8<9> Count;
+    typedef U16<10> LengthXor;
+};
+
+//'h' the Checksum request echoed, with the CRC32C of that part of the buffer
+struct ChecksumResponse : Frame<'h', 14, false> {
+    typedef U8<1> Buffer;
+    typedef U32<2> Address;
+    typedef U32<6> Length;
+    typedef U32<10> Crc;
+};
+
+//'y' parameter register value
+struct RegReadResponse : Frame<'y', 6, false> {
+    typedef U8<1> Register;
+    typedef U32<2> Value;
+};
+
+//'e' something was wrong with a command (RECEIVE_ERROR_*)
+struct Error : Frame<'e', 2, false> {
+    typedef U8<1> Code;
+};
+
+} //namespace SircWire
+
+#endif //DEFINESIRCWIREH
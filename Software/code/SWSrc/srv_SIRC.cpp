@@ -49,6 +49,10 @@
 //This number should be larger than NUMOUTSTANDINGREADS
 #define NUMOUTSTANDINGWRITES 250
 
+//With receive credits on, how long (msec) we wait for the host to grant more before
+// giving up on the rest of a response.  The host asks for what is missing again.
+#define CREDITTIMEOUT 250
+
 //******
 //******Other (internal) constants.
 //******
@@ -79,16 +83,20 @@
 #else
 #define BIGDEBUG_ONLY(x)
 #endif
-#pragma intrinsic(_byteswap_ulong,_byteswap_ushort) //jic. And btw why don't we define BYTE_ORDER
 
 //PUBLIC FUNCTIONS
 //Constructor for the class
 //Return with an error code if anything goes wrong.
 SIRC_DLL_LINKAGE SRV_SIRC::SRV_SIRC(uint32_t **registerFile, uint8_t **inputBuffer, uint8_t **outputBuffer,
              uint32_t driverVersion,
-             wchar_t *nicName)
+             wchar_t *nicName,
+             const uint8_t *boardMAC)
 {
 	setLastError(0);
+    codeBuffer = NULL;
+    fec = NULL;
+    numGroups = 0;
+    promiscuous = false;
 	//Make connection to NIC driver
     PacketDriver = OpenPacketDriver(nicName,driverVersion,false);
     if (!PacketDriver) {
@@ -99,6 +107,17 @@ SIRC_DLL_LINKAGE SRV_SIRC::SRV_SIRC(uint32_t **registerFile, uint8_t **inputBuff
     //See what MAC address we have
 	PacketDriver->GetMacAddress(My_MACAddress);
 
+    //Or pretend to be a board with one of its own
+    if (boardMAC) {
+        memcpy(My_MACAddress, boardMAC, 6);
+        if (PacketDriver->SetFilter(NDIS_PACKET_TYPE_DIRECTED | NDIS_PACKET_TYPE_BROADCAST |
+                                    NDIS_PACKET_TYPE_PROMISCUOUS) != S_OK) {
+            setLastError(FAILVMNSDRIVERFILTER);
+            return;
+        }
+        promiscuous = true;
+    }
+
     //See how many outstanding packets we can have
     if (!PacketDriver->GetMaxOutstanding(&maxOutstandingReads,
                                          &maxOutstandingWrites)) {
@@ -116,6 +135,18 @@ SIRC_DLL_LINKAGE SRV_SIRC::SRV_SIRC(uint32_t **registerFile, uint8_t **inputBuff
     maxInputDataBytes  = MAXINPUTDATABYTEADDRESS;
     maxOutputDataBytes = MAXOUTPUTDATABYTEADDRESS;
 
+    //Plain frames until the host negotiates
+    compression = 0;
+    codeBuffer = (uint8_t *) malloc(MAXPACKETDATASIZE);
+
+    //No parity until the host asks for it
+    fecGroup = 0;
+    fec = (SIRC_FEC_GROUP *) calloc(1, sizeof(SIRC_FEC_GROUP));
+
+    //Nor credits
+    creditFlow = false;
+    creditsLeft = 0;
+
     //Make these optional so the user can better control them (and their sizes)
     if (*registerFile == NULL)
         *registerFile = (uint32_t *) malloc(256 * sizeof(uint32_t));
@@ -124,7 +155,7 @@ SIRC_DLL_LINKAGE SRV_SIRC::SRV_SIRC(uint32_t **registerFile, uint8_t **inputBuff
     if (*outputBuffer == NULL)
         *outputBuffer = (uint8_t *) malloc(maxOutputDataBytes * sizeof(uint8_t));
 
-	if(!*registerFile || !*inputBuffer || !*outputBuffer){
+	if(!*registerFile || !*inputBuffer || !*outputBuffer || !codeBuffer || !fec){
 		setLastError(FAILMEMALLOC);
 		return;
 	}
@@ -152,7 +183,13 @@ SIRC_DLL_LINKAGE SRV_SIRC::SRV_SIRC(uint32_t **registerFile, uint8_t **inputBuff
 }
 
 SRV_SIRC::~SRV_SIRC(){
+    while (!deferred.empty()) {
+        PacketDriver->FreePacket(deferred.front(),true);
+        deferred.pop_front();
+    }
 	delete PacketDriver;
+	free(codeBuffer);
+	free(fec);
 }
 
 //Dynamic parameters
@@ -161,7 +198,7 @@ BOOL SRV_SIRC::getParameters(SIRC_SERVER::PARAMETERS *outParameters, uint32_t ma
 {
     SIRC_SERVER::PARAMETERS params;
 
-    params.myVersion            = SIRC_PARAMETERS_CURRENT_VERSION;
+    params.myVersion            = SIRC_SERVER_PARAMETERS_CURRENT_VERSION;
     params.maxInputDataBytes    = maxInputDataBytes;
     params.maxOutputDataBytes   = maxOutputDataBytes;
     params.maxOutstandingReads  = maxOutstandingReads;
@@ -183,7 +220,7 @@ BOOL SRV_SIRC::setParameters(const SIRC_SERVER::PARAMETERS *inParameters, uint32
 {
     //Sometimes you got to know what you are doing.
     if ((length < sizeof(*inParameters)) ||
-        (inParameters->myVersion < SIRC_PARAMETERS_CURRENT_VERSION)){
+        (inParameters->myVersion < SIRC_SERVER_PARAMETERS_CURRENT_VERSION)){
         setLastError(INVALIDLENGTH);
         return false;
     }
@@ -233,11 +270,17 @@ BOOL SRV_SIRC::processCommands(bool *writeAndExecute){
         //  Wait for an I/O to complete.
         //
         
-        Packet = NULL;
-        Mode = PacketDriver->GetNextCompletedPacket(&Packet,INFINITE);
-
-        if (Mode == PacketModeInvalid)
-            return false;
+        //Whatever came in while a response waited for credits goes first
+        if (!deferred.empty()) {
+            Packet = deferred.front();
+            deferred.pop_front();
+        } else {
+            Packet = NULL;
+            Mode = PacketDriver->GetNextCompletedPacket(&Packet,INFINITE);
+
+            if (Mode == PacketModeInvalid)
+                return false;
+        }
 
 		BIGDEBUG_ONLY(printf("***********%c-Completion on packet @ %p  [%p]\n", 
                (Packet->Mode == PacketModeReceiving) ? 'R' : 'T',
@@ -274,21 +317,52 @@ BOOL SRV_SIRC::processCommands(bool *writeAndExecute){
 BOOL SRV_SIRC::sendReadBacks(uint32_t length){
 	uint32_t startAddress = 0;
 	uint32_t currLength;
+	uint32_t codedLength = 0;
+	//Room for the parity frame header, if there is one
+	uint32_t overhead = fecGroup ? SIRC_FEC_OVERHEAD : 0;
+
+	if(fecGroup)
+		sircFecStart(fec);
 
 	while(length > 0){
-		if(length > MAXREADSIZE - 4){
-			currLength = MAXREADSIZE - 4;
+		if(length > MAXREADSIZE - 4 - overhead){
+			currLength = MAXREADSIZE - 4 - overhead;
 		}
 		else{
 			currLength = length;
 		}	
-	
-		if(!createReadBackPacketAndTransmit(startAddress, currLength, length)){
+
+		//Code the frame if the host agreed to it and that carries more
+		if(compression & SIRC_COMPRESS_READS)
+			codedLength = sircRleEncodeFrame(outputBufP + startAddress, length, MAXREADSIZE - 4 - overhead,
+											 codeBuffer, MAXPACKETDATASIZE - SircWire::CodedReadBack::headerLength - overhead, &currLength);
+
+		//Out of credits for good, the host will ask for the rest
+		if(creditFlow && !takeCredit(WriteAndRunHostMACAddress)){
+			return (getLastError() == 0);
+		}
+
+		if(codedLength){
+			if(!createCodedReadBackPacketAndTransmit(startAddress, currLength, length, codedLength)){
+				return false;
+			}
+		}
+		else if(!createReadBackPacketAndTransmit(startAddress, currLength, length)){
 			return false;
 		}
 	
 		startAddress += currLength;
 		length -= currLength;
+
+		//A group is complete, or the output
+		if(fecGroup && ((fec->frames == fecGroup) || (length == 0))){
+			if(creditFlow && !takeCredit(WriteAndRunHostMACAddress)){
+				return (getLastError() == 0);
+			}
+			if(!sendParity(WriteAndRunHostMACAddress)){
+				return false;
+			}
+		}
 	}
 	return true;
 }
@@ -326,17 +400,22 @@ BOOL SRV_SIRC::processPacket(PACKET* Packet, bool *execute, bool *writeAndExecut
 
 	message = Packet->Buffer;
 
-	//Make sure it is directed at specifically us, not just a broadcast packet
-    if (memcmp(message,My_MACAddress,6) != 0)
-		return true;
+	//Make sure it is directed at specifically us, not just a broadcast packet.
+	//Groups we joined can only write.
+    if (memcmp(message,My_MACAddress,6) != 0) {
+        uint8_t command = message[SircWire::Ethernet::headerLength];
+        if (!inGroup(message) || ((command != SircWire::Write::command) && (command != SircWire::RegWrite::command)))
+            return true;
+    }
 
-	length = message[12] * 256 + message[13];
+	length = SircWire::Ethernet::Length::get(message);
 	if(length == 0){
 		return sendErrorMessage(RECEIVE_ERROR_PACKET_LENGTH, message);
 	}
 
-	switch(message[14]){
+	switch(message[SircWire::Ethernet::headerLength]){
 		case 'r':
+		case 'q':
 			if(!checkReadPacket(message)){
 				return false;
 			}
@@ -346,6 +425,26 @@ BOOL SRV_SIRC::processPacket(PACKET* Packet, bool *execute, bool *writeAndExecut
 				return false;
 			}
 			break;
+		case 'z':
+			if(!checkCodedWritePacket(message)){
+				return false;
+			}
+			break;
+		case 'n':
+			if(!checkNegotiatePacket(message)){
+				return false;
+			}
+			break;
+		case 'f':
+			if(!checkFecSetupPacket(message)){
+				return false;
+			}
+			break;
+		case 'c':
+			if(!checkCreditPacket(message)){
+				return false;
+			}
+			break;
 		case 'y':
 			if(!checkRegReadPacket(message)){
 				return false;
@@ -366,6 +465,16 @@ BOOL SRV_SIRC::processPacket(PACKET* Packet, bool *execute, bool *writeAndExecut
 				return false;
 			}
 			break;
+		case 'j':
+			if(!checkJoinPacket(message)){
+				return false;
+			}
+			break;
+		case 'h':
+			if(!checkChecksumPacket(message)){
+				return false;
+			}
+			break;
 		default:
 			//if(!sendErrorMessage(RECEIVE_ERROR_COMMAND, message)){
 				//return false;
@@ -379,12 +488,12 @@ BOOL SRV_SIRC::processPacket(PACKET* Packet, bool *execute, bool *writeAndExecut
 BOOL SRV_SIRC::sendErrorMessage(int8_t errorNumber, uint8_t *sourceMessage){
 
 	//The packet will be 2 bytes long
-	if (!allocateAndFillPacket(sourceMessage + 6, 2))
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::Error::headerLength))
         return false;
 
 	//Set the first byte to 'e'
-	currentBuffer[0] = 'e';
-	currentBuffer[1] = errorNumber;
+	SircWire::Error::start(currentBuffer);
+	SircWire::Error::Code::put(currentBuffer, errorNumber);
 
 	if(addTransmit(currentPacket))
         return true;
@@ -403,26 +512,21 @@ BOOL SRV_SIRC::allocateAndFillPacket(uint8_t *sourceMAC, uint16_t length){
 
 	currentPacket->Mode = PacketModeTransmitting;
 
-	//Get the beginning of the packet payload (header is 14 bytes)
-	currentBuffer = &(currentPacket->Buffer[14]);
+	//Get the beginning of the packet payload
+	currentBuffer = SircWire::Ethernet::payload(currentPacket->Buffer);
 
 	assert(length <= MAXPACKETDATASIZE);
 
 	//The length of the frame will be the length of the payload plus 6 + 6 + 2 (dest MAC,
 	//  source MAC, and payload length)
-	currentPacket->nBytesAvail = length + 14;
+	currentPacket->nBytesAvail = length + SircWire::Ethernet::headerLength;
 
 	//Set the destination and source addresses of the packet (0-5 and 6-11)
 	memcpy(currentPacket->Buffer, sourceMAC, 6);
 	memcpy(currentPacket->Buffer + 6, My_MACAddress, 6);
 
-	//The payload length field (bytes 12 and 13) does not include the length of the header
-#if defined(_MSC_VER) //other compilers might not
-    *(uint16_t*)(currentPacket->Buffer+12) = _byteswap_ushort(length);
-#else
-	currentPacket->Buffer[12] = (length) >> 8;
-	currentPacket->Buffer[13] = (length) % 256;
-#endif
+	//The payload length field does not include the length of the header
+	SircWire::Ethernet::Length::put(currentPacket->Buffer, length);
 
     return true;
 }
@@ -451,9 +555,9 @@ BOOL SRV_SIRC::checkResetPacket(uint8_t *sourceMessage){
 
 	uint16_t length;
 
-	length = sourceMessage[12] * 256 + sourceMessage[13];
+	length = SircWire::Ethernet::Length::get(sourceMessage);
 	//Is this reset command the right length?
-	if(length == 1){
+	if(length == SircWire::Reset::headerLength){
         //Send the appropriate read values back
         return sendResetAck(sourceMessage);
     }
@@ -464,11 +568,11 @@ BOOL SRV_SIRC::checkResetPacket(uint8_t *sourceMessage){
 BOOL SRV_SIRC::sendResetAck(uint8_t *sourceMessage){
 
 	//The packet will be 1 bytes long
-	if (!allocateAndFillPacket(sourceMessage + 6, 1))
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::Reset::headerLength))
         return false;
 
 	//Set the byte to 'm'
-	currentBuffer[0] = 'm';
+	SircWire::Reset::start(currentBuffer);
 
 	if(addTransmit(currentPacket))
         return true;
@@ -482,9 +586,9 @@ BOOL SRV_SIRC::checkRegWritePacket(uint8_t *sourceMessage, bool *execute){
 
 	uint16_t length;
 
-	length = sourceMessage[12] * 256 + sourceMessage[13];
+	length = SircWire::Ethernet::Length::get(sourceMessage);
 	//Is this reg write command the right length?
-	if(length == 6){
+	if(length == SircWire::RegWrite::headerLength){
         //Perform the write and send the appropriate ack values back
         return sendRegWriteAck(sourceMessage, execute);
     }
@@ -494,10 +598,10 @@ BOOL SRV_SIRC::checkRegWritePacket(uint8_t *sourceMessage, bool *execute){
 
 BOOL SRV_SIRC::sendRegWriteAck(uint8_t *sourceMessage, bool *execute){
 
-	uint8_t regAddress = sourceMessage[15];
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+	uint8_t regAddress = SircWire::RegWrite::Register::get(frame);
 
-	uint32_t value = ((uint32_t) sourceMessage[16] << 24) + ((uint32_t) sourceMessage[17] << 16)+
-		((uint32_t) sourceMessage[18] << 8) + ((uint32_t) sourceMessage[19]);
+	uint32_t value = SircWire::RegWrite::Value::get(frame);
 		
 	regFileP[regAddress] = value;
 
@@ -506,10 +610,10 @@ BOOL SRV_SIRC::sendRegWriteAck(uint8_t *sourceMessage, bool *execute){
 	}
 
 	//The packet will be 6 bytes long
-	if (!allocateAndFillPacket(sourceMessage + 6, 6))
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::RegWrite::headerLength))
         return false;
 
-	memcpy(currentBuffer, &(sourceMessage[14]), 6);
+	memcpy(currentBuffer, frame, SircWire::RegWrite::headerLength);
 
 	if(addTransmit(currentPacket))
         return true;
@@ -518,28 +622,291 @@ BOOL SRV_SIRC::sendRegWriteAck(uint8_t *sourceMessage, bool *execute){
     return false;
 }
 
+BOOL SRV_SIRC::checkNegotiatePacket(uint8_t *sourceMessage){
+	assert(sourceMessage != NULL);
+
+	uint16_t length;
+	uint32_t wanted;
+
+	length = SircWire::Ethernet::Length::get(sourceMessage);
+	//Is this negotiate command the wrong length?
+	if(length != SircWire::Negotiate::headerLength){
+		return sendErrorMessage(RECEIVE_ERROR_NEGOTIATE_LENGTH, sourceMessage);
+	}
+
+	wanted = SircWire::Negotiate::Mask::get(SircWire::Ethernet::payload(sourceMessage));
+
+	//We know all there is so far
+	compression = wanted & (SIRC_COMPRESS_WRITES | SIRC_COMPRESS_READS);
+
+	//The packet will be 5 bytes long
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::Negotiate::headerLength))
+        return false;
+
+	SircWire::Negotiate::start(currentBuffer);
+	SircWire::Negotiate::Mask::put(currentBuffer, compression);
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("Negotiate Ack not sent!\n"));
+    setLastError(INVALIDPARAMWRITETRANSMIT);
+    return false;
+}
+
+//Start or stop sending parity frames (sirc_fec.h), and tell the host which group size we use
+BOOL SRV_SIRC::checkFecSetupPacket(uint8_t *sourceMessage){
+	assert(sourceMessage != NULL);
+
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+
+	//Is this FEC setup command the wrong length?
+	if(!SircWire::FecSetup::valid(frame, SircWire::Ethernet::Length::get(sourceMessage))){
+		return sendErrorMessage(RECEIVE_ERROR_NEGOTIATE_LENGTH, sourceMessage);
+	}
+
+	//A single parity frame per group, however big the host wants it
+	fecGroup = min((uint32_t) SircWire::FecSetup::Group::get(frame), (uint32_t) SIRC_FEC_MAXGROUP);
+
+	//The packet will be 2 bytes long
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::FecSetup::headerLength))
+        return false;
+
+	SircWire::FecSetup::start(currentBuffer);
+	SircWire::FecSetup::Group::put(currentBuffer, (uint8_t) fecGroup);
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("FEC setup Ack not sent!\n"));
+    setLastError(INVALIDPARAMWRITETRANSMIT);
+    return false;
+}
+
+//Send the parity of the data frames since the last one, and start a new group
+BOOL SRV_SIRC::sendParity(uint8_t *destinationMAC){
+
+	//The packet will be as long as the longest frame of the group + 12 bytes
+	if (!allocateAndFillPacket(destinationMAC, SircWire::Parity::frameLength(fec->length)))
+        return false;
+
+	SircWire::Parity::start(currentBuffer);
+	SircWire::Parity::First::put(currentBuffer, fec->first);
+	SircWire::Parity::End::put(currentBuffer, fec->end);
+	SircWire::Parity::Count::put(currentBuffer, (uint8_t) fec->frames);
+	SircWire::Parity::LengthXor::put(currentBuffer, fec->lengthXor);
+
+	memcpy(SircWire::Parity::data(currentBuffer), fec->sum, fec->length);
+	sircFecStart(fec);
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("Parity not sent!\n"));
+    setLastError(INVALIDREADTRANSMIT);
+    return false;
+}
+
+//Turn receive credits on or off and tell the host ('c' + on), or take more of them
+// from the host ('c' + start + credits, not answered)
+BOOL SRV_SIRC::checkCreditPacket(uint8_t *sourceMessage){
+	assert(sourceMessage != NULL);
+
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+	uint16_t length = SircWire::Ethernet::Length::get(sourceMessage);
+
+	if(SircWire::Credit::valid(frame, length)){
+		if(SircWire::Credit::Start::get(frame))
+			creditsLeft = 0;
+		creditsLeft += SircWire::Credit::Credits::get(frame);
+		return true;
+	}
+
+	//Is this credit setup command the wrong length?
+	if(!SircWire::CreditSetup::valid(frame, length)){
+		return sendErrorMessage(RECEIVE_ERROR_NEGOTIATE_LENGTH, sourceMessage);
+	}
+
+	//Until the first read or write & run says otherwise, we can send nothing
+	creditFlow = (SircWire::CreditSetup::On::get(frame) != 0);
+	creditsLeft = 0;
+
+	//The packet will be 2 bytes long
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::CreditSetup::headerLength))
+        return false;
+
+	SircWire::CreditSetup::start(currentBuffer);
+	SircWire::CreditSetup::On::put(currentBuffer, creditFlow ? 1 : 0);
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("Credit setup Ack not sent!\n"));
+    setLastError(INVALIDPARAMWRITETRANSMIT);
+    return false;
+}
+
+//Use up a credit for the next response frame to hostMAC, waiting for the host to grant
+// more if we have none.  Whatever else comes in meanwhile is kept for processCommands.
+//Return true with the credit taken.  Return false if none came in time (lastError 0, the
+// host will ask for the rest) or with an error code if something went wrong.
+BOOL SRV_SIRC::takeCredit(uint8_t *hostMAC){
+	PACKET *        Packet;
+    DWORD expires = GetTickCount() + CREDITTIMEOUT;
+
+	setLastError(0);
+	while(creditsLeft == 0){
+        DWORD now = GetTickCount();
+        if ((int32_t)(expires - now) <= 0) {
+            PRINTF(("No credits from the host, response cut short\n"));
+            return false;
+        }
+
+        Packet = NULL;
+        (void) PacketDriver->GetNextCompletedPacket(&Packet, expires - now);
+        if (Packet == NULL)
+            continue;
+
+        if (Packet->Mode != PacketModeReceiving) {
+            assert((Packet->Mode == PacketModeTransmitting) ||
+                   (Packet->Mode == PacketModeTransmittingBuffer));
+            PacketDriver->FreePacket(Packet,false);
+            continue;
+        }
+
+        //Credits from our host are what we are waiting for, anything else waits its turn
+        uint8_t *message = Packet->Buffer;
+        uint8_t *frame = SircWire::Ethernet::payload(message);
+        if ((memcmp(message, My_MACAddress, 6) == 0) && (memcmp(message + 6, hostMAC, 6) == 0) &&
+            SircWire::Credit::valid(frame, SircWire::Ethernet::Length::get(message))) {
+            if (!checkCreditPacket(message) || !addReceive(Packet))
+                return false;
+            continue;
+        }
+        deferred.push_back(Packet);
+	}
+	creditsLeft--;
+	return true;
+}
+
+//Send the host the CRC32C (sirc_crc.h) of part of the input or output buffer
+BOOL SRV_SIRC::checkChecksumPacket(uint8_t *sourceMessage){
+	assert(sourceMessage != NULL);
+
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+	uint32_t startAddress, length, bufferBytes;
+	uint8_t *buffer;
+
+	//Is this checksum command the wrong length?
+	if(!SircWire::Checksum::valid(frame, SircWire::Ethernet::Length::get(sourceMessage))){
+		return sendErrorMessage(RECEIVE_ERROR_CHECKSUM, sourceMessage);
+	}
+
+	startAddress = SircWire::Checksum::Address::get(frame);
+	length = SircWire::Checksum::Length::get(frame);
+	if(SircWire::Checksum::Buffer::get(frame) == SircWire::Checksum::output){
+		buffer = outputBufP;
+		bufferBytes = maxOutputDataBytes;
+	}
+	else{
+		buffer = inputBufP;
+		bufferBytes = maxInputDataBytes;
+	}
+
+	//..or not within the buffer?
+	if((startAddress > bufferBytes) || (length > bufferBytes - startAddress)){
+		return sendErrorMessage(RECEIVE_ERROR_CHECKSUM, sourceMessage);
+	}
+
+	//The packet will be 14 bytes long, the command echoed + 4 bytes CRC
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::ChecksumResponse::headerLength))
+        return false;
+
+	memcpy(currentBuffer, frame, SircWire::Checksum::headerLength);
+	SircWire::ChecksumResponse::Crc::put(currentBuffer, sircCrc32c(0, buffer + startAddress, length));
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("Checksum not sent!\n"));
+    setLastError(INVALIDPARAMREADTRANSMIT);
+    return false;
+}
+
+//Join or leave a multicast group, and ack it.
+//A host that gets no ack (we are in too many groups) sends us everything by unicast.
+BOOL SRV_SIRC::checkJoinPacket(uint8_t *sourceMessage){
+	assert(sourceMessage != NULL);
+
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+	uint8_t *group = SircWire::Join::group(frame);
+
+	//Is this join command the wrong length, or not about a group address?
+	if(!SircWire::Join::valid(frame, SircWire::Ethernet::Length::get(sourceMessage)) || ((group[0] & 1) == 0)){
+		return sendErrorMessage(RECEIVE_ERROR_JOIN, sourceMessage);
+	}
+
+	if(SircWire::Join::Op::get(frame) == SircWire::Join::leave){
+		for(uint32_t g = 0; g < numGroups; g++){
+			if(memcmp(groups[g], group, 6) == 0){
+				memcpy(groups[g], groups[--numGroups], 6);
+				break;
+			}
+		}
+	}
+	else if(!inGroup(group)){
+		if(numGroups == SRV_SIRC_MAX_GROUPS){
+			PRINTF(("Too many groups!\n"));
+			return true;
+		}
+		//Group frames are not for our MAC, the NIC must let them in
+		if(!promiscuous && (numGroups == 0) &&
+		   (PacketDriver->SetFilter(NDIS_PACKET_TYPE_DIRECTED | NDIS_PACKET_TYPE_BROADCAST |
+		                            NDIS_PACKET_TYPE_ALL_MULTICAST) != S_OK)){
+			PRINTF(("Cannot see multicast frames!\n"));
+			return true;
+		}
+		memcpy(groups[numGroups++], group, 6);
+	}
+
+	//The packet will be 8 bytes long, an echo of the command
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::Join::headerLength))
+        return false;
+
+	memcpy(currentBuffer, frame, SircWire::Join::headerLength);
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("Join Ack not sent!\n"));
+    setLastError(INVALIDPARAMWRITETRANSMIT);
+    return false;
+}
+
+//Did we join the group at groupMAC?
+BOOL SRV_SIRC::inGroup(const uint8_t *groupMAC){
+	for(uint32_t g = 0; g < numGroups; g++){
+		if(memcmp(groups[g], groupMAC, 6) == 0)
+			return true;
+	}
+	return false;
+}
+
 BOOL SRV_SIRC::checkWritePacket(uint8_t *sourceMessage){
 	assert(sourceMessage != NULL);
 
 	uint16_t packetLength;
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
 
 	uint32_t startAddress;
 	uint32_t writeLength;
 
-	packetLength = ((uint16_t)sourceMessage[12] << 8) + ((uint16_t) sourceMessage[13]);
+	packetLength = SircWire::Ethernet::Length::get(sourceMessage);
 
 	//Is this write command the wrong length?
-	if(packetLength < 10){
+	if(!SircWire::Write::valid(frame, packetLength)){
 		return sendErrorMessage(RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
 	}
 
-	startAddress = ((uint32_t) sourceMessage[15] << 24) + ((uint32_t) sourceMessage[16] << 16)+
-		((uint32_t) sourceMessage[17] << 8) + ((uint32_t) sourceMessage[18]);
+	startAddress = SircWire::Write::Address::get(frame);
 
-	writeLength = ((uint32_t) sourceMessage[19] << 24) + ((uint32_t) sourceMessage[20] << 16)+
-		((uint32_t) sourceMessage[21] << 8) + ((uint32_t) sourceMessage[22]);
+	writeLength = SircWire::Write::Length::get(frame);
 
-	if(packetLength-9 != writeLength){
+	if(SircWire::Write::dataLength(packetLength) != writeLength){
 		return sendErrorMessage(RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
 	}
 
@@ -548,19 +915,56 @@ BOOL SRV_SIRC::checkWritePacket(uint8_t *sourceMessage){
 	}
 
 	//Perform the write
-	memcpy(inputBufP + startAddress, sourceMessage + 23, writeLength);
+	memcpy(inputBufP + startAddress, SircWire::Write::data(frame), writeLength);
 	
 	//Send the appropriate ack values back
 	return sendWriteAck(sourceMessage);
 }
 
+BOOL SRV_SIRC::checkCodedWritePacket(uint8_t *sourceMessage){
+	assert(sourceMessage != NULL);
+
+	uint16_t packetLength;
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
+
+	uint32_t startAddress;
+	uint32_t writeLength;
+
+	packetLength = SircWire::Ethernet::Length::get(sourceMessage);
+
+	//Is this write command the wrong length?
+	if(!SircWire::CodedWrite::valid(frame, packetLength)){
+		return sendErrorMessage(RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
+	}
+
+	startAddress = SircWire::CodedWrite::Address::get(frame);
+
+	//This is the length after expansion
+	writeLength = SircWire::CodedWrite::Length::get(frame);
+
+	if(startAddress + writeLength > maxInputDataBytes){
+		return sendErrorMessage(RECEIVE_ERROR_WRITE_LENGTH, sourceMessage);
+	}
+
+	if(sircRleDecodedLength(SircWire::CodedWrite::data(frame), SircWire::CodedWrite::dataLength(packetLength)) != writeLength){
+		return sendErrorMessage(RECEIVE_ERROR_CODED_WRITE, sourceMessage);
+	}
+
+	//Perform the write
+	sircRleDecode(SircWire::CodedWrite::data(frame), SircWire::CodedWrite::dataLength(packetLength),
+				  inputBufP + startAddress, writeLength);
+	
+	//Send the appropriate ack values back, same as for 'w'
+	return sendWriteAck(sourceMessage);
+}
+
 BOOL SRV_SIRC::sendWriteAck(uint8_t *sourceMessage){
 
-	//The packet will be 9 bytes long
-	if (!allocateAndFillPacket(sourceMessage + 6, 9))
+	//The packet will be 9 bytes long, an echo of the write header
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::Write::headerLength))
         return false;
 
-	memcpy(currentBuffer, &(sourceMessage[14]), 9);
+	memcpy(currentBuffer, SircWire::Ethernet::payload(sourceMessage), SircWire::Write::headerLength);
 
 	if(addTransmit(currentPacket))
         return true;
@@ -573,24 +977,23 @@ BOOL SRV_SIRC::checkWriteAndRunPacket(uint8_t *sourceMessage, bool *execute, boo
 	assert(sourceMessage != NULL);
 
 	uint16_t packetLength;
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
 
 	uint32_t startAddress;
 	uint32_t writeLength;
 
-	packetLength = ((uint16_t)sourceMessage[12] << 8) + ((uint16_t) sourceMessage[13]);
+	packetLength = SircWire::Ethernet::Length::get(sourceMessage);
 
 	//Is this write command the wrong length?
-	if(packetLength < 10){
+	if(!SircWire::WriteAndRun::valid(frame, packetLength)){
 		return sendErrorMessage(RECEIVE_ERROR_WRITE_AND_EXECUTE_LENGTH, sourceMessage);
 	}
 
-	startAddress = ((uint32_t) sourceMessage[15] << 24) + ((uint32_t) sourceMessage[16] << 16)+
-		((uint32_t) sourceMessage[17] << 8) + ((uint32_t) sourceMessage[18]);
+	startAddress = SircWire::WriteAndRun::Address::get(frame);
 
-	writeLength = ((uint32_t) sourceMessage[19] << 24) + ((uint32_t) sourceMessage[20] << 16)+
-		((uint32_t) sourceMessage[21] << 8) + ((uint32_t) sourceMessage[22]);
+	writeLength = SircWire::WriteAndRun::Length::get(frame);
 
-	if(packetLength-9 != writeLength){
+	if(SircWire::WriteAndRun::dataLength(packetLength) != writeLength){
 		return sendErrorMessage(RECEIVE_ERROR_WRITE_AND_EXECUTE_LENGTH, sourceMessage);
 	}
 
@@ -599,7 +1002,7 @@ BOOL SRV_SIRC::checkWriteAndRunPacket(uint8_t *sourceMessage, bool *execute, boo
 	}
 
 	//Perform the write
-	memcpy(inputBufP + startAddress, sourceMessage + 23, writeLength);
+	memcpy(inputBufP + startAddress, SircWire::WriteAndRun::data(frame), writeLength);
 	
 	//There is no ack right now, since the readback is the ack.
 	//However, we should save the MAC address of the host
@@ -617,9 +1020,9 @@ BOOL SRV_SIRC::checkRegReadPacket(uint8_t *sourceMessage){
 
 	uint16_t length;
 
-	length = sourceMessage[12] * 256 + sourceMessage[13];
+	length = SircWire::Ethernet::Length::get(sourceMessage);
 	//Is this reg read command the wrong length?
-	if(length == 2){
+	if(length == SircWire::RegRead::headerLength){
         //Perform the read and send the appropriate ack values back
         return sendRegReadAck(sourceMessage);
     }
@@ -630,20 +1033,14 @@ BOOL SRV_SIRC::checkRegReadPacket(uint8_t *sourceMessage){
 BOOL SRV_SIRC::sendRegReadAck(uint8_t *sourceMessage){
 
 	//The packet will be 6 bytes long
-	if (!allocateAndFillPacket(sourceMessage + 6, 6))
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::RegReadResponse::headerLength))
         return false;
 
-	memcpy(currentBuffer, &(sourceMessage[14]), 2);
+	uint8_t regAddress = SircWire::RegRead::Register::get(SircWire::Ethernet::payload(sourceMessage));
 
-	uint32_t regValue = regFileP[sourceMessage[15]];
-#if defined(_MSC_VER) //other compilers might not
-    *(uint32_t*)(currentBuffer+2) = _byteswap_ulong(regValue);
-#else
-	currentBuffer[2] = (regValue >> 24) % 256;
-	currentBuffer[3] = (regValue >> 16) % 256;
-	currentBuffer[4] = (regValue >> 8) % 256;
-	currentBuffer[5] = (regValue) % 256;
-#endif
+	SircWire::RegReadResponse::start(currentBuffer);
+	SircWire::RegReadResponse::Register::put(currentBuffer, regAddress);
+	SircWire::RegReadResponse::Value::put(currentBuffer, regFileP[regAddress]);
 
 	if(addTransmit(currentPacket))
         return true;
@@ -657,22 +1054,34 @@ BOOL SRV_SIRC::checkReadPacket(uint8_t *sourceMessage){
 	assert(sourceMessage != NULL);
 
 	uint16_t packetLength;
+	uint8_t *frame = SircWire::Ethernet::payload(sourceMessage);
 
 	uint32_t startAddress;
 	uint32_t readLength;
 
-	packetLength = ((uint16_t)sourceMessage[12] << 8) + ((uint16_t) sourceMessage[13]);
-
-	//Is this read command the wrong length?
-	if(packetLength != 9){
+	packetLength = SircWire::Ethernet::Length::get(sourceMessage);
+
+	//Is this read command ('r' or 'q', same layout) the wrong length?
+	static_assert((SircWire::Read::headerLength == SircWire::CodedRead::headerLength) &&
+	              (SircWire::Read::Address::offset == SircWire::CodedRead::Address::offset) &&
+	              (SircWire::Read::Length::offset == SircWire::CodedRead::Length::offset),
+	              "read requests must share a layout");
+	//With credits on it may say how many frames the host can take
+	static_assert((SircWire::Read::Address::offset == SircWire::CreditRead::Address::offset) &&
+	              (SircWire::Read::Length::offset == SircWire::CreditRead::Length::offset),
+	              "credit reads must extend read requests");
+	if(creditFlow && (packetLength == SircWire::CreditRead::headerLength)){
+		uint32_t credits = SircWire::CreditRead::Credits::get(frame);
+		if(credits != SircWire::CreditRead::keep)
+			creditsLeft = credits;
+	}
+	else if(packetLength != SircWire::Read::headerLength){
 		return sendErrorMessage(RECEIVE_ERROR_READ_LENGTH, sourceMessage);
 	}
 
-	startAddress = ((uint32_t) sourceMessage[15] << 24) + ((uint32_t) sourceMessage[16] << 16)+
-		((uint32_t) sourceMessage[17] << 8) + ((uint32_t) sourceMessage[18]);
+	startAddress = SircWire::Read::Address::get(frame);
 
-	readLength = ((uint32_t) sourceMessage[19] << 24) + ((uint32_t) sourceMessage[20] << 16)+
-		((uint32_t) sourceMessage[21] << 8) + ((uint32_t) sourceMessage[22]);
+	readLength = SircWire::Read::Length::get(frame);
 
 	if(startAddress + readLength > maxOutputDataBytes){
 		return sendErrorMessage(RECEIVE_ERROR_READ_LENGTH, sourceMessage);
@@ -684,21 +1093,52 @@ BOOL SRV_SIRC::checkReadPacket(uint8_t *sourceMessage){
 
 BOOL SRV_SIRC::sendReadAcks(uint8_t *sourceMessage, uint32_t startAddress, uint32_t readLength){
 	uint32_t currLength;
+	uint32_t codedLength = 0;
+	//Room for the parity frame header, if there is one
+	uint32_t overhead = fecGroup ? SIRC_FEC_OVERHEAD : 0;
+
+	if(fecGroup)
+		sircFecStart(fec);
 
 	while(readLength > 0){
-		if(readLength > MAXREADSIZE){
-			currLength = MAXREADSIZE;
+		if(readLength > MAXREADSIZE - overhead){
+			currLength = MAXREADSIZE - overhead;
 		}
 		else{
 			currLength = readLength;
 		}	
-	
-		if(!createReadPacketAndTransmit(sourceMessage, startAddress, currLength)){
+
+		//A 'q' read lets us code any frame where that carries more
+		if(SircWire::Ethernet::payload(sourceMessage)[0] == SircWire::CodedRead::command)
+			codedLength = sircRleEncodeFrame(outputBufP + startAddress, readLength, MAXREADSIZE - overhead,
+											 codeBuffer, MAXPACKETDATASIZE - SircWire::CodedReadResponse::headerLength - overhead, &currLength);
+
+		//Out of credits for good, the host will ask for the rest
+		if(creditFlow && !takeCredit(sourceMessage + 6)){
+			return (getLastError() == 0);
+		}
+
+		if(codedLength){
+			if(!createCodedReadPacketAndTransmit(sourceMessage, startAddress, currLength, codedLength)){
+				return false;
+			}
+		}
+		else if(!createReadPacketAndTransmit(sourceMessage, startAddress, currLength)){
 			return false;
 		}
 	
 		startAddress += currLength;
 		readLength -= currLength;
+
+		//A group is complete, or the response
+		if(fecGroup && ((fec->frames == fecGroup) || (readLength == 0))){
+			if(creditFlow && !takeCredit(sourceMessage + 6)){
+				return (getLastError() == 0);
+			}
+			if(!sendParity(sourceMessage + 6)){
+				return false;
+			}
+		}
 	}
 	return true;
 }
@@ -706,20 +1146,17 @@ BOOL SRV_SIRC::sendReadAcks(uint8_t *sourceMessage, uint32_t startAddress, uint3
 BOOL SRV_SIRC::createReadPacketAndTransmit(uint8_t *sourceMessage, uint32_t startAddress, uint32_t readLength){
 
 	//The packet will be readLength + 5 bytes long
-	if (!allocateAndFillPacket(sourceMessage + 6, readLength + 5))
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::ReadResponse::frameLength(readLength)))
         return false;
 
-	currentBuffer[0] = 'r';
-#if defined(_MSC_VER) //other compilers might not
-    *(uint32_t*)(currentBuffer+1) = _byteswap_ulong(startAddress);
-#else
-	currentBuffer[1] = (startAddress >> 24) % 256;
-	currentBuffer[2] = (startAddress >> 16) % 256;
-	currentBuffer[3] = (startAddress >> 8) % 256;
-	currentBuffer[4] = (startAddress) % 256;
-#endif
+	SircWire::ReadResponse::start(currentBuffer);
+	SircWire::ReadResponse::Address::put(currentBuffer, startAddress);
+
+	memcpy(SircWire::ReadResponse::data(currentBuffer), outputBufP + startAddress, readLength);
 
-	memcpy(currentBuffer + 5, outputBufP + startAddress, readLength);
+	//Into the parity of its group
+	if(fecGroup)
+		sircFecAdd(fec, currentBuffer, SircWire::Ethernet::Length::get(currentPacket->Buffer));
 
 	if(addTransmit(currentPacket))
         return true;
@@ -728,29 +1165,44 @@ BOOL SRV_SIRC::createReadPacketAndTransmit(uint8_t *sourceMessage, uint32_t star
     return false;
 }
 
+BOOL SRV_SIRC::createCodedReadPacketAndTransmit(uint8_t *sourceMessage, uint32_t startAddress, uint32_t readLength, uint32_t codedLength){
+
+	//The packet will be codedLength + 9 bytes long
+	if (!allocateAndFillPacket(sourceMessage + 6, SircWire::CodedReadResponse::frameLength(codedLength)))
+        return false;
+
+	SircWire::CodedReadResponse::start(currentBuffer);
+	SircWire::CodedReadResponse::Address::put(currentBuffer, startAddress);
+	SircWire::CodedReadResponse::Length::put(currentBuffer, readLength);
+
+	memcpy(SircWire::CodedReadResponse::data(currentBuffer), codeBuffer, codedLength);
+
+	//Into the parity of its group
+	if(fecGroup)
+		sircFecAdd(fec, currentBuffer, SircWire::Ethernet::Length::get(currentPacket->Buffer));
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("Coded read not sent!\n"));
+    setLastError(INVALIDREADTRANSMIT);
+    return false;
+}
+
 BOOL SRV_SIRC::createReadBackPacketAndTransmit(uint32_t startAddress, uint32_t readLength, uint32_t remainingLength){
 
 	//The packet will be readLength + 9 bytes long
-	if (!allocateAndFillPacket(WriteAndRunHostMACAddress, readLength + 9))
+	if (!allocateAndFillPacket(WriteAndRunHostMACAddress, SircWire::ReadBack::frameLength(readLength)))
         return false;
 
-	currentBuffer[0] = 'g';
-#if defined(_MSC_VER) //other compilers might not
-    *(uint32_t*)(currentBuffer+1) = _byteswap_ulong(startAddress);
-    *(uint32_t*)(currentBuffer+5) = _byteswap_ulong(remainingLength);
-#else
-	currentBuffer[1] = (startAddress >> 24) % 256;
-	currentBuffer[2] = (startAddress >> 16) % 256;
-	currentBuffer[3] = (startAddress >> 8) % 256;
-	currentBuffer[4] = (startAddress) % 256;
-
-	currentBuffer[5] = (remainingLength >> 24) % 256;
-	currentBuffer[6] = (remainingLength >> 16) % 256;
-	currentBuffer[7] = (remainingLength >> 8) % 256;
-	currentBuffer[8] = (remainingLength) % 256;
-#endif
+	SircWire::ReadBack::start(currentBuffer);
+	SircWire::ReadBack::Address::put(currentBuffer, startAddress);
+	SircWire::ReadBack::Remaining::put(currentBuffer, remainingLength);
+
+	memcpy(SircWire::ReadBack::data(currentBuffer), outputBufP + startAddress, readLength);
 
-	memcpy(currentBuffer + 9, outputBufP + startAddress, readLength);
+	//Into the parity of its group
+	if(fecGroup)
+		sircFecAdd(fec, currentBuffer, SircWire::Ethernet::Length::get(currentPacket->Buffer));
 
 	if(addTransmit(currentPacket))
         return true;
@@ -759,6 +1211,29 @@ BOOL SRV_SIRC::createReadBackPacketAndTransmit(uint32_t startAddress, uint32_t r
     return false;
 }
 
+BOOL SRV_SIRC::createCodedReadBackPacketAndTransmit(uint32_t startAddress, uint32_t readLength, uint32_t remainingLength, uint32_t codedLength){
+
+	//The packet will be codedLength + 13 bytes long
+	if (!allocateAndFillPacket(WriteAndRunHostMACAddress, SircWire::CodedReadBack::frameLength(codedLength)))
+        return false;
+
+	SircWire::CodedReadBack::start(currentBuffer);
+	SircWire::CodedReadBack::Address::put(currentBuffer, startAddress);
+	SircWire::CodedReadBack::Remaining::put(currentBuffer, remainingLength);
+	SircWire::CodedReadBack::Length::put(currentBuffer, readLength);
+
+	memcpy(SircWire::CodedReadBack::data(currentBuffer), codeBuffer, codedLength);
+
+	//Into the parity of its group
+	if(fecGroup)
+		sircFecAdd(fec, currentBuffer, SircWire::Ethernet::Length::get(currentPacket->Buffer));
+
+	if(addTransmit(currentPacket))
+        return true;
+    PRINTF(("Coded readback not sent!\n"));
+    setLastError(INVALIDREADTRANSMIT);
+    return false;
+}
 
 //void SRV_SIRC::printPacket(PACKET* packet){
 //	unsigned int i;
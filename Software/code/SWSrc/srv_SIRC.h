@@ -24,16 +24,24 @@
 
 #include "sirc_server.h"
 
+//Multicast groups (see eth_multicast.h) one server can be in
+#define SRV_SIRC_MAX_GROUPS 8
+
 class SRV_SIRC : public SIRC_SERVER{
 public:
 	//Constructor for the class
     // registerFile, inputBuffer, and outputBuffer can be null and will be allocated.
     // driverVersion and nicName are optional
+    // boardMAC: answer as the board with this MAC address rather than as the NIC.
+    //  The NIC is put in promiscuous mode, so one host can play many boards.
+    // Hosts can have us join multicast groups ('j'), we then take writes and register
+    //  writes sent to the group as well.
 	// Check error code with getLastError() to make certain constructor
 	// succeeded fully.
 	SIRC_DLL_LINKAGE __stdcall SRV_SIRC(uint32_t **registerFile, uint8_t **inputBuffer, uint8_t **outputBuffer,
              uint32_t driverVersion = 0,
-             wchar_t *nicName = NULL);
+             wchar_t *nicName = NULL,
+             const uint8_t *boardMAC = NULL);
 	//Destructor for the class
     __stdcall ~SRV_SIRC();
 
@@ -75,6 +83,25 @@ private:
     uint32_t maxInputDataBytes;
     uint32_t maxOutputDataBytes;
 
+    //Payload compression (sirc_codec.h), SIRC_COMPRESS_* the host negotiated
+    uint32_t compression;
+    uint8_t *codeBuffer;
+
+    //Forward error correction (sirc_fec.h), data frames per parity frame, 0 for none
+    uint32_t fecGroup;
+    SIRC_FEC_GROUP *fec;        //the group going out
+
+    //Receive credits (SircWire::Credit), response frames the host can still take
+    BOOL creditFlow;
+    uint32_t creditsLeft;
+    //What came in while we waited for credits, processed next
+    std::list <PACKET *> deferred;
+
+    //Multicast groups we joined
+    uint8_t groups[SRV_SIRC_MAX_GROUPS][6];
+    uint32_t numGroups;
+    BOOL promiscuous;           //sees every group already
+
 	inline BOOL addReceive(PACKET *Packet = NULL);
 	inline BOOL addTransmit(PACKET* Packet);
 
@@ -90,7 +117,20 @@ private:
 	BOOL checkRegWritePacket(uint8_t *sourceMessage, bool *execute);
 	BOOL sendRegWriteAck(uint8_t *sourceMessage, bool *execute);
 
+	BOOL checkNegotiatePacket(uint8_t *sourceMessage);
+	BOOL checkFecSetupPacket(uint8_t *sourceMessage);
+	BOOL sendParity(uint8_t *destinationMAC);
+
+	BOOL checkCreditPacket(uint8_t *sourceMessage);
+	BOOL takeCredit(uint8_t *hostMAC);
+
+	BOOL checkJoinPacket(uint8_t *sourceMessage);
+
+	BOOL checkChecksumPacket(uint8_t *sourceMessage);
+	BOOL inGroup(const uint8_t *groupMAC);
+
 	BOOL checkWritePacket(uint8_t *sourceMessage);
+	BOOL checkCodedWritePacket(uint8_t *sourceMessage);
 	BOOL sendWriteAck(uint8_t *sourceMessage);
 
 	BOOL checkWriteAndRunPacket(uint8_t *sourceMessage, bool *execute, bool *writeAndExecute);
@@ -101,8 +141,10 @@ private:
 	BOOL checkReadPacket(uint8_t *sourceMessage);
 	BOOL sendReadAcks(uint8_t *sourceMessage, uint32_t startAddress, uint32_t readLength);
 	BOOL createReadPacketAndTransmit(uint8_t *sourceMessage, uint32_t startAddress, uint32_t readLength);
+	BOOL createCodedReadPacketAndTransmit(uint8_t *sourceMessage, uint32_t startAddress, uint32_t readLength, uint32_t codedLength);
 
 	BOOL createReadBackPacketAndTransmit(uint32_t startAddress, uint32_t readLength, uint32_t remainingLength);
+	BOOL createCodedReadBackPacketAndTransmit(uint32_t startAddress, uint32_t readLength, uint32_t remainingLength, uint32_t codedLength);
 
 };
 
@@ -1,7 +1,20 @@
 // SW_Server.cpp : Defines the entry point for the console application.
 //
+// Usage: srv_main [-<driverVersion>] [-b<boards>] [-m<MAC>]
+// With -b the server plays that many boards on one NIC, one thread each, so a host can
+// be tested against several boards sharing its NIC (see eth_nic.h).  The boards get
+// consecutive MAC addresses starting at -m (default AA:AA:AA:AA:AA:AA).
+//
+// On Linux: srv_main -i<interface> [-m<MAC>] [-w<workers>] [-s] [-r<seconds>]
+// One server for any number of hosts, each with its own register file and buffers, or
+// with -s all sharing one set (see linux_srv_SIRC.h).  -w spreads the hosts over that
+// many threads, -r prints the traffic every that many seconds.
+//
 
-#include "include.h"
+#include "sirc_internal.h"
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
 
 using namespace std;
 
@@ -20,27 +33,35 @@ void error(string inErr){
 	exit(-1);
 }
 
-int main(int argc, char* argv[])
+#if defined(_WIN32)
+
+//Most boards one server plays
+#define MAXBOARDS 32
+
+//One board
+typedef struct {
+    uint32_t driverVersion;
+    uint8_t MAC[6];
+    BOOL ownMAC;            //as the board, not as the NIC
+} BOARD;
+
+DWORD WINAPI serveBoard(LPVOID lpParam)
 {
+    BOARD *board = (BOARD *) lpParam;
     SRV_SIRC *srv;
-	uint32_t *registerFile;
-	uint8_t *inputBuffer;
-	uint8_t *outputBuffer;
+	uint32_t *registerFile = NULL;
+	uint8_t *inputBuffer = NULL;
+	uint8_t *outputBuffer = NULL;
 	bool writeAndExecute;
 	uint32_t expectedOutputBytes;
 
-    /* args? */
-    uint32_t driverVersion = 0;
-    if ((argc > 1) && (argv[1][0] == '-'))
-        driverVersion = atoi(argv[1]+1);
-    //BUGBUG add NIC name option
-
 	std::ostringstream tempStream;
 
-    srv = new SRV_SIRC(&registerFile, &inputBuffer, &outputBuffer, driverVersion);
+    srv = new SRV_SIRC(&registerFile, &inputBuffer, &outputBuffer, board->driverVersion, NULL,
+                       board->ownMAC ? board->MAC : NULL);
 	//Make sure that the constructor didn't run into trouble
 	if(srv->getLastError() != 0){
-		tempStream << "Constructor failed with code " << srv->getLastError();
+		tempStream << "Constructor failed with code " << (int) srv->getLastError();
 		error(tempStream.str());
 	}
 
@@ -79,9 +100,164 @@ int main(int argc, char* argv[])
 
 
     delete srv;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    BOARD boards[MAXBOARDS];
+    HANDLE threads[MAXBOARDS];
+    uint32_t numBoards = 1;
+    BOARD first;
+
+	std::ostringstream tempStream;
+
+    /* args? */
+    //BUGBUG add NIC name option
+    first.driverVersion = 0;
+    first.ownMAC = false;
+    memset(first.MAC, 0xAA, 6);
+    for (int a = 1; a < argc; a++) {
+        if (argv[a][0] != '-')
+            continue;
+        if (argv[a][1] == 'b') {
+            numBoards = atoi(argv[a]+2);
+            first.ownMAC = true;
+        } else if (argv[a][1] == 'm') {
+            if (hexToFpgaId(argv[a]+2, first.MAC, sizeof(first.MAC)) != 6)
+                error("Invalid MAC address " + (string) (argv[a]+2));
+            first.ownMAC = true;
+        } else
+            first.driverVersion = atoi(argv[a]+1);
+    }
+    if ((numBoards < 1) || (numBoards > MAXBOARDS)) {
+        tempStream << "Can play 1 to " << MAXBOARDS << " boards";
+        error(tempStream.str());
+    }
+
+    //Just the one, as the NIC: the way it always was
+    if (!first.ownMAC) {
+        serveBoard(&first);
+        PrintZeLog();
+        return 0;
+    }
+
+    for (uint32_t b = 0; b < numBoards; b++) {
+        boards[b] = first;
+        boards[b].MAC[5] = (uint8_t) (first.MAC[5] + b);
+        threads[b] = CreateThread(NULL, 0, serveBoard, &boards[b], 0, NULL);
+        if (threads[b] == NULL)
+            error("Cannot start a board thread");
+    }
+    WaitForMultipleObjects(numBoards, threads, TRUE, INFINITE);
 
     PrintZeLog();
 
 	return 0;
 }
 
+#else //!_WIN32
+
+static LINUX_SRV_SIRC *server;
+static volatile BOOL serving;
+
+//The same circuit as serveBoard's, for one host
+static BOOL multiply(uint32_t *registerFile, uint8_t *inputBuffer, uint8_t *outputBuffer,
+                     uint32_t *outputLength, void *context)
+{
+    if (registerFile[1] != 0) {
+        uint32_t numOps = min(registerFile[0], (uint32_t) LINUX_SRV_OUTPUT_BYTES);
+        uint32_t multiplier = registerFile[1];
+        for (uint32_t i = 0; i < numOps; i++)
+            outputBuffer[i] = inputBuffer[i] * multiplier;
+        *outputLength = numOps;
+    }
+    return true;
+}
+
+static void stopServing(int signalNumber)
+{
+    server->stop();
+}
+
+//Traffic every report seconds, until the server stops
+static void *reportTraffic(void *lpParam)
+{
+    uint32_t report = *(uint32_t *) lpParam;
+    uint64_t framesIn, bytesIn, framesOut, bytesOut;
+    uint64_t lastFramesIn = 0, lastBytesIn = 0, lastFramesOut = 0, lastBytesOut = 0;
+    uint32_t sessions;
+
+    while (serving) {
+        Sleep(report * 1000);
+        server->getCounters(&framesIn, &bytesIn, &framesOut, &bytesOut, &sessions);
+        printf("%u hosts, in %.1f Mb/s %.0f frames/s, out %.1f Mb/s %.0f frames/s\n", sessions,
+               (bytesIn - lastBytesIn) * 8.0 / 1e6 / report, (double) (framesIn - lastFramesIn) / report,
+               (bytesOut - lastBytesOut) * 8.0 / 1e6 / report, (double) (framesOut - lastFramesOut) / report);
+        lastFramesIn = framesIn;
+        lastBytesIn = bytesIn;
+        lastFramesOut = framesOut;
+        lastBytesOut = bytesOut;
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    const char *interfaceName = NULL;
+    uint8_t MAC[6];
+    BOOL ownMAC = false;
+    uint32_t workers = 1;
+    BOOL shared = false;
+    uint32_t report = 0;
+    pthread_t reporter;
+
+	std::ostringstream tempStream;
+
+    for (int a = 1; a < argc; a++) {
+        if (argv[a][0] != '-')
+            continue;
+        if (argv[a][1] == 'i') {
+            interfaceName = argv[a]+2;
+        } else if (argv[a][1] == 'm') {
+            if (hexToFpgaId(argv[a]+2, MAC, sizeof(MAC)) != 6)
+                error("Invalid MAC address " + (string) (argv[a]+2));
+            ownMAC = true;
+        } else if (argv[a][1] == 'w') {
+            workers = atoi(argv[a]+2);
+        } else if (argv[a][1] == 's') {
+            shared = true;
+        } else if (argv[a][1] == 'r') {
+            report = atoi(argv[a]+2);
+        }
+    }
+    if (interfaceName == NULL)
+        error("Usage: srv_main -i<interface> [-m<MAC>] [-w<workers>] [-s] [-r<seconds>]");
+
+    server = new LINUX_SRV_SIRC(interfaceName, multiply, NULL, ownMAC ? MAC : NULL, workers, shared);
+	//Make sure that the constructor didn't run into trouble
+	if(server->getLastError() != 0){
+		tempStream << "Constructor failed with code " << (int) server->getLastError();
+		error(tempStream.str());
+	}
+
+    signal(SIGINT, stopServing);
+    signal(SIGTERM, stopServing);
+
+    serving = true;
+    if ((report != 0) && (pthread_create(&reporter, NULL, reportTraffic, &report) != 0))
+        report = 0;
+
+    if (!server->serve()) {
+        tempStream << "Serving failed with code " << (int) server->getLastError();
+        error(tempStream.str());
+    }
+
+    serving = false;
+    if (report != 0)
+        pthread_join(reporter, NULL);
+    delete server;
+	return 0;
+}
+
+#endif //!_WIN32
@@ -21,8 +21,25 @@
 // Test #5 - Test circuit: same as test #4, only show how to handle small output error of write/execute command
 // Test #6 - Write bandwidth test
 // Test #7 - Read bandwidth test
+// Test #8 - Control command latency, idle and during write/read bandwidth runs
+// Test #9 - Payload compression: bandwidth and CPU cost on PUF and multiply by 3 data
+// Test #10 - Frame header encode/decode cost, byte-at-a-time versus sirc_wire.h
+// Test #11 - Pipelined write, run, read loop: synchronous calls versus submit*
+// Test #12 - Write bandwidth with and without a dedicated I/O thread
+// Test #13 - Scattered writes and reads: one call per segment versus sendWriteV/sendReadV
+// Test #14 - Streaming: a large input through the circuit in chunks, from a callback and from memory
+// Test #15 - Several boards on one NIC: write bandwidth as boards are added (srv_main -b plays them)
+// Test #16 - Device group: the circuit sharded over all the boards, and as independent jobs
+// Test #17 - Multicast: the same block to every board, once per board and once to a group
+// Test #18 - Broker: per-call overhead of going through a SIRC_BROKER versus direct use
+// Test #19 - Remote: a board served over TCP by SIRC_PROXY, through REMOTE_SIRC versus direct use
+// Test #20 - Forward error correction: read bandwidth and frames recovered for several parity group sizes
+// Test #21 - Receive credits: read bandwidth on a small receive ring, with and without credits
+// Test #22 - Checksums: write, run, verify loop with full readback versus device-side CRC32C
+// Test #23 - PCIe DMA queue: write and read bandwidth as the number of segments in flight grows
 //----------------------------------------------------------------------------
 //
+#include <winsock2.h>
 #include <windows.h>
 #include <WinIoctl.h>
 #include <setupapi.h>
@@ -38,8 +55,18 @@
 #include <direct.h>
 
 #include "sirc.h"
+#include "sirc_wire.h"
 #include "sirc_error.h"
+#include "sirc_crc.h"
 #include "sirc_util.h"
+#include "sirc_stream.h"
+#include "eth_nic.h"
+#include "sirc_group.h"
+#include "eth_SIRC.h"
+#include "eth_multicast.h"
+#include "sirc_broker.h"
+#include "sirc_remote.h"
+#include "pcie2_SIRC.h"
 #include "log.h"
 #include "display.h"
 
@@ -57,6 +84,42 @@ using namespace System::Collections;
 //How many times would we like to send this message?
 #define BANDWIDTHTESTITER 2000
 
+//How many register reads do we time for each latency test?
+#define LATENCYTESTITER 200
+
+//Receives the credit test leaves posted, if the driver lets us choose
+#define CREDITTESTRECEIVES 12
+
+//How many times do we send each buffer in the compression test?
+#define COMPRESSIONTESTITER 500
+
+//How many frames do we encode and decode in the wire format test?
+#define WIRETESTITER 10000000
+
+//How many blocks go through the write, run, read pipeline test?
+#define PIPELINETESTITER 200
+
+//Segments per transfer, and transfers, in the scatter-gather test
+#define VECTORTESTSEGMENTS 32
+#define VECTORTESTITER 200
+
+//How many bytes go through the circuit in the streaming test?
+#define STREAMTESTBYTES 16*1024*1024
+
+//Up to how many boards share the NIC in the multi-board test?
+//They are at the MAC addresses after the one given, in the last byte.
+#define MULTIBOARDTESTBOARDS 4
+
+//Jobs handed out to the boards in the device group test
+#define GROUPTESTJOBS 64
+
+//What the broker test serves the first board as
+#define BROKERTESTNAME L"sirc_example"
+
+//Bytes per transfer, and transfers per queue depth, in the PCIe DMA queue test
+#define DMATESTBYTES 32*1024*1024
+#define DMATESTITER 20
+
 void error(string inErr){
 	cerr << "Error:" << endl;
 	cerr << "\t" << inErr << endl;
@@ -65,6 +128,267 @@ void error(string inErr){
 	exit(-1);
 }
 
+//The bulk traffic that runs under the latency test
+typedef struct {
+    SIRC *sirc;
+    uint8_t *buffer;
+    BOOL doReads;
+    volatile BOOL stop;
+    volatile BOOL failed;
+} BULKLOAD;
+
+DWORD WINAPI bulkLoadThreadProc(LPVOID lpParam){
+    BULKLOAD *load = (BULKLOAD *) lpParam;
+
+    while (!load->stop){
+        BOOL ok = (load->doReads) ?
+            load->sirc->sendRead(0, BANDWIDTHTESTSIZE, load->buffer) :
+            load->sirc->sendWrite(0, BANDWIDTHTESTSIZE, load->buffer);
+        if (!ok){
+            load->failed = true;
+            break;
+        }
+    }
+    return 0;
+}
+
+//One board's share of the multi-board test: BANDWIDTHTESTITER writes
+typedef struct {
+    SIRC *sirc;
+    uint8_t *buffer;
+    BOOL failed;
+} BOARDLOAD;
+
+DWORD WINAPI boardLoadThreadProc(LPVOID lpParam){
+    BOARDLOAD *load = (BOARDLOAD *) lpParam;
+
+    load->failed = false;
+    for (int i = 0; i < BANDWIDTHTESTITER; i++){
+        if (!load->sirc->sendWrite(0, BANDWIDTHTESTSIZE, load->buffer)){
+            load->failed = true;
+            break;
+        }
+    }
+    return 0;
+}
+
+//Serves the broker test's board until stopped
+DWORD WINAPI brokerThreadProc(LPVOID lpParam){
+    ((SIRC_BROKER *) lpParam)->run();
+    return 0;
+}
+
+//Serves the remote test's board until stopped
+DWORD WINAPI proxyThreadProc(LPVOID lpParam){
+    ((SIRC_PROXY *) lpParam)->run();
+    return 0;
+}
+
+//Time BANDWIDTHTESTITER writes of BANDWIDTHTESTSIZE bytes, return Mbps
+double measureWriteBandwidth(SIRC *SIRC_P, uint8_t *buffer){
+    DWORD start, end;
+    std::ostringstream tempStream;
+
+    start = GetTickCount();
+    for (int i = 0; i < BANDWIDTHTESTITER; i++){
+        if (!SIRC_P->sendWrite(0, BANDWIDTHTESTSIZE, buffer)){
+            tempStream << "Write failed with code " << (int) SIRC_P->getLastError();
+            error(tempStream.str());
+        }
+    }
+    end = GetTickCount();
+    return ((double)8 * (double) BANDWIDTHTESTSIZE * (double)BANDWIDTHTESTITER) /
+        ((double)(end - start) * 1000.0);
+}
+
+//Time BANDWIDTHTESTITER reads of BANDWIDTHTESTSIZE bytes, return Mbps
+double measureReadBandwidth(SIRC *SIRC_P, uint8_t *buffer){
+    DWORD start, end;
+    std::ostringstream tempStream;
+
+    start = GetTickCount();
+    for (int i = 0; i < BANDWIDTHTESTITER; i++){
+        if (!SIRC_P->sendRead(0, BANDWIDTHTESTSIZE, buffer)){
+            tempStream << "Read failed with code " << (int) SIRC_P->getLastError();
+            error(tempStream.str());
+        }
+    }
+    end = GetTickCount();
+    return ((double)8 * (double) BANDWIDTHTESTSIZE * (double)BANDWIDTHTESTITER) /
+        ((double)(end - start) * 1000.0);
+}
+
+//Time LATENCYTESTITER register reads, return the average and worst case in usec
+void measureControlLatency(SIRC *SIRC_P, double *average, double *worst){
+    LARGE_INTEGER frequency, before, after;
+    uint32_t value;
+    double total = 0.0, us;
+    std::ostringstream tempStream;
+
+    QueryPerformanceFrequency(&frequency);
+    *worst = 0.0;
+    for (int i = 0; i < LATENCYTESTITER; i++){
+        QueryPerformanceCounter(&before);
+        if (!SIRC_P->sendParamRegisterRead(1, &value)){
+            tempStream << "Parameter register read failed with code " << (int) SIRC_P->getLastError();
+            error(tempStream.str());
+        }
+        QueryPerformanceCounter(&after);
+        us = ((double)(after.QuadPart - before.QuadPart) * 1000000.0) / (double)frequency.QuadPart;
+        total += us;
+        if (*worst < us)
+            *worst = us;
+    }
+    *average = total / LATENCYTESTITER;
+}
+
+//User plus kernel time this process has used so far, in msec
+double processCpuMsec(void){
+    FILETIME creation, exit, kernel, user;
+    ULARGE_INTEGER k, u;
+
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) / 10000.0;
+}
+
+//Input for the streaming test.  The source and the sink run the same generator,
+//so the sink can check the results without keeping the input around.
+typedef struct {
+    uint32_t sourceSeed;
+    uint32_t sinkSeed;
+    uint32_t sourceLeft;
+    uint32_t mismatches;
+} STREAMTEST;
+
+uint8_t streamTestByte(uint32_t *seed){
+    *seed = *seed * 1103515245 + 12345;
+    return (uint8_t)(*seed >> 16);
+}
+
+uint32_t __stdcall streamTestSource(uint8_t *buffer, uint32_t maxLength, void *context){
+    STREAMTEST *test = (STREAMTEST *) context;
+    uint32_t length = min(maxLength, test->sourceLeft);
+
+    for (uint32_t i = 0; i < length; i++)
+        buffer[i] = streamTestByte(&test->sourceSeed);
+    test->sourceLeft -= length;
+    return length;
+}
+
+BOOL __stdcall streamTestSink(const uint8_t *data, uint32_t length, void *context){
+    STREAMTEST *test = (STREAMTEST *) context;
+
+    for (uint32_t i = 0; i < length; i++)
+        if ((uint8_t)(streamTestByte(&test->sinkSeed) * 3) != data[i])
+            test->mismatches++;
+    return true;
+}
+
+//Data for the compression test
+//	0 - PUF challenges: 8 top and 8 bottom line configuration bytes in each 128-byte slot, the rest zero
+//	1 - multiply by 3: random bytes, as in test #3
+void fillWorkload(uint8_t *buffer, uint32_t length, int workload){
+    for (uint32_t i = 0; i < length; i++){
+        if (workload == 0)
+            buffer[i] = ((i % 128) < 16) ? (uint8_t)(rand() % 256) : 0;
+        else
+            buffer[i] = rand() % 256;
+    }
+}
+
+//Frame headers the way the drivers used to build and parse them, a byte at a time.
+//A 'w' request going out and an 'r' response coming back, Ethernet length included.
+void legacyEncodeWrite(uint8_t *message, uint32_t address, uint32_t length){
+    message[12] = (uint8_t)((length + 9) >> 8);
+    message[13] = (uint8_t)((length + 9) % 256);
+    message[14] = 'w';
+    for(int i = 3; i >= 0; i--){
+        message[15 + i] = address % 256;
+        message[19 + i] = length % 256;
+        address = address >> 8;
+        length = length >> 8;
+    }
+}
+
+BOOL legacyDecodeReadResponse(uint8_t *message, uint32_t *address, uint32_t *length){
+    uint32_t dataLength = message[12];
+    dataLength = (dataLength << 8) + message[13];
+    if(dataLength < 6 || message[14] != 'r')
+        return false;
+    *address = 0;
+    for(int i = 0; i < 4; i++){
+        *address = *address << 8;
+        *address += message[15 + i];
+    }
+    *length = dataLength - 5;
+    return true;
+}
+
+//The same two, with the generated accessors
+void wireEncodeWrite(uint8_t *message, uint32_t address, uint32_t length){
+    uint8_t *frame = SircWire::Ethernet::payload(message);
+    SircWire::Ethernet::Length::put(message, (uint16_t)SircWire::Write::frameLength(length));
+    SircWire::Write::start(frame);
+    SircWire::Write::Address::put(frame, address);
+    SircWire::Write::Length::put(frame, length);
+}
+
+BOOL wireDecodeReadResponse(uint8_t *message, uint32_t *address, uint32_t *length){
+    uint8_t *frame = SircWire::Ethernet::payload(message);
+    uint32_t dataLength = SircWire::Ethernet::Length::get(message);
+    if(!SircWire::ReadResponse::valid(frame, dataLength))
+        return false;
+    *address = SircWire::ReadResponse::Address::get(frame);
+    *length = SircWire::ReadResponse::dataLength(dataLength);
+    return true;
+}
+
+//Time WIRETESTITER encodes and decodes, return nsec per frame for each
+void measureWireCodec(void (*encode)(uint8_t *, uint32_t, uint32_t),
+                      BOOL (*decode)(uint8_t *, uint32_t *, uint32_t *),
+                      double *encodeNs, double *decodeNs){
+    LARGE_INTEGER frequency, before, after;
+    uint8_t message[64];
+    uint32_t address, length;
+    volatile uint32_t sink = 0;
+
+    QueryPerformanceFrequency(&frequency);
+    memset(message, 0, sizeof(message));
+
+    QueryPerformanceCounter(&before);
+    for (uint32_t i = 0; i < WIRETESTITER; i++){
+        encode(message, i, i & 0x3FF);
+        sink += message[20];
+    }
+    QueryPerformanceCounter(&after);
+    *encodeNs = ((double)(after.QuadPart - before.QuadPart) * 1e9) / ((double)frequency.QuadPart * WIRETESTITER);
+
+    //A read response for the decoder to chew on
+    message[12] = 0;
+    message[13] = 5 + 100;
+    message[14] = 'r';
+    QueryPerformanceCounter(&before);
+    for (uint32_t i = 0; i < WIRETESTITER; i++){
+        message[18] = (uint8_t)i;
+        if (decode(message, &address, &length))
+            sink += address + length;
+    }
+    QueryPerformanceCounter(&after);
+    *decodeNs = ((double)(after.QuadPart - before.QuadPart) * 1e9) / ((double)frequency.QuadPart * WIRETESTITER);
+}
+
+//Request callback for the pipeline test, remembers the first error
+void __stdcall recordFirstError(SIRC_REQUEST *request, void *context){
+    volatile int8_t *firstError = (volatile int8_t *) context;
+
+    if (request->getError() && (*firstError == 0))
+        *firstError = request->getError();
+}
+
 DWORD dwDisplayThreadID = 0;
 typedef char strbuf[64];
 strbuf lines[4];
@@ -483,7 +807,1083 @@ int main(int argc, char* argv[]){
 	cout << "\tBest write bandwidth = " << bestWrite << " Mbps" << endl;
 	cout << "\tBest read bandwidth = " << bestRead << " Mbps" << endl << endl;
 
+	//**** Time register reads while the bandwidth tests run in another thread
+	//Control commands should not queue up behind the bulk traffic.
+	cout << "****Beginning test #8 - control command latency" << endl;
+    LogIt("main::****Testing control latency");
+    LogIt(LOGIT_TIME_MARKER);
+    double avgLatency, worstLatency;
+
+    measureControlLatency(SIRC_P, &avgLatency, &worstLatency);
+    cout << "\tIdle: average " << avgLatency << " us, worst " << worstLatency << " us" << endl;
+
+    for (int n = 0; n < 2; n++){
+        BULKLOAD load;
+        load.sirc    = SIRC_P;
+        load.buffer  = (n == 0) ? inputValues : outputValues;
+        load.doReads = (n != 0);
+        load.stop    = false;
+        load.failed  = false;
+
+        HANDLE hLoadThread = CreateThread(NULL, 0, &bulkLoadThreadProc, (LPVOID) &load, 0, NULL);
+        if(!hLoadThread){
+            tempStream << "Could not create bulk load thread!";
+            error(tempStream.str());
+        }
+        //Let the stream get going
+        Sleep(100);
+
+        measureControlLatency(SIRC_P, &avgLatency, &worstLatency);
+
+        load.stop = true;
+        WaitForSingleObject(hLoadThread, INFINITE);
+        CloseHandle(hLoadThread);
+        if (load.failed){
+            tempStream << "Bulk transfer under latency test failed with code " << (int) SIRC_P->getLastError();
+            error(tempStream.str());
+        }
+        cout << "\tDuring " << ((n == 0) ? "writes" : "reads") << ": average " << avgLatency 
+             << " us, worst " << worstLatency << " us" << endl;
+    }
+	cout << "Passed test #8" << endl << endl;
+
+	//**** Send and read back the same data with and without payload compression.
+	//Effective bandwidth counts the uncompressed bytes, CPU cost is ours per MB moved.
+	cout << "****Beginning test #9 - payload compression" << endl;
+    LogIt("main::****Testing payload compression");
+    LogIt(LOGIT_TIME_MARKER);
+    const char *workloadNames[2] = {"PUF challenges", "multiply by 3"};
+    double megabytes = ((double) BANDWIDTHTESTSIZE * (double)COMPRESSIONTESTITER) / (1024.0 * 1024.0);
+    double cpuStart, writeCpu, readCpu, writeBw, readBw;
+
+    for (int w = 0; w < 2; w++){
+        fillWorkload(inputValues, BANDWIDTHTESTSIZE, w);
+
+        //Have the circuit compute what the reads will bring back
+        if(!SIRC_P->sendWrite(0, BANDWIDTHTESTSIZE, inputValues) ||
+           !SIRC_P->sendParamRegisterWrite(0, BANDWIDTHTESTSIZE) ||
+           !SIRC_P->sendParamRegisterWrite(1, 3) ||
+           !SIRC_P->sendRun() ||
+           !SIRC_P->waitDone(4000)){
+            tempStream << "Compression test setup failed with code " << (int) SIRC_P->getLastError();
+            error(tempStream.str());
+        }
+
+        for (int c = 0; c < 2; c++){
+            params.compression = (c == 0) ? 0 : (SIRC_COMPRESS_WRITES | SIRC_COMPRESS_READS);
+            if (!SIRC_P->setParameters(&params,sizeof(params)) ||
+                !SIRC_P->getParameters(&params,sizeof(params))){
+                tempStream << "Cannot set compression on SIRC interface, code " << (int) SIRC_P->getLastError();
+                error(tempStream.str());
+            }
+
+            cpuStart = processCpuMsec();
+            start = GetTickCount();
+            for(i = 0; i < COMPRESSIONTESTITER; i++){
+                if(!SIRC_P->sendWrite(0, BANDWIDTHTESTSIZE, inputValues)){
+                    tempStream << "Write to FPGA failed with code " << (int) SIRC_P->getLastError();
+                    error(tempStream.str());
+                }
+            }
+            end = GetTickCount();
+            writeCpu = processCpuMsec() - cpuStart;
+            writeBw = (8.0 * megabytes * 1024.0 * 1024.0) / ((double)max(end - start, 1) * 1000);
+
+            cpuStart = processCpuMsec();
+            start = GetTickCount();
+            for(i = 0; i < COMPRESSIONTESTITER; i++){
+                if(!SIRC_P->sendRead(0, BANDWIDTHTESTSIZE, outputValues)){
+                    tempStream << "Read from FPGA failed with code " << (int) SIRC_P->getLastError();
+                    error(tempStream.str());
+                }
+            }
+            end = GetTickCount();
+            readCpu = processCpuMsec() - cpuStart;
+            readBw = (8.0 * megabytes * 1024.0 * 1024.0) / ((double)max(end - start, 1) * 1000);
+
+            for(i = 0; i < BANDWIDTHTESTSIZE; i++){
+                if((inputValues[i] * 3) % 256 != outputValues[i]){
+                    tempStream << "Output #" << (int) i << " does not match expected value";
+                    error(tempStream.str());
+                }
+            }
+
+            cout << "\t" << workloadNames[w] << ", compression " << ((c == 0) ? "off" : "on")
+                 << " (agreed 0x" << hex << params.compression << dec << ")" << endl;
+            cout << "\t\tWrite bandwidth = " << writeBw << " Mbps, CPU " << (writeCpu / megabytes) << " ms/MB" << endl;
+            cout << "\t\tRead bandwidth = " << readBw << " Mbps, CPU " << (readCpu / megabytes) << " ms/MB" << endl;
+        }
+    }
+
+    //Back to plain frames
+    params.compression = 0;
+    if (!SIRC_P->setParameters(&params,sizeof(params))){
+		tempStream << "Cannot setParameters on SIRC interface, code " << (int) SIRC_P->getLastError();
+		error(tempStream.str());
+    }
+	cout << "Passed test #9" << endl << endl;
+
+	//**** Encode 'w' headers and decode 'r' headers, the old way and with sirc_wire.h.
+	//Host only, this does not talk to the FPGA.
+	cout << "****Beginning test #10 - frame header encode/decode" << endl;
+    LogIt("main::****Testing frame header codec");
+    double legacyEncode, legacyDecode, wireEncode, wireDecode;
+    uint8_t legacyFrame[64], wireFrame[64];
+    uint32_t legacyAddress, legacyLength, wireAddress, wireLength;
+
+    //Both must produce and understand the same bytes
+    memset(legacyFrame, 0, sizeof(legacyFrame));
+    memset(wireFrame, 0, sizeof(wireFrame));
+    legacyEncodeWrite(legacyFrame, 0x12345678, 1000);
+    wireEncodeWrite(wireFrame, 0x12345678, 1000);
+    if (memcmp(legacyFrame, wireFrame, sizeof(legacyFrame)) != 0)
+        error("sirc_wire.h encodes a write header differently");
+    SircWire::Ethernet::Length::put(wireFrame, (uint16_t)SircWire::ReadResponse::frameLength(1000));
+    SircWire::ReadResponse::start(SircWire::Ethernet::payload(wireFrame));
+    if (!legacyDecodeReadResponse(wireFrame, &legacyAddress, &legacyLength) ||
+        !wireDecodeReadResponse(wireFrame, &wireAddress, &wireLength) ||
+        (legacyAddress != wireAddress) || (legacyLength != wireLength))
+        error("sirc_wire.h decodes a read response differently");
+
+    measureWireCodec(legacyEncodeWrite, legacyDecodeReadResponse, &legacyEncode, &legacyDecode);
+    measureWireCodec(wireEncodeWrite, wireDecodeReadResponse, &wireEncode, &wireDecode);
+    cout << "\tByte at a time: encode " << legacyEncode << " ns/frame, decode " << legacyDecode << " ns/frame" << endl;
+    cout << "\tsirc_wire.h:    encode " << wireEncode << " ns/frame, decode " << wireDecode << " ns/frame" << endl;
+	cout << "Passed test #10" << endl << endl;
+
+	//**** Push blocks through write, run, read.  First with one synchronous call after
+	//the other, then with the submit* methods.  There the next block is generated and
+	//queued while the previous one is still on the wire, with two sets of buffers.
+	cout << "****Beginning test #11 - pipelined write, run, read" << endl;
+    LogIt("main::****Testing pipelined write, run, read");
+    LogIt(LOGIT_TIME_MARKER);
+    uint8_t *pipeIn[2], *pipeOut[2];
+    SIRC_REQUEST *pipeRead[2] = {NULL, NULL};
+    SIRC_REQUEST *pipeStep[5];
+    volatile int8_t pipeError = 0;
+    DWORD syncTime, asyncTime;
+
+    for (int b = 0; b < 2; b++){
+        pipeIn[b] = (uint8_t *) malloc(sizeof(uint8_t) * BANDWIDTHTESTSIZE);
+        pipeOut[b] = (uint8_t *) malloc(sizeof(uint8_t) * BANDWIDTHTESTSIZE);
+        if (!pipeIn[b] || !pipeOut[b])
+            error("Unable to allocate pipeline buffers");
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < PIPELINETESTITER; i++){
+        fillWorkload(pipeIn[0], BANDWIDTHTESTSIZE, 1);
+        if(!SIRC_P->sendWrite(0, BANDWIDTHTESTSIZE, pipeIn[0]) ||
+           !SIRC_P->sendParamRegisterWrite(0, BANDWIDTHTESTSIZE) ||
+           !SIRC_P->sendParamRegisterWrite(1, 3) ||
+           !SIRC_P->sendRun() ||
+           !SIRC_P->waitDone(4000) ||
+           !SIRC_P->sendRead(0, BANDWIDTHTESTSIZE, pipeOut[0])){
+            tempStream << "Synchronous pipeline failed with code " << (int) SIRC_P->getLastError();
+            error(tempStream.str());
+        }
+        for(tempInt = 0; tempInt < BANDWIDTHTESTSIZE; tempInt++){
+            if((pipeIn[0][tempInt] * 3) % 256 != pipeOut[0][tempInt]){
+                tempStream << "Synchronous pipeline output #" << (int) tempInt << " does not match expected value";
+                error(tempStream.str());
+            }
+        }
+    }
+    end = GetTickCount();
+    syncTime = max(end - start, (DWORD)1);
+
+    start = GetTickCount();
+    for (i = 0; i < PIPELINETESTITER + 2; i++){
+        int b = i % 2;
+
+        //Block i-2 used these buffers.  Once its read is back it is all done.
+        if (pipeRead[b]){
+            pipeRead[b]->wait(INFINITE);
+            pipeRead[b]->release();
+            pipeRead[b] = NULL;
+            if (pipeError){
+                tempStream << "Asynchronous pipeline failed with code " << (int) pipeError;
+                error(tempStream.str());
+            }
+            for(tempInt = 0; tempInt < BANDWIDTHTESTSIZE; tempInt++){
+                if((pipeIn[b][tempInt] * 3) % 256 != pipeOut[b][tempInt]){
+                    tempStream << "Asynchronous pipeline output #" << (int) tempInt << " does not match expected value";
+                    error(tempStream.str());
+                }
+            }
+        }
+        if (i >= PIPELINETESTITER)
+            continue;
+
+        //This overlaps with block i-1 on the wire
+        fillWorkload(pipeIn[b], BANDWIDTHTESTSIZE, 1);
+
+        pipeStep[0] = SIRC_P->submitWrite(0, BANDWIDTHTESTSIZE, pipeIn[b], recordFirstError, (void *) &pipeError);
+        pipeStep[1] = SIRC_P->submitParamRegisterWrite(0, BANDWIDTHTESTSIZE, recordFirstError, (void *) &pipeError);
+        pipeStep[2] = SIRC_P->submitParamRegisterWrite(1, 3, recordFirstError, (void *) &pipeError);
+        pipeStep[3] = SIRC_P->submitRun(recordFirstError, (void *) &pipeError);
+        pipeStep[4] = SIRC_P->submitWaitDone(4000, recordFirstError, (void *) &pipeError);
+        pipeRead[b] = SIRC_P->submitRead(0, BANDWIDTHTESTSIZE, pipeOut[b], recordFirstError, (void *) &pipeError);
+        for (int n = 0; n < 5; n++){
+            if (!pipeStep[n])
+                error("Unable to submit pipeline request");
+            //The callback is all we need from these
+            pipeStep[n]->release();
+        }
+        if (!pipeRead[b])
+            error("Unable to submit pipeline read");
+    }
+    end = GetTickCount();
+    asyncTime = max(end - start, (DWORD)1);
+
+    cout << "\tSynchronous: " << syncTime << " ms, " << ((double)PIPELINETESTITER * 1000.0 / syncTime) << " blocks/s" << endl;
+    cout << "\tsubmit*:     " << asyncTime << " ms, " << ((double)PIPELINETESTITER * 1000.0 / asyncTime) << " blocks/s" << endl;
+    for (int b = 0; b < 2; b++){
+        free(pipeIn[b]);
+        free(pipeOut[b]);
+    }
+	cout << "Passed test #11" << endl << endl;
+
+	//**** Same write loop as test #6, once with the calling thread driving the wire and
+	//once with a dedicated I/O thread on the last CPU.  Backends without one ignore it.
+	cout << "****Beginning test #12 - write bandwidth, dedicated I/O thread" << endl;
+    LogIt("main::****Testing dedicated I/O thread");
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    for (uint32_t useThread = 0; useThread < 2; useThread++){
+        params.ioThread = useThread ? sysInfo.dwNumberOfProcessors : 0;
+        if (!SIRC_P->setParameters(&params,sizeof(params))){
+            tempStream << "Cannot setParameters on SIRC interface, code " << (int) SIRC_P->getLastError();
+            error(tempStream.str());
+        }
+        LogIt(LOGIT_TIME_MARKER);
+        start = GetTickCount();
+        for(i = 0; i < BANDWIDTHTESTITER; i++){
+            if(!SIRC_P->sendWrite(0, BANDWIDTHTESTSIZE, inputValues)){
+                tempStream << "Write to FPGA failed with code " << (int) SIRC_P->getLastError();
+                error(tempStream.str());
+            }
+        }
+        end = GetTickCount();
+        bw = ((double)8 * (double) BANDWIDTHTESTSIZE * (double)BANDWIDTHTESTITER) / 
+            (((double)max(end - start, (DWORD)1)) * 1000);
+        cout << (useThread ? "	I/O thread:     " : "	Calling thread: ") << (end - start) << " ms, " << bw << " Mbps" << endl;
+    }
+    params.ioThread = 0;
+    if (!SIRC_P->setParameters(&params,sizeof(params))){
+        tempStream << "Cannot setParameters on SIRC interface, code " << (int) SIRC_P->getLastError();
+        error(tempStream.str());
+    }
+	cout << "Passed test #12" << endl << endl;
+
+	//**** Write the input buffer as many small segments, each in a buffer of its own and
+	//in reverse order, run the circuit, and read the results back the same way.  First
+	//with a sendWrite/sendRead per segment, then with one sendWriteV and one sendReadV.
+	cout << "****Beginning test #13 - scattered writes and reads" << endl;
+    LogIt("main::****Testing scatter-gather");
+    SIRC_SEGMENT vectorIn[VECTORTESTSEGMENTS], vectorOut[VECTORTESTSEGMENTS];
+    const uint32_t vectorSlice = BANDWIDTHTESTSIZE / VECTORTESTSEGMENTS;
+    DWORD vectorTime[2];
+
+    for (int s = 0; s < VECTORTESTSEGMENTS; s++){
+        vectorIn[s].startAddress = (VECTORTESTSEGMENTS - 1 - s) * vectorSlice;
+        vectorIn[s].length = vectorSlice;
+        vectorIn[s].buffer = (uint8_t *) malloc(vectorSlice);
+        vectorOut[s] = vectorIn[s];
+        vectorOut[s].buffer = (uint8_t *) malloc(vectorSlice);
+        if (!vectorIn[s].buffer || !vectorOut[s].buffer)
+            error("Unable to allocate segment buffers");
+    }
+
+    for (int vectored = 0; vectored < 2; vectored++){
+        LogIt(LOGIT_TIME_MARKER);
+        start = GetTickCount();
+        for (i = 0; i < VECTORTESTITER; i++){
+            for (int s = 0; s < VECTORTESTSEGMENTS; s++)
+                fillWorkload(vectorIn[s].buffer, vectorSlice, 1);
+
+            BOOL ok = true;
+            if (vectored)
+                ok = SIRC_P->sendWriteV(vectorIn, VECTORTESTSEGMENTS);
+            else
+                for (int s = 0; ok && s < VECTORTESTSEGMENTS; s++)
+                    ok = SIRC_P->sendWrite(vectorIn[s].startAddress, vectorSlice, vectorIn[s].buffer);
+            ok = ok &&
+                SIRC_P->sendParamRegisterWrite(0, BANDWIDTHTESTSIZE) &&
+                SIRC_P->sendParamRegisterWrite(1, 3) &&
+                SIRC_P->sendRun() &&
+                SIRC_P->waitDone(4000);
+            if (vectored)
+                ok = ok && SIRC_P->sendReadV(vectorOut, VECTORTESTSEGMENTS);
+            else
+                for (int s = 0; ok && s < VECTORTESTSEGMENTS; s++)
+                    ok = SIRC_P->sendRead(vectorOut[s].startAddress, vectorSlice, vectorOut[s].buffer);
+            if (!ok){
+                tempStream << "Scattered transfer failed with code " << (int) SIRC_P->getLastError();
+                error(tempStream.str());
+            }
+
+            for (int s = 0; s < VECTORTESTSEGMENTS; s++){
+                for (tempInt = 0; tempInt < vectorSlice; tempInt++){
+                    if ((vectorIn[s].buffer[tempInt] * 3) % 256 != vectorOut[s].buffer[tempInt]){
+                        tempStream << "Scattered output #" << (int) (vectorOut[s].startAddress + tempInt) << " does not match expected value";
+                        error(tempStream.str());
+                    }
+                }
+            }
+        }
+        end = GetTickCount();
+        vectorTime[vectored] = max(end - start, (DWORD)1);
+    }
+
+    cout << "\tPer segment:         " << vectorTime[0] << " ms, " << ((double)VECTORTESTITER * 1000.0 / vectorTime[0]) << " blocks/s" << endl;
+    cout << "\tsendWriteV/ReadV:    " << vectorTime[1] << " ms, " << ((double)VECTORTESTITER * 1000.0 / vectorTime[1]) << " blocks/s" << endl;
+    for (int s = 0; s < VECTORTESTSEGMENTS; s++){
+        free(vectorIn[s].buffer);
+        free(vectorOut[s].buffer);
+    }
+	cout << "Passed test #13" << endl << endl;
+
+	//**** Put STREAMTESTBYTES through the multiply by 3 circuit, as many write and run
+	//chunks as it takes.  First from a callback, then from one block of memory.
+	cout << "****Beginning test #14 - streaming" << endl;
+    LogIt("main::****Testing streaming");
+    SIRC_STREAM_KERNEL multiplyBy3 = { 0, 1, 1, 0, 4000 };
+    SIRC_STREAM_STATISTICS streamStatistics;
+    STREAMTEST streamTest;
+    uint8_t *streamInput = (uint8_t *) malloc(STREAMTESTBYTES);
+
+    if (!streamInput)
+        error("Unable to allocate streaming input");
+    if (!SIRC_P->sendParamRegisterWrite(1, 3)){
+        tempStream << "Parameter register write failed with code " << (int) SIRC_P->getLastError();
+        error(tempStream.str());
+    }
+    SIRC_STREAM stream(SIRC_P, &multiplyBy3);
+    if (stream.getLastError() != 0){
+        tempStream << "Stream constructor failed with code " << (int) stream.getLastError();
+        error(tempStream.str());
+    }
+
+    for (int fromMemory = 0; fromMemory < 2; fromMemory++){
+        BOOL ok;
+
+        streamTest.sourceSeed = streamTest.sinkSeed = 14;
+        streamTest.sourceLeft = STREAMTESTBYTES;
+        streamTest.mismatches = 0;
+        if (fromMemory){
+            streamTestSource(streamInput, STREAMTESTBYTES, &streamTest);
+            ok = stream.runBuffer(streamInput, STREAMTESTBYTES, streamTestSink, &streamTest);
+        } else {
+            ok = stream.run(streamTestSource, &streamTest, streamTestSink, &streamTest);
+        }
+        if (!ok){
+            tempStream << "Stream failed with code " << (int) stream.getLastError();
+            error(tempStream.str());
+        }
+        stream.getStatistics(&streamStatistics);
+        if (streamTest.mismatches || streamStatistics.outputBytes != STREAMTESTBYTES){
+            tempStream << streamTest.mismatches << " streamed outputs do not match expected value";
+            error(tempStream.str());
+        }
+        cout << (fromMemory ? "\tFrom memory:   " : "\tFrom callback: ") << streamStatistics.elapsedMsec << " ms, "
+             << streamStatistics.chunks << " chunks of " << streamStatistics.chunkBytes << " bytes, "
+             << streamStatistics.inputMBps << " MB/s" << endl;
+    }
+    free(streamInput);
+	cout << "Passed test #14" << endl << endl;
+
 	delete SIRC_P;
+
+	//**** Write bandwidth with 1 to MULTIBOARDTESTBOARDS boards sharing one NIC, each
+	//with a thread of its own.  It should add up until the link is full.
+	cout << "****Beginning test #15 - boards sharing a NIC" << endl;
+    LogIt("main::****Testing multiple boards");
+    ETH_NIC nic(driverVersion, NULL);
+    SIRC *boardSirc[MULTIBOARDTESTBOARDS];
+    BOARDLOAD boardLoad[MULTIBOARDTESTBOARDS];
+    HANDLE boardThread[MULTIBOARDTESTBOARDS];
+    ETH_NIC_STATISTICS nicStatistics;
+    uint32_t numBoards;
+
+    if (nic.getLastError() != 0){
+        tempStream << "Shared NIC failed with code " << (int) nic.getLastError();
+        error(tempStream.str());
+    }
+    for (numBoards = 0; numBoards < MULTIBOARDTESTBOARDS; numBoards++){
+        uint8_t boardId[6];
+
+        memcpy(boardId, FPGA_ID, 6);
+        boardId[5] = (uint8_t) (FPGA_ID[5] + numBoards);
+        boardSirc[numBoards] = nic.openSession(boardId);
+        if (boardSirc[numBoards] == NULL || boardSirc[numBoards]->getLastError() != 0){
+            //No more boards out there
+            delete boardSirc[numBoards];
+            break;
+        }
+        //Same buffer sizes as the hw design, the rest is the board's share of the NIC
+        SIRC::PARAMETERS boardParams;
+        if (!boardSirc[numBoards]->getParameters(&boardParams, sizeof(boardParams))){
+            tempStream << "Cannot getParameters from board " << numBoards << ", code " << (int) boardSirc[numBoards]->getLastError();
+            error(tempStream.str());
+        }
+        boardParams.maxInputDataBytes = params.maxInputDataBytes;
+        boardParams.maxOutputDataBytes = params.maxOutputDataBytes;
+        if (!boardSirc[numBoards]->setParameters(&boardParams, sizeof(boardParams))){
+            tempStream << "Cannot setParameters on board " << numBoards << ", code " << (int) boardSirc[numBoards]->getLastError();
+            error(tempStream.str());
+        }
+        boardLoad[numBoards].sirc = boardSirc[numBoards];
+        boardLoad[numBoards].buffer = inputValues;
+
+        start = GetTickCount();
+        for (uint32_t b = 0; b <= numBoards; b++)
+            boardThread[b] = CreateThread(NULL, 0, &boardLoadThreadProc, (LPVOID) &boardLoad[b], 0, NULL);
+        WaitForMultipleObjects(numBoards + 1, boardThread, TRUE, INFINITE);
+        end = GetTickCount();
+        for (uint32_t b = 0; b <= numBoards; b++){
+            CloseHandle(boardThread[b]);
+            if (boardLoad[b].failed){
+                tempStream << "Write to board " << b << " failed with code " << (int) boardSirc[b]->getLastError();
+                error(tempStream.str());
+            }
+        }
+        double bw = ((double)8 * (double) BANDWIDTHTESTSIZE * (double)BANDWIDTHTESTITER * (numBoards + 1)) /
+            ((double)(end - start) * 1000.0);
+        cout << "\t" << (numBoards + 1) << " board(s): " << bw << " Mbps total, "
+             << (bw / (numBoards + 1)) << " Mbps each" << endl;
+    }
+    nic.getStatistics(&nicStatistics);
+    cout << "\tSteered " << nicStatistics.steered << " frames, discarded " << nicStatistics.discarded
+         << ", " << nicStatistics.handoffs << " handoffs" << endl;
+    if (numBoards == 0)
+        error("No board answered on the shared NIC");
+	cout << "Passed test #15" << endl << endl;
+
+	//**** The multiply by 3 circuit on all the boards at once: one logical call sharded
+	//over them, then the same data as independent jobs.  Register 0 gets each board's share.
+	cout << "****Beginning test #16 - device group over " << numBoards << " board(s)" << endl;
+    LogIt("main::****Testing a device group");
+    SIRC_GROUP group(boardSirc, numBoards, 1, 0);
+    SIRC_GROUP_STATISTICS groupStatistics;
+    SIRC_GROUP_MEMBER_STATISTICS memberStatistics;
+    SIRC_GROUP_JOB groupJobs[GROUPTESTJOBS];
+    uint32_t groupBytes = numOps * numBoards;
+    uint8_t *groupInput = (uint8_t *) malloc(groupBytes);
+    uint8_t *groupOutput = (uint8_t *) malloc(groupBytes);
+    uint32_t groupOutputLength;
+
+    assert(groupInput && groupOutput);
+    if (group.getLastError() != 0){
+        tempStream << "Device group failed with code " << (int) group.getLastError();
+        error(tempStream.str());
+    }
+    for (i = 0; i < groupBytes; i++)
+        groupInput[i] = rand() % 256;
+
+    start = GetTickCount();
+    if (!group.sendParamRegisterWrite(1, 3) || !group.sendWrite(0, groupBytes, groupInput) ||
+        !group.sendRun() || !group.waitDone(4000) || !group.sendRead(0, groupBytes, groupOutput)){
+        tempStream << "Sharded call failed with code " << (int) group.getLastError();
+        error(tempStream.str());
+    }
+    end = GetTickCount();
+    for (i = 0; i < groupBytes; i++){
+        if ((groupInput[i] * 3) % 256 != groupOutput[i]){
+            tempStream << "Sharded output #" << (int) i << " does not match expected value";
+            error(tempStream.str());
+        }
+    }
+    cout << "	Write, run, read: " << groupBytes << " bytes in " << (end - start) << " ms" << endl;
+
+    memset(groupOutput, 0, groupBytes);
+    start = GetTickCount();
+    if (!group.sendWriteAndRun(0, groupBytes, groupInput, 4000, groupOutput, groupBytes, &groupOutputLength) ||
+        groupOutputLength != groupBytes){
+        tempStream << "Sharded write & execute failed with code " << (int) group.getLastError();
+        error(tempStream.str());
+    }
+    end = GetTickCount();
+    for (i = 0; i < groupBytes; i++){
+        if ((groupInput[i] * 3) % 256 != groupOutput[i]){
+            tempStream << "Sharded write & execute output #" << (int) i << " does not match expected value";
+            error(tempStream.str());
+        }
+    }
+    cout << "	Write & execute: " << groupBytes << " bytes in " << (end - start) << " ms" << endl;
+
+    //Jobs as big as one board's share, so register 0 is right for all of them
+    memset(groupOutput, 0, groupBytes);
+    for (i = 0; i < GROUPTESTJOBS; i++){
+        uint32_t offset = (i % numBoards) * numOps;
+
+        memset(&groupJobs[i], 0, sizeof(groupJobs[i]));
+        groupJobs[i].inLength = numOps;
+        groupJobs[i].inData = groupInput + offset;
+        groupJobs[i].maxWaitTimeInMsec = 4000;
+        groupJobs[i].outData = groupOutput + offset;
+        groupJobs[i].maxOutLength = numOps;
+    }
+    start = GetTickCount();
+    if (!group.runJobs(groupJobs, GROUPTESTJOBS)){
+        tempStream << "Group jobs failed with code " << (int) group.getLastError();
+        error(tempStream.str());
+    }
+    end = GetTickCount();
+    for (i = 0; i < groupBytes; i++){
+        if ((groupInput[i] * 3) % 256 != groupOutput[i]){
+            tempStream << "Job output #" << (int) i << " does not match expected value";
+            error(tempStream.str());
+        }
+    }
+    cout << "	" << GROUPTESTJOBS << " jobs in " << (end - start) << " ms" << endl;
+
+    for (uint32_t b = 0; b < numBoards; b++){
+        group.getMemberStatistics(b, &memberStatistics);
+        cout << "	Board " << b << ": " << memberStatistics.calls << " calls, "
+             << memberStatistics.busyMsec << " ms busy, straggled " << memberStatistics.straggles << " times" << endl;
+    }
+    group.getStatistics(&groupStatistics);
+    cout << "	" << groupStatistics.straggles << " calls waited on a straggler, "
+         << groupStatistics.waitedMsec << " ms in all" << endl;
+    free(groupInput);
+    free(groupOutput);
+	cout << "Passed test #16" << endl << endl;
+
+	//**** The same block to every board: once per board, then once to a multicast group.
+	//Every board has to end up with it either way.
+	cout << "****Beginning test #17 - multicast writes to " << numBoards << " board(s)" << endl;
+    LogIt("main::****Testing multicast");
+    uint8_t groupMAC[6] = { 0x03, 0xAA, 0xAA, 0xAA, 0xAA, 0x01 };
+    ETH_MULTICAST_STATISTICS multicastStatistics;
+    uint32_t registerBack;
+
+    for (i = 0; i < numOps; i++)
+        inputValues[i] = rand() % 256;
+    start = GetTickCount();
+    for (uint32_t b = 0; b < numBoards; b++){
+        if (!boardSirc[b]->sendWrite(0, numOps, inputValues)){
+            tempStream << "Write to board " << b << " failed with code " << (int) boardSirc[b]->getLastError();
+            error(tempStream.str());
+        }
+    }
+    end = GetTickCount();
+    cout << "\tUnicast:   " << numOps << " bytes to each board in " << (end - start) << " ms" << endl;
+
+    {
+        //Sessions on the NIC are ETH_SIRCs
+        ETH_SIRC *boardEth[MULTIBOARDTESTBOARDS];
+        for (uint32_t b = 0; b < numBoards; b++)
+            boardEth[b] = static_cast<ETH_SIRC *>(boardSirc[b]);
+        ETH_MULTICAST multicast(groupMAC, boardEth, numBoards);
+
+        if (multicast.getLastError() != 0){
+            tempStream << "Multicast group failed with code " << (int) multicast.getLastError();
+            error(tempStream.str());
+        }
+        for (i = 0; i < numOps; i++)
+            inputValues[i] = rand() % 256;
+        start = GetTickCount();
+        if (!multicast.sendParamRegisterWrite(1, 5) || !multicast.sendWrite(0, numOps, inputValues)){
+            tempStream << "Multicast write failed with code " << (int) multicast.getLastError();
+            error(tempStream.str());
+        }
+        end = GetTickCount();
+        multicast.getStatistics(&multicastStatistics);
+        cout << "\tMulticast: " << numOps << " bytes to each board in " << (end - start) << " ms, "
+             << multicastStatistics.members << " board(s) in the group" << endl;
+        cout << "\t" << multicastStatistics.groupFrames << " group frames, " << multicastStatistics.repairs
+             << " repaired, " << multicastStatistics.unicastBytes << " bytes by unicast" << endl;
+    }
+
+    //Run each board on what it got and check
+    for (uint32_t b = 0; b < numBoards; b++){
+        if (!boardSirc[b]->sendParamRegisterRead(1, &registerBack) || registerBack != 5){
+            tempStream << "Board " << b << " did not get the multicast register write";
+            error(tempStream.str());
+        }
+        memset(outputValues, 0, numOps);
+        if (!boardSirc[b]->sendParamRegisterWrite(0, numOps) || !boardSirc[b]->sendRun() ||
+            !boardSirc[b]->waitDone(4000) || !boardSirc[b]->sendRead(0, numOps, outputValues)){
+            tempStream << "Run on board " << b << " failed with code " << (int) boardSirc[b]->getLastError();
+            error(tempStream.str());
+        }
+        for (i = 0; i < numOps; i++){
+            if ((inputValues[i] * 5) % 256 != outputValues[i]){
+                tempStream << "Board " << b << " output #" << (int) i << " does not match expected value";
+                error(tempStream.str());
+            }
+        }
+    }
+	cout << "Passed test #17" << endl << endl;
+
+	//**** The first board served by a broker, and used through it as another process
+	//would.  What does the extra hop cost per call?
+	cout << "****Beginning test #18 - broker overhead" << endl;
+    LogIt("main::****Testing the broker");
+    SIRC_BROKER broker(boardSirc[0], BROKERTESTNAME);
+    SIRC_BROKER_STATISTICS brokerStatistics;
+    BROKER_SIRC *client = NULL;
+    HANDLE brokerThread;
+    uint8_t *shared;
+    uint32_t sharedBytes;
+    double directAverage, brokerAverage, directWorst, brokerWorst, directBw, brokerBw, inPlaceBw;
+
+    if (broker.getLastError() != 0){
+        tempStream << "Broker failed with code " << (int) broker.getLastError();
+        error(tempStream.str());
+    }
+    brokerThread = CreateThread(NULL, 0, &brokerThreadProc, (LPVOID) &broker, 0, NULL);
+    //Until it is listening
+    for (i = 0; i < 100; i++){
+        client = new BROKER_SIRC(BROKERTESTNAME);
+        if (client->getLastError() == 0)
+            break;
+        delete client;
+        client = NULL;
+        Sleep(10);
+    }
+    if (client == NULL)
+        error("Cannot connect to the broker");
+    shared = client->getSharedBuffer(&sharedBytes);
+    assert(sharedBytes >= 2 * numOps && sharedBytes >= BANDWIDTHTESTSIZE);
+
+    //The circuit through the broker, from the shared buffer
+    for (i = 0; i < numOps; i++)
+        shared[i] = rand() % 256;
+    if (!client->sendParamRegisterWrite(0, numOps) || !client->sendParamRegisterWrite(1, 3) ||
+        !client->sendWriteAndRun(0, numOps, shared, 4000, shared + numOps, numOps, &numOpsReturned) ||
+        numOpsReturned != numOps){
+        tempStream << "Write & execute through the broker failed with code " << (int) client->getLastError();
+        error(tempStream.str());
+    }
+    for (i = 0; i < numOps; i++){
+        if ((shared[i] * 3) % 256 != shared[numOps + i]){
+            tempStream << "Broker output #" << (int) i << " does not match expected value";
+            error(tempStream.str());
+        }
+    }
+
+    measureControlLatency(boardSirc[0], &directAverage, &directWorst);
+    measureControlLatency(client, &brokerAverage, &brokerWorst);
+    cout << "\tRegister read: " << directAverage << " us direct, " << brokerAverage << " us through the broker, "
+         << (brokerAverage - directAverage) << " us added per call (worst " << directWorst << " / " << brokerWorst << " us)" << endl;
+
+    directBw = measureWriteBandwidth(boardSirc[0], inputValues);
+    brokerBw = measureWriteBandwidth(client, inputValues);
+    inPlaceBw = measureWriteBandwidth(client, shared);
+    cout << "\tWrite bandwidth: " << directBw << " Mbps direct, " << brokerBw << " Mbps through the broker, "
+         << inPlaceBw << " Mbps from the shared buffer" << endl;
+
+    delete client;
+    broker.stop();
+    WaitForSingleObject(brokerThread, INFINITE);
+    CloseHandle(brokerThread);
+    broker.getStatistics(&brokerStatistics);
+    cout << "\t" << brokerStatistics.calls << " calls, " << brokerStatistics.waits << " waited for their turn" << endl;
+	cout << "Passed test #18" << endl << endl;
+
+	//**** The first board served over TCP on this machine, and used through the proxy as
+	//a machine without a link to the board would.  How close to direct use does it get?
+	cout << "****Beginning test #19 - remote SIRC" << endl;
+    LogIt("main::****Testing the proxy");
+    SIRC_PROXY proxy(boardSirc[0], SIRC_REMOTE_PORT);
+    SIRC_PROXY_STATISTICS proxyStatistics;
+    REMOTE_SIRC *remote;
+    HANDLE proxyThread;
+    SIRC_REQUEST *lastWrite = NULL;
+    volatile int8_t remoteError = 0;
+    uint8_t *readBack;
+    double remoteAverage, remoteWorst, remoteBw, pipelinedBw, directReadBw, remoteReadBw;
+
+    if (proxy.getLastError() != 0){
+        tempStream << "Proxy failed with code " << (int) proxy.getLastError();
+        error(tempStream.str());
+    }
+    proxyThread = CreateThread(NULL, 0, &proxyThreadProc, (LPVOID) &proxy, 0, NULL);
+    //It is listening already, connections wait for run() to take them
+    remote = new REMOTE_SIRC("127.0.0.1", SIRC_REMOTE_PORT);
+    if (remote->getLastError() != 0){
+        tempStream << "Cannot connect to the proxy, code " << (int) remote->getLastError();
+        error(tempStream.str());
+    }
+
+    //The circuit through the proxy
+    for (i = 0; i < numOps; i++)
+        inputValues[i] = rand() % 256;
+    if (!remote->sendParamRegisterWrite(0, numOps) || !remote->sendParamRegisterWrite(1, 3) ||
+        !remote->sendWriteAndRun(0, numOps, inputValues, 4000, outputValues, numOps, &numOpsReturned) ||
+        numOpsReturned != numOps){
+        tempStream << "Write & execute through the proxy failed with code " << (int) remote->getLastError();
+        error(tempStream.str());
+    }
+    for (i = 0; i < numOps; i++){
+        if ((inputValues[i] * 3) % 256 != outputValues[i]){
+            tempStream << "Remote output #" << (int) i << " does not match expected value";
+            error(tempStream.str());
+        }
+    }
+
+    measureControlLatency(boardSirc[0], &directAverage, &directWorst);
+    measureControlLatency(remote, &remoteAverage, &remoteWorst);
+    cout << "\tRegister read: " << directAverage << " us direct, " << remoteAverage << " us remote, "
+         << (remoteAverage - directAverage) << " us added per call (worst " << directWorst << " / " << remoteWorst << " us)" << endl;
+
+    directBw = measureWriteBandwidth(boardSirc[0], inputValues);
+    remoteBw = measureWriteBandwidth(remote, inputValues);
+
+    //The same writes, all in flight at once
+    start = GetTickCount();
+    for (i = 0; i < BANDWIDTHTESTITER; i++){
+        if (lastWrite)
+            lastWrite->release();
+        lastWrite = remote->submitWrite(0, BANDWIDTHTESTSIZE, inputValues, recordFirstError, (void *) &remoteError);
+        if (!lastWrite)
+            error("Unable to submit remote write");
+    }
+    lastWrite->wait(INFINITE);
+    lastWrite->release();
+    end = GetTickCount();
+    if (remoteError){
+        tempStream << "Pipelined remote write failed with code " << (int) remoteError;
+        error(tempStream.str());
+    }
+    pipelinedBw = ((double)8 * (double) BANDWIDTHTESTSIZE * (double)BANDWIDTHTESTITER) /
+        ((double)max(end - start, (DWORD)1) * 1000.0);
+    cout << "\tWrite bandwidth: " << directBw << " Mbps direct, " << remoteBw << " Mbps remote, "
+         << pipelinedBw << " Mbps remote with submitWrite" << endl;
+
+    readBack = (uint8_t *) malloc(sizeof(uint8_t) * BANDWIDTHTESTSIZE);
+    if (!readBack)
+        error("Unable to allocate the read buffer");
+    directReadBw = measureReadBandwidth(boardSirc[0], readBack);
+    remoteReadBw = measureReadBandwidth(remote, readBack);
+    cout << "\tRead bandwidth: " << directReadBw << " Mbps direct, " << remoteReadBw << " Mbps remote" << endl;
+    free(readBack);
+
+    delete remote;
+    proxy.stop();
+    WaitForSingleObject(proxyThread, INFINITE);
+    CloseHandle(proxyThread);
+    proxy.getStatistics(&proxyStatistics);
+    cout << "\t" << proxyStatistics.commands << " commands, " << proxyStatistics.bytesIn << " bytes in, "
+         << proxyStatistics.bytesOut << " bytes out" << endl;
+	cout << "Passed test #19" << endl << endl;
+
+	//**** Read back with a parity frame every K data frames.  Parity costs bandwidth even
+	//when nothing is lost, and saves a readTimeout and a resend when one frame of a group is.
+	//Pick the smallest K that recovers most of what the link loses.
+	cout << "****Beginning test #20 - forward error correction" << endl;
+    LogIt("main::****Testing FEC");
+    {
+        static const uint32_t groups[] = {0, 16, 8, 4};
+        SIRC::PARAMETERS fecParams;
+        uint32_t recovered, parityFrames;
+        double readBw, plainReadBw = 0.0;
+
+        readBack = (uint8_t *) malloc(sizeof(uint8_t) * BANDWIDTHTESTSIZE);
+        if (!readBack)
+            error("Unable to allocate the read buffer");
+        for (i = 0; i < BANDWIDTHTESTSIZE; i++)
+            inputValues[i] = rand() % 256;
+        if (!boardSirc[0]->sendWrite(0, BANDWIDTHTESTSIZE, inputValues) ||
+            !boardSirc[0]->sendParamRegisterWrite(0, BANDWIDTHTESTSIZE) ||
+            !boardSirc[0]->sendParamRegisterWrite(1, 3) ||
+            !boardSirc[0]->sendRun() ||
+            !boardSirc[0]->waitDone(4000)){
+            tempStream << "FEC test setup failed with code " << (int) boardSirc[0]->getLastError();
+            error(tempStream.str());
+        }
+
+        for (uint32_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++){
+            if (!boardSirc[0]->getParameters(&fecParams, sizeof(fecParams))){
+                tempStream << "Cannot getParameters on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+                error(tempStream.str());
+            }
+            fecParams.fecGroup = groups[g];
+            if (!boardSirc[0]->setParameters(&fecParams, sizeof(fecParams)) ||
+                !boardSirc[0]->getParameters(&fecParams, sizeof(fecParams))){
+                tempStream << "Cannot set the FEC group on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+                error(tempStream.str());
+            }
+            recovered = fecParams.fecRecovered;
+            parityFrames = fecParams.fecParityFrames;
+
+            readBw = measureReadBandwidth(boardSirc[0], readBack);
+            for (i = 0; i < BANDWIDTHTESTSIZE; i++){
+                if ((inputValues[i] * 3) % 256 != readBack[i]){
+                    tempStream << "Output #" << (int) i << " does not match expected value";
+                    error(tempStream.str());
+                }
+            }
+
+            //Write & run brings its results back the same way
+            if (!boardSirc[0]->sendParamRegisterWrite(0, numOps) ||
+                !boardSirc[0]->sendWriteAndRun(0, numOps, inputValues, 4000, outputValues, numOps, &numOpsReturned) ||
+                numOpsReturned != numOps){
+                tempStream << "Write & execute with FEC failed with code " << (int) boardSirc[0]->getLastError();
+                error(tempStream.str());
+            }
+            for (i = 0; i < numOps; i++){
+                if ((inputValues[i] * 3) % 256 != outputValues[i]){
+                    tempStream << "Output #" << (int) i << " does not match expected value";
+                    error(tempStream.str());
+                }
+            }
+
+            if (!boardSirc[0]->getParameters(&fecParams, sizeof(fecParams))){
+                tempStream << "Cannot getParameters on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+                error(tempStream.str());
+            }
+            if (g == 0)
+                plainReadBw = readBw;
+            cout << "	Group " << groups[g] << " (agreed " << fecParams.fecGroup << "): read bandwidth = " << readBw
+                 << " Mbps, " << ((plainReadBw > 0.0) ? (100.0 * (plainReadBw - readBw) / plainReadBw) : 0.0)
+                 << "% below no FEC, " << (fecParams.fecParityFrames - parityFrames) << " parity frames, "
+                 << (fecParams.fecRecovered - recovered) << " frames recovered" << endl;
+        }
+
+        //Back to no parity
+        fecParams.fecGroup = 0;
+        if (!boardSirc[0]->setParameters(&fecParams, sizeof(fecParams))){
+            tempStream << "Cannot setParameters on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+            error(tempStream.str());
+        }
+        free(readBack);
+    }
+	cout << "Passed test #20" << endl << endl;
+
+	//**** Read the whole output buffer with few receives posted and the tuner off, so a
+	//response burst is larger than the ring.  Without credits the FPGA overruns it and
+	//the host asks again after readTimeout, with them it waits for the host to catch up.
+	cout << "****Beginning test #21 - receive credits" << endl;
+    LogIt("main::****Testing receive credits");
+    {
+        SIRC::PARAMETERS creditParams, savedParams;
+        uint32_t grants;
+        double readBw;
+
+        if (!boardSirc[0]->getParameters(&savedParams, sizeof(savedParams))){
+            tempStream << "Cannot getParameters on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+            error(tempStream.str());
+        }
+        creditParams = savedParams;
+        creditParams.autoTune = 0;
+        creditParams.maxOutstandingReads = CREDITTESTRECEIVES;
+        if (!boardSirc[0]->setParameters(&creditParams, sizeof(creditParams))){
+            //The driver has a fixed limit, live with it
+            cout << "	Receive limit fixed at " << savedParams.maxOutstandingReads << endl;
+            creditParams.maxOutstandingReads = savedParams.maxOutstandingReads;
+        }
+
+        readBack = (uint8_t *) malloc(sizeof(uint8_t) * savedParams.maxOutputDataBytes);
+        if (!readBack)
+            error("Unable to allocate the read buffer");
+
+        for (uint32_t c = 0; c < 2; c++){
+            creditParams.receiveCredits = c;
+            if (!boardSirc[0]->setParameters(&creditParams, sizeof(creditParams)) ||
+                !boardSirc[0]->getParameters(&creditParams, sizeof(creditParams))){
+                tempStream << "Cannot set receive credits on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+                error(tempStream.str());
+            }
+            grants = creditParams.creditGrants;
+
+            start = GetTickCount();
+            for (i = 0; i < PIPELINETESTITER; i++){
+                if (!boardSirc[0]->sendRead(0, savedParams.maxOutputDataBytes, readBack)){
+                    tempStream << "Read failed with code " << (int) boardSirc[0]->getLastError();
+                    error(tempStream.str());
+                }
+            }
+            end = GetTickCount();
+            readBw = ((double)8 * (double) savedParams.maxOutputDataBytes * (double)PIPELINETESTITER) /
+                ((double)max(end - start, (DWORD)1) * 1000.0);
+
+            if (!boardSirc[0]->getParameters(&creditParams, sizeof(creditParams))){
+                tempStream << "Cannot getParameters on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+                error(tempStream.str());
+            }
+            cout << "	Credits " << (c ? "on" : "off") << " (agreed " << creditParams.receiveCredits << "), "
+                 << creditParams.postedReceives << " receives posted: " << (end - start) << " ms, " << readBw << " Mbps, "
+                 << (creditParams.creditGrants - grants) << " credit frames" << endl;
+        }
+
+        free(readBack);
+        savedParams.receiveCredits = 0;
+        if (!boardSirc[0]->setParameters(&savedParams, sizeof(savedParams))){
+            tempStream << "Cannot setParameters on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+            error(tempStream.str());
+        }
+    }
+	cout << "Passed test #21" << endl << endl;
+
+	//**** Write a block, run, and make sure both the input and the results are right.
+	//Reading the results back costs the whole output on the wire again.  Asking the
+	//device for checksums costs one small frame each, and a CRC32C pass on the host.
+	cout << "****Beginning test #22 - checksums" << endl;
+    LogIt("main::****Testing checksums");
+    {
+        SIRC::PARAMETERS checkParams;
+        uint8_t *expected;
+        uint32_t bytes, crc;
+        double readBackBw, checksumBw;
+
+        if (!boardSirc[0]->getParameters(&checkParams, sizeof(checkParams))){
+            tempStream << "Cannot getParameters on SIRC interface, code " << (int) boardSirc[0]->getLastError();
+            error(tempStream.str());
+        }
+        bytes = min(checkParams.maxInputDataBytes, checkParams.maxOutputDataBytes);
+
+        free(inputValues);
+        inputValues = (uint8_t *) malloc(sizeof(uint8_t) * bytes);
+        expected = (uint8_t *) malloc(sizeof(uint8_t) * bytes);
+        readBack = (uint8_t *) malloc(sizeof(uint8_t) * bytes);
+        if (!inputValues || !expected || !readBack)
+            error("Unable to allocate the checksum test buffers");
+        for (i = 0; i < bytes; i++){
+            inputValues[i] = rand() % 256;
+            expected[i] = (inputValues[i] * 3) % 256;
+        }
+        if (!boardSirc[0]->sendParamRegisterWrite(0, bytes) ||
+            !boardSirc[0]->sendParamRegisterWrite(1, 3)){
+            tempStream << "Checksum test setup failed with code " << (int) boardSirc[0]->getLastError();
+            error(tempStream.str());
+        }
+
+        //Verified by reading the results back
+        start = GetTickCount();
+        for (uint32_t n = 0; n < PIPELINETESTITER; n++){
+            if (!boardSirc[0]->sendWrite(0, bytes, inputValues) ||
+                !boardSirc[0]->sendRun() ||
+                !boardSirc[0]->waitDone(4000) ||
+                !boardSirc[0]->sendRead(0, bytes, readBack)){
+                tempStream << "Write, run, read failed with code " << (int) boardSirc[0]->getLastError();
+                error(tempStream.str());
+            }
+            if (memcmp(readBack, expected, bytes) != 0)
+                error("Results read back do not match expected values");
+        }
+        end = GetTickCount();
+        readBackBw = ((double)8 * (double) bytes * (double)PIPELINETESTITER) /
+            ((double)max(end - start, (DWORD)1) * 1000.0);
+        cout << "	Readback: " << (end - start) << " ms, " << readBackBw << " Mbps" << endl;
+
+        //Verified by the device's checksums
+        if (!boardSirc[0]->sendChecksum(false, 0, bytes, &crc) &&
+            (boardSirc[0]->getLastError() == FAILNOCHECKSUM)){
+            cout << "	Device does not compute checksums" << endl;
+        }
+        else{
+            start = GetTickCount();
+            for (uint32_t n = 0; n < PIPELINETESTITER; n++){
+                if (!boardSirc[0]->sendWriteVerified(0, bytes, inputValues) ||
+                    !boardSirc[0]->sendRun() ||
+                    !boardSirc[0]->waitDone(4000) ||
+                    !boardSirc[0]->sendChecksum(true, 0, bytes, &crc)){
+                    tempStream << "Verified write, run, checksum failed with code " << (int) boardSirc[0]->getLastError();
+                    error(tempStream.str());
+                }
+                if (crc != sircCrc32c(0, expected, bytes))
+                    error("Results checksum does not match expected values");
+            }
+            end = GetTickCount();
+            checksumBw = ((double)8 * (double) bytes * (double)PIPELINETESTITER) /
+                ((double)max(end - start, (DWORD)1) * 1000.0);
+            cout << "	Checksums: " << (end - start) << " ms, " << checksumBw << " Mbps, "
+                 << ((readBackBw > 0.0) ? (100.0 * (checksumBw - readBackBw) / readBackBw) : 0.0)
+                 << "% above readback" << endl;
+        }
+
+        free(expected);
+        free(readBack);
+    }
+	cout << "Passed test #22" << endl << endl;
+
+	//**** Large transfers over PCIe, with 1 to 32 DMA segments in flight each way.
+	//Then the same bytes as one submitRead per segment, all in the queue together.
+	cout << "****Beginning test #23 - PCIe DMA queue depth" << endl;
+    LogIt("main::****Testing PCIe DMA queue depth");
+    {
+        PCIE2_SIRC *pcie = new PCIE2_SIRC();
+        SIRC::PARAMETERS dmaParams;
+        uint8_t *dmaBuffer;
+        SIRC_REQUEST *requests[DMATESTBYTES / (1024*1024)];
+        uint32_t segments = DMATESTBYTES / (1024*1024);
+        double writeBw, readBw;
+
+        if (pcie->getLastError() != 0){
+            cout << "	No PCIe board, skipped" << endl;
+        }
+        else{
+            dmaBuffer = (uint8_t *) malloc(DMATESTBYTES);
+            if (!dmaBuffer || !pcie->getParameters(&dmaParams, sizeof(dmaParams)))
+                error("Unable to set up the DMA queue test");
+            for (i = 0; i < DMATESTBYTES; i++)
+                dmaBuffer[i] = rand() % 256;
+
+            for (uint32_t depth = 1; depth <= 32; depth *= 2){
+                dmaParams.maxOutstandingReads = depth;
+                dmaParams.maxOutstandingWrites = depth;
+                if (!pcie->setParameters(&dmaParams, sizeof(dmaParams))){
+                    tempStream << "Cannot setParameters on PCIe interface, code " << (int) pcie->getLastError();
+                    error(tempStream.str());
+                }
+
+                start = GetTickCount();
+                for (uint32_t n = 0; n < DMATESTITER; n++){
+                    if (!pcie->sendWrite(0, DMATESTBYTES, dmaBuffer)){
+                        tempStream << "Write to FPGA failed with code " << (int) pcie->getLastError();
+                        error(tempStream.str());
+                    }
+                }
+                end = GetTickCount();
+                writeBw = ((double)8 * (double) DMATESTBYTES * (double)DMATESTITER) /
+                    ((double)max(end - start, (DWORD)1) * 1000.0);
+
+                start = GetTickCount();
+                for (uint32_t n = 0; n < DMATESTITER; n++){
+                    if (!pcie->sendRead(0, DMATESTBYTES, dmaBuffer)){
+                        tempStream << "Read from FPGA failed with code " << (int) pcie->getLastError();
+                        error(tempStream.str());
+                    }
+                }
+                end = GetTickCount();
+                readBw = ((double)8 * (double) DMATESTBYTES * (double)DMATESTITER) /
+                    ((double)max(end - start, (DWORD)1) * 1000.0);
+                cout << "	Depth " << depth << ": write " << writeBw << " Mbps, read " << readBw << " Mbps" << endl;
+            }
+
+            //Every segment its own request
+            start = GetTickCount();
+            for (uint32_t n = 0; n < DMATESTITER; n++){
+                for (uint32_t s = 0; s < segments; s++){
+                    requests[s] = pcie->submitRead(s * 1024*1024, 1024*1024, dmaBuffer + s * 1024*1024);
+                    if (requests[s] == NULL)
+                        error("submitRead failed");
+                }
+                for (uint32_t s = 0; s < segments; s++){
+                    if (!requests[s]->wait(4000) || (requests[s]->getError() != 0)){
+                        tempStream << "Submitted read failed with code " << (int) requests[s]->getError();
+                        error(tempStream.str());
+                    }
+                    requests[s]->release();
+                }
+            }
+            end = GetTickCount();
+            readBw = ((double)8 * (double) DMATESTBYTES * (double)DMATESTITER) /
+                ((double)max(end - start, (DWORD)1) * 1000.0);
+            cout << "	" << segments << " submitted reads per pass: " << readBw << " Mbps" << endl;
+
+            free(dmaBuffer);
+        }
+        delete pcie;
+    }
+	cout << "Passed test #23" << endl << endl;
+
+    for (uint32_t b = 0; b < numBoards; b++)
+        delete boardSirc[b];
+
 	free(inputValues);
 	free(outputValues);
 
@@ -0,0 +1,216 @@
+// Title: Coroutine concurrency example
+//
+// Description: Many logical experiments, each a coroutine on one sirc_coro.h event loop,
+// sharing one or more boards running the multiply-by-3 test circuit (or the srv_main
+// loopback server).  Each experiment owns a slice of the 8KB buffers and keeps writing
+// and reading it back.  The total data moved is the same for every experiment count,
+// so the times show what it costs (or saves) to have that many of them in flight.
+// At the end the whole input goes through the circuit once to check the result.
+//
+//      coro_SW_Example [FPGA_MAC_addr ...]
+//
+// Build as a console program with a C++20 compiler (/std:c++latest) against Sirc_lib
+// or eth_sirc_lib.  SW_Example.cpp is C++/CLI, which has no coroutines.
+//
+// Created: 10/19/26
+//
+// Version: 1.00
+//
+//
+// Changelog:
+//
+//----------------------------------------------------------------------------
+//
+#include <windows.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <iomanip>
+#include <vector>
+#include <stdlib.h>
+
+#include "sirc.h"
+#include "sirc_error.h"
+#include "sirc_util.h"
+#include "sirc_coro.h"
+#include "log.h"
+
+using namespace std;
+
+//Buffer size, the smaller of the circuit's input and output memories
+#define COROTESTSIZE 8*1024
+
+//How many times each experiment writes and reads its slice
+#define COROTESTROUNDS 50
+
+//Most boards we take from the command line
+#define COROMAXBOARDS 8
+
+void error(string inErr){
+	cerr << "Error:" << endl;
+	cerr << "\t" << inErr << endl;
+	exit(-1);
+}
+
+//One experiment: write a slice, read it back, compare, again
+SircCoro::Task experiment(SircCoro::Board &board, uint32_t offset, uint32_t length,
+                          uint8_t *in, uint8_t *back, uint32_t *mismatches)
+{
+    for (uint32_t round = 0; round < COROTESTROUNDS; round++){
+        for (uint32_t i = 0; i < length; i++)
+            in[offset + i] = (uint8_t) rand();
+
+        co_await board.write(offset, length, in + offset);
+        co_await board.read(offset, length, back + offset);
+
+        for (uint32_t i = 0; i < length; i++)
+            if (in[offset + i] != back[offset + i])
+                (*mismatches)++;
+    }
+}
+
+//Run the circuit over everything, without exceptions this time
+SircCoro::Task multiplyBy3(SircCoro::Board &board, uint8_t *in, uint8_t *out, int8_t *failure)
+{
+    SircCoro::Result step;
+
+    step = co_await board.paramRegisterWrite(0, COROTESTSIZE).result();
+    if (step)
+        step = co_await board.paramRegisterWrite(1, 3).result();
+    if (step)
+        step = co_await board.run().result();
+    if (step)
+        step = co_await board.waitDone(4000).result();
+    if (step)
+        step = co_await board.read(0, COROTESTSIZE, out).result();
+    *failure = step.error;
+}
+
+int main(int argc, char* argv[]){
+    SIRC *sircs[COROMAXBOARDS];
+    uint8_t FPGA_ID[6];
+    uint32_t numBoards = 0;
+    uint8_t *inputValues[COROMAXBOARDS];
+    uint8_t *readValues[COROMAXBOARDS];
+    uint8_t *outputValues;
+    static const uint32_t experimentCounts[] = {1, 16, 256, 4096};
+    DWORD start, end, firstTime = 0;
+
+    std::ostringstream tempStream;
+
+    StartLog();
+
+	//**** Open every board on the command line, or the default one
+    for (int a = 1; a < max(argc, 2) && numBoards < COROMAXBOARDS; a++){
+        if (argc > 1){
+            if (hexToFpgaId(argv[a], FPGA_ID, sizeof(FPGA_ID)) != 6)
+                error("Invalid MAC address " + (string) argv[a]);
+        } else {
+            cout << "****USING DEFAULT MAC ADDRESS - AA:AA:AA:AA:AA:AA" << endl;
+            memset(FPGA_ID, 0xAA, sizeof(FPGA_ID));
+        }
+
+        sircs[numBoards] = openSirc(FPGA_ID, 0);
+        if (sircs[numBoards] == NULL)
+            error("Unable to find a suitable SIRC driver");
+        if (sircs[numBoards]->getLastError() != 0){
+            tempStream << "Constructor failed with code " << (int) sircs[numBoards]->getLastError();
+            error(tempStream.str());
+        }
+
+        //These MUST match the buffer sizes in the hw design.
+        SIRC::PARAMETERS params;
+        if (!sircs[numBoards]->getParameters(&params, sizeof(params))){
+            tempStream << "Cannot getParameters from SIRC interface, code " << (int) sircs[numBoards]->getLastError();
+            error(tempStream.str());
+        }
+        params.maxInputDataBytes  = 1<<17; //2**17 128KBytes
+        params.maxOutputDataBytes = 1<<13; //2**13 8KBytes
+        if (!sircs[numBoards]->setParameters(&params, sizeof(params))){
+            tempStream << "Cannot setParameters on SIRC interface, code " << (int) sircs[numBoards]->getLastError();
+            error(tempStream.str());
+        }
+
+        inputValues[numBoards] = (uint8_t *) malloc(COROTESTSIZE);
+        readValues[numBoards] = (uint8_t *) malloc(COROTESTSIZE);
+        if (!inputValues[numBoards] || !readValues[numBoards])
+            error("Unable to allocate buffers");
+        numBoards++;
+    }
+    outputValues = (uint8_t *) malloc(COROTESTSIZE);
+    if (!outputValues)
+        error("Unable to allocate buffers");
+
+    SircCoro::EventLoop loop;
+    vector <SircCoro::Board> boards;
+    for (uint32_t b = 0; b < numBoards; b++)
+        boards.push_back(SircCoro::Board(loop, sircs[b]));
+
+	//**** Same data, more and more experiments.  Experiments are dealt out to the
+	//boards in turn, each board's buffer is split between the ones it got.
+    cout << "****Coroutine concurrency, " << numBoards << " board(s), "
+         << COROTESTROUNDS << " x " << COROTESTSIZE << " bytes per board" << endl;
+    for (size_t c = 0; c < sizeof(experimentCounts) / sizeof(experimentCounts[0]); c++){
+        uint32_t count = max(experimentCounts[c], numBoards);
+        uint32_t perBoard = count / numBoards;
+        uint32_t slice = COROTESTSIZE / perBoard;
+        uint32_t mismatches = 0;
+        uint32_t failed;
+
+        LogIt(LOGIT_TIME_MARKER);
+        start = GetTickCount();
+        for (uint32_t e = 0; e < perBoard * numBoards; e++){
+            uint32_t b = e % numBoards;
+            loop.spawn(experiment(boards[b], (e / numBoards) * slice, slice,
+                                  inputValues[b], readValues[b], &mismatches));
+        }
+        failed = loop.run();
+        end = GetTickCount();
+
+        if (failed){
+            tempStream << failed << " experiments failed with " << count << " in flight, code "
+                       << (int) sircs[0]->getLastError();
+            error(tempStream.str());
+        }
+        if (mismatches){
+            tempStream << mismatches << " bytes read back wrong with " << count << " in flight";
+            error(tempStream.str());
+        }
+
+        DWORD elapsed = max(end - start, (DWORD)1);
+        if (firstTime == 0)
+            firstTime = elapsed;
+        cout << "\t" << setw(5) << perBoard * numBoards << " experiments: " << setw(6) << elapsed << " ms, "
+             << ((double) COROTESTROUNDS * COROTESTSIZE * numBoards * 2 / 1024 / 1024 * 1000.0 / elapsed)
+             << " MB/s, x" << ((double) firstTime / elapsed) << endl;
+    }
+
+	//**** The last round left each board's input buffer full, put it through the circuit
+    for (uint32_t b = 0; b < numBoards; b++){
+        int8_t failure = 0;
+
+        loop.spawn(multiplyBy3(boards[b], inputValues[b], outputValues, &failure));
+        loop.run();
+        if (failure){
+            tempStream << "Multiply by 3 failed with code " << (int) failure;
+            error(tempStream.str());
+        }
+        for (uint32_t i = 0; i < COROTESTSIZE; i++){
+            if ((uint8_t)(inputValues[b][i] * 3) != outputValues[i]){
+                tempStream << "Output #" << i << " of board " << b << " does not match expected value";
+                error(tempStream.str());
+            }
+        }
+    }
+    cout << "Passed" << endl << endl;
+
+    for (uint32_t b = 0; b < numBoards; b++){
+        delete sircs[b];
+        free(inputValues[b]);
+        free(readValues[b]);
+    }
+    free(outputValues);
+
+    PrintZeLog();
+	return 0;
+}
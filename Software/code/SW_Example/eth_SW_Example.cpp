@@ -133,7 +133,9 @@ void adjustCounters(bool byteNum, int val){
 int main(int argc, char* argv[]){
 
 	//Test harness variables
-	ETH_SIRC *SIRC_P;
+	SIRC *SIRC_P;
+	SIRC_SUPERVISOR *supervisor;
+	SIRC_SUPERVISOR_STATISTICS recovery;
 	uint8_t FPGA_ID[6];
 	bool FPGA_ID_DEF = false;
 
@@ -227,8 +229,10 @@ int main(int argc, char* argv[]){
 	}
 
 	//**** Set up communication with FPGA
-	//Create communication object
-	SIRC_P = new ETH_SIRC(FPGA_ID, driverVersion, NULL);
+	//Create communication object.  The runs take hours, so the supervisor gets the board
+	// going again after a stall instead of ending the run.
+	supervisor = new SIRC_SUPERVISOR(new ETH_SIRC(FPGA_ID, driverVersion, NULL), true);
+	SIRC_P = supervisor;
 	//Make sure that the constructor didn't run into trouble
     if (SIRC_P == NULL){
 		tempStream << "Unable to find a suitable SIRC driver or unable to ";
@@ -474,6 +478,11 @@ int main(int argc, char* argv[]){
 		cout<<(int)inputValues[i]<<", ";
 	}
 	cout<<endl<<endl<<endl;
+
+	//What the supervisor had to do
+	supervisor->getStatistics(&recovery);
+	cout<<"Recoveries: "<<recovery.recoveries<<" ("<<recovery.stalls<<" stalls, "
+		<<recovery.failedRecoveries<<" failed), time lost: "<<recovery.lostMsec<<" ms"<<endl<<endl;
 	
 //################################################      End of report    ###################################################################
 
@@ -517,6 +526,8 @@ int main(int argc, char* argv[]){
 	}
 
 	outfile<<endl<<endl<<"# of runs: "<<runSize;
+	outfile<<endl<<"Recoveries: "<<recovery.recoveries<<" ("<<recovery.stalls<<" stalls, "
+		<<recovery.failedRecoveries<<" failed), time lost: "<<recovery.lostMsec<<" ms";
 	outfile.close();
 
 //###########################################     End of writing    ###############################################################